@@ -0,0 +1,47 @@
+#ifndef ADAPTIVE_SAMPLING_H
+#define ADAPTIVE_SAMPLING_H
+
+#include <stdint.h>
+#include "sensor_channels.h"
+
+/*
+ * =================================================
+ * ███████████████ CONFIGURATION ███████████████████
+ * =================================================
+ */
+
+// Adaptive sampling: after every sample, a sensor's period is set from
+// how close its channels are to their first threshold (the warning level,
+// or the alarm level if there is none, as used by checkSafetyAndAlert())
+// and how fast they approach it:
+//   - by level: the slowest period while a reading has
+//     ADAPT_HEADROOM_FULL of its threshold to go, shrinking linearly to
+//     the fastest at the threshold; at or above it the fastest
+//   - by slope: at the smoothed rate of rise, at least
+//     ADAPT_SAMPLES_TO_THRESHOLD samples before the threshold is reached
+// The shortest wins at once; when the signal is flat the period grows by
+// at most ADAPT_GROWTH per sample. The rate of rise is smoothed over time,
+// not samples, so sampling faster does not make it noisier. Channels
+// without thresholds do not take part.
+#define ADAPT_HEADROOM_FULL 0.5f // Fraction of the threshold
+#define ADAPT_SAMPLES_TO_THRESHOLD 20
+#define ADAPT_SMOOTHING_MS 3000 // Time constant of the level and rate of rise
+#define ADAPT_GROWTH 1.25f
+#define ADAPT_RETIME_STEP 0.1f // Smaller relative changes are not applied
+
+// Default bounds per sensor: X(sensor, fastest period µs, slowest period µs).
+// Sensors not listed keep their fixed period. Both bounds can be changed
+// at runtime (<sensor>.min_period_ms / .max_period_ms, <sensor>.adaptive=off),
+// see runtime_config.h.
+#define ADAPTIVE_SAMPLING_TABLE(X) \
+    X(MQ2, 250000, 5000000)
+
+/*
+ * =================================================
+ * ███████████████ FUNCTION DECLARATION ████████████
+ * =================================================
+ */
+
+void updateAdaptiveSampling(SensorGroup group, uint32_t nowMs);
+
+#endif
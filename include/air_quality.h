@@ -0,0 +1,64 @@
+#ifndef AIR_QUALITY_H
+#define AIR_QUALITY_H
+
+#include <stdint.h>
+
+/*
+ * =================================================
+ * ███████████████ CONFIGURATION ███████████████████
+ * =================================================
+ */
+
+// Humidity compensation: metal-oxide gas resistance falls as humidity
+// rises, roughly exponentially. Readings are normalised to the reference
+// humidity before they are compared with the baseline.
+#define IAQ_HUMIDITY_REFERENCE 40.0f // %RH
+#define IAQ_HUMIDITY_SLOPE 0.03f     // ln(kΩ) per %RH, typical for the BME680 plate
+
+// Score split: 75% gas, 25% humidity distance from the reference
+#define IAQ_GAS_WEIGHT 75.0f
+#define IAQ_HUMIDITY_WEIGHT 25.0f
+
+// CO2-equivalent: a linear rescaling of the IAQ index, not a CO2 measurement
+#define IAQ_ECO2_BASE_PPM 400.0f
+#define IAQ_ECO2_PPM_PER_INDEX 6.0f
+
+#define IAQ_SETTLE_MS 1800000UL // Baseline learned this boot counts as settled after 30 min
+
+// Accuracy of the published IAQ, published as the iaq_accuracy channel
+enum IaqAccuracy
+{
+    IAQ_STABILIZING = 0, // Gas heater warming up, or no baseline yet
+    IAQ_LEARNING = 1,    // Baseline is being learned from scratch
+    IAQ_CALIBRATED = 2   // Baseline loaded from NVS or settled
+};
+
+/*
+ * =================================================
+ * ███████████████ DATA STRUCTURES █████████████████
+ * =================================================
+ */
+
+// IAQ index (0 excellent to 500 hazardous) and its CO2-equivalent
+struct AirQualityEstimate
+{
+    float iaq;
+    float eco2; // ppm
+};
+
+/*
+ * =================================================
+ * ███████████████ FUNCTION DECLARATION ████████████
+ * =================================================
+ */
+
+// Kernels (air_quality_kernels.cpp, plain C++)
+float compensateGasResistance(float gasKOhm, float humidity);
+AirQualityEstimate estimateAirQuality(float compensatedKOhm, float humidity, float baselineKOhm);
+IaqAccuracy classifyAirQualityAccuracy(float baselineKOhm, uint32_t nowMs, bool baselineCached,
+                                       uint32_t &learningStartMs);
+
+// Channel update (air_quality.cpp)
+void updateAirQuality(float gasKOhm, float humidity);
+
+#endif
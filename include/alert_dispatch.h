@@ -0,0 +1,27 @@
+#ifndef ALERT_DISPATCH_H
+#define ALERT_DISPATCH_H
+
+/*
+ * =================================================
+ * ███████████████ CONFIGURATION ███████████████████
+ * =================================================
+ */
+
+// Alert task: sets the NeoPixel status and publishes early-warning events
+// as soon as a sampler raises them, instead of at loop()'s next publish,
+// up to a whole display cycle (about 70 s) later. It owns the NeoPixels;
+// loop() and the samplers only ask it for an update.
+#define ALERT_TASK_STACK 4096
+#define ALERT_TASK_PRIORITY 2 // Above loop(), below the spectrum and sampler tasks
+#define ALERT_RETRY_MS 1000   // Retry for events the broker connection did not take
+
+/*
+ * =================================================
+ * ███████████████ FUNCTION DECLARATION ████████████
+ * =================================================
+ */
+
+void startAlertDispatch();
+void requestAlertUpdate();
+
+#endif
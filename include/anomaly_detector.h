@@ -0,0 +1,133 @@
+#ifndef ANOMALY_DETECTOR_H
+#define ANOMALY_DETECTOR_H
+
+#include <stdint.h>
+#include "sensor_channels.h"
+
+/*
+ * =================================================
+ * ███████████████ CONFIGURATION ███████████████████
+ * =================================================
+ */
+
+// Streaming early-warning detectors on the readings that rise first in a
+// fire or leak, well before the absolute thresholds. Every sample updates,
+// in O(1) and without a square root:
+//   - an exponentially weighted baseline and mean absolute deviation,
+//     giving a z-score of the new sample against the baseline
+//   - an exponentially weighted rate of change (units per second)
+//   - a one-sided CUSUM of the z-score, for slow sustained rises
+// An anomaly starts when any of them crosses its limit and ends after
+// ANOMALY_CLEAR_PERIODS without one.
+//
+// Weights and counts are per default sampling period of the channel's
+// sensor (SENSOR_GROUP_TABLE: 1 s for the MQ-2, 10 s for the BME680).
+// Each sample is weighted by the time since the previous one, so adaptive
+// sampling changes how finely a channel is watched, not its time
+// constants.
+#define ANOMALY_BASELINE_ALPHA 0.05f // Baseline and deviation weight (~20 periods)
+#define ANOMALY_RATE_ALPHA 0.3f      // Rate of change weight (~3 periods)
+#define ANOMALY_WARMUP_PERIODS 30    // Before a detector may fire
+#define ANOMALY_Z_LIMIT 4.0f         // Sample this many deviations above the baseline
+#define ANOMALY_RATE_MIN_Z 2.0f      // The rate only counts once the reading has left the noise
+#define ANOMALY_CUSUM_DRIFT 0.5f     // CUSUM allowance per period, in deviations
+#define ANOMALY_CUSUM_LIMIT 8.0f     // CUSUM decision level, in deviations
+#define ANOMALY_CLEAR_PERIODS 10
+#define ANOMALY_MAX_STEP_PERIODS 10.0f // A longer gap (skipped samples) counts as this
+#define ANOMALY_EVENT_QUEUE 8 // Start/end events kept for the MQTT publisher
+
+// Watched channels: X(channel, rate limit, noise floor)
+//   rate limit   rise per second, as a fraction of the baseline
+//   noise floor  smallest deviation (channel units) a z-score is taken
+//                against, and smallest baseline for the rate limit, so a
+//                flat clean-air reading does not turn noise into sigmas
+#define ANOMALY_CHANNEL_TABLE(X) \
+    X(LPG, 0.10f, 2.0f)          \
+    X(CO, 0.10f, 1.0f)           \
+    X(SMOKE, 0.10f, 2.0f)        \
+    X(IAQ, 0.05f, 5.0f)
+
+#define ANOMALY_CHANNEL_ENUM(channel, rateLimit, noiseFloor) ANOMALY_##channel,
+enum AnomalyChannel
+{
+    ANOMALY_CHANNEL_TABLE(ANOMALY_CHANNEL_ENUM)
+    NUM_ANOMALY_CHANNELS
+};
+#undef ANOMALY_CHANNEL_ENUM
+
+// What fired, as bits
+enum AnomalyTrigger
+{
+    ANOMALY_TRIGGER_Z = 1 << 0,
+    ANOMALY_TRIGGER_RATE = 1 << 1,
+    ANOMALY_TRIGGER_CUSUM = 1 << 2
+};
+#define NUM_ANOMALY_TRIGGERS 3
+
+/*
+ * =================================================
+ * ███████████████ DATA STRUCTURES █████████████████
+ * =================================================
+ */
+
+// Detector state of one channel
+struct AnomalyDetector
+{
+    float baseline;   // EWMA of the readings
+    float deviation;  // EWMA of |reading - baseline|
+    float rate;       // EWMA of the rate of change, units per second
+    float cusum;      // Upward CUSUM of the z-score
+    float lastValue;
+    uint32_t lastMs;
+    float periods;    // Default periods since the first sample, up to ANOMALY_WARMUP_PERIODS
+    float quiet;      // Default periods without a trigger during an anomaly
+    bool started;     // A first sample has been taken
+    uint8_t triggers; // AnomalyTrigger bits of the current anomaly, 0 if none
+};
+
+// Start or end of an anomaly
+struct AnomalyEvent
+{
+    uint32_t sequence; // 1, 2, ... in order of occurrence
+    AnomalyChannel channel;
+    bool start;
+    uint8_t triggers;  // Everything that fired during the anomaly
+    float value;       // Reading that started or ended it
+    float baseline;
+    float zScore;
+    float ratePerS;
+    float cusum;
+    uint32_t timestampS; // Seconds since boot
+};
+
+// Counters and current state of one channel
+struct AnomalyStatus
+{
+    uint32_t events;  // Anomalies since boot
+    uint8_t triggers; // Current anomaly, 0 if none
+    float baseline;
+    float ratePerS;
+};
+
+/*
+ * =================================================
+ * ███████████████ GLOBAL VARIABLES ████████████████
+ * =================================================
+ */
+
+extern const SensorChannel ANOMALY_CHANNELS[NUM_ANOMALY_CHANNELS];
+extern const char *const ANOMALY_TRIGGER_NAMES[NUM_ANOMALY_TRIGGERS];
+
+/*
+ * =================================================
+ * ███████████████ FUNCTION DECLARATION ████████████
+ * =================================================
+ */
+
+void updateAnomalyDetector(SensorChannel channel, float value, uint32_t nowMs);
+bool isAnomalyActive();
+AnomalyStatus getAnomalyStatus(AnomalyChannel channel);
+uint32_t getLastAnomalySequence();
+bool getAnomalyEvent(uint32_t sequence, AnomalyEvent &event);
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef BATCH_MODE_H
+#define BATCH_MODE_H
+
+/*
+ * =================================================
+ * ███████████████ CONFIGURATION ███████████████████
+ * =================================================
+ */
+
+#define BATCH_SLEEP_SECONDS 60           // Deep-sleep period between samples
+#define BATCH_UPLOAD_EVERY 10            // Bring Wi-Fi up every N wakes
+#define BATCH_CAPACITY 64                // Samples buffered in RTC slow memory
+#define BATCH_CONNECT_TIMEOUT_MS 15000   // Give up on the broker after this
+#define BATCH_FLUSH_TIMEOUT_MS 5000      // Wait for the batch to leave the device
+
+/*
+ * =================================================
+ * ███████████████ FUNCTION DECLARATION ████████████
+ * =================================================
+ */
+
+void runBatchModeCycle();
+
+#endif
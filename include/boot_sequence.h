@@ -0,0 +1,32 @@
+#ifndef BOOT_SEQUENCE_H
+#define BOOT_SEQUENCE_H
+
+#include <stdint.h>
+
+/*
+ * =================================================
+ * ███████████████ CONFIGURATION ███████████████████
+ * =================================================
+ */
+
+#define BOOT_BUDGET_MS 2000           // Target time from reset to first sample
+#define BOOT_NETWORK_TASK_STACK 6144  // Wi-Fi association and OTA setup
+#define BOOT_SELF_TEST_TASK_STACK 2048
+
+// Define BOOT_SELF_TEST to run the NeoPixel and buzzer tests at boot. They
+// run in the background after the first sample instead of delaying it.
+
+/*
+ * =================================================
+ * ███████████████ FUNCTION DECLARATION ████████████
+ * =================================================
+ */
+
+void startNetworkBoot();
+bool isNetworkReady();
+void startSelfTests();
+bool isSelfTestRunning();
+void markFirstSample();
+void markFirstPublish();
+
+#endif
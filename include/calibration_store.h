@@ -0,0 +1,67 @@
+#ifndef CALIBRATION_STORE_H
+#define CALIBRATION_STORE_H
+
+#include <stdint.h>
+
+/*
+ * =================================================
+ * ███████████████ CONFIGURATION ███████████████████
+ * =================================================
+ */
+
+#define CAL_NVS_NAMESPACE "calib"
+#define CAL_VERSION 2 // Bump to discard caches written by an incompatible format
+
+// Background baseline tracking. Clean air gives the highest sensor
+// resistance for both the MQ-2 and the BME680 gas plate, so the baseline
+// follows rises quickly and falls only very slowly; a gas incident barely
+// moves it. The weights are per default sampling period of the sensor
+// (SENSOR_GROUP_TABLE); each sample is weighted by the time since the
+// previous one, so adaptive sampling does not change the time constants.
+#define CAL_WARMUP_MS 300000UL  // Heaters need a few minutes before tracking starts
+#define CAL_ALPHA_RISE 0.02f    // Weight per period when resistance goes up
+#define CAL_ALPHA_FALL 0.0005f  // Weight per period when resistance goes down
+
+// Flash wear bound: a baseline is written back at most once per
+// CAL_WRITE_INTERVAL_MS of uptime, and only if it moved by more than
+// CAL_WRITE_THRESHOLD. That is at most 4 writes/day, or about 1500 a year.
+// NVS spreads these over its pages, so each flash sector sees a handful
+// of erase cycles a year against a rating of ~100k. Reboots never
+// trigger a write once a cache exists.
+#define CAL_WRITE_INTERVAL_MS (6UL * 3600UL * 1000UL)
+#define CAL_WRITE_THRESHOLD 0.02f // Relative change
+
+/*
+ * =================================================
+ * ███████████████ DATA STRUCTURES █████████████████
+ * =================================================
+ */
+
+struct CalibrationStats
+{
+    float mq2R0;            // Current MQ-2 clean-air resistance (kΩ)
+    float gasBaseline;      // Current BME680 clean-air gas resistance at the IAQ reference humidity (kΩ), 0 if unknown
+    bool loadedFromNvs;     // Boot used the cached R0 instead of calibrating
+    bool gasBaselineCached; // Gas baseline came from NVS rather than this boot
+    uint32_t nvsWrites;     // Lifetime write-backs
+};
+
+/*
+ * =================================================
+ * ███████████████ FUNCTION DECLARATION ████████████
+ * =================================================
+ */
+
+// Baseline kernel (calibration_kernels.cpp, plain C++)
+float stepBaseline(float baseline, float sample, float periods);
+
+// NVS-backed baselines (calibration_store.cpp)
+void initializeCalibrationStore();
+bool getCachedMQ2R0(float &r0);
+void storeMQ2R0(float r0);
+void updateMQ2Baseline(float r0Estimate);
+void updateGasBaseline(float gasKOhm);
+float getGasBaseline();
+CalibrationStats getCalibrationStats();
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef DIAGNOSTICS_H
+#define DIAGNOSTICS_H
+
+#include <stdint.h>
+
+/*
+ * =================================================
+ * ███████████████ DATA STRUCTURES █████████████████
+ * =================================================
+ */
+
+// Internal counters exposed on /metrics and the diagnostics topics
+struct SystemMetrics
+{
+    uint32_t loopCount;      // Completed loop() cycles
+    uint32_t loopTimeMs;     // Duration of the last loop() cycle
+    uint32_t maxLoopTimeMs;  // Longest loop() cycle since boot
+    uint32_t mqttReconnects; // Successful MQTT (re)connections
+    uint32_t wifiReconnects; // Wi-Fi reconnections from checkWiFi()
+    uint32_t firstSampleMs;  // Reset to first complete set of readings
+    uint32_t networkReadyMs; // Reset to Wi-Fi associated and OTA up
+    uint32_t firstPublishMs; // Reset to first readings sent to the broker
+};
+
+extern SystemMetrics systemMetrics;
+
+/*
+ * =================================================
+ * ███████████████ FUNCTION DECLARATION ████████████
+ * =================================================
+ */
+
+void beginLoopTiming();
+void endLoopTiming();
+
+#endif
@@ -11,6 +11,7 @@
 #include <MQUnifiedsensor.h>
 #include <WiFi.h>
 #include <PubSubClient.h>
+#include "sensor_channels.h" // Reading globals (temperature, lpg, sound, ...)
 
 /*
  * =================================================
@@ -22,12 +23,12 @@
 #define SCREEN_WIDTH 128
 #define SCREEN_HEIGHT 64
 #define OLED_RESET -1
+#define OLED_ADDRESS 0x3C
 
 // BME680 SENSOR CONFIGURATION
 #define SDA_PIN 21
 #define SCL_PIN 22
 #define BME680_ADDRESS 0x77
-#define SEALEVELPRESSURE_HPA (1013.25)
 
 // MQ-2 SENSOR CONFIGURATION
 #define MQ2_BOARD "ESP32"
@@ -36,10 +37,10 @@
 #define MQ2_VOLTAGE_RESOLUTION 3.3
 #define MQ2_ADC_RESOLUTION 12
 #define MQ2_RATIO_CLEAN_AIR 9.83
+#define MQ2_LOAD_RESISTANCE_KOHM 10.0 // MQUnifiedsensor default RL
 
 // KY-038 SENSOR CONFIGURATION
-#define KY038_PIN 34
-#define LOUD_THRESHOLD 70.0 // Threshold for loudness in dB
+#define KY038_PIN 34 // Loudness threshold: see SENSOR_CHANNEL_TABLE
 
 // NEOPIXEL CONFIGURATION
 #define NEOPIXEL_PIN 16
@@ -48,35 +49,27 @@
 // BUZZER CONFIGURATION
 #define BUZZER_PIN 25
 
-/*
- * =================================================
- * ███████████████ GLOBAL VARIABLES ████████████████
- * =================================================
- */
-
-// BME680 Sensor Readings
-extern float temperature; // Temperature reading (°C)
-extern float humidity;    // Humidity reading (%)
-extern float pressure;    // Barometric Pressure reading (hPa)
-extern float gas;         // Gas Resistance reading (kΩ)
-extern float altitude;    // Altitude reading (meters)
-
-// MQ-2 Gas Sensor Readings
-extern float lpg;   // LPG gas concentration (ppm)
-extern float co;    // Carbon Monoxide concentration (ppm)
-extern float smoke; // Smoke concentration (ppm)
-
-// KY-038 Sound Sensor Reading
-extern float sound; // Sound level (dB)
-
 /*
  * =================================================
  * ███████████████ OBJECTS █████████████████████████
  * =================================================
  */
 
+// SH1106 driver that draws into the static arena's frame buffer. The
+// stock driver mallocs its buffer in begin(), again after every re-init.
+// Frames are sent one page at a time (one I2C transaction each, see
+// i2c_bus.h) instead of with display().
+class ArenaSH1106G : public Adafruit_SH1106G
+{
+public:
+    ArenaSH1106G(uint16_t w, uint16_t h, TwoWire *twi, int8_t rstPin);
+    ~ArenaSH1106G();
+    void setBusClock(uint32_t hz);
+    bool writePage(uint8_t page, const uint8_t *data);
+};
+
 extern Adafruit_NeoPixel pixels;
-extern Adafruit_SH1106G display;
+extern ArenaSH1106G display;
 extern Adafruit_BME680 bme;
 extern MQUnifiedsensor MQ2;
 extern WiFiClient espClient;
@@ -92,6 +85,7 @@ extern PubSubClient client;
 void initializeBuzzer();
 void initializeNeoPixels();
 void initializeOLED();
+void configureBME680(Adafruit_BME680 &sensor);
 void initializeBME680();
 void initializeMQ2();
 void initializeSoundSensor();
@@ -19,7 +19,8 @@ enum Status
 
 void testBuzzer();
 void testNeoPixels();
-void checkSafetyAndAlert(float lpg, float co, float smoke);
+void checkSafetyAndAlert();
+void updateAlarmBuzzer();
 void setNeoPixelStatus(Status status);
 float convertRawSoundToDecibels(int rawValue);
 void checkWiFi();
@@ -0,0 +1,21 @@
+#ifndef HTTP_SERVER_H
+#define HTTP_SERVER_H
+
+/*
+ * =================================================
+ * ███████████████ CONFIGURATION ███████████████████
+ * =================================================
+ */
+
+#define HTTP_PORT 80
+#define HTTP_LINE_MAX 128 // Longest single line rendered by an endpoint
+
+/*
+ * =================================================
+ * ███████████████ FUNCTION DECLARATION ████████████
+ * =================================================
+ */
+
+void setupHTTPServer();
+
+#endif
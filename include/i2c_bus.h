@@ -0,0 +1,79 @@
+#ifndef I2C_BUS_H
+#define I2C_BUS_H
+
+#include <stdint.h>
+
+/*
+ * =================================================
+ * ███████████████ CONFIGURATION ███████████████████
+ * =================================================
+ */
+
+// The OLED, the BME680 and the sensor registry's TCA9548A share Wire on
+// SDA_PIN/SCL_PIN. Every transaction runs under one bus mutex. FreeRTOS
+// queues the waiters of a mutex by task priority and lends the holder the
+// priority of the highest waiter, so the BME680 sampler (above every other
+// bus user) goes next whenever the current transaction ends. OLED frames
+// are sent by their own task one page per transaction (see
+// oled_display.h), so a sensor read waits for at most one page.
+#define I2C_PROBE_HZ 100000         // Boot probe, and the fallback clock
+#define I2C_FAST_HZ 400000          // Fast mode
+#define I2C_BUS_MAX_HZ 1000000      // Fast mode plus: needs ~2.2 kOhm pull-ups
+#define I2C_ACQUIRE_TIMEOUT_MS 200  // A transaction gives up waiting after this
+
+// Bus clients: X(id, name, device address, fastest clock of that device).
+// The bus runs at the fastest clock every answering device supports, capped
+// at I2C_BUS_MAX_HZ. The boot probe steps it down if a device does not
+// answer at that clock; it is not changed at runtime.
+// The SH1106 and the TCA9548A are fast-mode parts; the BME680 goes up to
+// 3.4 MHz. The registry's sensors sit behind the mux or are BME680s.
+#define I2C_CLIENT_TABLE(X)                          \
+    X(DISPLAY, "display", OLED_ADDRESS, 400000)      \
+    X(BME680, "bme680", BME680_ADDRESS, 3400000)     \
+    X(REGISTRY, "registry", TCA9548A_ADDRESS, 400000)
+
+#define I2C_CLIENT_ENUM(id, name, address, maxHz) I2C_CLIENT_##id,
+enum I2CClient
+{
+    I2C_CLIENT_TABLE(I2C_CLIENT_ENUM)
+    NUM_I2C_CLIENTS
+};
+#undef I2C_CLIENT_ENUM
+
+/*
+ * =================================================
+ * ███████████████ DATA STRUCTURES █████████████████
+ * =================================================
+ */
+
+// Bus use of one client since boot
+struct I2CClientStats
+{
+    uint32_t transactions;
+    uint32_t timeouts;  // Gave up waiting for the bus
+    uint64_t waitUs;    // Time spent waiting for the bus
+    uint32_t maxWaitUs;
+    uint64_t busyUs;    // Time holding the bus
+};
+
+/*
+ * =================================================
+ * ███████████████ GLOBAL VARIABLES ████████████████
+ * =================================================
+ */
+
+extern const char *const I2C_CLIENT_NAMES[NUM_I2C_CLIENTS];
+
+/*
+ * =================================================
+ * ███████████████ FUNCTION DECLARATION ████████████
+ * =================================================
+ */
+
+void initializeI2CBus();
+bool acquireI2CBus(I2CClient client);
+void releaseI2CBus(I2CClient client);
+uint32_t getI2CClockHz();
+I2CClientStats getI2CClientStats(I2CClient client);
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef MATH_KERNELS_H
+#define MATH_KERNELS_H
+
+#include <stdint.h>
+
+/*
+ * =================================================
+ * ███████████████ CONFIGURATION ███████████████████
+ * =================================================
+ */
+
+#define SEALEVELPRESSURE_HPA (1013.25) // Reference pressure for the BME680 altitude
+
+// Altitude table: barometric formula sampled every ALT_TABLE_STEP_HPA over
+// the BME680 pressure range, linearly interpolated. Worst-case error
+// against 44330 * (1 - (p/p0)^0.1903) is 0.29 m near 300 hPa and 0.05 m
+// above 800 hPa; the sensor's own ±1 hPa is ~8 m. Outside the
+// range the end segments are extrapolated.
+#define ALT_TABLE_MIN_HPA 300.0f
+#define ALT_TABLE_MAX_HPA 1100.0f
+#define ALT_TABLE_STEP_HPA 6.25f
+#define ALT_TABLE_SIZE 129
+
+// log2/exp2 tables for the MQ-2 power law a * ratio^b, 64 linear segments
+// each. Worst-case error over every float Rs/R0 of 2^-16..2^16 (the ADC
+// range, tools/math_sweep): 4.4e-5 absolute in log2, 1.6e-5 relative in
+// exp2. For the MQ-2 curves (|b| <= 3.11) that is 1.2e-4 relative (0.012%)
+// on the ppm value.
+#define POW_TABLE_BITS 6
+#define POW_TABLE_SIZE ((1 << POW_TABLE_BITS) + 1)
+
+// Sound level: the integer map(raw, 0, 1023, 30, 100) as a multiply and
+// shift. Bit-exact with map() for every 12-bit ADC value.
+#define SOUND_DB_MIN 30
+#define SOUND_DB_MULTIPLIER 287001 // ceil(70 * 2^22 / 1023)
+#define SOUND_DB_SHIFT 22
+
+/*
+ * =================================================
+ * ███████████████ FUNCTION DECLARATION ████████████
+ * =================================================
+ */
+
+void initializeMathKernels();
+float altitudeFromPressure(float pressureHpa);
+float fastLog2(float x);
+float fastExp2(float x);
+float powerLawPpm(float log2Ratio, float a, float b);
+int32_t soundDecibelsFromRaw(int32_t raw);
+
+#endif
@@ -0,0 +1,154 @@
+#ifndef MEMORY_MONITOR_H
+#define MEMORY_MONITOR_H
+
+#include <stdint.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+/*
+ * =================================================
+ * ███████████████ CONFIGURATION ███████████████████
+ * =================================================
+ */
+
+#define MEM_SAMPLE_INTERVAL_MS 1000 // Heap sampling (free, largest block)
+#define MEM_STACK_CHECK_EVERY 10    // Stack high-water marks every N samples
+
+// Alert thresholds
+#define MEM_ALERT_FREE_BYTES 24000      // Free heap below this
+#define MEM_ALERT_BLOCK_BYTES 8192      // Largest free block below this
+#define MEM_ALERT_FRAGMENTATION_PCT 60  // 100 * (1 - largest block / free heap) above this
+#define MEM_ALERT_STACK_BYTES 512       // Unused stack of any watched task below this
+
+// Tasks whose stack high-water mark is watched, by FreeRTOS task name.
+// Tasks that are not running (e.g. never started) are skipped.
+#define MEMORY_TASK_TABLE(X) \
+    X("loopTask")            \
+    X("bme680")              \
+    X("mq2")                 \
+    X("ky038")               \
+    X("spectrum")            \
+    X("display")             \
+    X("alerts")              \
+    X("watchdog")            \
+    X("wdt_reset")           \
+    X("ota")                 \
+    X("mqtt_tx")             \
+    X("async_tcp")           \
+    X("esp_timer")           \
+    X("tiT")
+
+#define MEMORY_TASK_COUNT(name) +1
+#define NUM_MEMORY_TASKS (0 MEMORY_TASK_TABLE(MEMORY_TASK_COUNT))
+
+// Allocation call sites in loop(). Build with -D MEMORY_ALLOC_HOOK and the
+// linker flags -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc to count
+// every heap allocation against the site loop() is in:
+//   other     setup() and between sites
+//   network   OTA, Wi-Fi and MQTT keepalive
+//   history   history query answers
+//   display   OLED pages and serial output
+//   registry  registry sensor poll
+//   publish   MQTT publishing
+//   tasks     any task but loop()
+// X(id, name, sealed): with STATIC_ALLOCATION_MODE, an allocation at a
+// sealed site after sealHeap() is a stray. Sites that drive the network
+// stack are not sealed, lwIP and the MQTT/HTTP libraries allocate per
+// packet. "tasks" only counts strays from tasks given to
+// watchTaskAllocations().
+#define ALLOC_SITE_TABLE(X)         \
+    X(OTHER, "other", true)         \
+    X(NETWORK, "network", false)    \
+    X(HISTORY, "history", false)    \
+    X(DISPLAY, "display", true)     \
+    X(REGISTRY, "registry", true)   \
+    X(PUBLISH, "publish", false)    \
+    X(TASKS, "tasks", true)
+
+#define ALLOC_SITE_ENUM(id, name, sealed) ALLOC_SITE_##id,
+enum AllocationSite
+{
+    ALLOC_SITE_TABLE(ALLOC_SITE_ENUM)
+    NUM_ALLOC_SITES
+};
+#undef ALLOC_SITE_ENUM
+
+// Static allocation mode: no heap allocation after setup() outside the
+// network stack. Strays are counted; with STATIC_ALLOC_TRAP (debug builds)
+// the first one aborts with its size, task and site.
+#if defined(STATIC_ALLOCATION_MODE) && !defined(MEMORY_ALLOC_HOOK)
+#error "STATIC_ALLOCATION_MODE needs MEMORY_ALLOC_HOOK and the malloc/calloc/realloc linker wraps"
+#endif
+#define MEM_MAX_WATCHED_TASKS 8 // Tasks checked besides loop()
+
+// Memory alert flags
+enum MemoryAlert
+{
+    MEM_ALERT_HEAP_LOW = 1 << 0,
+    MEM_ALERT_BLOCK_SMALL = 1 << 1,
+    MEM_ALERT_FRAGMENTED = 1 << 2,
+    MEM_ALERT_STACK_LOW = 1 << 3
+};
+#define NUM_MEMORY_ALERTS 4
+
+/*
+ * =================================================
+ * ███████████████ DATA STRUCTURES █████████████████
+ * =================================================
+ */
+
+// Heap and stack state from the latest samples
+struct MemoryStats
+{
+    uint32_t freeHeap;
+    uint32_t minFreeHeap;     // Lowest free heap since boot
+    uint32_t largestBlock;    // Largest free block
+    uint32_t minLargestBlock; // Smallest largest-block seen since boot
+    uint8_t fragmentationPct;
+    uint8_t maxFragmentationPct;
+    int32_t stackFree[NUM_MEMORY_TASKS]; // Unused stack bytes, -1 if the task is not running
+    uint8_t alerts;                      // MemoryAlert flags
+};
+
+// Allocations counted at one site since boot
+struct AllocationCount
+{
+    uint32_t calls;
+    uint32_t bytes;
+};
+
+// Allocations after sealHeap() at sealed sites
+struct StrayAllocations
+{
+    uint32_t count;
+    uint32_t lastSize;     // Size of the latest stray
+    AllocationSite lastSite;
+    char lastTask[16];     // Task that made it
+};
+
+/*
+ * =================================================
+ * ███████████████ GLOBAL VARIABLES ████████████████
+ * =================================================
+ */
+
+extern const char *const MEMORY_TASK_NAMES[NUM_MEMORY_TASKS];
+extern const char *const ALLOC_SITE_NAMES[NUM_ALLOC_SITES];
+extern const char *const MEMORY_ALERT_NAMES[NUM_MEMORY_ALERTS];
+
+/*
+ * =================================================
+ * ███████████████ FUNCTION DECLARATION ████████████
+ * =================================================
+ */
+
+void initializeMemoryMonitor();
+void setAllocationSite(AllocationSite site);
+MemoryStats getMemoryStats();
+AllocationCount getAllocationCount(AllocationSite site);
+void watchTaskAllocations(TaskHandle_t task);
+void permitHeapAllocation(bool permit);
+void sealHeap();
+StrayAllocations getStrayAllocations();
+
+#endif
@@ -1,17 +1,50 @@
 #ifndef OLED_DISPLAY_H
 #define OLED_DISPLAY_H
 
+#include <stdint.h>
+#include "sensor_channels.h"
+
+/*
+ * =================================================
+ * ███████████████ CONFIGURATION ███████████████████
+ * =================================================
+ */
+
+// Frames are sent by a writer task: showFrame() copies the finished frame
+// and returns, and the writer sends it one page per I2C transaction (see
+// i2c_bus.h), so loop() does not wait for the transfer and a sensor read
+// can go between two pages. A frame drawn while the previous one is still
+// being sent waits up to DISPLAY_FRAME_WAIT_MS, then is dropped.
+#define DISPLAY_WRITER_STACK 3072
+#define DISPLAY_WRITER_PRIORITY 2 // Above loop(), below the spectrum and sampler tasks
+#define DISPLAY_FRAME_WAIT_MS 200
+
+/*
+ * =================================================
+ * ███████████████ DATA STRUCTURES █████████████████
+ * =================================================
+ */
+
+// Frame writer counters since boot
+struct DisplayWriterStats
+{
+    uint32_t frames;        // Frames sent
+    uint32_t droppedFrames; // Frames not sent: writer busy, bus busy or write failed
+    uint32_t lastFrameUs;   // Transfer time of the last frame, bus waits included
+};
+
 /*
  * =================================================
  * ███████████████ FUNCTION DECLARATION ████████████
  * =================================================
  */
 
+void startDisplayWriter();
+DisplayWriterStats getDisplayWriterStats();
 void displayWelcomeLogo();
 void displayParrotGif();
 void displayWaveAnimation();
-void displayBME680Readings(float temperature, float humidity, float pressure, float gas, float altitude);
-void displayMQ2Readings(float lpg, float co, float smoke);
-void displaySoundSensorReading(float soundLevel);
+void displaySensorReadings(SensorGroup group);
+void displaySensorRegistryPages();
 
 #endif
\ No newline at end of file
@@ -0,0 +1,75 @@
+#ifndef OTA_PACK_H
+#define OTA_PACK_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * =================================================
+ * ███████████████ CONFIGURATION ███████████████████
+ * =================================================
+ */
+
+// Compressed firmware image ("packed image") as written by
+// tools/ota_pack.py: an OtaPackHeader followed by the firmware as one zlib
+// stream. The stream is inflated into a wrapping window of
+// OTA_PACK_WINDOW_SIZE bytes, so it must be compressed with at most
+// OTA_PACK_MAX_WINDOW_BITS (zlib wbits).
+#define OTA_PACK_MAGIC 0x315A4348 // "HCZ1"
+#define OTA_PACK_VERSION 1
+#define OTA_PACK_MAX_WINDOW_BITS 12
+#define OTA_PACK_WINDOW_SIZE (1 << OTA_PACK_MAX_WINDOW_BITS)
+
+// Result of a packed image step
+enum OtaPackStatus
+{
+    OTA_PACK_OK,
+    OTA_PACK_BUSY,          // Another update is running
+    OTA_PACK_BAD_HEADER,    // Unknown magic or version, or a window that does not fit
+    OTA_PACK_NO_MEMORY,     // No room for the inflate state
+    OTA_PACK_FLASH_ERROR,   // The OTA partition refused the image
+    OTA_PACK_CORRUPT,       // Inflate failed or the sizes disagree with the header
+    OTA_PACK_TRUNCATED,     // The stream ended early
+    OTA_PACK_HASH_MISMATCH  // SHA-256 of the inflated image differs from the header
+};
+#define NUM_OTA_PACK_STATUSES 8
+
+/*
+ * =================================================
+ * ███████████████ DATA STRUCTURES █████████████████
+ * =================================================
+ */
+
+// Packed image header, little-endian
+struct __attribute__((packed)) OtaPackHeader
+{
+    uint32_t magic;       // OTA_PACK_MAGIC
+    uint8_t version;      // OTA_PACK_VERSION
+    uint8_t windowBits;   // zlib wbits the stream was compressed with
+    uint16_t reserved;
+    uint32_t imageBytes;  // Size of the firmware image
+    uint32_t packedBytes; // Size of the zlib stream after the header
+    uint8_t sha256[32];   // SHA-256 of the firmware image
+};
+static_assert(sizeof(OtaPackHeader) == 48, "OtaPackHeader must match tools/ota_pack.py");
+
+/*
+ * =================================================
+ * ███████████████ GLOBAL VARIABLES ████████████████
+ * =================================================
+ */
+
+extern const char *const OTA_PACK_STATUS_NAMES[NUM_OTA_PACK_STATUSES];
+
+/*
+ * =================================================
+ * ███████████████ FUNCTION DECLARATION ████████████
+ * =================================================
+ */
+
+OtaPackStatus beginPackedOTA();
+OtaPackStatus writePackedOTA(const uint8_t *data, size_t length);
+OtaPackStatus endPackedOTA();
+void abortPackedOTA();
+
+#endif
@@ -2,6 +2,45 @@
 #define OTA_SETUP_H
 
 #include <ArduinoOTA.h>
+#include "sampling_scheduler.h"
+
+/*
+ * =================================================
+ * ███████████████ CONFIGURATION ███████████████████
+ * =================================================
+ */
+
+// OTA service task. It polls for the espota invite on its own, so an
+// upload is picked up within one poll interval, however long loop() takes.
+// It runs on the protocol core, and even while an image streams in it
+// stays below every sampler, so receiving an image never preempts one.
+#define OTA_TASK_STACK 4096
+#define OTA_TASK_PRIORITY 2 // Listening: above loop() (1), below the samplers
+#define OTA_TRANSFER_PRIORITY (SAMPLER_PRIORITY_BASE - 1) // While an image streams in
+#define OTA_CORE 0 // Away from SAMPLER_CORE
+#define OTA_POLL_INTERVAL_MS 100
+#define OTA_RESTART_DELAY_MS 500 // After an HTTP update, so the response goes out first
+
+// Password for espota and for POST /ota (user OTA_HTTP_USER)
+#define OTA_PASSWORD "Password123!"
+#define OTA_HTTP_USER "ota"
+
+/*
+ * =================================================
+ * ███████████████ DATA STRUCTURES █████████████████
+ * =================================================
+ */
+
+// Update counters. Kept across the restart into the new firmware.
+struct OtaStats
+{
+    uint32_t updates;         // Completed updates
+    uint32_t failures;        // Updates that failed or were aborted
+    uint32_t lastBytes;       // Size of the last completed image
+    uint32_t lastPackedBytes; // Bytes received for it if it was compressed, else 0
+    uint32_t lastDurationMs;  // Start to end of the last completed update
+    uint32_t lastBytesPerSec; // Average throughput of the last completed update
+};
 
 /*
  * =================================================
@@ -10,6 +49,10 @@
  */
 
 void setupOTA();
-void handleOTA();
+void beginOTATransfer();
+void endOTATransfer(bool success, uint32_t imageBytes, uint32_t packedBytes);
+void requestOTARestart();
+bool isOTAInProgress();
+OtaStats getOTAStats();
 
-#endif
\ No newline at end of file
+#endif
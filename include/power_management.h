@@ -0,0 +1,63 @@
+#ifndef POWER_MANAGEMENT_H
+#define POWER_MANAGEMENT_H
+
+#include <stdint.h>
+
+/*
+ * =================================================
+ * ███████████████ CONFIGURATION ███████████████████
+ * =================================================
+ */
+
+#define PM_MAX_FREQ_MHZ 240 // Clock while a PM lock is held
+#define PM_MIN_FREQ_MHZ 80  // Clock (or light sleep) otherwise
+#define PM_ACTIVE_CURRENT_MA 68.0 // Typical draw at 240 MHz, Wi-Fi idle
+#define PM_IDLE_CURRENT_MA 8.0    // Typical draw in auto light sleep with modem sleep
+#define PM_AWAKE_CURRENT_MA 20.0  // Typical draw idling at PM_MIN_FREQ_MHZ with modem sleep
+
+// Auto light sleep is only entered when the CPU stays idle for longer than
+// the sleep entry and wake-up take. A sampler timer firing more often
+// than this (the KY-038 at 1 ms by default) keeps the CPU awake at
+// PM_MIN_FREQ_MHZ between samples instead.
+#define PM_LIGHT_SLEEP_MIN_PERIOD_US 10000
+
+// Code sections that need full clock
+enum PowerSection
+{
+    PM_SECTION_ACQUISITION, // Sensor reads
+    PM_SECTION_RENDER,      // OLED frame transfers
+    PM_SECTION_NETWORK,     // MQTT publishing
+    NUM_PM_SECTIONS
+};
+
+/*
+ * =================================================
+ * ███████████████ DATA STRUCTURES █████████████████
+ * =================================================
+ */
+
+// Active-time accounting for the last completed cycle
+struct PowerStats
+{
+    bool pmEnabled;                          // esp_pm accepted DFS/light-sleep config
+    uint32_t cycleTimeMs;                    // Length of the last loop() cycle
+    uint32_t activeTimeMs;                   // Time spent holding PM locks in it
+    uint32_t sectionTimeMs[NUM_PM_SECTIONS]; // Same, per section
+    float activeRatio;                       // activeTimeMs / cycleTimeMs
+    bool lightSleep;                         // Time outside sections can be spent in light sleep
+    float estimatedMahPerDay;                // Projected charge use at this duty cycle
+};
+
+/*
+ * =================================================
+ * ███████████████ FUNCTION DECLARATION ████████████
+ * =================================================
+ */
+
+void initializePowerManagement();
+void beginPowerSection(PowerSection section);
+void endPowerSection(PowerSection section);
+void endPowerCycle();
+PowerStats getPowerStats();
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef ROLLING_STATS_H
+#define ROLLING_STATS_H
+
+#include <stdint.h>
+#include "sensor_channels.h"
+
+/*
+ * =================================================
+ * ███████████████ CONFIGURATION ███████████████████
+ * =================================================
+ */
+
+// Windows cover a fixed span of time, whatever rate a channel samples at:
+// readings are summed into STATS_SLOT_MS slots and a summary merges the
+// last STATS_WINDOW_SLOTS of them. The newest slot is still filling, so a
+// summary covers between STATS_WINDOW_MS - STATS_SLOT_MS and STATS_WINDOW_MS.
+#define STATS_WINDOW_MS 300000UL                            // Time covered per channel window (5 minutes)
+#define STATS_WINDOW_SLOTS 30                               // Slots per window
+#define STATS_SLOT_MS (STATS_WINDOW_MS / STATS_WINDOW_SLOTS) // 10 s per slot
+#define STATS_PUBLISH_INTERVAL_MS 300000UL                  // Default aggregate publish rate, `stats.publish_ms`
+
+/*
+ * =================================================
+ * ███████████████ DATA STRUCTURES █████████████████
+ * =================================================
+ */
+
+// Aggregates of the readings that fell into one slot
+struct StatsSlot
+{
+    uint32_t index; // Absolute slot number, millis() / STATS_SLOT_MS
+    uint32_t count; // Readings in the slot, 0 when unused
+    float min;
+    float max;
+    float mean;     // Welford running mean
+    float m2;       // Welford sum of squared deviations
+};
+
+// Time-based sliding window, indexed by slot number % STATS_WINDOW_SLOTS
+struct RollingWindow
+{
+    StatsSlot slots[STATS_WINDOW_SLOTS];
+};
+
+// Aggregates for one channel window
+struct StatsSummary
+{
+    float min;
+    float max;
+    float mean;
+    float stddev;
+    uint32_t count;
+};
+
+/*
+ * =================================================
+ * ███████████████ FUNCTION DECLARATION ████████████
+ * =================================================
+ */
+
+// Window kernels (rolling_window.cpp, plain C++)
+void resetRollingWindow(RollingWindow &window);
+void pushRollingWindow(RollingWindow &window, float value, uint32_t nowMs);
+StatsSummary summarizeRollingWindow(const RollingWindow &window, uint32_t nowMs);
+
+// Per-channel windows (rolling_stats.cpp)
+void initializeRollingStats();
+void updateRollingStats(SensorChannel channel, float value, uint32_t nowMs);
+StatsSummary getRollingStats(SensorChannel channel, uint32_t nowMs);
+
+#endif
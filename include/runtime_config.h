@@ -0,0 +1,93 @@
+#ifndef RUNTIME_CONFIG_H
+#define RUNTIME_CONFIG_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "sensor_channels.h"
+#include "stage_watchdog.h"
+
+/*
+ * =================================================
+ * ███████████████ CONFIGURATION ███████████████████
+ * =================================================
+ */
+
+#define CFG_NVS_NAMESPACE "config"
+#define CFG_VERSION 4 // Bump when RuntimeConfig changes layout
+
+// Defaults are the thresholds and periods in sensor_channels.h, the
+// adaptive sampling bounds in adaptive_sampling.h, the stage deadlines in
+// stage_watchdog.h, the stats publish rate in rolling_stats.h and:
+#define CFG_DEFAULT_DISPLAY_PAGE_MS 5000
+
+// Accepted ranges
+#define CFG_PERIOD_MIN_US 250UL         // esp_timer task dispatch cannot go much faster
+#define CFG_PERIOD_MAX_US 600000000UL   // 10 minutes
+#define CFG_DISPLAY_PAGE_MIN_MS 500
+#define CFG_DISPLAY_PAGE_MAX_MS 60000
+#define CFG_STATS_PUBLISH_MIN_MS 10000   // One stats slot
+#define CFG_STATS_PUBLISH_MAX_MS 3600000 // 1 hour
+#define CFG_DEADLINE_MIN_MS 10
+#define CFG_DEADLINE_MAX_MS 60000 // Stays below the task watchdog timeout
+
+#define CFG_TOKEN_MAX 24 // Longest value token (numbers are copied out to parse)
+
+/*
+ * =================================================
+ * ███████████████ DATA STRUCTURES █████████████████
+ * =================================================
+ */
+
+// Warning and alarm level of one channel, NAN if none
+struct ChannelThresholds
+{
+    float warn;
+    float alarm;
+};
+
+// Fastest and slowest period of an adaptively sampled sensor, 0 for a
+// fixed period
+struct SamplingBounds
+{
+    uint32_t minUs;
+    uint32_t maxUs;
+};
+
+// Everything tunable without a reflash. Plain data, stored in NVS as a blob.
+struct RuntimeConfig
+{
+    ChannelThresholds thresholds[NUM_CHANNELS];
+    uint32_t samplePeriodUs[NUM_SENSOR_GROUPS];
+    SamplingBounds samplingBounds[NUM_SENSOR_GROUPS];
+    uint32_t displayPageMs;
+    uint32_t statsPublishMs;
+    uint32_t stageDeadlineMs[NUM_WATCHDOG_STAGES];
+    WatchdogEscalation stageEscalation[NUM_WATCHDOG_STAGES];
+};
+
+// Outcome of a configuration message
+enum ConfigResult
+{
+    CONFIG_APPLIED,
+    CONFIG_UNCHANGED,
+    CONFIG_REJECTED
+};
+
+/*
+ * =================================================
+ * ███████████████ FUNCTION DECLARATION ████████████
+ * =================================================
+ */
+
+void initializeRuntimeConfig();
+ConfigResult applyRuntimeConfig(const char *text, size_t length, char *error, size_t errorSize);
+RuntimeConfig getRuntimeConfig();
+ChannelThresholds getChannelThresholds(SensorChannel channel);
+uint32_t getSamplePeriodUs(SensorGroup group);
+SamplingBounds getSamplingBounds(SensorGroup group);
+uint32_t getDisplayPageMs();
+uint32_t getStatsPublishMs();
+uint32_t getStageDeadlineMs(WatchdogStage stage);
+WatchdogEscalation getStageEscalation(WatchdogStage stage);
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef SAMPLING_SCHEDULER_H
+#define SAMPLING_SCHEDULER_H
+
+#include <stdint.h>
+#include "sensor_channels.h"
+
+/*
+ * =================================================
+ * ███████████████ CONFIGURATION ███████████████████
+ * =================================================
+ */
+
+// Default periods are set per sensor in SENSOR_GROUP_TABLE
+// (sensor_channels.h) and can be changed at runtime, see runtime_config.h.
+// Sensors with adaptive sampling then move between their bounds, see
+// adaptive_sampling.h. Each sensor has an esp_timer that releases its own
+// sampler task.
+#define SAMPLER_TASK_STACK 4096
+#define SAMPLER_PRIORITY_BASE 5 // Longest period; shorter periods get +1 each
+#define SAMPLER_CORE 1          // Application core, away from Wi-Fi
+
+// KY-038 samples are reduced to their peak level over this window
+#define SOUND_WINDOW_US 1000000
+
+// Jitter histogram: release-to-start delay in JITTER_BIN_US steps; the
+// last bin collects everything beyond
+#define JITTER_BIN_US 25
+#define JITTER_HISTOGRAM_BINS 80
+
+/*
+ * =================================================
+ * ███████████████ DATA STRUCTURES █████████████████
+ * =================================================
+ */
+
+// Deviation of sample start times from the schedule, since boot
+struct SamplingJitter
+{
+    uint32_t periodUs;
+    uint8_t priority;
+    uint32_t samples;
+    uint32_t overruns; // Releases missed because the previous sample ran late
+    uint32_t retimes;  // Period changes by adaptive sampling
+    int32_t minUs;
+    int32_t maxUs;
+    int32_t p99Us;
+};
+
+/*
+ * =================================================
+ * ███████████████ FUNCTION DECLARATION ████████████
+ * =================================================
+ */
+
+void startSensorSampling();
+void setSamplingPeriod(SensorGroup group, uint32_t periodUs);
+void retimeSampling(SensorGroup group, uint32_t periodUs);
+uint32_t getSamplingPeriod(SensorGroup group);
+SamplingJitter getSamplingJitter(SensorGroup group);
+
+#endif
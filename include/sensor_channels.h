@@ -0,0 +1,147 @@
+#ifndef SENSOR_CHANNELS_H
+#define SENSOR_CHANNELS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <math.h>
+
+/*
+ * =================================================
+ * ███████████████ CONFIGURATION ███████████████████
+ * =================================================
+ */
+
+// Every channel publishes on <TOPIC_SENSOR_BASE>/<topic suffix>
+#ifndef TOPIC_SENSOR_BASE
+#define TOPIC_SENSOR_BASE "home/sensors"
+#endif
+
+/*
+ * =================================================
+ * ███████████████ SENSOR CHANNELS █████████████████
+ * =================================================
+ */
+
+// Physical sensors: X(id, name, label, sampling period in µs). The
+// sampling scheduler runs each sensor on its own period; the shortest
+// period gets the highest task priority (rate-monotonic). The KY-038 is
+// sampled at 1 kHz and reports the peak level of each SOUND_WINDOW_US.
+#define SENSOR_GROUP_TABLE(X)                 \
+    X(BME680, "bme680", "BME680", 10000000)   \
+    X(MQ2, "mq2", "MQ-2", 1000000)            \
+    X(KY038, "ky038", "KY-038", 1000)
+
+// One entry per published sensor reading. Everything that lists channels
+// (reading globals, MQTT topics, display pages, serial output, alarms) is
+// generated from this table, so a new channel is one line here plus the
+// code that measures it.
+//
+// X(id, variable, group, name, topic suffix, label, unit, precision, warn, alarm)
+//   variable   global float holding the latest reading
+//   name       lower-case name for queries, JSON and /metrics
+//   precision  decimals on MQTT, OLED and serial
+//   warn       shown as HIGH on the OLED and serial, NAN if none
+//   alarm      NeoPixel/buzzer DANGER level, NAN if none. Only channels
+//              with an alarm take part in checkSafetyAndAlert().
+// Thresholds and periods are defaults, see runtime_config.h.
+#define SENSOR_CHANNEL_TABLE(X)                                                                                  \
+    X(TEMPERATURE, temperature, BME680, "temperature", "bme680/temperature", "Temperature", "C", 1, NAN, NAN)    \
+    X(HUMIDITY, humidity, BME680, "humidity", "bme680/humidity", "Relative Humidity", "%", 1, NAN, NAN)          \
+    X(PRESSURE, pressure, BME680, "pressure", "bme680/pressure", "Barometric Pressure", "hPa", 1, NAN, NAN)       \
+    X(GAS, gas, BME680, "gas", "bme680/gas", "Gas Resistance", "kOhms", 1, NAN, NAN)                             \
+    X(ALTITUDE, altitude, BME680, "altitude", "bme680/altitude", "Altitude", "m", 1, NAN, NAN)                   \
+    X(LPG, lpg, MQ2, "lpg", "mq2/lpg", "LPG", "ppm", 1, 500, 1000)                                               \
+    X(CO, co, MQ2, "co", "mq2/co", "CO", "ppm", 1, 20, 50)                                                       \
+    X(SMOKE, smoke, MQ2, "smoke", "mq2/smoke", "Smoke", "ppm", 1, 100, 200)                                      \
+    X(SOUND, sound, KY038, "sound", "ky038/sound", "Sound Level", "dB", 1, 70, NAN)                              \
+    X(IAQ, iaq, BME680, "iaq", "bme680/iaq", "IAQ", "", 0, NAN, NAN)                                             \
+    X(ECO2, eco2, BME680, "eco2", "bme680/eco2", "eCO2", "ppm", 0, NAN, NAN)                                     \
+    X(IAQ_ACCURACY, iaqAccuracy, BME680, "iaq_accuracy", "bme680/iaq_accuracy", "IAQ Accuracy", "", 0, NAN, NAN)
+
+#define SENSOR_GROUP_ENUM(id, name, label, periodUs) GROUP_##id,
+enum SensorGroup
+{
+    SENSOR_GROUP_TABLE(SENSOR_GROUP_ENUM)
+    NUM_SENSOR_GROUPS
+};
+#undef SENSOR_GROUP_ENUM
+
+#define SENSOR_CHANNEL_ENUM(id, variable, group, name, topic, label, unit, precision, warn, alarm) CHANNEL_##id,
+enum SensorChannel
+{
+    SENSOR_CHANNEL_TABLE(SENSOR_CHANNEL_ENUM)
+    NUM_CHANNELS
+};
+#undef SENSOR_CHANNEL_ENUM
+
+// Bit mask selecting every channel
+#define ALL_CHANNELS_MASK ((uint16_t)((1u << NUM_CHANNELS) - 1))
+static_assert(NUM_CHANNELS <= 16, "Channel masks are 16 bits wide");
+
+// Threshold state of a reading
+enum ChannelLevel
+{
+    LEVEL_NORMAL,
+    LEVEL_WARNING,
+    LEVEL_ALARM
+};
+
+/*
+ * =================================================
+ * ███████████████ DATA STRUCTURES █████████████████
+ * =================================================
+ */
+
+// Generated description of one channel. All strings are literals.
+struct ChannelDescriptor
+{
+    const char *name;   // Lower-case name
+    const char *topic;  // Full MQTT topic
+    const char *label;  // OLED and serial label
+    const char *unit;   // Unit suffix, may be empty
+    const char *format; // printf format of the value, e.g. "%.1f"
+    float warn;         // Default warning threshold, NAN if none
+    float alarm;        // Default alarm threshold, NAN if none
+    SensorGroup group;
+    float *value; // Latest reading
+};
+
+// Struct-of-arrays block of N samples, one contiguous column per channel
+template <uint16_t N>
+struct ChannelColumns
+{
+    uint32_t timestamp[N];
+    float values[NUM_CHANNELS][N];
+};
+
+/*
+ * =================================================
+ * ███████████████ GLOBAL VARIABLES ████████████████
+ * =================================================
+ */
+
+// Latest reading of every channel, e.g. `temperature`, `lpg`, `iaqAccuracy`
+#define SENSOR_CHANNEL_EXTERN(id, variable, group, name, topic, label, unit, precision, warn, alarm) extern float variable;
+SENSOR_CHANNEL_TABLE(SENSOR_CHANNEL_EXTERN)
+#undef SENSOR_CHANNEL_EXTERN
+
+extern const ChannelDescriptor CHANNELS[NUM_CHANNELS];
+extern const char *const CHANNEL_NAMES[NUM_CHANNELS];
+extern const char *const SENSOR_GROUP_NAMES[NUM_SENSOR_GROUPS];
+extern const char *const SENSOR_GROUP_LABELS[NUM_SENSOR_GROUPS];
+extern const uint32_t SENSOR_SAMPLE_PERIODS_US[NUM_SENSOR_GROUPS];
+
+/*
+ * =================================================
+ * ███████████████ FUNCTION DECLARATION ████████████
+ * =================================================
+ */
+
+float getChannelValue(SensorChannel channel);
+ChannelLevel getChannelLevel(SensorChannel channel);
+ChannelLevel getChannelLevel(SensorChannel channel, float value);
+int formatChannelValue(SensorChannel channel, char *buffer, size_t size);
+int formatChannelReading(SensorChannel channel, char *buffer, size_t size);
+uint16_t parseChannelMask(const char *list, size_t length);
+
+#endif
@@ -1,12 +1,21 @@
 #ifndef SENSOR_PROCESSING_H
 #define SENSOR_PROCESSING_H
 
+#include "sensor_channels.h"
+
 /*
  * =================================================
  * ███████████████ FUNCTION DECLARATION ████████████
  * =================================================
  */
 
+void readSoundSensor();
+bool readBME680();
+float mq2SensorResistance(float volts);
+void computeMQ2Concentrations(float volts, float r0, float &lpgPpm, float &coPpm, float &smokePpm);
+void readMQ2();
+void acquireAllSensors();
+void sampleSensor(SensorGroup group);
 void processSoundSensor();
 void processBME680();
 void processMQ2();
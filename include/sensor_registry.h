@@ -0,0 +1,86 @@
+#ifndef SENSOR_REGISTRY_H
+#define SENSOR_REGISTRY_H
+
+#include <stdint.h>
+#include "sensor_channels.h"
+
+/*
+ * =================================================
+ * ███████████████ CONFIGURATION ███████████████████
+ * =================================================
+ */
+
+// Additional sensors beyond the built-in BME680, MQ-2 and KY-038, e.g. one
+// BME680 per room behind a TCA9548A. The table lives in sensor_registry.cpp.
+// Registry readings are checked against the thresholds of the matching
+// built-in channel, so a kitchen MQ-2 over the CO alarm level sets the
+// NeoPixels to danger and sounds the buzzer like the built-in one. They
+// are published and shown live only: the rolling statistics, the
+// time-series history, the anomaly detectors and adaptive sampling cover
+// the built-in sensors alone.
+#define MAX_SENSOR_INSTANCES 8
+#define MAX_SENSOR_VALUES 5 // BME680 has the most readings
+
+// TCA9548A I2C multiplexer
+#define TCA9548A_ADDRESS 0x70
+#define MUX_NONE 0xFF // Sensor on the main bus, or an ADC pin
+
+enum SensorType
+{
+    SENSOR_TYPE_BME680, // values: temperature, humidity, pressure, gas, altitude
+    SENSOR_TYPE_MQ2,    // values: lpg, co, smoke
+    SENSOR_TYPE_KY038,  // values: sound
+    NUM_SENSOR_TYPES
+};
+
+/*
+ * =================================================
+ * ███████████████ DATA STRUCTURES █████████████████
+ * =================================================
+ */
+
+// Wiring of one sensor instance
+struct SensorConfig
+{
+    SensorType type;
+    const char *room;   // Topic segment and display page title
+    uint8_t muxChannel; // TCA9548A channel 0-7, or MUX_NONE
+    uint8_t location;   // I2C address (BME680) or ADC pin (MQ-2, KY-038)
+};
+
+// Per-instance state
+struct SensorInstance
+{
+    SensorConfig config;
+    bool present;                    // Answered at boot
+    bool valid;                      // values hold a completed reading
+    float values[MAX_SENSOR_VALUES]; // Latest readings, see SensorType
+    float r0;                        // MQ-2 clean-air resistance (kΩ)
+    unsigned long readyAt;           // BME680 measurement in flight, 0 if none
+};
+
+// Counters for the batched poller
+struct SensorPollStats
+{
+    uint32_t polls;       // Completed pollSensorRegistry() calls
+    uint32_t muxSwitches; // TCA9548A channel selections
+    uint32_t lastPollMs;  // Duration of the last poll, heater wait included
+};
+
+/*
+ * =================================================
+ * ███████████████ FUNCTION DECLARATION ████████████
+ * =================================================
+ */
+
+void initializeSensorRegistry();
+void pollSensorRegistry();
+uint8_t getSensorInstanceCount();
+const SensorInstance &getSensorInstance(uint8_t index);
+uint8_t getSensorValueCount(SensorType type);
+const char *getSensorTypeName(SensorType type);
+const char *getSensorValueName(SensorType type, uint8_t value);
+SensorPollStats getSensorPollStats();
+ChannelLevel getSensorRegistryLevel();
+
+#endif
@@ -1,14 +1,14 @@
 #ifndef SERIAL_MONITOR_H
 #define SERIAL_MONITOR_H
 
+#include "sensor_channels.h"
+
 /*
  * =================================================
  * ███████████████ FUNCTION DECLARATION ████████████
  * =================================================
  */
 
-void printBME680Readings(float temperature, float humidity, float pressure, float gas, float altitude);
-void printMQ2Readings(float lpg, float co, float smoke);
-void printSoundSensorReadings(float soundLevel);
+void printSensorReadings(SensorGroup group);
 
-#endif
\ No newline at end of file
+#endif
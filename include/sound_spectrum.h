@@ -0,0 +1,148 @@
+#ifndef SOUND_SPECTRUM_H
+#define SOUND_SPECTRUM_H
+
+#include <stdint.h>
+#include "sampling_scheduler.h"
+
+/*
+ * =================================================
+ * ███████████████ CONFIGURATION ███████████████████
+ * =================================================
+ */
+
+// Spectral analysis of the KY-038: every SPECTRUM_FRAME_INTERVAL_MS a
+// frame of SPECTRUM_FRAME_SIZE samples is captured at
+// SPECTRUM_SAMPLE_RATE_HZ, Hann-windowed and run through a real FFT. The
+// scheduler's esp_timer cannot release samples at audio rates (see
+// CFG_PERIOD_MIN_US), so frames are captured in paced bursts by their own
+// task: 32 ms of every 250 ms with the defaults. A frame with a sample
+// more than SPECTRUM_LATE_LIMIT_US late (a sampler preempted the burst)
+// is dropped.
+#define SPECTRUM_SAMPLE_RATE_HZ 8000
+#define SPECTRUM_SAMPLE_PERIOD_US (1000000 / SPECTRUM_SAMPLE_RATE_HZ)
+#define SPECTRUM_FRAME_SIZE 256 // Power of two; 31.25 Hz bins at 8 kHz
+#define SPECTRUM_FRAME_INTERVAL_MS 250
+#define SPECTRUM_LATE_LIMIT_US 60
+#define SPECTRUM_TASK_STACK 3072
+#define SPECTRUM_TASK_PRIORITY (SAMPLER_PRIORITY_BASE - 1) // Below the samplers, above loop()
+
+// Largest FFT the twiddle table covers; only the host benchmark needs more
+// than the frame size
+#ifndef SPECTRUM_FFT_MAX_SIZE
+#define SPECTRUM_FFT_MAX_SIZE SPECTRUM_FRAME_SIZE
+#endif
+
+// ESP-DSP's radix-2 FFT (ANSI/assembly for the ESP32) when the framework
+// ships it, the portable FFT otherwise or with -D SPECTRUM_PORTABLE_FFT
+#if defined(ARDUINO_ARCH_ESP32) && !defined(SPECTRUM_PORTABLE_FFT) && __has_include(<esp_dsp.h>)
+#define SPECTRUM_USE_ESP_DSP
+#endif
+
+// Levels are in dBFS: 0 dB is a full-scale sine (12-bit ADC, ±2048 counts)
+#define SPECTRUM_FULL_SCALE 2048.0f
+#define SPECTRUM_SILENCE_DBFS -120.0f
+
+// Octave bands by centre frequency (Hz), each from centre/√2 to centre*√2,
+// cut at the Nyquist frequency. Levels are the mean power of the frames of
+// each SOUND_WINDOW_US.
+#define SOUND_BAND_TABLE(X) \
+    X(125)                  \
+    X(250)                  \
+    X(500)                  \
+    X(1000)                 \
+    X(2000)                 \
+    X(4000)
+
+#define SOUND_BAND_COUNT(centreHz) +1
+#define NUM_SOUND_BANDS (0 SOUND_BAND_TABLE(SOUND_BAND_COUNT))
+
+// Smoke alarm tone: a frame holds the tone when the strongest bin between
+// SPECTRUM_TONE_LOW_HZ and SPECTRUM_TONE_HIGH_HZ (with its neighbours)
+// carries SPECTRUM_TONE_SHARE of the power above the lowest band and is
+// louder than SPECTRUM_TONE_MIN_DBFS. Broadband noise (vacuum cleaner,
+// running water) spreads its power and stays well below the share.
+#define SPECTRUM_TONE_LOW_HZ 2800
+#define SPECTRUM_TONE_HIGH_HZ 3600
+#define SPECTRUM_TONE_SHARE 0.4f
+#define SPECTRUM_TONE_MIN_DBFS -50.0f
+
+// Temporal-three pattern (ISO 8201): three 0.5 s pulses 0.5 s apart, then
+// 1.5 s of silence. Limits are wide enough for the frame interval. The
+// alarm tone is reported after T3_CYCLES matching cycles in a row and
+// held for T3_HOLD_MS after the last.
+#define T3_PULSE_MIN_MS 200 // On pulse and short gap
+#define T3_PULSE_MAX_MS 850
+#define T3_PAUSE_MIN_MS 1100 // Gap after the third pulse
+#define T3_PAUSE_MAX_MS 2600
+#define T3_PULSES 3
+#define T3_CYCLES 2
+#define T3_HOLD_MS 10000
+
+/*
+ * =================================================
+ * ███████████████ DATA STRUCTURES █████████████████
+ * =================================================
+ */
+
+// Analysis of one frame. Powers are relative to a full-scale sine.
+struct SpectrumFrame
+{
+    float bandPower[NUM_SOUND_BANDS];
+    float tonePower; // Strongest bin in the tone range and its neighbours
+    float toneShare; // tonePower over the power above the lowest band
+    float toneHz;    // Frequency of that bin
+    bool tone;       // Alarm tone present in this frame
+};
+
+// T3 pattern matcher, fed one tone/no-tone decision per frame
+struct AlarmTonePattern
+{
+    bool tone;      // Decision of the previous frame
+    bool pauseOpen; // Cycle complete, waiting for the next one to start
+    bool heard;     // Alarm tone reported
+    uint8_t pulses; // Valid pulses in the current cycle
+    uint8_t cycles; // Complete cycles in a row, up to T3_CYCLES
+    uint32_t edgeMs; // Last change between tone and silence
+    uint32_t lastCycleMs;
+};
+
+// Latest results and counters
+struct SoundSpectrum
+{
+    float bandDbfs[NUM_SOUND_BANDS]; // Mean level of the last window
+    float toneShare;                 // Last frame
+    float toneHz;
+    bool alarmTone;               // T3 pattern being heard
+    uint32_t alarmToneDetections; // Times the alarm tone started
+    uint32_t frames;              // Frames analysed
+    uint32_t droppedFrames;       // Frames with a late sample
+    uint32_t analysisUs;          // Window, FFT and bands of the last frame
+};
+
+/*
+ * =================================================
+ * ███████████████ GLOBAL VARIABLES ████████████████
+ * =================================================
+ */
+
+extern const uint16_t SOUND_BAND_CENTRES_HZ[NUM_SOUND_BANDS];
+
+/*
+ * =================================================
+ * ███████████████ FUNCTION DECLARATION ████████████
+ * =================================================
+ */
+
+// Kernels (spectrum_kernels.cpp, plain C++)
+void initializeSpectrumKernels();
+void realFFT(float *data, uint16_t size);
+void analyzeSpectrumFrame(float *frame, SpectrumFrame &result);
+bool updateAlarmTonePattern(AlarmTonePattern &pattern, bool tone, uint32_t nowMs);
+float powerToDbfs(float power);
+
+// Capture task and results (sound_spectrum.cpp)
+void startSoundSpectrum();
+SoundSpectrum getSoundSpectrum();
+bool isAlarmToneActive();
+
+#endif
@@ -0,0 +1,122 @@
+#ifndef STAGE_WATCHDOG_H
+#define STAGE_WATCHDOG_H
+
+#include <stdint.h>
+
+/*
+ * =================================================
+ * ███████████████ CONFIGURATION ███████████████████
+ * =================================================
+ */
+
+// ESP-IDF task watchdog on the loop() task: the last line of defence when
+// a stage hangs in a task that cannot escalate on its own. Fed at every
+// stage boundary and every frame loop() shows, so it must exceed the
+// longest display page (CFG_DISPLAY_PAGE_MAX_MS).
+#define WDT_TASK_TIMEOUT_S 90
+
+// Monitor task, above the sampler tasks so a busy sampler cannot hide
+#define WDT_CHECK_INTERVAL_MS 100
+#define WDT_TASK_STACK 3072
+#define WDT_TASK_PRIORITY 12
+#define WDT_MAX_TASKS 8 // Tasks that can run stages at the same time
+
+// Reset worker: re-initialises peripherals off the stage's own tasks, so a
+// blocking re-init (the MQ-2 calibration takes a second) never holds up a
+// sampler. At loop()'s priority, below every other task.
+#define WDT_RESET_TASK_STACK 4096
+#define WDT_RESET_TASK_PRIORITY 1
+
+// Escalation ladder: every missed deadline in a row climbs one step, up to
+// the stage's configured limit
+#define WDT_RESET_AFTER 2  // Consecutive misses before a peripheral reset
+#define WDT_REBOOT_AFTER 3 // Consecutive misses before a reboot
+#define WDT_RESET_HOLDOFF_MS 30000 // Minimum time between resets of one stage
+
+// Most severe reaction to a missed deadline
+enum WatchdogEscalation
+{
+    WDT_SKIP,             // Count it and skip the task's next run of the stage
+    WDT_RESET_PERIPHERAL, // Also re-initialise the stage's peripheral
+    WDT_REBOOT            // Also restart the device
+};
+
+// Watched stages: X(id, name, deadline in ms, escalation). Defaults, see
+// runtime_config.h. Stages do not nest within one task.
+//   ACQUISITION  one sensor sample (sampler tasks) or registry poll
+//   ALERT        NeoPixel status and buzzer
+//   PUBLISH      MQTT keepalive/reconnect and publishing
+//   RENDER       one OLED frame transfer
+#define WATCHDOG_STAGE_TABLE(X)                             \
+    X(ACQUISITION, "acquisition", 2000, WDT_REBOOT)          \
+    X(ALERT, "alert", 5000, WDT_RESET_PERIPHERAL)            \
+    X(PUBLISH, "publish", 20000, WDT_RESET_PERIPHERAL)       \
+    X(RENDER, "render", 1000, WDT_RESET_PERIPHERAL)
+
+#define WATCHDOG_STAGE_ENUM(id, name, deadlineMs, escalation) STAGE_##id,
+enum WatchdogStage
+{
+    WATCHDOG_STAGE_TABLE(WATCHDOG_STAGE_ENUM)
+    NUM_WATCHDOG_STAGES
+};
+#undef WATCHDOG_STAGE_ENUM
+
+/*
+ * =================================================
+ * ███████████████ DATA STRUCTURES █████████████████
+ * =================================================
+ */
+
+// Counters of one stage since boot
+struct StageStats
+{
+    uint32_t deadlineMs;
+    WatchdogEscalation escalation;
+    uint32_t runs;        // Completed runs
+    uint32_t overruns;    // Runs that missed the deadline
+    uint32_t skips;       // Runs skipped after an overrun
+    uint32_t resets;      // Peripheral resets
+    uint32_t failures;    // Peripheral failures reported by the code itself
+    uint32_t lastMs;      // Duration of the last completed run
+    uint32_t worstMs;     // Longest completed run
+};
+
+// The most recent overrun. Kept across a watchdog reboot.
+struct WatchdogEvent
+{
+    uint32_t sequence; // 0 while nothing happened
+    WatchdogStage stage;
+    char task[16];       // Task that overran
+    uint32_t elapsedMs;  // Time in the stage when the monitor noticed
+    uint32_t deadlineMs;
+    WatchdogEscalation action;
+    bool beforeReboot; // Recorded just before the watchdog restarted the device
+};
+
+/*
+ * =================================================
+ * ███████████████ GLOBAL VARIABLES ████████████████
+ * =================================================
+ */
+
+extern const char *const WATCHDOG_STAGE_NAMES[NUM_WATCHDOG_STAGES];
+extern const char *const WATCHDOG_ESCALATION_NAMES[WDT_REBOOT + 1];
+extern const uint32_t WATCHDOG_DEFAULT_DEADLINES_MS[NUM_WATCHDOG_STAGES];
+extern const WatchdogEscalation WATCHDOG_DEFAULT_ESCALATIONS[NUM_WATCHDOG_STAGES];
+
+/*
+ * =================================================
+ * ███████████████ FUNCTION DECLARATION ████████████
+ * =================================================
+ */
+
+void initializeStageWatchdog();
+bool beginStage(WatchdogStage stage);
+void endStage(WatchdogStage stage);
+void reportStageFailure(WatchdogStage stage);
+void feedLoopWatchdog();
+StageStats getStageStats(WatchdogStage stage);
+WatchdogEvent getLastWatchdogEvent();
+bool lastResetByTaskWatchdog();
+
+#endif
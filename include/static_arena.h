@@ -0,0 +1,82 @@
+#ifndef STATIC_ARENA_H
+#define STATIC_ARENA_H
+
+#include <stdint.h>
+#include "hardware_init.h"
+#include "time_series_store.h"
+#include "rolling_stats.h"
+#include "../lib/mqtt/mqtt_async.h"
+#include "../lib/mqtt/mqtt_functions.h"
+
+/*
+ * =================================================
+ * ███████████████ CONFIGURATION ███████████████████
+ * =================================================
+ */
+
+// Upper bound for everything in the arena. The build fails when a buffer
+// grows past it, instead of the heap running out at runtime.
+#define STATIC_ARENA_BUDGET_BYTES (96 * 1024)
+
+// Longest serial log line, including the terminator. Longer lines are cut.
+#define LOG_LINE_MAX 256
+
+// History response chunk: one queue slot, or PubSubClient's packet buffer
+#ifdef MQTT_ASYNC_TRANSPORT
+#define HISTORY_CHUNK_MAX MQTT_QUEUE_PAYLOAD_MAX
+#else
+#define HISTORY_CHUNK_MAX MQTT_BUFFER_SIZE
+#endif
+
+// OLED frame buffer: one bit per pixel, in pages of 8 rows
+#define DISPLAY_FRAME_BYTES (SCREEN_WIDTH * ((SCREEN_HEIGHT + 7) / 8))
+
+/*
+ * =================================================
+ * ███████████████ DATA STRUCTURES █████████████████
+ * =================================================
+ */
+
+// Every long-lived runtime buffer, statically sized in one place. The
+// owning modules bind to their member at file scope; nothing here is ever
+// allocated or freed.
+struct StaticArena
+{
+    // Sample rings
+    TsBlock tsRawBlocks[TS_RAW_TOTAL_BLOCKS]; // Split per channel by its sensor, see TS_RAW_SPAN_S
+    TsBlock tsMinuteBlocks[NUM_CHANNELS][TS_MINUTE_BLOCKS];
+    TsBlock tsHourBlocks[NUM_CHANNELS][TS_HOUR_BLOCKS];
+    RollingWindow statsWindows[NUM_CHANNELS];
+
+    // MQTT payloads
+#ifdef MQTT_ASYNC_TRANSPORT
+    MqttQueueEntry mqttQueue[MQTT_QUEUE_LENGTH];
+#endif
+    char historyChunk[HISTORY_CHUNK_MAX];
+
+    // Display and log
+    uint8_t displayFrame[DISPLAY_FRAME_BYTES];
+    uint8_t displayTransfer[DISPLAY_FRAME_BYTES]; // Copy being sent by the frame writer
+    char logLine[LOG_LINE_MAX];
+};
+
+static_assert(sizeof(StaticArena) <= STATIC_ARENA_BUDGET_BYTES, "Static arena exceeds STATIC_ARENA_BUDGET_BYTES");
+
+/*
+ * =================================================
+ * ███████████████ GLOBAL VARIABLES ████████████████
+ * =================================================
+ */
+
+extern StaticArena staticArena;
+
+/*
+ * =================================================
+ * ███████████████ FUNCTION DECLARATION ████████████
+ * =================================================
+ */
+
+void initializeStaticArena();
+void logPrintf(const char *format, ...) __attribute__((format(printf, 1, 2)));
+
+#endif
@@ -0,0 +1,135 @@
+#ifndef TIME_SERIES_STORE_H
+#define TIME_SERIES_STORE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "sensor_channels.h"
+
+/*
+ * =================================================
+ * ███████████████ CONFIGURATION ███████████████████
+ * =================================================
+ */
+
+// A block holds 70-120 samples of a noisy sensor reading (17-28 bits each,
+// measured with tools/ts_bench.cpp); integer readings such as whole dB
+// take far less. A full ring recycles its oldest block, so it keeps
+// (blocks - 1) to blocks of history. Measured lower bounds per channel:
+// minute tier 21-35 h, hour tier 3-4 days.
+#define TS_BLOCK_BYTES 256        // Compressed payload bytes per block
+#define TS_MINUTE_BLOCKS 18       // 1-minute rollup blocks per channel
+#define TS_HOUR_BLOCKS 2          // 1-hour rollup blocks per channel
+#define TS_BLOCK_MIN_SAMPLES 70   // Fewest samples of a noisy reading per block
+
+// The raw tier stores 1 s means, so a sensor sampled faster (the MQ-2
+// under adaptive sampling) adds at most one point per second. Its ring is
+// sized per sensor from the default period in SENSOR_GROUP_TABLE to keep
+// at least TS_RAW_SPAN_S of noisy readings. Measured: 6 min for the MQ-2,
+// 21 min for whole-dB sound, 13-19 min for the BME680, whose minimum of
+// two blocks holds more. A period configured faster than the default
+// shortens the span.
+#define TS_RAW_SPAN_S 300
+#define TS_RAW_POINTS(periodUs) (TS_RAW_SPAN_S * 1000000ULL / ((periodUs) > 1000000 ? (periodUs) : 1000000))
+#define TS_RAW_BLOCKS_FOR(periodUs) \
+    ((TS_RAW_POINTS(periodUs) + TS_BLOCK_MIN_SAMPLES - 1) / TS_BLOCK_MIN_SAMPLES + 1)
+
+// Worst-case encoded size of one sample: a 36-bit timestamp (4-bit prefix,
+// 32-bit delta-of-delta) and a 44-bit value (2-bit prefix, 5-bit leading
+// zeros, 5-bit length, 32 bits). A block takes no sample it might not fit.
+#define TS_MAX_SAMPLE_BITS 80
+#define TS_NO_WINDOW 0xFF // Encoder/decoder state: no XOR window yet
+
+// Storage resolutions, finest first
+enum TsResolution
+{
+    TS_RAW,
+    TS_MINUTE,
+    TS_HOUR,
+    TS_NUM_RESOLUTIONS
+};
+
+// Raw blocks per channel of each sensor (TS_RAW_BLOCKS_BME680, ...), and
+// their total over all channels
+#define TS_RAW_GROUP_BLOCKS(id, name, label, periodUs) TS_RAW_BLOCKS_##id = TS_RAW_BLOCKS_FOR(periodUs),
+enum TsRawGroupBlocks
+{
+    SENSOR_GROUP_TABLE(TS_RAW_GROUP_BLOCKS)
+};
+#undef TS_RAW_GROUP_BLOCKS
+
+#define TS_RAW_CHANNEL_BLOCKS(id, variable, group, name, topic, label, unit, precision, warn, alarm) \
+    +TS_RAW_BLOCKS_##group
+#define TS_RAW_TOTAL_BLOCKS (0 SENSOR_CHANNEL_TABLE(TS_RAW_CHANNEL_BLOCKS))
+
+/*
+ * =================================================
+ * ███████████████ DATA STRUCTURES █████████████████
+ * =================================================
+ */
+
+// Gorilla-compressed block: delta-of-delta timestamps, XOR'd float values
+struct TsBlock
+{
+    uint32_t firstTimestamp; // Timestamp of the first sample (seconds)
+    uint32_t lastTimestamp;  // Encoder state: previous timestamp
+    int32_t lastDelta;       // Encoder state: previous timestamp delta
+    uint32_t lastValueBits;  // Encoder state: previous value as raw bits
+    uint16_t count;          // Samples in this block
+    uint16_t bitLength;      // Bits written to data
+    uint16_t generation;     // Bumped each time the block is recycled
+    uint8_t lastLeading;     // Encoder state: previous XOR leading zeros
+    uint8_t lastTrailing;    // Encoder state: previous XOR trailing zeros
+    uint8_t data[TS_BLOCK_BYTES];
+};
+
+// Range query cursor, decodes one block at a time without allocating
+struct TsIterator
+{
+    SensorChannel channel;
+    TsResolution resolution;
+    uint32_t from;
+    uint32_t to;
+    uint8_t blocksLeft;   // Blocks still to visit, oldest first
+    uint8_t blockIndex;   // Ring slot being decoded
+    uint16_t sampleIndex; // Next sample within the block
+    uint16_t bitPos;      // Read position within the block
+    uint16_t generation;  // Generation of the block being decoded
+    uint32_t timestamp;   // Decoder state
+    int32_t delta;
+    uint32_t valueBits;
+    uint8_t leading;
+    uint8_t trailing;
+};
+
+// Memory and compression figures for diagnostics
+struct TsStoreUsage
+{
+    uint32_t samples;         // Samples currently retained across all tiers
+    uint32_t encodedBytes;    // Bytes used by their compressed encoding
+    uint32_t allocatedBytes;  // Static SRAM reserved for the store
+};
+
+/*
+ * =================================================
+ * ███████████████ FUNCTION DECLARATION ████████████
+ * =================================================
+ */
+
+// Codec (ts_codec.cpp, plain C++)
+void encodeTimeSeriesSample(TsBlock &block, uint32_t timestamp, float value);
+void decodeTimeSeriesSample(TsIterator &it, const TsBlock &block);
+
+// Store (time_series_store.cpp)
+void initializeTimeSeriesStore();
+void appendTimeSeries(SensorChannel channel, uint32_t timestamp, float value);
+
+void beginTimeSeriesQuery(TsIterator &it, SensorChannel channel, TsResolution resolution, uint32_t from, uint32_t to);
+bool nextTimeSeriesPoint(TsIterator &it, uint32_t &timestamp, float &value);
+
+TsStoreUsage getTimeSeriesStoreUsage();
+
+// Readers on other tasks hold the lock around batches of nextTimeSeriesPoint()
+void lockTimeSeriesStore();
+void unlockTimeSeriesStore();
+
+#endif
@@ -0,0 +1,187 @@
+#include "mqtt_async.h"
+
+#ifdef MQTT_ASYNC_TRANSPORT
+
+#include <WiFi.h>
+#include <AsyncMqttClient.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/timers.h>
+#include "mqtt_functions.h"
+#include "mqtt_history.h"
+#include "diagnostics.h"
+#include "static_arena.h"
+
+static AsyncMqttClient asyncClient;
+static TimerHandle_t reconnectTimer = NULL;
+static TaskHandle_t drainTask = NULL;
+static SemaphoreHandle_t queueMutex = NULL;
+
+// Pending messages; the ring lives in the static arena
+static MqttQueue queue;
+
+// Connect if Wi-Fi is up, otherwise try again later
+static void connectAsyncMQTT(TimerHandle_t)
+{
+    if (WiFi.isConnected())
+    {
+        Serial.println("Connecting to MQTT broker (async)...");
+        asyncClient.connect();
+    }
+    else
+    {
+        xTimerStart(reconnectTimer, 0);
+    }
+}
+
+static void onAsyncMQTTConnect(bool sessionPresent)
+{
+    Serial.println("MQTT connected (async)");
+    systemMetrics.mqttReconnects++;
+    char topic[MQTT_TOPIC_MAX];
+    asyncClient.subscribe(deviceTopic(TOPIC_HISTORY_REQUEST, topic, sizeof(topic)), 0);
+    asyncClient.subscribe(deviceTopic(TOPIC_CONFIG, topic, sizeof(topic)), 1); // Retained, delivered on every connect
+    xTaskNotifyGive(drainTask);
+}
+
+static void onAsyncMQTTDisconnect(AsyncMqttClientDisconnectReason reason)
+{
+    logPrintf("MQTT disconnected (reason %d), retrying\n", (int)reason);
+    xTimerStart(reconnectTimer, 0);
+}
+
+// Only unfragmented messages are routed; requests are far below one packet
+static void onAsyncMQTTMessage(char *topic, char *payload, AsyncMqttClientMessageProperties properties,
+                               size_t length, size_t index, size_t total)
+{
+    if (index == 0 && length == total)
+    {
+        handleMQTTMessage(topic, (byte *)payload, length);
+    }
+}
+
+// Drain the queue into the TCP stack whenever notified. A failed publish
+// means the socket buffer is full: back off briefly and retry the same entry.
+static void drainQueueTask(void *)
+{
+    MqttQueueEntry entry;
+    TickType_t wait = portMAX_DELAY;
+
+    while (true)
+    {
+        ulTaskNotifyTake(pdTRUE, wait);
+        wait = portMAX_DELAY;
+
+        while (asyncClient.connected())
+        {
+            xSemaphoreTake(queueMutex, portMAX_DELAY);
+            bool pending = peekMqttQueue(queue, entry);
+            xSemaphoreGive(queueMutex);
+            if (!pending)
+            {
+                break;
+            }
+
+            if (asyncClient.publish(entry.topic, 0, entry.retain, entry.payload, entry.length) == 0)
+            {
+                wait = pdMS_TO_TICKS(10);
+                break;
+            }
+
+            uint32_t sentUs = micros();
+            xSemaphoreTake(queueMutex, portMAX_DELAY);
+            completeMqttQueue(queue, entry, sentUs);
+            xSemaphoreGive(queueMutex);
+        }
+    }
+}
+
+// Set up the event-driven client: keepalive and reconnects run on the
+// AsyncTCP task and a timer, draining runs on its own task.
+void setupAsyncMQTT()
+{
+    resetMqttQueue(queue, staticArena.mqttQueue);
+    queueMutex = xSemaphoreCreateMutex();
+    reconnectTimer = xTimerCreate("mqtt_reconnect", pdMS_TO_TICKS(MQTT_RECONNECT_DELAY_MS), pdFALSE, NULL, connectAsyncMQTT);
+    xTaskCreate(drainQueueTask, "mqtt_tx", 4096, NULL, 2, &drainTask);
+
+    asyncClient.onConnect(onAsyncMQTTConnect);
+    asyncClient.onDisconnect(onAsyncMQTTDisconnect);
+    asyncClient.onMessage(onAsyncMQTTMessage);
+    asyncClient.setServer(MQTT_BROKER, MQTT_PORT);
+    asyncClient.setCredentials(MQTT_USERNAME, MQTT_PASSWORD);
+    asyncClient.setClientId(mqttIdentity.clientId);
+    asyncClient.setKeepAlive(MQTT_KEEPALIVE_SECONDS);
+
+    connectAsyncMQTT(reconnectTimer);
+}
+
+bool isAsyncMQTTConnected()
+{
+    return asyncClient.connected();
+}
+
+// Force the TCP connection closed; the disconnect handler reconnects
+void resetAsyncMQTT()
+{
+    asyncClient.disconnect(true);
+}
+
+// Queue a message without blocking on the network. When the queue is full
+// the configured policy decides what gives way; returns false if the message
+// itself could not be queued.
+bool mqttQueuePublish(const char *topic, const char *payload, size_t length, bool retain, bool coalesce)
+{
+    xSemaphoreTake(queueMutex, portMAX_DELAY);
+    bool queued = pushMqttQueue(queue, MQTT_QUEUE_POLICY, topic, payload, length, retain, coalesce, micros());
+    xSemaphoreGive(queueMutex);
+    if (!queued)
+    {
+        return false;
+    }
+
+    xTaskNotifyGive(drainTask);
+    return true;
+}
+
+// Block the caller (never the network) until a slot is free, for producers
+// such as history responses that must not evict their own earlier chunks.
+bool mqttQueueWaitForSpace(uint32_t timeoutMs)
+{
+    uint32_t start = millis();
+    while (queue.count >= MQTT_QUEUE_LENGTH)
+    {
+        if (millis() - start >= timeoutMs)
+        {
+            return false;
+        }
+        vTaskDelay(pdMS_TO_TICKS(5));
+    }
+    return true;
+}
+
+// Wait until everything queued so far has been handed to the TCP stack
+bool mqttQueueFlush(uint32_t timeoutMs)
+{
+    uint32_t start = millis();
+    while (queue.count > 0)
+    {
+        if (!asyncClient.connected() || millis() - start >= timeoutMs)
+        {
+            return false;
+        }
+        vTaskDelay(pdMS_TO_TICKS(5));
+    }
+    return true;
+}
+
+MqttQueueStats getMqttQueueStats()
+{
+    xSemaphoreTake(queueMutex, portMAX_DELAY);
+    MqttQueueStats stats = queue.stats;
+    stats.depth = queue.count;
+    xSemaphoreGive(queueMutex);
+    return stats;
+}
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef MQTT_ASYNC_H
+#define MQTT_ASYNC_H
+
+#include <Arduino.h>
+#include "mqtt_config.h"
+#include "mqtt_identity.h"
+#include "mqtt_queue.h"
+
+// Connection configuration (override in mqtt_config.h if needed)
+#ifndef MQTT_KEEPALIVE_SECONDS
+#define MQTT_KEEPALIVE_SECONDS 15
+#endif
+#ifndef MQTT_RECONNECT_DELAY_MS
+#define MQTT_RECONNECT_DELAY_MS 2000
+#endif
+
+// Function Declarations
+void setupAsyncMQTT();
+bool isAsyncMQTTConnected();
+void resetAsyncMQTT();
+bool mqttQueuePublish(const char *topic, const char *payload, size_t length, bool retain, bool coalesce);
+bool mqttQueueWaitForSpace(uint32_t timeoutMs);
+bool mqttQueueFlush(uint32_t timeoutMs);
+MqttQueueStats getMqttQueueStats();
+
+#endif
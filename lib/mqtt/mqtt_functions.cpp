@@ -1,93 +1,613 @@
 #include "mqtt_functions.h"
+#include "static_arena.h"
+#include "mqtt_history.h"
+#include "mqtt_async.h"
+#include "mqtt_identity.h"
+#include "diagnostics.h"
+#include "power_management.h"
+#include "boot_sequence.h"
+#include "sensor_registry.h"
+#include "sampling_scheduler.h"
+#include "runtime_config.h"
+#include "stage_watchdog.h"
+#include "memory_monitor.h"
+#include "ota_setup.h"
+#include "hardware_init.h"
+#include "anomaly_detector.h"
+#include "sound_spectrum.h"
+#include "i2c_bus.h"
+#include <esp_timer.h>
+#include <stdarg.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
 
-// MQTT Connection Setup
+#ifndef MQTT_ASYNC_TRANSPORT
+// The blocking client is shared by loop(), the alert task and the
+// watchdog's reset worker. Every call into it holds this lock; it is
+// recursive because client.loop() runs the message callback, which
+// publishes.
+static StaticSemaphore_t clientLockBuffer;
+static SemaphoreHandle_t clientLock = NULL;
+
+static bool lockClient()
+{
+    return clientLock == NULL || xSemaphoreTakeRecursive(clientLock, pdMS_TO_TICKS(MQTT_CLIENT_LOCK_MS)) == pdTRUE;
+}
+
+static void unlockClient()
+{
+    if (clientLock != NULL)
+    {
+        xSemaphoreGiveRecursive(clientLock);
+    }
+}
+#endif
+
+// Apply a configuration message right away (periods must change within a
+// second) and report the outcome
+static void handleMQTTConfig(const byte *payload, unsigned int length)
+{
+    char status[96] = "rejected: ";
+    switch (applyRuntimeConfig((const char *)payload, length, status + 10, sizeof(status) - 10))
+    {
+    case CONFIG_APPLIED:
+        strcpy(status, "applied");
+        break;
+    case CONFIG_UNCHANGED:
+        strcpy(status, "unchanged");
+        break;
+    default:
+        logPrintf("Configuration %s\n", status);
+        break;
+    }
+    publishMQTTMessage(client, TOPIC_CONFIG_STATUS, status, false);
+}
+
+// Route incoming messages to their handlers
+void handleMQTTMessage(char *topic, byte *payload, unsigned int length)
+{
+    char expected[MQTT_TOPIC_MAX];
+    if (strcmp(topic, deviceTopic(TOPIC_HISTORY_REQUEST, expected, sizeof(expected))) == 0)
+    {
+        handleMQTTHistoryRequest(payload, length);
+    }
+    else if (strcmp(topic, deviceTopic(TOPIC_CONFIG, expected, sizeof(expected))) == 0)
+    {
+        handleMQTTConfig(payload, length);
+    }
+}
+
+// MQTT Connection Setup. The client ID and topic base come from the
+// factory MAC, which is readable before Wi-Fi is up.
 void setupMQTT(PubSubClient &client)
 {
+    uint64_t efuseMac = ESP.getEfuseMac();
+    uint8_t mac[6];
+    for (int i = 0; i < 6; i++)
+    {
+        mac[i] = (uint8_t)(efuseMac >> (8 * i));
+    }
+    buildMQTTIdentity(mqttIdentity, mac);
+    logPrintf("MQTT client %s on %s/#\n", mqttIdentity.clientId, mqttIdentity.topicBase);
+
+#ifdef MQTT_ASYNC_TRANSPORT
+    setupAsyncMQTT();
+#else
+    clientLock = xSemaphoreCreateRecursiveMutexStatic(&clientLockBuffer);
     client.setServer(MQTT_BROKER, MQTT_PORT);
+    client.setBufferSize(MQTT_BUFFER_SIZE);
+    client.setCallback(handleMQTTMessage);
+#endif
+}
+
+#ifndef MQTT_ASYNC_TRANSPORT
+// Single connection attempt
+static bool connectMQTTOnce(PubSubClient &client)
+{
+    Serial.print("Connecting to MQTT broker...");
+    if (client.connect(mqttIdentity.clientId, MQTT_USERNAME, MQTT_PASSWORD))
+    {
+        Serial.println("Connected!");
+        systemMetrics.mqttReconnects++;
+        char topic[MQTT_TOPIC_MAX];
+        client.subscribe(deviceTopic(TOPIC_HISTORY_REQUEST, topic, sizeof(topic)));
+        client.subscribe(deviceTopic(TOPIC_CONFIG, topic, sizeof(topic)), 1);
+        return true;
+    }
+    Serial.print("Failed, rc=");
+    Serial.println(client.state());
+    return false;
+}
+#endif
+
+// Keep the connection alive and process incoming messages. While the broker
+// is down this makes one connection attempt per MQTT_RETRY_INTERVAL_MS and
+// returns, so loop() (and its watchdog stages) keeps going. With the async
+// transport this happens on the network task, so there is nothing to do.
+void loopMQTT(PubSubClient &client)
+{
+#ifndef MQTT_ASYNC_TRANSPORT
+    static unsigned long lastAttempt = 0;
+    if (!lockClient())
+    {
+        return;
+    }
+    if (!client.connected())
+    {
+        if (lastAttempt != 0 && millis() - lastAttempt < MQTT_RETRY_INTERVAL_MS)
+        {
+            unlockClient();
+            return;
+        }
+        lastAttempt = millis() | 1;
+        if (!connectMQTTOnce(client))
+        {
+            unlockClient();
+            return;
+        }
+    }
+    client.loop();
+    unlockClient();
+#endif
 }
 
-// Reconnect to MQTT Broker
+// Reconnect to MQTT Broker (the async transport reconnects on its own)
 void reconnectMQTT(PubSubClient &client)
 {
+#ifndef MQTT_ASYNC_TRANSPORT
     while (!client.connected())
     {
-        Serial.print("Connecting to MQTT broker...");
-        if (client.connect("ESP32Client", MQTT_USERNAME, MQTT_PASSWORD))
+        if (!connectMQTTOnce(client))
         {
-            Serial.println("Connected!");
+            Serial.println("Retrying in 5 seconds...");
+            delay(MQTT_RETRY_INTERVAL_MS);
         }
-        else
+    }
+#endif
+}
+
+// Drop the broker connection, e.g. a half-open socket that stalled a
+// publish; it is re-established like any other disconnect
+void resetMQTTConnection(PubSubClient &client)
+{
+#ifdef MQTT_ASYNC_TRANSPORT
+    resetAsyncMQTT();
+#else
+    // Goes ahead without the lock if a hung publish holds it: dropping the
+    // socket is what unblocks it
+    bool locked = lockClient();
+    client.disconnect();
+    espClient.stop();
+    if (locked)
+    {
+        unlockClient();
+    }
+#endif
+}
+
+// Whether a broker session is currently up
+bool isMQTTConnected(PubSubClient &client)
+{
+#ifdef MQTT_ASYNC_TRANSPORT
+    return isAsyncMQTTConnected();
+#else
+    return client.connected();
+#endif
+}
+
+// Wait a bounded time for the broker connection, for short-lived sessions
+bool waitForMQTTConnection(PubSubClient &client, uint32_t timeoutMs)
+{
+    uint32_t start = millis();
+#ifdef MQTT_ASYNC_TRANSPORT
+    while (!isAsyncMQTTConnected())
+    {
+        if (millis() - start >= timeoutMs)
         {
-            Serial.print("Failed, rc=");
-            Serial.println(client.state());
-            Serial.println("Retrying in 5 seconds...");
-            delay(5000);
+            return false;
         }
+        delay(10);
     }
+#else
+    while (!connectMQTTOnce(client))
+    {
+        if (millis() - start >= timeoutMs)
+        {
+            return false;
+        }
+        delay(500);
+    }
+#endif
+    return true;
 }
 
-// Publish Sensor Readings to MQTT
-void publishMQTTReadings(
-    PubSubClient &client,
-    float temperature,
-    float humidity,
-    float pressure,
-    float gas,
-    float altitude,
-    float lpg,
-    float co,
-    float smoke,
-    float sound)
+// Wait until everything published so far has left the device
+bool flushMQTT(PubSubClient &client, uint32_t timeoutMs)
 {
+#ifdef MQTT_ASYNC_TRANSPORT
+    return mqttQueueFlush(timeoutMs);
+#else
+    client.loop();
+    return client.connected();
+#endif
+}
+
+// Publish one message: straight to the socket, or via the outbound queue
+// with the async transport. Coalescing messages replace a queued one on the
+// same topic; others wait for a free slot instead of evicting. Topics under
+// TOPIC_SENSOR_BASE go out under this node's topic base.
+bool publishMQTTMessage(PubSubClient &client, const char *topic, const char *payload, bool retained, bool coalesce)
+{
+    char mapped[MQTT_TOPIC_MAX];
+    int length = mapDeviceTopic(mqttIdentity, topic, mapped, sizeof(mapped));
+    if (length < 0 || (size_t)length >= sizeof(mapped))
+    {
+        return false;
+    }
+#ifdef MQTT_ASYNC_TRANSPORT
+    if (!coalesce && !mqttQueueWaitForSpace(1000))
+    {
+        return false;
+    }
+    return mqttQueuePublish(mapped, payload, strlen(payload), retained, coalesce);
+#else
+    if (!lockClient())
+    {
+        return false;
+    }
+    bool sent = client.publish(mapped, payload, retained);
+    unlockClient();
+    return sent;
+#endif
+}
 
+// Publish a single float reading with two decimals
+static void publishMQTTValue(PubSubClient &client, const char *topic, float value)
+{
+    char payload[16];
+    snprintf(payload, sizeof(payload), "%.2f", value);
+    publishMQTTMessage(client, topic, payload, true);
+}
+
+// Publish Sensor Readings to MQTT, one retained message per channel
+void publishMQTTReadings(PubSubClient &client)
+{
     // Ensure MQTT connection
-    if (!client.connected())
+    loopMQTT(client);
+
+    char payload[16];
+    for (int ch = 0; ch < NUM_CHANNELS; ch++)
     {
-        reconnectMQTT(client);
+        formatChannelValue((SensorChannel)ch, payload, sizeof(payload));
+        publishMQTTMessage(client, CHANNELS[ch].topic, payload, true);
     }
-    client.loop();
 
-    // Debug sensor readings
-    Serial.println("Preparing to publish MQTT readings...");
-    Serial.print("Temperature: ");
-    Serial.println(temperature);
+    Serial.println("MQTT readings successfully published!");
 
-    Serial.print("Humidity: ");
-    Serial.println(humidity);
+    // The first readings to reach a live session close the boot timeline
+    if (systemMetrics.firstPublishMs == 0 && isMQTTConnected(client))
+    {
+        markFirstPublish();
+        publishMQTTBootReport(client);
+    }
+}
 
-    Serial.print("Pressure: ");
-    Serial.println(pressure);
+// Publish the KY-038 octave band levels and the alarm tone state, retained
+void publishMQTTSoundSpectrum(PubSubClient &client)
+{
+    SoundSpectrum spectrum = getSoundSpectrum();
+    char topic[MQTT_QUEUE_TOPIC_MAX];
+    char payload[16];
+    for (int b = 0; b < NUM_SOUND_BANDS; b++)
+    {
+        snprintf(topic, sizeof(topic), "%s/%u", TOPIC_SOUND_BANDS, SOUND_BAND_CENTRES_HZ[b]);
+        snprintf(payload, sizeof(payload), "%.1f", spectrum.bandDbfs[b]);
+        publishMQTTMessage(client, topic, payload, true);
+    }
+    publishMQTTMessage(client, TOPIC_ALARM_TONE, spectrum.alarmTone ? "1" : "0", true);
+}
 
-    Serial.print("Gas Resistance: ");
-    Serial.println(gas);
+// Publish Readings of the Registry Sensors (additional rooms) to MQTT
+void publishMQTTRoomReadings(PubSubClient &client)
+{
+    char topic[MQTT_QUEUE_TOPIC_MAX];
+    for (uint8_t i = 0; i < getSensorInstanceCount(); i++)
+    {
+        const SensorInstance &instance = getSensorInstance(i);
+        if (!instance.present || !instance.valid)
+        {
+            continue;
+        }
+        SensorType type = instance.config.type;
+        for (uint8_t v = 0; v < getSensorValueCount(type); v++)
+        {
+            snprintf(topic, sizeof(topic), "%s/%s/%s/%s", TOPIC_ROOM_BASE, instance.config.room,
+                     getSensorTypeName(type), getSensorValueName(type, v));
+            publishMQTTValue(client, topic, instance.values[v]);
+        }
+    }
+}
 
-    Serial.print("Altitude: ");
-    Serial.println(altitude);
+// Publish Rolling Window Aggregates to MQTT
+void publishMQTTStatistics(PubSubClient &client)
+{
+    loopMQTT(client);
 
-    Serial.print("LPG Levels: ");
-    Serial.println(lpg);
+    char topic[96];
+    char payload[128];
+    uint32_t nowMs = millis();
+    for (int i = 0; i < NUM_CHANNELS; i++)
+    {
+        StatsSummary stats = getRollingStats((SensorChannel)i, nowMs);
+        if (stats.count == 0)
+        {
+            continue;
+        }
 
-    Serial.print("CO Levels: ");
-    Serial.println(co);
+        snprintf(topic, sizeof(topic), "%s%s", CHANNELS[i].topic, TOPIC_STATS_SUFFIX);
+        snprintf(payload, sizeof(payload),
+                 "{\"min\":%.2f,\"max\":%.2f,\"mean\":%.2f,\"stddev\":%.2f,\"samples\":%u}",
+                 stats.min, stats.max, stats.mean, stats.stddev, (unsigned)stats.count);
+        publishMQTTMessage(client, topic, payload, true);
+    }
 
-    Serial.print("Smoke Levels: ");
-    Serial.println(smoke);
+    Serial.println("MQTT statistics successfully published!");
+}
 
-    Serial.print("Sound Levels: ");
-    Serial.println(sound);
+// Publish boot timings (time to first sample, network, first publish)
+void publishMQTTBootReport(PubSubClient &client)
+{
+    char payload[128];
+    snprintf(payload, sizeof(payload),
+             "{\"first_sample_ms\":%lu,\"network_ready_ms\":%lu,\"first_publish_ms\":%lu,\"budget_ms\":%d}",
+             (unsigned long)systemMetrics.firstSampleMs,
+             (unsigned long)systemMetrics.networkReadyMs,
+             (unsigned long)systemMetrics.firstPublishMs,
+             BOOT_BUDGET_MS);
+    publishMQTTMessage(client, TOPIC_BOOT, payload, true);
+}
 
-    Serial.println("All sensor readings logged.");
+// Append to a JSON payload built piece by piece. Returns the new length,
+// which stops at the terminator once the payload is full, so later
+// appends write nothing instead of running past the buffer.
+int appendPayload(char *payload, size_t size, int length, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    int written = vsnprintf(payload + length, size - length, format, args);
+    va_end(args);
+    if (written < 0)
+    {
+        return length;
+    }
+    return (size_t)(length + written) < size ? length + written : (int)size - 1;
+}
+
+// Publish Device Health (loop timing, reconnects, heap, energy, sampling jitter, I2C bus) to MQTT
+void publishMQTTDiagnostics(PubSubClient &client)
+{
+    PowerStats power = getPowerStats();
+    OtaStats ota = getOTAStats();
+    char payload[384];
+    snprintf(payload, sizeof(payload),
+             "{\"uptime_s\":%lu,\"loop_ms\":%lu,\"loop_max_ms\":%lu,\"mqtt_reconnects\":%lu,"
+             "\"wifi_reconnects\":%lu,\"heap_free\":%lu,\"heap_min\":%lu,"
+             "\"active_ms\":%lu,\"active_pct\":%.1f,\"mah_per_day\":%.0f,\"pm\":%d,\"light_sleep\":%d,\"task_wdt_reset\":%d,"
+             "\"ota_updates\":%lu,\"ota_ms\":%lu,\"ota_kbps\":%.1f,\"ota_ratio\":%.2f}",
+             millis() / 1000,
+             (unsigned long)systemMetrics.loopTimeMs,
+             (unsigned long)systemMetrics.maxLoopTimeMs,
+             (unsigned long)systemMetrics.mqttReconnects,
+             (unsigned long)systemMetrics.wifiReconnects,
+             (unsigned long)ESP.getFreeHeap(),
+             (unsigned long)ESP.getMinFreeHeap(),
+             (unsigned long)power.activeTimeMs,
+             power.activeRatio * 100,
+             power.estimatedMahPerDay,
+             power.pmEnabled ? 1 : 0,
+             power.lightSleep ? 1 : 0,
+             lastResetByTaskWatchdog() ? 1 : 0,
+             (unsigned long)ota.updates,
+             (unsigned long)ota.lastDurationMs,
+             ota.lastBytesPerSec / 1024.0,
+             ota.lastPackedBytes > 0 ? (double)ota.lastBytes / ota.lastPackedBytes : 1.0);
+    publishMQTTMessage(client, TOPIC_DIAGNOSTICS, payload, false);
 
-    // Publish sensor readings to MQTT topics
-    client.publish(TOPIC_TEMPERATURE, String(temperature).c_str(), true);
-    client.publish(TOPIC_HUMIDITY, String(humidity).c_str(), true);
-    client.publish(TOPIC_PRESSURE, String(pressure).c_str(), true);
-    client.publish(TOPIC_GAS, String(gas).c_str(), true);
-    client.publish(TOPIC_ALTITUDE, String(altitude).c_str(), true);
-    client.publish(TOPIC_LPG, String(lpg).c_str(), true);
-    client.publish(TOPIC_CO, String(co).c_str(), true);
-    client.publish(TOPIC_SMOKE, String(smoke).c_str(), true);
-    client.publish(TOPIC_SOUND, String(sound).c_str(), true);
+    // Sampling jitter, one object per sensor
+    int length = appendPayload(payload, sizeof(payload), 0, "{");
+    for (int g = 0; g < NUM_SENSOR_GROUPS; g++)
+    {
+        SamplingJitter jitter = getSamplingJitter((SensorGroup)g);
+        length = appendPayload(payload, sizeof(payload), length,
+                               "%s\"%s\":{\"period_us\":%lu,\"min_us\":%ld,\"max_us\":%ld,\"p99_us\":%ld,"
+                               "\"overruns\":%lu,\"retimes\":%lu}",
+                               g > 0 ? "," : "", SENSOR_GROUP_NAMES[g], (unsigned long)jitter.periodUs,
+                               (long)jitter.minUs, (long)jitter.maxUs, (long)jitter.p99Us,
+                               (unsigned long)jitter.overruns, (unsigned long)jitter.retimes);
+    }
+    appendPayload(payload, sizeof(payload), length, "}");
+    publishMQTTMessage(client, TOPIC_SAMPLING, payload, false);
 
-    Serial.println("MQTT readings successfully published!");
-}
\ No newline at end of file
+    // I2C bus: utilisation since the last report, then per client
+    static uint64_t lastBusyUs = 0;
+    static int64_t lastReportUs = 0;
+    I2CClientStats stats[NUM_I2C_CLIENTS];
+    uint64_t busyUs = 0;
+    for (int c = 0; c < NUM_I2C_CLIENTS; c++)
+    {
+        stats[c] = getI2CClientStats((I2CClient)c);
+        busyUs += stats[c].busyUs;
+    }
+    int64_t nowUs = esp_timer_get_time();
+    double utilisation = nowUs > lastReportUs ? (double)(busyUs - lastBusyUs) / (nowUs - lastReportUs) : 0;
+    lastBusyUs = busyUs;
+    lastReportUs = nowUs;
+
+    length = appendPayload(payload, sizeof(payload), 0, "{\"clock_hz\":%lu,\"utilisation\":%.3f",
+                           (unsigned long)getI2CClockHz(), utilisation);
+    for (int c = 0; c < NUM_I2C_CLIENTS; c++)
+    {
+        uint32_t waitAvgUs = stats[c].transactions > 0 ? (uint32_t)(stats[c].waitUs / stats[c].transactions) : 0;
+        length = appendPayload(payload, sizeof(payload), length,
+                               ",\"%s\":{\"transactions\":%lu,\"wait_avg_us\":%lu,\"wait_max_us\":%lu,"
+                               "\"timeouts\":%lu}",
+                               I2C_CLIENT_NAMES[c], (unsigned long)stats[c].transactions, (unsigned long)waitAvgUs,
+                               (unsigned long)stats[c].maxWaitUs, (unsigned long)stats[c].timeouts);
+    }
+    appendPayload(payload, sizeof(payload), length, "}");
+    publishMQTTMessage(client, TOPIC_I2C, payload, false);
+}
+
+// Per-stage watchdog counters, at the statistics rate
+void publishMQTTWatchdog(PubSubClient &client)
+{
+    char topic[64];
+    char payload[192];
+    for (int s = 0; s < NUM_WATCHDOG_STAGES; s++)
+    {
+        StageStats stats = getStageStats((WatchdogStage)s);
+        snprintf(topic, sizeof(topic), "%s/%s", TOPIC_WATCHDOG, WATCHDOG_STAGE_NAMES[s]);
+        snprintf(payload, sizeof(payload),
+                 "{\"deadline_ms\":%lu,\"escalation\":\"%s\",\"runs\":%lu,\"overruns\":%lu,\"skips\":%lu,"
+                 "\"resets\":%lu,\"failures\":%lu,\"last_ms\":%lu,\"worst_ms\":%lu}",
+                 (unsigned long)stats.deadlineMs, WATCHDOG_ESCALATION_NAMES[stats.escalation],
+                 (unsigned long)stats.runs, (unsigned long)stats.overruns, (unsigned long)stats.skips,
+                 (unsigned long)stats.resets, (unsigned long)stats.failures, (unsigned long)stats.lastMs,
+                 (unsigned long)stats.worstMs);
+        publishMQTTMessage(client, topic, payload, false);
+    }
+}
+
+// Latest overrun with the offending stage (retained), once per new overrun.
+// An overrun that caused a watchdog reboot is sent after the reboot.
+void publishMQTTWatchdogEvent(PubSubClient &client)
+{
+    static uint32_t publishedSequence = 0;
+    WatchdogEvent event = getLastWatchdogEvent();
+    if (event.sequence == publishedSequence)
+    {
+        return;
+    }
+
+    char payload[192];
+    snprintf(payload, sizeof(payload),
+             "{\"stage\":\"%s\",\"task\":\"%s\",\"elapsed_ms\":%lu,\"deadline_ms\":%lu,\"action\":\"%s\","
+             "\"overruns\":%lu,\"rebooted\":%s}",
+             WATCHDOG_STAGE_NAMES[event.stage], event.task, (unsigned long)event.elapsedMs,
+             (unsigned long)event.deadlineMs, WATCHDOG_ESCALATION_NAMES[event.action],
+             (unsigned long)getStageStats(event.stage).overruns, event.beforeReboot ? "true" : "false");
+    if (publishMQTTMessage(client, TOPIC_WATCHDOG_EVENT, payload, true))
+    {
+        publishedSequence = event.sequence;
+    }
+}
+
+// Anomaly starts and ends since the last call, oldest first. Events that
+// fell out of the detector's queue in between are skipped. Called by the
+// alert task only; false if an event could not be sent and is still due.
+bool publishMQTTAnomalyEvents(PubSubClient &client)
+{
+    static uint32_t publishedSequence = 0;
+    uint32_t last = getLastAnomalySequence();
+    if (last - publishedSequence > ANOMALY_EVENT_QUEUE)
+    {
+        publishedSequence = last - ANOMALY_EVENT_QUEUE;
+    }
+
+    char payload[256];
+    AnomalyEvent event;
+    while (publishedSequence != last && getAnomalyEvent(publishedSequence + 1, event))
+    {
+        int length = appendPayload(payload, sizeof(payload), 0,
+                                   "{\"channel\":\"%s\",\"state\":\"%s\",\"triggers\":[",
+                                   CHANNEL_NAMES[ANOMALY_CHANNELS[event.channel]], event.start ? "start" : "end");
+        bool firstItem = true;
+        for (int t = 0; t < NUM_ANOMALY_TRIGGERS; t++)
+        {
+            if (event.triggers & (1 << t))
+            {
+                length = appendPayload(payload, sizeof(payload), length, "%s\"%s\"", firstItem ? "" : ",",
+                                       ANOMALY_TRIGGER_NAMES[t]);
+                firstItem = false;
+            }
+        }
+        appendPayload(payload, sizeof(payload), length,
+                      "],\"value\":%.2f,\"baseline\":%.2f,\"z\":%.1f,\"rate_per_s\":%.3f,\"cusum\":%.1f,"
+                      "\"at_s\":%lu,\"events\":%lu}",
+                      event.value, event.baseline, event.zScore, event.ratePerS, event.cusum,
+                      (unsigned long)event.timestampS, (unsigned long)getAnomalyStatus(event.channel).events);
+        if (!publishMQTTMessage(client, TOPIC_ANOMALY, payload, false, false))
+        {
+            return false;
+        }
+        publishedSequence = event.sequence;
+    }
+    return true;
+}
+
+// Alert flags of the last memory report
+static uint8_t publishedMemoryAlerts = 0;
+
+// Heap, fragmentation, stacks and alerts; with the allocation hook also
+// the allocations per site since the previous report
+void publishMQTTMemory(PubSubClient &client)
+{
+    MemoryStats stats = getMemoryStats();
+    char payload[384];
+    int length = appendPayload(payload, sizeof(payload), 0,
+                               "{\"free\":%lu,\"min_free\":%lu,\"largest\":%lu,\"min_largest\":%lu,\"frag_pct\":%u,"
+                               "\"max_frag_pct\":%u,\"strays\":%lu,\"alerts\":[",
+                               (unsigned long)stats.freeHeap, (unsigned long)stats.minFreeHeap,
+                               (unsigned long)stats.largestBlock, (unsigned long)stats.minLargestBlock,
+                               stats.fragmentationPct, stats.maxFragmentationPct,
+                               (unsigned long)getStrayAllocations().count);
+    bool firstItem = true;
+    for (int a = 0; a < NUM_MEMORY_ALERTS; a++)
+    {
+        if (stats.alerts & (1 << a))
+        {
+            length = appendPayload(payload, sizeof(payload), length, "%s\"%s\"", firstItem ? "" : ",",
+                                   MEMORY_ALERT_NAMES[a]);
+            firstItem = false;
+        }
+    }
+    length = appendPayload(payload, sizeof(payload), length, "],\"stack_free\":{");
+    firstItem = true;
+    for (int t = 0; t < NUM_MEMORY_TASKS; t++)
+    {
+        if (stats.stackFree[t] >= 0)
+        {
+            length = appendPayload(payload, sizeof(payload), length, "%s\"%s\":%ld", firstItem ? "" : ",",
+                                   MEMORY_TASK_NAMES[t], (long)stats.stackFree[t]);
+            firstItem = false;
+        }
+    }
+    appendPayload(payload, sizeof(payload), length, "}}");
+    publishMQTTMessage(client, TOPIC_MEMORY, payload, false);
+    publishedMemoryAlerts = stats.alerts;
+
+#ifdef MEMORY_ALLOC_HOOK
+    static AllocationCount reported[NUM_ALLOC_SITES];
+    length = appendPayload(payload, sizeof(payload), 0, "{");
+    for (int site = 0; site < NUM_ALLOC_SITES; site++)
+    {
+        AllocationCount count = getAllocationCount((AllocationSite)site);
+        length = appendPayload(payload, sizeof(payload), length, "%s\"%s\":{\"calls\":%lu,\"bytes\":%lu}",
+                               site > 0 ? "," : "", ALLOC_SITE_NAMES[site],
+                               (unsigned long)(count.calls - reported[site].calls),
+                               (unsigned long)(count.bytes - reported[site].bytes));
+        reported[site] = count;
+    }
+    appendPayload(payload, sizeof(payload), length, "}");
+    publishMQTTMessage(client, TOPIC_ALLOCATIONS, payload, false);
+#endif
+}
+
+// Report straight away when a memory alert is raised or cleared
+void publishMQTTMemoryAlerts(PubSubClient &client)
+{
+    if (getMemoryStats().alerts != publishedMemoryAlerts)
+    {
+        publishMQTTMemory(client);
+    }
+}
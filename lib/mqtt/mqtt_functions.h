@@ -3,10 +3,125 @@
 
 #include <PubSubClient.h>
 #include "mqtt_config.h"
+#include "rolling_stats.h"
+
+// Reading topics come from SENSOR_CHANNEL_TABLE (sensor_channels.h) under
+// TOPIC_SENSOR_BASE. Registry sensors publish on <base>/<room>/<type>/<value>.
+#ifndef TOPIC_ROOM_BASE
+#define TOPIC_ROOM_BASE TOPIC_SENSOR_BASE
+#endif
+
+// PubSubClient packet buffer (the library default of 256 is too small for
+// a batch sample with every channel)
+#ifndef MQTT_BUFFER_SIZE
+#define MQTT_BUFFER_SIZE 512
+#endif
+
+// Suffix appended to each reading topic for its rolling aggregates
+#ifndef TOPIC_STATS_SUFFIX
+#define TOPIC_STATS_SUFFIX "/stats"
+#endif
+
+// Device health topic
+#ifndef TOPIC_DIAGNOSTICS
+#define TOPIC_DIAGNOSTICS TOPIC_SENSOR_BASE "/diagnostics"
+#endif
+
+// Per-sensor sampling period and jitter
+#ifndef TOPIC_SAMPLING
+#define TOPIC_SAMPLING TOPIC_DIAGNOSTICS "/sampling"
+#endif
+// I2C bus clock, utilisation and per-client wait times
+#ifndef TOPIC_I2C
+#define TOPIC_I2C TOPIC_DIAGNOSTICS "/i2c"
+#endif
+
+// Stage watchdog: counters per stage on <TOPIC_WATCHDOG>/<stage> and the
+// latest overrun, with the offending stage, on TOPIC_WATCHDOG_EVENT
+#ifndef TOPIC_WATCHDOG
+#define TOPIC_WATCHDOG TOPIC_DIAGNOSTICS "/watchdog"
+#endif
+#ifndef TOPIC_WATCHDOG_EVENT
+#define TOPIC_WATCHDOG_EVENT TOPIC_WATCHDOG "/event"
+#endif
+
+// Heap, fragmentation and stack high-water marks with alert flags, and
+// allocations per loop() site since the last report (MEMORY_ALLOC_HOOK)
+#ifndef TOPIC_MEMORY
+#define TOPIC_MEMORY TOPIC_DIAGNOSTICS "/memory"
+#endif
+#ifndef TOPIC_ALLOCATIONS
+#define TOPIC_ALLOCATIONS TOPIC_MEMORY "/allocations"
+#endif
+
+// Early-warning anomalies on the gas channels: one message per start and
+// end (anomaly_detector.h)
+#ifndef TOPIC_ANOMALY
+#define TOPIC_ANOMALY TOPIC_SENSOR_BASE "/anomaly"
+#endif
+
+// KY-038 spectrum (sound_spectrum.h): octave band levels in dBFS on
+// <TOPIC_SOUND_BANDS>/<centre Hz>, and 1 while a smoke alarm's T3 tone is
+// heard, 0 otherwise (all retained)
+#ifndef TOPIC_SOUND_BANDS
+#define TOPIC_SOUND_BANDS TOPIC_SENSOR_BASE "/ky038/band"
+#endif
+#ifndef TOPIC_ALARM_TONE
+#define TOPIC_ALARM_TONE TOPIC_SENSOR_BASE "/ky038/alarm_tone"
+#endif
+
+// Runtime configuration (retained, see runtime_config.h) and the outcome
+// of each message: "applied", "unchanged" or "rejected: <reason>"
+#ifndef TOPIC_CONFIG
+#define TOPIC_CONFIG TOPIC_SENSOR_BASE "/config"
+#endif
+#ifndef TOPIC_CONFIG_STATUS
+#define TOPIC_CONFIG_STATUS TOPIC_CONFIG "/status"
+#endif
+
+// Boot timing report (retained)
+#ifndef TOPIC_BOOT
+#define TOPIC_BOOT TOPIC_SENSOR_BASE "/boot"
+#endif
+
+// Deep-sleep batch upload topic
+#ifndef TOPIC_BATCH
+#define TOPIC_BATCH TOPIC_SENSOR_BASE "/batch"
+#endif
+
+// Time between connection attempts of the blocking client
+#ifndef MQTT_RETRY_INTERVAL_MS
+#define MQTT_RETRY_INTERVAL_MS 5000
+#endif
+
+// Longest wait for the blocking client while another task is using it
+// (loop() and the alert task both publish)
+#ifndef MQTT_CLIENT_LOCK_MS
+#define MQTT_CLIENT_LOCK_MS 1000
+#endif
 
 // Function Declarations
 void setupMQTT(PubSubClient &client);
+void loopMQTT(PubSubClient &client);
 void reconnectMQTT(PubSubClient &client);
-void publishMQTTReadings(PubSubClient &client, float temperature, float humidity, float pressure, float gas, float altitude, float lpg, float co, float smoke, float sound);
+void resetMQTTConnection(PubSubClient &client);
+void handleMQTTMessage(char *topic, byte *payload, unsigned int length);
+bool isMQTTConnected(PubSubClient &client);
+bool waitForMQTTConnection(PubSubClient &client, uint32_t timeoutMs);
+bool flushMQTT(PubSubClient &client, uint32_t timeoutMs);
+bool publishMQTTMessage(PubSubClient &client, const char *topic, const char *payload, bool retained, bool coalesce = true);
+void publishMQTTReadings(PubSubClient &client);
+void publishMQTTSoundSpectrum(PubSubClient &client);
+void publishMQTTRoomReadings(PubSubClient &client);
+void publishMQTTStatistics(PubSubClient &client);
+void publishMQTTDiagnostics(PubSubClient &client);
+void publishMQTTWatchdog(PubSubClient &client);
+void publishMQTTWatchdogEvent(PubSubClient &client);
+bool publishMQTTAnomalyEvents(PubSubClient &client);
+void publishMQTTMemory(PubSubClient &client);
+void publishMQTTMemoryAlerts(PubSubClient &client);
+void publishMQTTBootReport(PubSubClient &client);
+int appendPayload(char *payload, size_t size, int length, const char *format, ...)
+    __attribute__((format(printf, 4, 5)));
 
 #endif
\ No newline at end of file
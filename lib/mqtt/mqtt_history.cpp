@@ -0,0 +1,104 @@
+#include "mqtt_history.h"
+#include "mqtt_async.h"
+#include "static_arena.h"
+
+// MQTT fixed header (1 byte type + up to 4 bytes remaining length)
+#define MQTT_FIXED_HEADER_MAX 5
+
+// Query received on TOPIC_HISTORY_REQUEST, served from the main loop
+static HistoryQuery pendingQuery;
+
+// Queue a query for serviceMQTTHistoryQuery(), see parseHistoryQuery()
+void handleMQTTHistoryRequest(const byte *payload, unsigned int length)
+{
+    HistoryQuery query;
+    if (!parseHistoryQuery((const char *)payload, length, millis() / 1000, query))
+    {
+        Serial.println("History request ignored: no channels or empty range");
+        return;
+    }
+
+    query.pending = true;
+    pendingQuery = query;
+}
+
+// Each chunk is encoded into one buffer, sized for the transport, and
+// published once the store is unlocked
+static char (&chunkBuffer)[HISTORY_CHUNK_MAX] = staticArena.historyChunk;
+
+#ifdef MQTT_ASYNC_TRANSPORT
+// Async transport: each chunk takes one queue slot
+static bool responseConnected(PubSubClient &)
+{
+    return isAsyncMQTTConnected();
+}
+
+static size_t responseChunkLimit(PubSubClient &)
+{
+    return MQTT_QUEUE_PAYLOAD_MAX;
+}
+
+static bool waitResponseChunk(void *)
+{
+    yield();
+    return mqttQueueWaitForSpace(1000);
+}
+
+static bool publishResponseChunk(void *, const char *data, size_t length)
+{
+    char topic[MQTT_TOPIC_MAX];
+    return mqttQueuePublish(deviceTopic(TOPIC_HISTORY_RESPONSE, topic, sizeof(topic)), data, length, false, false);
+}
+#else
+// PubSubClient: each chunk is copied into the client's packet buffer
+static bool responseConnected(PubSubClient &client)
+{
+    return client.connected();
+}
+
+static size_t responseChunkLimit(PubSubClient &client)
+{
+    char topic[MQTT_TOPIC_MAX];
+    size_t topicOverhead = 2 + strlen(deviceTopic(TOPIC_HISTORY_RESPONSE, topic, sizeof(topic))) + MQTT_FIXED_HEADER_MAX;
+    return client.getBufferSize() > topicOverhead ? client.getBufferSize() - topicOverhead : 0;
+}
+
+static bool waitResponseChunk(void *)
+{
+    yield();
+    return true;
+}
+
+static bool publishResponseChunk(void *client, const char *data, size_t length)
+{
+    char topic[MQTT_TOPIC_MAX];
+    return ((PubSubClient *)client)->publish(deviceTopic(TOPIC_HISTORY_RESPONSE, topic, sizeof(topic)),
+                                             (const uint8_t *)data, length, false);
+}
+#endif
+
+// Stream a pending history query as one or more response messages, each
+// sized to fit PubSubClient's buffer (or one queue slot)
+void serviceMQTTHistoryQuery(PubSubClient &client)
+{
+    if (!pendingQuery.pending || !responseConnected(client))
+    {
+        return;
+    }
+    HistoryQuery query = pendingQuery;
+    pendingQuery.pending = false;
+
+    size_t chunkLimit = responseChunkLimit(client);
+    if (chunkLimit > HISTORY_CHUNK_MAX)
+    {
+        chunkLimit = HISTORY_CHUNK_MAX;
+    }
+    HistorySink sink = {&client, waitResponseChunk, publishResponseChunk};
+    int chunks = streamHistoryResponse(query, chunkBuffer, chunkLimit, sink);
+    if (chunks < 0)
+    {
+        Serial.println("History response aborted: publish failed");
+        return;
+    }
+    logPrintf("History response sent in %d chunk(s)\n", chunks);
+}
@@ -0,0 +1,12 @@
+#ifndef MQTT_HISTORY_H
+#define MQTT_HISTORY_H
+
+#include <PubSubClient.h>
+#include "mqtt_config.h"
+#include "mqtt_history_query.h"
+
+// Function Declarations
+void handleMQTTHistoryRequest(const byte *payload, unsigned int length);
+void serviceMQTTHistoryQuery(PubSubClient &client);
+
+#endif
@@ -0,0 +1,195 @@
+#include "mqtt_history_query.h"
+#include <stdio.h>
+#include <string.h>
+
+// Position within a response, copied to re-run a chunk after measuring it
+struct HistoryCursor
+{
+    int channel;
+    bool started;
+    TsIterator it;
+};
+
+// Compare a non-terminated token with a C string
+static bool tokenEquals(const char *token, size_t length, const char *text)
+{
+    return strlen(text) == length && strncmp(token, text, length) == 0;
+}
+
+// Parse an unsigned decimal token, false on any non-digit
+static bool parseUnsigned(const char *token, size_t length, uint32_t &value)
+{
+    if (length == 0)
+    {
+        return false;
+    }
+    value = 0;
+    for (size_t i = 0; i < length; i++)
+    {
+        if (token[i] < '0' || token[i] > '9')
+        {
+            return false;
+        }
+        value = value * 10 + (token[i] - '0');
+    }
+    return true;
+}
+
+// Parse "channels=temperature,co;last=3600;res=minute;id=ha" style queries.
+// Keys: channels, from, to (seconds since boot), last (seconds back from
+// now), res (raw|minute|hour), id (echoed in every response chunk). False
+// if the query selects no channel or an empty range.
+bool parseHistoryQuery(const char *text, size_t length, uint32_t now, HistoryQuery &query)
+{
+    query = {false, 0, 0, UINT32_MAX, TS_MINUTE, ""};
+
+    size_t start = 0;
+    for (size_t i = 0; i <= length; i++)
+    {
+        if (i < length && text[i] != ';' && text[i] != '&')
+        {
+            continue;
+        }
+
+        const char *pair = text + start;
+        size_t pairLength = i - start;
+        start = i + 1;
+
+        const char *eq = (const char *)memchr(pair, '=', pairLength);
+        if (eq == nullptr)
+        {
+            continue;
+        }
+        size_t keyLength = eq - pair;
+        const char *value = eq + 1;
+        size_t valueLength = pairLength - keyLength - 1;
+        uint32_t number;
+
+        if (tokenEquals(pair, keyLength, "channels"))
+        {
+            query.channelMask = parseChannelMask(value, valueLength);
+        }
+        else if (tokenEquals(pair, keyLength, "from") && parseUnsigned(value, valueLength, number))
+        {
+            query.from = number;
+        }
+        else if (tokenEquals(pair, keyLength, "to") && parseUnsigned(value, valueLength, number))
+        {
+            query.to = number;
+        }
+        else if (tokenEquals(pair, keyLength, "last") && parseUnsigned(value, valueLength, number))
+        {
+            query.from = number < now ? now - number : 0;
+        }
+        else if (tokenEquals(pair, keyLength, "res"))
+        {
+            if (tokenEquals(value, valueLength, "raw"))
+            {
+                query.resolution = TS_RAW;
+            }
+            else if (tokenEquals(value, valueLength, "hour"))
+            {
+                query.resolution = TS_HOUR;
+            }
+            else
+            {
+                query.resolution = TS_MINUTE;
+            }
+        }
+        else if (tokenEquals(pair, keyLength, "id"))
+        {
+            size_t idLength = valueLength < HISTORY_ID_MAX - 1 ? valueLength : HISTORY_ID_MAX - 1;
+            memcpy(query.id, value, idLength);
+            query.id[idLength] = '\0';
+        }
+    }
+
+    return query.channelMask != 0 && query.from <= query.to;
+}
+
+// Advance to the next record of the response, formatted as "name,ts,value\n"
+static int nextHistoryRecord(const HistoryQuery &query, HistoryCursor &cursor, char *line)
+{
+    while (cursor.channel < NUM_CHANNELS)
+    {
+        if (!(query.channelMask & (1u << cursor.channel)))
+        {
+            cursor.channel++;
+            continue;
+        }
+        if (!cursor.started)
+        {
+            beginTimeSeriesQuery(cursor.it, (SensorChannel)cursor.channel, query.resolution, query.from, query.to);
+            cursor.started = true;
+        }
+
+        uint32_t timestamp;
+        float value;
+        if (nextTimeSeriesPoint(cursor.it, timestamp, value))
+        {
+            return snprintf(line, HISTORY_LINE_MAX, "%s,%lu,%.2f\n",
+                            CHANNEL_NAMES[cursor.channel], (unsigned long)timestamp, value);
+        }
+        cursor.channel++;
+        cursor.started = false;
+    }
+    return 0;
+}
+
+// Stream a query as one or more response messages of at most maxPayload
+// bytes. Each chunk is encoded into buffer (maxPayload bytes) with the
+// store locked, so samplers cannot append while it is read, and handed to
+// the sink after unlocking, so a slow connection never holds up a sampler.
+// The cursor only moves past records that made it into a chunk. Returns
+// the number of chunks sent, or -1 if the sink gave up or maxPayload
+// cannot hold a single record.
+int streamHistoryResponse(const HistoryQuery &query, char *buffer, size_t maxPayload, const HistorySink &sink)
+{
+    char line[HISTORY_LINE_MAX];
+    HistoryCursor cursor = {0, false, {}};
+    uint16_t chunk = 0;
+    bool final = false;
+
+    while (!final)
+    {
+        if (!sink.wait(sink.context))
+        {
+            return -1;
+        }
+
+        // The header is the same length either way; its final flag is set
+        // once the chunk is full
+        int headerLength = snprintf(line, sizeof(line), "#id=%s;chunk=%u;final=0\n", query.id, chunk);
+        if ((size_t)headerLength + HISTORY_LINE_MAX > maxPayload)
+        {
+            return -1;
+        }
+        memcpy(buffer, line, headerLength);
+        size_t length = headerLength;
+        final = true;
+
+        lockTimeSeriesStore();
+        HistoryCursor next = cursor;
+        int lineLength;
+        while ((lineLength = nextHistoryRecord(query, next, line)) > 0)
+        {
+            if (length + lineLength > maxPayload)
+            {
+                final = false;
+                break;
+            }
+            memcpy(buffer + length, line, lineLength);
+            length += lineLength;
+            cursor = next;
+        }
+        unlockTimeSeriesStore();
+
+        buffer[headerLength - 2] = final ? '1' : '0';
+        if (!sink.publish(sink.context, buffer, length))
+        {
+            return -1;
+        }
+        chunk++;
+    }
+    return chunk;
+}
@@ -0,0 +1,48 @@
+#ifndef MQTT_HISTORY_QUERY_H
+#define MQTT_HISTORY_QUERY_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "time_series_store.h"
+
+// History queries and their chunked CSV responses, independent of the MQTT
+// transport. Plain C++ only, so the host integration test
+// (tools/history_check) runs the same parser and chunking.
+
+// History query topics (override in mqtt_config.h if needed)
+#ifndef TOPIC_HISTORY_REQUEST
+#define TOPIC_HISTORY_REQUEST TOPIC_SENSOR_BASE "/history/request"
+#endif
+#ifndef TOPIC_HISTORY_RESPONSE
+#define TOPIC_HISTORY_RESPONSE TOPIC_SENSOR_BASE "/history/response"
+#endif
+
+#define HISTORY_LINE_MAX 48
+#define HISTORY_ID_MAX 16
+
+// Query received on TOPIC_HISTORY_REQUEST
+struct HistoryQuery
+{
+    bool pending;
+    uint16_t channelMask;
+    uint32_t from;
+    uint32_t to;
+    TsResolution resolution;
+    char id[HISTORY_ID_MAX];
+};
+
+// Where a response goes, one chunk (MQTT message) at a time. Both run with
+// the store unlocked and may block: wait() before each chunk is encoded,
+// publish() once it is.
+struct HistorySink
+{
+    void *context;
+    bool (*wait)(void *context);
+    bool (*publish)(void *context, const char *data, size_t length);
+};
+
+// Function Declarations
+bool parseHistoryQuery(const char *text, size_t length, uint32_t now, HistoryQuery &query);
+int streamHistoryResponse(const HistoryQuery &query, char *buffer, size_t maxPayload, const HistorySink &sink);
+
+#endif
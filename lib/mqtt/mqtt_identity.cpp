@@ -0,0 +1,42 @@
+#include "mqtt_identity.h"
+#include <stdio.h>
+#include <string.h>
+
+MqttIdentity mqttIdentity;
+
+// Client ID and topic base of a node with the given MAC
+void buildMQTTIdentity(MqttIdentity &identity, const uint8_t mac[6])
+{
+#ifdef MQTT_DEVICE_ID
+    (void)mac;
+    snprintf(identity.clientId, sizeof(identity.clientId), "%s", MQTT_DEVICE_ID);
+#else
+    snprintf(identity.clientId, sizeof(identity.clientId), MQTT_DEVICE_ID_PREFIX "%02x%02x%02x", mac[3], mac[4],
+             mac[5]);
+#endif
+#ifdef MQTT_SHARED_TOPICS
+    snprintf(identity.topicBase, sizeof(identity.topicBase), "%s", TOPIC_SENSOR_BASE);
+#else
+    snprintf(identity.topicBase, sizeof(identity.topicBase), "%s/%s", TOPIC_SENSOR_BASE, identity.clientId);
+#endif
+}
+
+// Write a topic under TOPIC_SENSOR_BASE with the node's base in its place;
+// other topics are copied unchanged. Returns the snprintf() length.
+int mapDeviceTopic(const MqttIdentity &identity, const char *topic, char *buffer, size_t size)
+{
+    static const size_t baseLength = sizeof(TOPIC_SENSOR_BASE) - 1;
+    if (strncmp(topic, TOPIC_SENSOR_BASE, baseLength) == 0 && (topic[baseLength] == '/' || topic[baseLength] == '\0'))
+    {
+        return snprintf(buffer, size, "%s%s", identity.topicBase, topic + baseLength);
+    }
+    return snprintf(buffer, size, "%s", topic);
+}
+
+// Map a fixed topic for this node into an MQTT_TOPIC_MAX buffer, for
+// subscriptions and comparisons. Returns the buffer.
+const char *deviceTopic(const char *topic, char *buffer, size_t size)
+{
+    mapDeviceTopic(mqttIdentity, topic, buffer, size);
+    return buffer;
+}
@@ -0,0 +1,45 @@
+#ifndef MQTT_IDENTITY_H
+#define MQTT_IDENTITY_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "sensor_channels.h"
+
+// Every node connects with its own client ID and publishes under its own
+// topic base, both derived from the factory MAC: client ID
+// "homeclimate-a1b2c3" (last three MAC bytes) and topics
+// <TOPIC_SENSOR_BASE>/homeclimate-a1b2c3/... A fixed client ID made nodes
+// take over each other's broker session.
+//
+// Topics are written everywhere as TOPIC_SENSOR_BASE "/..." and mapped to
+// the device base when they go on the wire. Plain C++ only, so the fleet
+// simulator (tools/fleet_sim) builds the same identities and topics.
+#ifndef MQTT_DEVICE_ID_PREFIX
+#define MQTT_DEVICE_ID_PREFIX "homeclimate-"
+#endif
+
+// Set MQTT_DEVICE_ID in mqtt_config.h to use a fixed name instead of the
+// MAC, and MQTT_SHARED_TOPICS to publish on TOPIC_SENSOR_BASE directly
+// (single-node installs with existing Home Assistant entities)
+
+#define MQTT_DEVICE_ID_MAX 32
+#define MQTT_TOPIC_MAX 96 // Longest topic after mapping, terminator included
+#define MQTT_TOPIC_SUFFIX_MAX 48 // Longest fixed topic after TOPIC_SENSOR_BASE
+static_assert(sizeof(TOPIC_SENSOR_BASE) + MQTT_DEVICE_ID_MAX + MQTT_TOPIC_SUFFIX_MAX <= MQTT_TOPIC_MAX,
+              "MQTT_TOPIC_MAX too small for the device topic base");
+
+struct MqttIdentity
+{
+    char clientId[MQTT_DEVICE_ID_MAX];                              // Client ID and topic segment
+    char topicBase[sizeof(TOPIC_SENSOR_BASE) + MQTT_DEVICE_ID_MAX]; // Replaces TOPIC_SENSOR_BASE
+};
+
+// Identity of this node, set by setupMQTT()
+extern MqttIdentity mqttIdentity;
+
+// Function Declarations
+void buildMQTTIdentity(MqttIdentity &identity, const uint8_t mac[6]);
+int mapDeviceTopic(const MqttIdentity &identity, const char *topic, char *buffer, size_t size);
+const char *deviceTopic(const char *topic, char *buffer, size_t size);
+
+#endif
@@ -0,0 +1,100 @@
+#include "mqtt_queue.h"
+#include <string.h>
+
+// Evict the oldest message to make room
+static void dropOldest(MqttQueue &queue)
+{
+    queue.head = (queue.head + 1) % MQTT_QUEUE_LENGTH;
+    queue.count--;
+    queue.stats.dropped++;
+}
+
+void resetMqttQueue(MqttQueue &queue, MqttQueueEntry *entries)
+{
+    memset(&queue, 0, sizeof(queue));
+    queue.entries = entries;
+    queue.nextSequence = 1;
+}
+
+// Queue a copy of the message. When the queue is full the policy decides
+// what gives way; returns false if the message itself could not be queued.
+bool pushMqttQueue(MqttQueue &queue, MqttQueuePolicy policy, const char *topic, const char *payload, size_t length,
+                   bool retain, bool coalesce, uint32_t nowUs)
+{
+    if (strlen(topic) >= MQTT_QUEUE_TOPIC_MAX || length > MQTT_QUEUE_PAYLOAD_MAX)
+    {
+        queue.stats.dropped++;
+        return false;
+    }
+
+    MqttQueueEntry *slot = NULL;
+    if (policy == MQTT_COALESCE && coalesce)
+    {
+        for (uint16_t i = 0; i < queue.count; i++)
+        {
+            MqttQueueEntry &queued = queue.entries[(queue.head + i) % MQTT_QUEUE_LENGTH];
+            if (queued.coalesce && strcmp(queued.topic, topic) == 0)
+            {
+                slot = &queued;
+                queue.stats.coalesced++;
+                break;
+            }
+        }
+    }
+
+    if (slot == NULL)
+    {
+        if (queue.count == MQTT_QUEUE_LENGTH)
+        {
+            dropOldest(queue);
+        }
+        slot = &queue.entries[(queue.head + queue.count) % MQTT_QUEUE_LENGTH];
+        queue.count++;
+        strcpy(slot->topic, topic);
+    }
+
+    slot->sequence = queue.nextSequence++;
+    slot->enqueuedUs = nowUs;
+    slot->length = length;
+    slot->retain = retain;
+    slot->coalesce = coalesce;
+    memcpy(slot->payload, payload, length);
+
+    queue.stats.enqueued++;
+    if (queue.count > queue.stats.highWater)
+    {
+        queue.stats.highWater = queue.count;
+    }
+    return true;
+}
+
+// Copy the oldest message out, so it can be sent without holding the lock;
+// false when the queue is empty
+bool peekMqttQueue(const MqttQueue &queue, MqttQueueEntry &entry)
+{
+    if (queue.count == 0)
+    {
+        return false;
+    }
+    entry = queue.entries[queue.head];
+    return true;
+}
+
+// Record a peeked message as sent. It is only removed if it is still at
+// the head unchanged: while it was on the wire it may have been evicted,
+// or coalesced with a newer payload that still has to go out.
+void completeMqttQueue(MqttQueue &queue, const MqttQueueEntry &entry, uint32_t nowUs)
+{
+    uint32_t latency = nowUs - entry.enqueuedUs;
+    if (queue.count > 0 && queue.entries[queue.head].sequence == entry.sequence)
+    {
+        queue.head = (queue.head + 1) % MQTT_QUEUE_LENGTH;
+        queue.count--;
+    }
+    queue.stats.sent++;
+    queue.stats.lastLatencyUs = latency;
+    if (latency > queue.stats.maxLatencyUs)
+    {
+        queue.stats.maxLatencyUs = latency;
+    }
+}
@@ -0,0 +1,77 @@
+#ifndef MQTT_QUEUE_H
+#define MQTT_QUEUE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "mqtt_identity.h"
+
+// Outbound message ring of the async transport and its backpressure
+// policy, independent of AsyncMqttClient and FreeRTOS. Plain C++ only, so
+// the host transport test (tools/mqtt_queue_check) runs the same queue.
+
+// Outbound queue configuration (override in mqtt_config.h if needed)
+#ifndef MQTT_QUEUE_LENGTH
+#define MQTT_QUEUE_LENGTH 16
+#endif
+#ifndef MQTT_QUEUE_TOPIC_MAX
+#define MQTT_QUEUE_TOPIC_MAX MQTT_TOPIC_MAX
+#endif
+#ifndef MQTT_QUEUE_PAYLOAD_MAX
+#define MQTT_QUEUE_PAYLOAD_MAX 384
+#endif
+
+// Backpressure policy applied when the queue is full
+enum MqttQueuePolicy
+{
+    MQTT_DROP_OLDEST, // Evict the oldest queued message
+    MQTT_COALESCE     // Replace a queued message on the same topic, else evict the oldest
+};
+
+#ifndef MQTT_QUEUE_POLICY
+#define MQTT_QUEUE_POLICY MQTT_COALESCE
+#endif
+
+// Queue counters for diagnostics
+struct MqttQueueStats
+{
+    uint32_t enqueued;      // Messages accepted
+    uint32_t sent;          // Messages handed to the TCP stack
+    uint32_t dropped;       // Messages evicted or rejected
+    uint32_t coalesced;     // Messages replaced by a newer one on the same topic
+    uint16_t depth;         // Messages currently queued
+    uint16_t highWater;     // Deepest the queue has been
+    uint32_t lastLatencyUs; // Enqueue-to-send latency of the last message
+    uint32_t maxLatencyUs;  // Worst enqueue-to-send latency
+};
+
+// Queued outbound message
+struct MqttQueueEntry
+{
+    uint32_t sequence;   // Changes whenever the slot's content changes
+    uint32_t enqueuedUs; // micros() when queued, for latency
+    uint16_t length;
+    bool retain;
+    bool coalesce;
+    char topic[MQTT_QUEUE_TOPIC_MAX];
+    char payload[MQTT_QUEUE_PAYLOAD_MAX];
+};
+
+// Ring of pending messages, oldest at head. Not locked: the transport
+// holds its queue mutex around every call.
+struct MqttQueue
+{
+    MqttQueueEntry *entries; // MQTT_QUEUE_LENGTH slots
+    uint16_t head;
+    uint16_t count;
+    uint32_t nextSequence;
+    MqttQueueStats stats;
+};
+
+// Function Declarations
+void resetMqttQueue(MqttQueue &queue, MqttQueueEntry *entries);
+bool pushMqttQueue(MqttQueue &queue, MqttQueuePolicy policy, const char *topic, const char *payload, size_t length,
+                   bool retain, bool coalesce, uint32_t nowUs);
+bool peekMqttQueue(const MqttQueue &queue, MqttQueueEntry &entry);
+void completeMqttQueue(MqttQueue &queue, const MqttQueueEntry &entry, uint32_t nowUs);
+
+#endif
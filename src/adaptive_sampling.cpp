@@ -0,0 +1,131 @@
+#include "adaptive_sampling.h"
+#include "sampling_scheduler.h"
+#include "runtime_config.h"
+#include <math.h>
+
+// Smoothed level and rate of rise of one channel; only touched by its
+// sensor's sampler task
+struct AdaptiveChannel
+{
+    float level;
+    float slope; // Units per second
+    uint32_t lastMs;
+    bool primed;
+};
+
+static AdaptiveChannel adaptive[NUM_CHANNELS];
+
+/*
+ * ==================================================
+ * FUNCTION: TRACK SLOPE
+ * ==================================================
+ * Description:
+ *   Updates a channel's smoothed level and its rate of rise with a weight
+ *   from the time since the last sample (time constant
+ *   ADAPT_SMOOTHING_MS), so the estimate means the same at any period.
+ */
+
+static void trackSlope(AdaptiveChannel &state, float value, uint32_t nowMs)
+{
+    if (!state.primed)
+    {
+        state.level = value;
+        state.slope = 0;
+        state.lastMs = nowMs;
+        state.primed = true;
+        return;
+    }
+    uint32_t elapsedMs = nowMs - state.lastMs;
+    if (elapsedMs == 0)
+    {
+        return;
+    }
+    float weight = 1.0f - expf(-(float)elapsedMs / ADAPT_SMOOTHING_MS);
+    float level = state.level + weight * (value - state.level);
+    float slope = (level - state.level) * 1000.0f / elapsedMs;
+    state.slope += weight * (slope - state.slope);
+    state.level = level;
+    state.lastMs = nowMs;
+}
+
+/*
+ * ==================================================
+ * FUNCTION: CHANNEL PERIOD
+ * ==================================================
+ * Description:
+ *   Period one channel asks for (µs, unclamped): by its headroom to the
+ *   first threshold and by its time to reach it at the current rate of
+ *   rise. The slowest bound if it has no threshold.
+ */
+
+static float channelPeriodUs(SensorChannel channel, float value, const AdaptiveChannel &state,
+                             const SamplingBounds &bounds)
+{
+    ChannelThresholds thresholds = getChannelThresholds(channel);
+    float threshold = isnan(thresholds.warn) ? thresholds.alarm : thresholds.warn;
+    if (isnan(threshold) || isnan(value))
+    {
+        return bounds.maxUs;
+    }
+    if (value >= threshold || threshold <= 0)
+    {
+        return bounds.minUs;
+    }
+
+    float headroom = (threshold - value) / threshold;
+    float periodUs = bounds.minUs + (bounds.maxUs - bounds.minUs) * fminf(headroom / ADAPT_HEADROOM_FULL, 1.0f);
+    if (state.slope > 0)
+    {
+        float reachUs = (threshold - value) / state.slope * 1e6f;
+        periodUs = fminf(periodUs, reachUs / ADAPT_SAMPLES_TO_THRESHOLD);
+    }
+    return periodUs;
+}
+
+/*
+ * ==================================================
+ * FUNCTION: UPDATE ADAPTIVE SAMPLING
+ * ==================================================
+ * Description:
+ *   Runs on the sensor's sampler task after each recorded sample. Takes
+ *   the shortest period any channel of the sensor asks for, shrinks to it
+ *   at once or grows towards it by ADAPT_GROWTH, and retimes the sampler
+ *   when that moves the period by more than ADAPT_RETIME_STEP or onto a
+ *   bound. Sensors without bounds keep their fixed period.
+ */
+
+void updateAdaptiveSampling(SensorGroup group, uint32_t nowMs)
+{
+    SamplingBounds bounds = getSamplingBounds(group);
+    if (bounds.maxUs == 0)
+    {
+        return;
+    }
+
+    float targetUs = bounds.maxUs;
+    for (int ch = 0; ch < NUM_CHANNELS; ch++)
+    {
+        if (CHANNELS[ch].group != group)
+        {
+            continue;
+        }
+        float value = getChannelValue((SensorChannel)ch);
+        if (isnan(value))
+        {
+            continue;
+        }
+        trackSlope(adaptive[ch], value, nowMs);
+        targetUs = fminf(targetUs, channelPeriodUs((SensorChannel)ch, value, adaptive[ch], bounds));
+    }
+
+    uint32_t currentUs = getSamplingPeriod(group);
+    targetUs = fminf(targetUs, currentUs * ADAPT_GROWTH);
+    uint32_t periodUs = targetUs <= bounds.minUs ? bounds.minUs
+                        : targetUs >= bounds.maxUs ? bounds.maxUs
+                                                   : (uint32_t)targetUs;
+    bool onBound = periodUs == bounds.minUs || periodUs == bounds.maxUs;
+    if (periodUs != currentUs && (onBound || fabsf((float)periodUs - currentUs) > currentUs * ADAPT_RETIME_STEP))
+    {
+        retimeSampling(group, periodUs);
+    }
+}
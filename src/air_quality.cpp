@@ -0,0 +1,29 @@
+#include "air_quality.h"
+#include "hardware_init.h"
+#include "calibration_store.h"
+
+static uint32_t learningStartMs = 0; // First baseline of this boot, when not cached
+
+/*
+ * ==================================================
+ * FUNCTION: UPDATE AIR QUALITY
+ * ==================================================
+ * Description:
+ *   Updates `iaq`, `eco2` and `iaqAccuracy` from one BME680 reading in
+ *   constant time. The gas resistance is compensated to the reference
+ *   humidity, feeds the rolling clean-air baseline and is scored against
+ *   it (air_quality_kernels.cpp).
+ */
+
+void updateAirQuality(float gasKOhm, float humidity)
+{
+    float compensated = compensateGasResistance(gasKOhm, humidity);
+    updateGasBaseline(compensated);
+    float baseline = getGasBaseline();
+
+    AirQualityEstimate estimate = estimateAirQuality(compensated, humidity, baseline);
+    iaq = estimate.iaq;
+    eco2 = estimate.eco2;
+    iaqAccuracy = classifyAirQualityAccuracy(baseline, millis(), getCalibrationStats().gasBaselineCached,
+                                             learningStartMs);
+}
@@ -0,0 +1,81 @@
+#include "air_quality.h"
+#include "calibration_store.h"
+#include <math.h>
+
+/*
+ * ==================================================
+ * FUNCTION: COMPENSATE GAS RESISTANCE
+ * ==================================================
+ * Description:
+ *   Normalises a gas resistance to IAQ_HUMIDITY_REFERENCE, undoing the
+ *   exponential drop with humidity.
+ */
+
+float compensateGasResistance(float gasKOhm, float humidity)
+{
+    return gasKOhm * expf(IAQ_HUMIDITY_SLOPE * (humidity - IAQ_HUMIDITY_REFERENCE));
+}
+
+/*
+ * ==================================================
+ * FUNCTION: ESTIMATE AIR QUALITY
+ * ==================================================
+ * Description:
+ *   The gas score is the compensated reading as a share of the clean-air
+ *   baseline (full marks without a baseline). The humidity score falls
+ *   off linearly away from the reference. The combined 0-100 score maps
+ *   onto a 0 (excellent) to 500 (hazardous) index.
+ */
+
+AirQualityEstimate estimateAirQuality(float compensatedKOhm, float humidity, float baselineKOhm)
+{
+    float gasScore = IAQ_GAS_WEIGHT;
+    if (baselineKOhm > 0 && compensatedKOhm < baselineKOhm)
+    {
+        gasScore = compensatedKOhm / baselineKOhm * IAQ_GAS_WEIGHT;
+    }
+
+    float humidityScore;
+    if (humidity > IAQ_HUMIDITY_REFERENCE)
+    {
+        humidityScore = (100.0f - humidity) / (100.0f - IAQ_HUMIDITY_REFERENCE) * IAQ_HUMIDITY_WEIGHT;
+    }
+    else
+    {
+        humidityScore = humidity / IAQ_HUMIDITY_REFERENCE * IAQ_HUMIDITY_WEIGHT;
+    }
+    humidityScore = fminf(fmaxf(humidityScore, 0.0f), IAQ_HUMIDITY_WEIGHT);
+
+    AirQualityEstimate estimate;
+    estimate.iaq = (100.0f - gasScore - humidityScore) * 5.0f;
+    estimate.eco2 = IAQ_ECO2_BASE_PPM + IAQ_ECO2_PPM_PER_INDEX * estimate.iaq;
+    return estimate;
+}
+
+/*
+ * ==================================================
+ * FUNCTION: CLASSIFY AIR QUALITY ACCURACY
+ * ==================================================
+ * Description:
+ *   How far the IAQ estimate can be trusted, from heater warm-up and the
+ *   age of the gas baseline. learningStartMs (0 until then) records when
+ *   a baseline learned this boot was first used.
+ */
+
+IaqAccuracy classifyAirQualityAccuracy(float baselineKOhm, uint32_t nowMs, bool baselineCached,
+                                       uint32_t &learningStartMs)
+{
+    if (baselineKOhm <= 0 || nowMs < CAL_WARMUP_MS)
+    {
+        return IAQ_STABILIZING;
+    }
+    if (baselineCached)
+    {
+        return IAQ_CALIBRATED;
+    }
+    if (learningStartMs == 0)
+    {
+        learningStartMs = nowMs;
+    }
+    return nowMs - learningStartMs >= IAQ_SETTLE_MS ? IAQ_CALIBRATED : IAQ_LEARNING;
+}
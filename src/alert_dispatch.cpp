@@ -0,0 +1,71 @@
+#include "alert_dispatch.h"
+#include "helper_functions.h"
+#include "boot_sequence.h"
+#include "stage_watchdog.h"
+#include "../lib/mqtt/mqtt_functions.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+static TaskHandle_t alertTask = NULL;
+
+/*
+ * ==================================================
+ * FUNCTION: ALERT TASK
+ * ==================================================
+ * Description:
+ *   Waits for an update request, publishes the early-warning events raised
+ *   since the last run, then refreshes the NeoPixel status. Events the
+ *   broker connection did not take are retried every ALERT_RETRY_MS; the
+ *   status is only refreshed on a request.
+ */
+
+static void alertTaskLoop(void *)
+{
+    bool pending = false;
+    for (;;)
+    {
+        bool requested = ulTaskNotifyTake(pdTRUE, pending ? pdMS_TO_TICKS(ALERT_RETRY_MS) : portMAX_DELAY) != 0;
+
+        pending = true;
+        if (isNetworkReady() && beginStage(STAGE_PUBLISH))
+        {
+            pending = !publishMQTTAnomalyEvents(client);
+            endStage(STAGE_PUBLISH);
+        }
+
+        if (requested)
+        {
+            checkSafetyAndAlert();
+        }
+    }
+}
+
+/*
+ * ==================================================
+ * FUNCTION: START ALERT DISPATCH
+ * ==================================================
+ * Description:
+ *   Starts the alert task. Requests made before this are dropped.
+ */
+
+void startAlertDispatch()
+{
+    xTaskCreate(alertTaskLoop, "alerts", ALERT_TASK_STACK, NULL, ALERT_TASK_PRIORITY, &alertTask);
+}
+
+/*
+ * ==================================================
+ * FUNCTION: REQUEST ALERT UPDATE
+ * ==================================================
+ * Description:
+ *   Wakes the alert task; never blocks, so samplers call it straight from
+ *   the detection path. Requests made while it is busy are merged.
+ */
+
+void requestAlertUpdate()
+{
+    if (alertTask != NULL)
+    {
+        xTaskNotifyGive(alertTask);
+    }
+}
@@ -0,0 +1,256 @@
+#include "anomaly_detector.h"
+#include "static_arena.h"
+#include "alert_dispatch.h"
+#include <Arduino.h>
+#include <math.h>
+#include <freertos/FreeRTOS.h>
+
+// Mean absolute deviation to standard deviation, for normal noise
+#define MAD_TO_SIGMA 1.2533f
+
+#define ANOMALY_CHANNEL_ID(channel, rateLimit, noiseFloor) CHANNEL_##channel,
+const SensorChannel ANOMALY_CHANNELS[NUM_ANOMALY_CHANNELS] = {ANOMALY_CHANNEL_TABLE(ANOMALY_CHANNEL_ID)};
+#undef ANOMALY_CHANNEL_ID
+
+#define ANOMALY_RATE_LIMIT(channel, rateLimit, noiseFloor) rateLimit,
+static const float RATE_LIMITS[NUM_ANOMALY_CHANNELS] = {ANOMALY_CHANNEL_TABLE(ANOMALY_RATE_LIMIT)};
+#undef ANOMALY_RATE_LIMIT
+
+#define ANOMALY_NOISE_FLOOR(channel, rateLimit, noiseFloor) noiseFloor,
+static const float NOISE_FLOORS[NUM_ANOMALY_CHANNELS] = {ANOMALY_CHANNEL_TABLE(ANOMALY_NOISE_FLOOR)};
+#undef ANOMALY_NOISE_FLOOR
+
+const char *const ANOMALY_TRIGGER_NAMES[NUM_ANOMALY_TRIGGERS] = {"z", "rate", "cusum"};
+
+// Each detector is updated by the sampler task of its sensor only; the
+// spinlock covers readers on other tasks and the shared event queue
+static AnomalyDetector detectors[NUM_ANOMALY_CHANNELS];
+static uint32_t eventCounts[NUM_ANOMALY_CHANNELS];
+static AnomalyEvent events[ANOMALY_EVENT_QUEUE];
+static uint32_t lastSequence = 0;
+static uint16_t activeMask = 0;
+static portMUX_TYPE anomalyMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Weight of an update covering `periods` default sampling periods, given
+// the weight of one period
+static float periodWeight(float alpha, float periods)
+{
+    return 1.0f - powf(1.0f - alpha, periods);
+}
+
+// Detector of a channel, -1 for channels that are not watched
+static int anomalySlot(SensorChannel channel)
+{
+    switch (channel)
+    {
+#define ANOMALY_CHANNEL_CASE(channel, rateLimit, noiseFloor) \
+    case CHANNEL_##channel:                                  \
+        return ANOMALY_##channel;
+        ANOMALY_CHANNEL_TABLE(ANOMALY_CHANNEL_CASE)
+#undef ANOMALY_CHANNEL_CASE
+    default:
+        return -1;
+    }
+}
+
+/*
+ * ==================================================
+ * FUNCTION: UPDATE ANOMALY DETECTOR
+ * ==================================================
+ * Description:
+ *   Feeds one reading into the channel's detector, at the full sampling
+ *   rate: about 30 floating-point operations, two divisions and two
+ *   powf(), no square root. Weights, the CUSUM step and the warm-up and
+ *   clear counts scale with the time since the previous reading, in
+ *   default sampling periods. The z-score and CUSUM are taken against the
+ *   baseline before the reading is folded in. Raises a start event when a
+ *   limit is crossed and an end event after ANOMALY_CLEAR_PERIODS without
+ *   one, and wakes the alert task for either. Channels that are not
+ *   watched, and saturated readings, are ignored.
+ */
+
+void updateAnomalyDetector(SensorChannel channel, float value, uint32_t nowMs)
+{
+    int slot = anomalySlot(channel);
+    if (slot < 0 || isnan(value) || isinf(value))
+    {
+        return;
+    }
+
+    portENTER_CRITICAL(&anomalyMux);
+    AnomalyDetector &d = detectors[slot];
+    if (!d.started)
+    {
+        d.baseline = value;
+        d.deviation = 0;
+        d.rate = 0;
+        d.cusum = 0;
+        d.lastValue = value;
+        d.lastMs = nowMs;
+        d.periods = 0;
+        d.started = true;
+        portEXIT_CRITICAL(&anomalyMux);
+        return;
+    }
+
+    uint32_t elapsedMs = nowMs - d.lastMs;
+    float periods = elapsedMs * 1000.0f / SENSOR_SAMPLE_PERIODS_US[CHANNELS[channel].group];
+    if (periods > ANOMALY_MAX_STEP_PERIODS)
+    {
+        periods = ANOMALY_MAX_STEP_PERIODS;
+    }
+    float baselineWeight = periodWeight(ANOMALY_BASELINE_ALPHA, periods);
+
+    float noiseFloor = NOISE_FLOORS[slot];
+    float sigma = d.deviation * MAD_TO_SIGMA;
+    float residual = value - d.baseline;
+    float zScore = residual / (sigma > noiseFloor ? sigma : noiseFloor);
+    if (elapsedMs > 0)
+    {
+        d.rate += periodWeight(ANOMALY_RATE_ALPHA, periods) * ((value - d.lastValue) * 1000.0f / elapsedMs - d.rate);
+    }
+    d.cusum += (zScore - ANOMALY_CUSUM_DRIFT) * periods;
+    if (d.cusum < 0)
+    {
+        d.cusum = 0;
+    }
+    d.baseline += baselineWeight * residual;
+    d.deviation += baselineWeight * (fabsf(residual) - d.deviation);
+    d.lastValue = value;
+    d.lastMs = nowMs;
+
+    if (d.periods < ANOMALY_WARMUP_PERIODS)
+    {
+        d.periods += periods;
+        d.cusum = 0;
+        portEXIT_CRITICAL(&anomalyMux);
+        return;
+    }
+
+    uint8_t triggers = 0;
+    if (zScore > ANOMALY_Z_LIMIT)
+    {
+        triggers |= ANOMALY_TRIGGER_Z;
+    }
+    if (zScore > ANOMALY_RATE_MIN_Z && d.rate > RATE_LIMITS[slot] * (d.baseline > noiseFloor ? d.baseline : noiseFloor))
+    {
+        triggers |= ANOMALY_TRIGGER_RATE;
+    }
+    if (d.cusum > ANOMALY_CUSUM_LIMIT)
+    {
+        triggers |= ANOMALY_TRIGGER_CUSUM;
+    }
+
+    bool start = triggers != 0 && d.triggers == 0;
+    bool end = false;
+    if (triggers != 0)
+    {
+        d.triggers |= triggers;
+        d.quiet = 0;
+    }
+    else if (d.triggers != 0 && (d.quiet += periods) >= ANOMALY_CLEAR_PERIODS)
+    {
+        end = true;
+    }
+
+    AnomalyEvent event = {};
+    if (start || end)
+    {
+        event.sequence = ++lastSequence;
+        event.channel = (AnomalyChannel)slot;
+        event.start = start;
+        event.triggers = d.triggers;
+        event.value = value;
+        event.baseline = d.baseline;
+        event.zScore = zScore;
+        event.ratePerS = d.rate;
+        event.cusum = d.cusum;
+        event.timestampS = nowMs / 1000;
+        events[event.sequence % ANOMALY_EVENT_QUEUE] = event;
+        if (start)
+        {
+            eventCounts[slot]++;
+            activeMask |= 1 << slot;
+        }
+        else
+        {
+            activeMask &= ~(1 << slot);
+            d.triggers = 0;
+            d.cusum = 0;
+        }
+    }
+    portEXIT_CRITICAL(&anomalyMux);
+
+    if (start || end)
+    {
+        requestAlertUpdate(); // Publish and show it now, not at loop()'s next publish
+    }
+    if (start)
+    {
+        logPrintf("Early warning: %s rising, %.1f against a baseline of %.1f (z %.1f, %.2f/s)\n",
+                  CHANNEL_NAMES[channel], value, event.baseline, zScore, event.ratePerS);
+    }
+    else if (end)
+    {
+        logPrintf("Early warning cleared: %s\n", CHANNEL_NAMES[channel]);
+    }
+}
+
+/*
+ * ==================================================
+ * FUNCTION: IS ANOMALY ACTIVE
+ * ==================================================
+ * Description:
+ *   True while any watched channel is in an anomaly.
+ */
+
+bool isAnomalyActive()
+{
+    return activeMask != 0;
+}
+
+/*
+ * ==================================================
+ * FUNCTION: GET ANOMALY STATUS
+ * ==================================================
+ * Description:
+ *   Event count and current state of one watched channel.
+ */
+
+AnomalyStatus getAnomalyStatus(AnomalyChannel channel)
+{
+    portENTER_CRITICAL(&anomalyMux);
+    AnomalyStatus status = {eventCounts[channel], detectors[channel].triggers, detectors[channel].baseline,
+                            detectors[channel].rate};
+    portEXIT_CRITICAL(&anomalyMux);
+    return status;
+}
+
+/*
+ * ==================================================
+ * FUNCTION: GET ANOMALY EVENT
+ * ==================================================
+ * Description:
+ *   Sequence number of the latest event (0 if none), and the event with a
+ *   given sequence number while it is among the last ANOMALY_EVENT_QUEUE.
+ */
+
+uint32_t getLastAnomalySequence()
+{
+    portENTER_CRITICAL(&anomalyMux);
+    uint32_t sequence = lastSequence;
+    portEXIT_CRITICAL(&anomalyMux);
+    return sequence;
+}
+
+bool getAnomalyEvent(uint32_t sequence, AnomalyEvent &event)
+{
+    portENTER_CRITICAL(&anomalyMux);
+    bool found = sequence != 0 && sequence <= lastSequence && lastSequence - sequence < ANOMALY_EVENT_QUEUE;
+    if (found)
+    {
+        event = events[sequence % ANOMALY_EVENT_QUEUE];
+    }
+    portEXIT_CRITICAL(&anomalyMux);
+    return found;
+}
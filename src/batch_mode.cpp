@@ -0,0 +1,183 @@
+#include "batch_mode.h"
+#include "static_arena.h"
+#include "hardware_init.h"
+#include "sensor_processing.h"
+#include "sensor_channels.h"
+#include "calibration_store.h"
+#include "math_kernels.h"
+#include "wifi_setup.h"
+#include <esp_sleep.h>
+#include <esp_timer.h>
+//
+#include "../lib/mqtt/mqtt_functions.h"
+
+// Survives deep sleep; reinitialised on power-on and any other reset. One
+// column per channel plus timestamps in seconds since first boot.
+RTC_DATA_ATTR static ChannelColumns<BATCH_CAPACITY> batchRing;
+RTC_DATA_ATTR static uint16_t batchHead = 0;
+RTC_DATA_ATTR static uint16_t batchCount = 0;
+RTC_DATA_ATTR static uint32_t batchDropped = 0;
+RTC_DATA_ATTR static uint32_t wakeCount = 0;
+RTC_DATA_ATTR static uint64_t elapsedUs = 0;      // Awake + asleep time since first boot
+RTC_DATA_ATTR static uint32_t lastSampleWakeMs = 0; // Wake-to-sleep of the last sampling-only wake
+RTC_DATA_ATTR static uint32_t lastUploadWakeMs = 0; // Wake-to-sleep of the last upload wake
+RTC_DATA_ATTR static uint32_t maxWakeMs = 0;
+
+static_assert(sizeof(batchRing) <= 4096, "Batch ring must leave room in RTC slow memory");
+
+/*
+ * ==================================================
+ * FUNCTION: APPEND BATCH SAMPLE
+ * ==================================================
+ * Description:
+ *   Stores the current readings in the RTC ring, overwriting the oldest
+ *   sample if uploads have been failing for a while.
+ */
+
+static void appendBatchSample(uint32_t timestamp)
+{
+    uint16_t slot = (batchHead + batchCount) % BATCH_CAPACITY;
+    if (batchCount == BATCH_CAPACITY)
+    {
+        batchHead = (batchHead + 1) % BATCH_CAPACITY;
+        batchDropped++;
+    }
+    else
+    {
+        batchCount++;
+    }
+
+    batchRing.timestamp[slot] = timestamp;
+    for (int ch = 0; ch < NUM_CHANNELS; ch++)
+    {
+        batchRing.values[ch][slot] = getChannelValue((SensorChannel)ch);
+    }
+}
+
+/*
+ * ==================================================
+ * FUNCTION: UPLOAD BATCH
+ * ==================================================
+ * Description:
+ *   Brings Wi-Fi up, publishes every buffered sample as one JSON message on
+ *   TOPIC_BATCH (oldest first), the latest readings on the regular topics and
+ *   the wake timings on TOPIC_DIAGNOSTICS, all in one MQTT session. The ring
+ *   is only cleared once the broker has the whole batch.
+ */
+
+static bool uploadBatch(uint32_t now)
+{
+    connectToWiFi();
+    setupMQTT(client);
+    if (!waitForMQTTConnection(client, BATCH_CONNECT_TIMEOUT_MS))
+    {
+        Serial.println("Batch upload failed: no MQTT connection");
+        return false;
+    }
+
+    char payload[384];
+    for (uint16_t i = 0; i < batchCount; i++)
+    {
+        uint16_t slot = (batchHead + i) % BATCH_CAPACITY;
+        uint32_t timestamp = batchRing.timestamp[slot];
+        int length = appendPayload(payload, sizeof(payload), 0, "{\"t\":%lu,\"age_s\":%lu",
+                                   (unsigned long)timestamp, (unsigned long)(now - timestamp));
+        for (int ch = 0; ch < NUM_CHANNELS; ch++)
+        {
+            // NaN and infinity are not JSON; a failed read goes out as null
+            float value = batchRing.values[ch][slot];
+            length = appendPayload(payload, sizeof(payload), length, ",\"%s\":", CHANNEL_NAMES[ch]);
+            length = isfinite(value) ? appendPayload(payload, sizeof(payload), length, CHANNELS[ch].format, value)
+                                     : appendPayload(payload, sizeof(payload), length, "null");
+        }
+        appendPayload(payload, sizeof(payload), length, "}");
+
+        if (!publishMQTTMessage(client, TOPIC_BATCH, payload, false, false))
+        {
+            Serial.println("Batch upload failed: publish rejected");
+            return false;
+        }
+    }
+
+    publishMQTTReadings(client);
+
+    snprintf(payload, sizeof(payload),
+             "{\"mode\":\"batch\",\"wakes\":%lu,\"samples\":%u,\"dropped\":%lu,"
+             "\"sample_wake_ms\":%lu,\"upload_wake_ms\":%lu,\"max_wake_ms\":%lu}",
+             (unsigned long)wakeCount, batchCount, (unsigned long)batchDropped,
+             (unsigned long)lastSampleWakeMs, (unsigned long)lastUploadWakeMs, (unsigned long)maxWakeMs);
+    publishMQTTMessage(client, TOPIC_DIAGNOSTICS, payload, false, false);
+
+    if (!flushMQTT(client, BATCH_FLUSH_TIMEOUT_MS))
+    {
+        Serial.println("Batch upload failed: flush timed out");
+        return false;
+    }
+
+    logPrintf("Batch of %u samples uploaded\n", batchCount);
+    batchCount = 0;
+    batchDropped = 0;
+    return true;
+}
+
+/*
+ * ==================================================
+ * FUNCTION: RUN BATCH MODE CYCLE
+ * ==================================================
+ * Description:
+ *   One wake of the deep-sleep batch mode: initialise only the sensors
+ *   (no NeoPixel self-test, logo or animations), take one reading of each,
+ *   buffer it in RTC memory, upload every BATCH_UPLOAD_EVERY wakes, then
+ *   go back to deep sleep. Never returns.
+ */
+
+void runBatchModeCycle()
+{
+    int64_t wakeStartUs = esp_timer_get_time();
+
+    // The cached R0 saves a one-second calibration on every wake
+    initializeMathKernels();
+    initializeCalibrationStore();
+    initializeBME680();
+    initializeMQ2();
+    initializeSoundSensor();
+
+    readSoundSensor();
+    readMQ2();
+    if (!readBME680())
+    {
+        Serial.println("BME680 failed to perform reading!");
+    }
+
+    uint32_t now = (elapsedUs + wakeStartUs) / 1000000ULL;
+    appendBatchSample(now);
+    wakeCount++;
+
+    bool upload = (wakeCount % BATCH_UPLOAD_EVERY == 0) || batchCount == BATCH_CAPACITY;
+    if (upload)
+    {
+        uploadBatch(now);
+        WiFi.disconnect(true);
+    }
+
+    // Wake-to-sleep time, reported with the next upload
+    uint32_t awakeMs = (esp_timer_get_time() - wakeStartUs) / 1000;
+    if (upload)
+    {
+        lastUploadWakeMs = awakeMs;
+    }
+    else
+    {
+        lastSampleWakeMs = awakeMs;
+    }
+    if (awakeMs > maxWakeMs)
+    {
+        maxWakeMs = awakeMs;
+    }
+    logPrintf("Awake for %lu ms, sleeping %d s\n", (unsigned long)awakeMs, BATCH_SLEEP_SECONDS);
+    Serial.flush();
+
+    elapsedUs += esp_timer_get_time() + (uint64_t)BATCH_SLEEP_SECONDS * 1000000ULL;
+    esp_sleep_enable_timer_wakeup((uint64_t)BATCH_SLEEP_SECONDS * 1000000ULL);
+    esp_deep_sleep_start();
+}
@@ -0,0 +1,126 @@
+#include "boot_sequence.h"
+#include "static_arena.h"
+#include "helper_functions.h"
+#include "diagnostics.h"
+#include "wifi_setup.h"
+#include "ota_setup.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+static volatile bool networkReady = false;
+static volatile bool selfTestRunning = false;
+
+/*
+ * ==================================================
+ * FUNCTION: NETWORK BOOT TASK
+ * ==================================================
+ * Description:
+ *   Associates with Wi-Fi and starts OTA off the main task, so sensor
+ *   initialisation and the first reading do not wait for the access point.
+ *   Records the time the network became usable and exits.
+ */
+
+static void networkBootTask(void *)
+{
+    connectToWiFi();
+    setupOTA();
+
+    systemMetrics.networkReadyMs = millis();
+    networkReady = true;
+    logPrintf("Network ready after %lu ms\n", (unsigned long)systemMetrics.networkReadyMs);
+
+    vTaskDelete(NULL);
+}
+
+/*
+ * ==================================================
+ * FUNCTION: START NETWORK BOOT
+ * ==================================================
+ * Description:
+ *   Kicks off Wi-Fi association in the background. Until isNetworkReady()
+ *   returns true the main loop must leave Wi-Fi, OTA and the blocking MQTT
+ *   client alone.
+ */
+
+void startNetworkBoot()
+{
+    xTaskCreate(networkBootTask, "net_boot", BOOT_NETWORK_TASK_STACK, NULL, 1, NULL);
+}
+
+bool isNetworkReady()
+{
+    return networkReady;
+}
+
+/*
+ * ==================================================
+ * FUNCTION: SELF TEST TASK
+ * ==================================================
+ * Description:
+ *   Runs the NeoPixel and buzzer tests at low priority. Safety status
+ *   colours are held back while the test owns the LEDs.
+ */
+
+static void selfTestTask(void *)
+{
+    testNeoPixels();
+    testBuzzer();
+    selfTestRunning = false;
+    vTaskDelete(NULL);
+}
+
+/*
+ * ==================================================
+ * FUNCTION: START SELF TESTS
+ * ==================================================
+ * Description:
+ *   Starts the optional peripheral self-tests in the background. Does
+ *   nothing unless BOOT_SELF_TEST is defined.
+ */
+
+void startSelfTests()
+{
+#ifdef BOOT_SELF_TEST
+    selfTestRunning = true;
+    if (xTaskCreate(selfTestTask, "self_test", BOOT_SELF_TEST_TASK_STACK, NULL, 0, NULL) != pdPASS)
+    {
+        selfTestRunning = false;
+    }
+#endif
+}
+
+bool isSelfTestRunning()
+{
+    return selfTestRunning;
+}
+
+/*
+ * ==================================================
+ * FUNCTION: MARK FIRST SAMPLE / FIRST PUBLISH
+ * ==================================================
+ * Description:
+ *   Record time-to-first-sample (all sensors read) and time-to-first-publish
+ *   (readings handed to a connected broker session). Later calls are ignored.
+ */
+
+void markFirstSample()
+{
+    if (systemMetrics.firstSampleMs != 0)
+    {
+        return;
+    }
+    systemMetrics.firstSampleMs = millis();
+    logPrintf("First sample after %lu ms\n", (unsigned long)systemMetrics.firstSampleMs);
+    if (systemMetrics.firstSampleMs > BOOT_BUDGET_MS)
+    {
+        logPrintf("Boot budget of %d ms exceeded\n", BOOT_BUDGET_MS);
+    }
+}
+
+void markFirstPublish()
+{
+    if (systemMetrics.firstPublishMs == 0)
+    {
+        systemMetrics.firstPublishMs = millis();
+    }
+}
@@ -0,0 +1,27 @@
+#include "calibration_store.h"
+#include <math.h>
+
+/*
+ * ==================================================
+ * FUNCTION: STEP BASELINE
+ * ==================================================
+ * Description:
+ *   One step of the asymmetric exponential average over `periods` default
+ *   sampling periods: rises are followed with CAL_ALPHA_RISE per period,
+ *   falls with CAL_ALPHA_FALL. Invalid samples leave the baseline
+ *   unchanged; the first valid one seeds it.
+ */
+
+float stepBaseline(float baseline, float sample, float periods)
+{
+    if (!(sample > 0) || isinf(sample))
+    {
+        return baseline;
+    }
+    if (baseline <= 0)
+    {
+        return sample;
+    }
+    float alpha = sample > baseline ? CAL_ALPHA_RISE : CAL_ALPHA_FALL;
+    return baseline + (1.0f - powf(1.0f - alpha, periods)) * (sample - baseline);
+}
@@ -0,0 +1,208 @@
+#include "calibration_store.h"
+#include "static_arena.h"
+#include "hardware_init.h"
+#include <Preferences.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+// Slowly adapting clean-air baseline, plus the value last written to NVS
+struct BaselineTracker
+{
+    float value;
+    float stored;
+    SensorGroup group; // Sensor whose default period the weights are per
+    uint32_t lastMs;   // Last tracked sample, 0 before the first
+};
+
+// Each tracker is only stepped by its own sensor's sampler task, but both
+// samplers and a peripheral reset can write NVS. The mutex serialises the
+// writes and the write-interval bookkeeping.
+static StaticSemaphore_t writeMutexBuffer;
+static SemaphoreHandle_t writeMutex = NULL;
+static Preferences calibrationPrefs;
+static BaselineTracker mq2Baseline = {0, 0, GROUP_MQ2, 0};
+static BaselineTracker gasBaseline = {0, 0, GROUP_BME680, 0};
+static bool loadedFromNvs = false;
+static bool gasBaselineCached = false;
+static uint32_t nvsWrites = 0;
+static unsigned long lastWriteMs = 0;
+
+/*
+ * ==================================================
+ * FUNCTION: INITIALIZE CALIBRATION STORE
+ * ==================================================
+ * Description:
+ *   Opens the calibration namespace in NVS and loads the cached MQ-2 R0
+ *   and BME680 gas baseline. A cache written by a different CAL_VERSION
+ *   is ignored. Call before the sampler tasks start.
+ */
+
+void initializeCalibrationStore()
+{
+    if (writeMutex == NULL)
+    {
+        writeMutex = xSemaphoreCreateMutexStatic(&writeMutexBuffer);
+    }
+    calibrationPrefs.begin(CAL_NVS_NAMESPACE, false);
+    nvsWrites = calibrationPrefs.getUInt("writes", 0);
+
+    if (calibrationPrefs.getUChar("version", 0) != CAL_VERSION)
+    {
+        Serial.println("No calibration cache found");
+        return;
+    }
+
+    mq2Baseline.value = mq2Baseline.stored = calibrationPrefs.getFloat("mq2_r0", 0);
+    gasBaseline.value = gasBaseline.stored = calibrationPrefs.getFloat("gas_base", 0);
+    gasBaselineCached = gasBaseline.value > 0;
+    logPrintf("Calibration cache: R0=%.2f, gas baseline=%.1f kOhm (%lu writes)\n",
+              mq2Baseline.value, gasBaseline.value, (unsigned long)nvsWrites);
+}
+
+/*
+ * ==================================================
+ * FUNCTION: WRITE CALIBRATION
+ * ==================================================
+ * Description:
+ *   Writes both baselines to NVS and counts the write. The caller holds
+ *   writeMutex.
+ */
+
+static void writeCalibration()
+{
+    calibrationPrefs.putUChar("version", CAL_VERSION);
+    calibrationPrefs.putFloat("mq2_r0", mq2Baseline.value);
+    calibrationPrefs.putFloat("gas_base", gasBaseline.value);
+    calibrationPrefs.putUInt("writes", ++nvsWrites);
+
+    mq2Baseline.stored = mq2Baseline.value;
+    gasBaseline.stored = gasBaseline.value;
+    lastWriteMs = millis();
+}
+
+/*
+ * ==================================================
+ * FUNCTION: GET / STORE MQ-2 R0
+ * ==================================================
+ * Description:
+ *   The cached R0 lets initializeMQ2() skip the clean-air calibration.
+ *   A fresh calibration is written through immediately, since it only
+ *   happens when there is no cache.
+ */
+
+bool getCachedMQ2R0(float &r0)
+{
+    if (mq2Baseline.value <= 0)
+    {
+        return false;
+    }
+    r0 = mq2Baseline.value;
+    loadedFromNvs = true;
+    return true;
+}
+
+void storeMQ2R0(float r0)
+{
+    xSemaphoreTake(writeMutex, portMAX_DELAY);
+    mq2Baseline.value = r0;
+    writeCalibration();
+    xSemaphoreGive(writeMutex);
+}
+
+/*
+ * ==================================================
+ * FUNCTION: TRACK BASELINE
+ * ==================================================
+ * Description:
+ *   One step of the baseline average (calibration_kernels.cpp), weighted
+ *   by the time since the previous sample. Samples taken while the heaters
+ *   warm up are skipped; the first one after counts as one period.
+ */
+
+static void trackBaseline(BaselineTracker &tracker, float sample)
+{
+    uint32_t nowMs = millis();
+    if (nowMs < CAL_WARMUP_MS)
+    {
+        return;
+    }
+    float periods = tracker.lastMs == 0 ? 1.0f
+                                        : (nowMs - tracker.lastMs) * 1000.0f / SENSOR_SAMPLE_PERIODS_US[tracker.group];
+    tracker.lastMs = nowMs;
+    tracker.value = stepBaseline(tracker.value, sample, periods);
+}
+
+static bool baselineMoved(const BaselineTracker &tracker)
+{
+    if (tracker.stored <= 0)
+    {
+        return tracker.value > 0;
+    }
+    return fabsf(tracker.value - tracker.stored) > CAL_WRITE_THRESHOLD * tracker.stored;
+}
+
+/*
+ * ==================================================
+ * FUNCTION: PERSIST IF DUE
+ * ==================================================
+ * Description:
+ *   Enforces the flash wear bound, see CAL_WRITE_INTERVAL_MS. Never waits
+ *   for the mutex: if another task is writing, it writes both baselines,
+ *   and this sampler moves on.
+ */
+
+static void persistIfDue()
+{
+    if (xSemaphoreTake(writeMutex, 0) != pdTRUE)
+    {
+        return;
+    }
+    if (millis() - lastWriteMs >= CAL_WRITE_INTERVAL_MS && (baselineMoved(mq2Baseline) || baselineMoved(gasBaseline)))
+    {
+        writeCalibration();
+        logPrintf("Calibration saved: R0=%.2f, gas baseline=%.1f kOhm\n", mq2Baseline.value, gasBaseline.value);
+    }
+    xSemaphoreGive(writeMutex);
+}
+
+/*
+ * ==================================================
+ * FUNCTION: UPDATE MQ-2 / GAS BASELINE
+ * ==================================================
+ * Description:
+ *   Feed one per-sample clean-air estimate: MQ2.calibrate() for the MQ-2
+ *   (applied to the sensor right away), the humidity-compensated gas
+ *   resistance from updateAirQuality() for the BME680.
+ */
+
+void updateMQ2Baseline(float r0Estimate)
+{
+    trackBaseline(mq2Baseline, r0Estimate);
+    if (mq2Baseline.value > 0)
+    {
+        MQ2.setR0(mq2Baseline.value);
+    }
+    persistIfDue();
+}
+
+void updateGasBaseline(float gasKOhm)
+{
+    trackBaseline(gasBaseline, gasKOhm);
+    persistIfDue();
+}
+
+float getGasBaseline()
+{
+    return gasBaseline.value;
+}
+
+CalibrationStats getCalibrationStats()
+{
+    CalibrationStats stats;
+    stats.mq2R0 = mq2Baseline.value;
+    stats.gasBaseline = gasBaseline.value;
+    stats.loadedFromNvs = loadedFromNvs;
+    stats.gasBaselineCached = gasBaselineCached;
+    stats.nvsWrites = nvsWrites;
+    return stats;
+}
@@ -0,0 +1,30 @@
+#include "diagnostics.h"
+#include <Arduino.h>
+
+SystemMetrics systemMetrics;
+
+static unsigned long loopStartMs = 0;
+
+/*
+ * ==================================================
+ * FUNCTION: BEGIN / END LOOP TIMING
+ * ==================================================
+ * Description:
+ *   Bracket one loop() cycle to record its duration.
+ */
+
+void beginLoopTiming()
+{
+    loopStartMs = millis();
+}
+
+void endLoopTiming()
+{
+    uint32_t elapsed = millis() - loopStartMs;
+    systemMetrics.loopTimeMs = elapsed;
+    if (elapsed > systemMetrics.maxLoopTimeMs)
+    {
+        systemMetrics.maxLoopTimeMs = elapsed;
+    }
+    systemMetrics.loopCount++;
+}
@@ -1,25 +1,73 @@
 #include "hardware_init.h"
 #include "helper_functions.h"
-
-// Declare Variables
-float temperature;
-float humidity;
-float pressure;
-float gas;
-float altitude;
-float lpg;
-float co;
-float smoke;
-float sound;
+#include "calibration_store.h"
+#include "stage_watchdog.h"
+#include "static_arena.h"
+#include "i2c_bus.h"
 
 // Hardware Initialization
 Adafruit_NeoPixel pixels(NUM_PIXELS, NEOPIXEL_PIN, NEO_GRB + NEO_KHZ800);
-Adafruit_SH1106G display(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, OLED_RESET);
+ArenaSH1106G display(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, OLED_RESET);
 Adafruit_BME680 bme;
 MQUnifiedsensor MQ2(MQ2_BOARD, MQ2_VOLTAGE_RESOLUTION, MQ2_ADC_RESOLUTION, MQ2_PIN, MQ2_TYPE);
 WiFiClient espClient;
 PubSubClient client(espClient);
 
+/*
+ * ==================================================
+ * CLASS: ARENA SH1106G
+ * ==================================================
+ * Description:
+ *   Hands the driver the arena frame buffer before begin() runs, so it
+ *   skips its own allocation, and takes it back on destruction so the
+ *   driver does not free() it.
+ */
+
+ArenaSH1106G::ArenaSH1106G(uint16_t w, uint16_t h, TwoWire *twi, int8_t rstPin)
+    : Adafruit_SH1106G(w, h, twi, rstPin)
+{
+    buffer = staticArena.displayFrame;
+}
+
+ArenaSH1106G::~ArenaSH1106G()
+{
+    buffer = NULL;
+}
+
+// Clock the driver sets around begin(); the stock 100 kHz afterwards
+// would undo the bus clock
+void ArenaSH1106G::setBusClock(uint32_t hz)
+{
+    i2c_preclk = hz;
+    i2c_postclk = hz;
+}
+
+// Sends one 8-row page of a frame, as display() does for each page
+bool ArenaSH1106G::writePage(uint8_t page, const uint8_t *data)
+{
+    if (i2c_dev == NULL)
+    {
+        return false; // begin() failed
+    }
+    uint8_t command[] = {0x00, (uint8_t)(SH110X_SETPAGEADDR + page), (uint8_t)(0x10 + (_page_start_offset >> 4)),
+                         (uint8_t)(_page_start_offset & 0x0F)};
+    if (!i2c_dev->write(command, sizeof(command)))
+    {
+        return false;
+    }
+    const uint8_t dataPrefix = 0x40;
+    size_t chunk = i2c_dev->maxBufferSize() - 1;
+    for (size_t offset = 0; offset < SCREEN_WIDTH; offset += chunk)
+    {
+        size_t length = SCREEN_WIDTH - offset < chunk ? SCREEN_WIDTH - offset : chunk;
+        if (!i2c_dev->write(data + offset, length, true, &dataPrefix, 1))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
 /*
  * ==================================================
  * FUNCTION: INITIALIZE BUZZER
@@ -40,14 +88,15 @@ void initializeBuzzer()
  * FUNCTION: INITIALIZE NEOPIXELS
  * ==================================================
  * Description:
- *   Configures and initializes the NeoPixel LED array. Performs a test sequence
- *   to verify that the NeoPixels are functioning correctly.
+ *   Configures and initializes the NeoPixel LED array and switches all LEDs
+ *   off. The colour test sequence is optional, see startSelfTests().
  */
 
 void initializeNeoPixels()
 {
     pixels.begin();
-    testNeoPixels();
+    pixels.clear();
+    pixels.show();
     Serial.println("NeoPixels initialized!");
 }
 
@@ -56,18 +105,31 @@ void initializeNeoPixels()
  * FUNCTION: INITIALIZE OLED
  * ==================================================
  * Description:
- *   Initializes the SH1106 OLED display. Clears the screen for fresh use and
- *   halts the program if the initialization fails.
+ *   Initializes the SH1106 OLED display and clears the screen for fresh
+ *   use. On failure the device keeps running without the display. A
+ *   display that answered before is retried by the watchdog, see
+ *   reportStageFailure(); one that never did is taken as not fitted.
  */
 
 void initializeOLED()
 {
-    if (!display.begin(0x3C))
+    static bool found = false;
+    bool ready = false;
+    if (acquireI2CBus(I2C_CLIENT_DISPLAY))
+    {
+        ready = display.begin(OLED_ADDRESS);
+        releaseI2CBus(I2C_CLIENT_DISPLAY);
+    }
+    if (!ready)
     {
-        Serial.println("SH1106 initialization failed!");
-        while (true)
-            ;
+        Serial.println(found ? "SH1106 initialization failed!" : "SH1106 not found, running without display");
+        if (found)
+        {
+            reportStageFailure(STAGE_RENDER);
+        }
+        return;
     }
+    found = true;
     display.clearDisplay();
     Serial.println("OLED initialized!");
 }
@@ -87,6 +149,24 @@ void initializeSoundSensor()
     Serial.println("Sound sensor initialized!");
 }
 
+/*
+ * ==================================================
+ * FUNCTION: CONFIGURE BME680
+ * ==================================================
+ * Description:
+ *   Applies the oversampling, filter size, and gas heater settings used for
+ *   every BME680, built-in or from the sensor registry.
+ */
+
+void configureBME680(Adafruit_BME680 &sensor)
+{
+    sensor.setTemperatureOversampling(BME680_OS_8X);
+    sensor.setHumidityOversampling(BME680_OS_2X);
+    sensor.setPressureOversampling(BME680_OS_4X);
+    sensor.setIIRFilterSize(BME680_FILTER_SIZE_3);
+    sensor.setGasHeater(320, 150);
+}
+
 /*
  * ==================================================
  * FUNCTION: INITIALIZE BME680 SENSOR
@@ -94,22 +174,34 @@ void initializeSoundSensor()
  * Description:
  *   Configures the BME680 sensor with oversampling, filter size, and gas heater
  *   settings. Checks for initialization success and sets up sensor parameters.
+ *   A sensor that stops answering is retried by the watchdog instead of
+ *   halting the other sensors; one that never answered since boot is not
+ *   fitted and is left alone.
  */
 
 void initializeBME680()
 {
-    if (!bme.begin(BME680_ADDRESS))
+    static bool found = false;
+    bool ready = false;
+    if (acquireI2CBus(I2C_CLIENT_BME680))
     {
-        Serial.println("BME680 initialization failed!");
-        while (true)
-            ;
+        ready = bme.begin(BME680_ADDRESS);
+        if (ready)
+        {
+            configureBME680(bme);
+        }
+        releaseI2CBus(I2C_CLIENT_BME680);
     }
-
-    bme.setTemperatureOversampling(BME680_OS_8X);
-    bme.setHumidityOversampling(BME680_OS_2X);
-    bme.setPressureOversampling(BME680_OS_4X);
-    bme.setIIRFilterSize(BME680_FILTER_SIZE_3);
-    bme.setGasHeater(320, 150);
+    if (!ready)
+    {
+        Serial.println(found ? "BME680 initialization failed!" : "BME680 not found, not retried");
+        if (found)
+        {
+            reportStageFailure(STAGE_ACQUISITION);
+        }
+        return;
+    }
+    found = true;
 
     Serial.println("BME680 initialized!");
 }
@@ -119,15 +211,29 @@ void initializeBME680()
  * FUNCTION: INITIALIZE MQ-2 SENSOR
  * ==================================================
  * Description:
- *   Calibrates the MQ-2 gas sensor by calculating the clean air R0 value. This
- *   ensures accurate readings for LPG, CO, and Smoke levels.
+ *   Loads the clean air R0 value from the calibration cache, or calibrates
+ *   the MQ-2 gas sensor by calculating it when there is none. This ensures
+ *   accurate readings for LPG, CO, and Smoke levels. A failed calibration
+ *   (open or shorted sensor) is not cached. It is retried by the watchdog
+ *   only if the sensor gave a valid R0 before; an MQ-2 that never did is
+ *   taken as not fitted.
  */
 
 void initializeMQ2()
 {
+    static bool found = false;
     MQ2.setRegressionMethod(1);
     MQ2.init();
 
+    float cachedR0;
+    if (getCachedMQ2R0(cachedR0))
+    {
+        MQ2.setR0(cachedR0);
+        found = true;
+        Serial.println("MQ-2 initialized from calibration cache!");
+        return;
+    }
+
     Serial.println("Calibrating MQ-2...");
     float calcR0 = 0;
     for (int i = 0; i < 10; i++)
@@ -140,10 +246,15 @@ void initializeMQ2()
 
     if (isinf(calcR0) || calcR0 == 0)
     {
-        Serial.println("MQ-2 calibration failed!");
-        while (true)
-            ;
+        Serial.println(found ? "MQ-2 calibration failed!" : "MQ-2 not found, not retried");
+        if (found)
+        {
+            reportStageFailure(STAGE_ACQUISITION);
+        }
+        return;
     }
+    found = true;
+    storeMQ2R0(calcR0 / 10);
 
     Serial.println("MQ-2 initialized and calibrated!");
 }
\ No newline at end of file
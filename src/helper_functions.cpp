@@ -1,5 +1,15 @@
 #include "helper_functions.h"
 #include "wifi_setup.h"
+#include "diagnostics.h"
+#include "boot_sequence.h"
+#include "math_kernels.h"
+#include "runtime_config.h"
+#include "stage_watchdog.h"
+#include "ota_setup.h"
+#include "anomaly_detector.h"
+#include "sound_spectrum.h"
+#include "alert_dispatch.h"
+#include "sensor_registry.h"
 
 /*
  * ==================================================
@@ -7,7 +17,7 @@
  * ==================================================
  * Description:
  *   This function activates the buzzer three times to test its functionality.
- *   It is called during setup to ensure the buzzer is operational.
+ *   Part of the optional boot self-test (BOOT_SELF_TEST).
  */
 
 void testBuzzer()
@@ -52,36 +62,119 @@ void testNeoPixels()
     Serial.println("NeoPixel test completed.");
 }
 
+/*
+ * ==================================================
+ * FUNCTION: WORST ALARM LEVEL
+ * ==================================================
+ * Description:
+ *   Highest threshold level among the channels with an alarm threshold
+ *   (the MQ-2 gases), of the built-in sensors and the registry's.
+ */
+
+static ChannelLevel worstAlarmLevel()
+{
+    ChannelLevel worst = LEVEL_NORMAL;
+    for (int ch = 0; ch < NUM_CHANNELS; ch++)
+    {
+        if (isnan(getChannelThresholds((SensorChannel)ch).alarm))
+        {
+            continue;
+        }
+        ChannelLevel level = getChannelLevel((SensorChannel)ch);
+        if (level > worst)
+        {
+            worst = level;
+        }
+    }
+    ChannelLevel registry = getSensorRegistryLevel();
+    return registry > worst ? registry : worst;
+}
+
 /*
  * ==================================================
  * FUNCTION: CHECK SAFETY AND ALERT
  * ==================================================
  * Description:
- *   Evaluates sensor readings for gas levels (LPG, CO, smoke) and triggers
- *   an alert if unsafe levels are detected. Alerts include activating the
- *   buzzer and setting the NeoPixel LEDs to corresponding danger levels.
+ *   Evaluates the gas levels (LPG, CO, smoke) against their thresholds and
+ *   sets the NeoPixel LEDs to the corresponding danger level. Another
+ *   smoke alarm's T3 tone heard by the KY-038 (see sound_spectrum.h) shows
+ *   as danger; a reading that rises abnormally fast (see
+ *   anomaly_detector.h) shows as a warning before it reaches a threshold.
+ *   The buzzer is driven by updateAlarmBuzzer() at the MQ-2 sampling rate.
+ *   Runs on the alert task (alert_dispatch.h), as a watchdog alert stage.
  */
 
-void checkSafetyAndAlert(float lpg, float co, float smoke)
+void checkSafetyAndAlert()
 {
-    if (lpg > 1000 || co > 50 || smoke > 200)
+    if (!beginStage(STAGE_ALERT))
+    {
+        return;
+    }
+
+    ChannelLevel worst = worstAlarmLevel();
+    if (worst == LEVEL_ALARM)
     {
         Serial.println("ALERT: Unsafe gas levels detected!");
-        digitalWrite(BUZZER_PIN, HIGH);
         setNeoPixelStatus(DANGER);
-        delay(2000);
-        digitalWrite(BUZZER_PIN, LOW);
     }
-    else if (lpg > 500 || co > 20 || smoke > 100)
+    else if (isAlarmToneActive())
+    {
+        Serial.println("ALERT: Smoke alarm sounding nearby!");
+        setNeoPixelStatus(DANGER);
+    }
+    else if (worst == LEVEL_WARNING)
     {
         Serial.println("Warning: Elevated gas levels detected!");
         setNeoPixelStatus(WARNING);
     }
+    else if (isAnomalyActive())
+    {
+        Serial.println("Early warning: Gas levels rising abnormally!");
+        setNeoPixelStatus(WARNING);
+    }
     else
     {
         Serial.println("Gas levels are within safe limits.");
         setNeoPixelStatus(SAFE);
     }
+    endStage(STAGE_ALERT);
+}
+
+/*
+ * ==================================================
+ * FUNCTION: UPDATE ALARM BUZZER
+ * ==================================================
+ * Description:
+ *   Sounds the buzzer for as long as a gas is above its alarm threshold.
+ *   Called after every MQ-2 sample; left alone while the self-test owns
+ *   the buzzer. A change of the gas level also updates the NeoPixels.
+ */
+
+void updateAlarmBuzzer()
+{
+    static bool sounding = false;
+    static ChannelLevel shownLevel = LEVEL_NORMAL;
+    ChannelLevel worst = worstAlarmLevel();
+    if (worst != shownLevel)
+    {
+        shownLevel = worst;
+        requestAlertUpdate();
+    }
+    if (isSelfTestRunning())
+    {
+        return;
+    }
+
+    bool alarm = worst == LEVEL_ALARM;
+    if (alarm != sounding)
+    {
+        digitalWrite(BUZZER_PIN, alarm ? HIGH : LOW);
+        sounding = alarm;
+        if (alarm)
+        {
+            Serial.println("ALERT: Unsafe gas levels detected!");
+        }
+    }
 }
 
 /*
@@ -91,10 +184,17 @@ void checkSafetyAndAlert(float lpg, float co, float smoke)
  * Description:
  *   Updates the NeoPixel LEDs based on the provided status (SAFE, WARNING, DANGER).
  *   Each status is associated with a specific color and flashing pattern.
+ *   Skipped while the self-test owns the LEDs or an OTA update is received
+ *   (the buzzer alarm keeps working).
  */
 
 void setNeoPixelStatus(Status status)
 {
+    if (isSelfTestRunning() || isOTAInProgress())
+    {
+        return;
+    }
+
     switch (status)
     {
     case SAFE:
@@ -145,7 +245,7 @@ void setNeoPixelStatus(Status status)
 
 float convertRawSoundToDecibels(int rawValue)
 {
-    return map(rawValue, 0, 1023, 30, 100); // Map analog value to decibels (30-100 dB range)
+    return soundDecibelsFromRaw(rawValue); // Same as map(rawValue, 0, 1023, 30, 100), without the division
 }
 
 /*
@@ -161,5 +261,6 @@ void checkWiFi()
     if (WiFi.status() != WL_CONNECTED)
     {
         connectToWiFi();
+        systemMetrics.wifiReconnects++;
     }
 }
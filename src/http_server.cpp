@@ -0,0 +1,753 @@
+#include "http_server.h"
+#include "static_arena.h"
+#include <ESPAsyncWebServer.h>
+#include "sensor_channels.h"
+#include "time_series_store.h"
+#include "diagnostics.h"
+#include "power_management.h"
+#include "calibration_store.h"
+#include "sensor_registry.h"
+#include "sampling_scheduler.h"
+#include "stage_watchdog.h"
+#include "memory_monitor.h"
+#include "ota_setup.h"
+#include "ota_pack.h"
+#include "anomaly_detector.h"
+#include "sound_spectrum.h"
+#include "i2c_bus.h"
+#include "oled_display.h"
+#include "../lib/mqtt/mqtt_async.h"
+
+static AsyncWebServer server(HTTP_PORT);
+
+// Line being copied into the response buffer, kept across filler calls
+struct PendingLine
+{
+    char text[HTTP_LINE_MAX];
+    uint16_t length;
+    uint16_t offset;
+};
+
+// Internal counters rendered on /metrics after the sensor values
+enum ScalarMetric
+{
+    METRIC_UPTIME,
+    METRIC_LOOP_TIME,
+    METRIC_LOOP_TIME_MAX,
+    METRIC_LOOPS,
+    METRIC_MQTT_RECONNECTS,
+    METRIC_WIFI_RECONNECTS,
+    METRIC_BOOT_FIRST_SAMPLE,
+    METRIC_BOOT_NETWORK_READY,
+    METRIC_BOOT_FIRST_PUBLISH,
+    METRIC_HEAP_FREE,
+    METRIC_HEAP_MIN_FREE,
+    METRIC_HEAP_MAX_BLOCK,
+    METRIC_HEAP_MIN_MAX_BLOCK,
+    METRIC_HEAP_FRAGMENTATION,
+    METRIC_MEMORY_ALERTS,
+    METRIC_HEAP_STRAYS,
+    METRIC_OTA_IN_PROGRESS,
+    METRIC_OTA_UPDATES,
+    METRIC_OTA_FAILURES,
+    METRIC_OTA_DURATION,
+    METRIC_OTA_THROUGHPUT,
+    METRIC_OTA_COMPRESSION,
+    METRIC_HISTORY_SAMPLES,
+    METRIC_HISTORY_BYTES,
+    METRIC_MQ2_R0,
+    METRIC_GAS_BASELINE,
+    METRIC_CALIBRATION_WRITES,
+    METRIC_SENSOR_POLL_TIME,
+    METRIC_MUX_SWITCHES,
+    METRIC_I2C_CLOCK,
+    METRIC_DISPLAY_FRAMES,
+    METRIC_DISPLAY_DROPPED,
+    METRIC_DISPLAY_FRAME_TIME,
+    METRIC_ALARM_TONE,
+    METRIC_ALARM_TONE_DETECTIONS,
+    METRIC_SPECTRUM_FRAMES,
+    METRIC_SPECTRUM_DROPPED,
+    METRIC_SPECTRUM_ANALYSIS,
+    METRIC_ACTIVE_TIME,
+    METRIC_ACTIVE_RATIO,
+    METRIC_ENERGY_ESTIMATE,
+#ifdef MQTT_ASYNC_TRANSPORT
+    METRIC_MQTT_QUEUE_DEPTH,
+    METRIC_MQTT_QUEUE_HIGH_WATER,
+    METRIC_MQTT_SENT,
+    METRIC_MQTT_DROPPED,
+    METRIC_MQTT_COALESCED,
+    METRIC_MQTT_LATENCY,
+    METRIC_MQTT_LATENCY_MAX,
+#endif
+    NUM_SCALAR_METRICS
+};
+
+struct ScalarMetricInfo
+{
+    const char *name;
+    const char *type;
+    const char *help;
+};
+
+static const ScalarMetricInfo SCALAR_METRICS[NUM_SCALAR_METRICS] = {
+    {"homeclimate_uptime_seconds", "counter", "Seconds since boot."},
+    {"homeclimate_loop_duration_seconds", "gauge", "Duration of the last main loop cycle."},
+    {"homeclimate_loop_duration_max_seconds", "gauge", "Longest main loop cycle since boot."},
+    {"homeclimate_loops_total", "counter", "Completed main loop cycles."},
+    {"homeclimate_mqtt_reconnects_total", "counter", "Successful MQTT connections."},
+    {"homeclimate_wifi_reconnects_total", "counter", "Wi-Fi reconnections."},
+    {"homeclimate_boot_first_sample_seconds", "gauge", "Time from reset to the first complete sample."},
+    {"homeclimate_boot_network_ready_seconds", "gauge", "Time from reset to Wi-Fi and OTA being up."},
+    {"homeclimate_boot_first_publish_seconds", "gauge", "Time from reset to the first readings sent to the broker."},
+    {"homeclimate_heap_free_bytes", "gauge", "Free heap."},
+    {"homeclimate_heap_min_free_bytes", "gauge", "Lowest free heap since boot."},
+    {"homeclimate_heap_max_alloc_bytes", "gauge", "Largest allocatable heap block."},
+    {"homeclimate_heap_max_alloc_min_bytes", "gauge", "Smallest largest-block seen since boot."},
+    {"homeclimate_heap_fragmentation_ratio", "gauge", "Share of free heap outside the largest block."},
+    {"homeclimate_memory_alerts", "gauge", "Raised memory alert flags (bit mask)."},
+    {"homeclimate_heap_stray_allocations_total", "counter", "Heap allocations after setup in static allocation mode."},
+    {"homeclimate_ota_in_progress", "gauge", "1 while an OTA image is being received."},
+    {"homeclimate_ota_updates_total", "counter", "Completed OTA updates since power-on."},
+    {"homeclimate_ota_failures_total", "counter", "Failed or aborted OTA updates since power-on."},
+    {"homeclimate_ota_duration_seconds", "gauge", "Duration of the last completed OTA update."},
+    {"homeclimate_ota_throughput_bytes_per_second", "gauge", "Average throughput of the last OTA update."},
+    {"homeclimate_ota_compression_ratio", "gauge", "Image size over bytes received, last OTA update."},
+    {"homeclimate_history_samples", "gauge", "Samples retained in the time-series store."},
+    {"homeclimate_history_encoded_bytes", "gauge", "Compressed size of the retained samples."},
+    {"homeclimate_mq2_r0_kohms", "gauge", "MQ-2 clean-air resistance in use."},
+    {"homeclimate_gas_baseline_kohms", "gauge", "BME680 clean-air gas resistance baseline."},
+    {"homeclimate_calibration_writes_total", "counter", "Calibration write-backs to NVS since first boot."},
+    {"homeclimate_sensor_poll_duration_seconds", "gauge", "Duration of the last registry sensor poll."},
+    {"homeclimate_i2c_mux_switches_total", "counter", "TCA9548A channel selections."},
+    {"homeclimate_i2c_clock_hz", "gauge", "I2C bus clock chosen at boot."},
+    {"homeclimate_display_frames_total", "counter", "OLED frames sent."},
+    {"homeclimate_display_dropped_frames_total", "counter", "OLED frames not sent (writer or bus busy, write failed)."},
+    {"homeclimate_display_frame_seconds", "gauge", "Transfer time of the last OLED frame."},
+    {"homeclimate_alarm_tone", "gauge", "1 while a smoke alarm T3 tone is heard."},
+    {"homeclimate_alarm_tone_detections_total", "counter", "Times a smoke alarm T3 tone started."},
+    {"homeclimate_spectrum_frames_total", "counter", "Sound frames analysed."},
+    {"homeclimate_spectrum_dropped_frames_total", "counter", "Sound frames dropped for a late sample."},
+    {"homeclimate_spectrum_analysis_seconds", "gauge", "Window, FFT and band time of the last sound frame."},
+    {"homeclimate_active_time_seconds", "gauge", "Full-clock time in the last cycle."},
+    {"homeclimate_active_ratio", "gauge", "Share of the last cycle spent at full clock."},
+    {"homeclimate_energy_estimate_mah_per_day", "gauge", "Projected daily charge at the current duty cycle."},
+#ifdef MQTT_ASYNC_TRANSPORT
+    {"homeclimate_mqtt_queue_depth", "gauge", "Messages waiting in the MQTT outbound queue."},
+    {"homeclimate_mqtt_queue_high_water", "gauge", "Deepest the MQTT outbound queue has been."},
+    {"homeclimate_mqtt_sent_total", "counter", "Messages handed to the TCP stack."},
+    {"homeclimate_mqtt_dropped_total", "counter", "Messages dropped by queue backpressure."},
+    {"homeclimate_mqtt_coalesced_total", "counter", "Messages replaced by a newer one on the same topic."},
+    {"homeclimate_mqtt_publish_latency_seconds", "gauge", "Enqueue-to-send latency of the last message."},
+    {"homeclimate_mqtt_publish_latency_max_seconds", "gauge", "Worst enqueue-to-send latency."},
+#endif
+};
+
+static double scalarMetricValue(int metric)
+{
+    switch (metric)
+    {
+    case METRIC_UPTIME:
+        return millis() / 1000.0;
+    case METRIC_LOOP_TIME:
+        return systemMetrics.loopTimeMs / 1000.0;
+    case METRIC_LOOP_TIME_MAX:
+        return systemMetrics.maxLoopTimeMs / 1000.0;
+    case METRIC_LOOPS:
+        return systemMetrics.loopCount;
+    case METRIC_MQTT_RECONNECTS:
+        return systemMetrics.mqttReconnects;
+    case METRIC_WIFI_RECONNECTS:
+        return systemMetrics.wifiReconnects;
+    case METRIC_BOOT_FIRST_SAMPLE:
+        return systemMetrics.firstSampleMs / 1000.0;
+    case METRIC_BOOT_NETWORK_READY:
+        return systemMetrics.networkReadyMs / 1000.0;
+    case METRIC_BOOT_FIRST_PUBLISH:
+        return systemMetrics.firstPublishMs / 1000.0;
+    case METRIC_HEAP_FREE:
+        return ESP.getFreeHeap();
+    case METRIC_HEAP_MIN_FREE:
+        return ESP.getMinFreeHeap();
+    case METRIC_HEAP_MAX_BLOCK:
+        return ESP.getMaxAllocHeap();
+    case METRIC_HEAP_MIN_MAX_BLOCK:
+        return getMemoryStats().minLargestBlock;
+    case METRIC_HEAP_FRAGMENTATION:
+        return getMemoryStats().fragmentationPct / 100.0;
+    case METRIC_MEMORY_ALERTS:
+        return getMemoryStats().alerts;
+    case METRIC_HEAP_STRAYS:
+        return getStrayAllocations().count;
+    case METRIC_OTA_IN_PROGRESS:
+        return isOTAInProgress() ? 1 : 0;
+    case METRIC_OTA_UPDATES:
+        return getOTAStats().updates;
+    case METRIC_OTA_FAILURES:
+        return getOTAStats().failures;
+    case METRIC_OTA_DURATION:
+        return getOTAStats().lastDurationMs / 1000.0;
+    case METRIC_OTA_THROUGHPUT:
+        return getOTAStats().lastBytesPerSec;
+    case METRIC_OTA_COMPRESSION:
+    {
+        OtaStats ota = getOTAStats();
+        return ota.lastPackedBytes > 0 ? (double)ota.lastBytes / ota.lastPackedBytes : 1.0;
+    }
+    case METRIC_HISTORY_SAMPLES:
+    case METRIC_HISTORY_BYTES:
+    {
+        lockTimeSeriesStore();
+        TsStoreUsage usage = getTimeSeriesStoreUsage();
+        unlockTimeSeriesStore();
+        return metric == METRIC_HISTORY_SAMPLES ? usage.samples : usage.encodedBytes;
+    }
+    case METRIC_MQ2_R0:
+        return getCalibrationStats().mq2R0;
+    case METRIC_GAS_BASELINE:
+        return getCalibrationStats().gasBaseline;
+    case METRIC_CALIBRATION_WRITES:
+        return getCalibrationStats().nvsWrites;
+    case METRIC_SENSOR_POLL_TIME:
+        return getSensorPollStats().lastPollMs / 1000.0;
+    case METRIC_MUX_SWITCHES:
+        return getSensorPollStats().muxSwitches;
+    case METRIC_I2C_CLOCK:
+        return getI2CClockHz();
+    case METRIC_DISPLAY_FRAMES:
+        return getDisplayWriterStats().frames;
+    case METRIC_DISPLAY_DROPPED:
+        return getDisplayWriterStats().droppedFrames;
+    case METRIC_DISPLAY_FRAME_TIME:
+        return getDisplayWriterStats().lastFrameUs / 1e6;
+    case METRIC_ALARM_TONE:
+        return getSoundSpectrum().alarmTone ? 1 : 0;
+    case METRIC_ALARM_TONE_DETECTIONS:
+        return getSoundSpectrum().alarmToneDetections;
+    case METRIC_SPECTRUM_FRAMES:
+        return getSoundSpectrum().frames;
+    case METRIC_SPECTRUM_DROPPED:
+        return getSoundSpectrum().droppedFrames;
+    case METRIC_SPECTRUM_ANALYSIS:
+        return getSoundSpectrum().analysisUs / 1e6;
+    case METRIC_ACTIVE_TIME:
+        return getPowerStats().activeTimeMs / 1000.0;
+    case METRIC_ACTIVE_RATIO:
+        return getPowerStats().activeRatio;
+    case METRIC_ENERGY_ESTIMATE:
+        return getPowerStats().estimatedMahPerDay;
+#ifdef MQTT_ASYNC_TRANSPORT
+    case METRIC_MQTT_QUEUE_DEPTH:
+        return getMqttQueueStats().depth;
+    case METRIC_MQTT_QUEUE_HIGH_WATER:
+        return getMqttQueueStats().highWater;
+    case METRIC_MQTT_SENT:
+        return getMqttQueueStats().sent;
+    case METRIC_MQTT_DROPPED:
+        return getMqttQueueStats().dropped;
+    case METRIC_MQTT_COALESCED:
+        return getMqttQueueStats().coalesced;
+    case METRIC_MQTT_LATENCY:
+        return getMqttQueueStats().lastLatencyUs / 1e6;
+    case METRIC_MQTT_LATENCY_MAX:
+        return getMqttQueueStats().maxLatencyUs / 1e6;
+#endif
+    }
+    return 0;
+}
+
+/*
+ * ==================================================
+ * FUNCTION: FILL LINES
+ * ==================================================
+ * Description:
+ *   Copies lines produced by nextLine(text, size) straight into the chunk
+ *   buffer handed out by the web server, splitting a line across calls when
+ *   it does not fit. nextLine returns the line length, or 0 when done.
+ */
+
+template <typename NextLine>
+static size_t fillLines(PendingLine &pending, uint8_t *buffer, size_t maxLen, NextLine nextLine)
+{
+    size_t written = 0;
+    while (written < maxLen)
+    {
+        if (pending.offset >= pending.length)
+        {
+            int length = nextLine(pending.text, sizeof(pending.text));
+            if (length <= 0)
+            {
+                break;
+            }
+            pending.length = length < (int)sizeof(pending.text) ? length : sizeof(pending.text) - 1;
+            pending.offset = 0;
+        }
+
+        size_t count = pending.length - pending.offset;
+        if (count > maxLen - written)
+        {
+            count = maxLen - written;
+        }
+        memcpy(buffer + written, pending.text + pending.offset, count);
+        written += count;
+        pending.offset += count;
+    }
+    return written;
+}
+
+/*
+ * ==================================================
+ * FUNCTION: HANDLE METRICS
+ * ==================================================
+ * Description:
+ *   Serves /metrics in Prometheus text exposition format, rendered line by
+ *   line into the response buffer.
+ */
+
+static void handleMetrics(AsyncWebServerRequest *request)
+{
+    PendingLine pending = {"", 0, 0};
+    uint16_t line = 0;
+
+    AsyncWebServerResponse *response = request->beginChunkedResponse(
+        "text/plain; version=0.0.4",
+        [pending, line](uint8_t *buffer, size_t maxLen, size_t) mutable -> size_t
+        {
+            return fillLines(pending, buffer, maxLen, [&line](char *text, size_t size) -> int
+                             {
+                uint16_t current = line++;
+                if (current == 0)
+                {
+                    return snprintf(text, size, "# HELP homeclimate_sensor_value Latest sensor reading.\n"
+                                                "# TYPE homeclimate_sensor_value gauge\n");
+                }
+                current -= 1;
+                if (current < NUM_CHANNELS)
+                {
+                    return snprintf(text, size, "homeclimate_sensor_value{channel=\"%s\"} %g\n",
+                                    CHANNEL_NAMES[current], getChannelValue((SensorChannel)current));
+                }
+                current -= NUM_CHANNELS;
+                if (current == 0)
+                {
+                    return snprintf(text, size, "# HELP homeclimate_sample_jitter_seconds Sample start delay vs schedule.\n"
+                                                "# TYPE homeclimate_sample_jitter_seconds gauge\n");
+                }
+                current -= 1;
+                if (current < NUM_SENSOR_GROUPS * 3)
+                {
+                    static const char *const STATS[3] = {"min", "max", "p99"};
+                    SamplingJitter jitter = getSamplingJitter((SensorGroup)(current / 3));
+                    int32_t values[3] = {jitter.minUs, jitter.maxUs, jitter.p99Us};
+                    return snprintf(text, size, "homeclimate_sample_jitter_seconds{sensor=\"%s\",stat=\"%s\"} %g\n",
+                                    SENSOR_GROUP_NAMES[current / 3], STATS[current % 3], values[current % 3] / 1e6);
+                }
+                current -= NUM_SENSOR_GROUPS * 3;
+                if (current == 0)
+                {
+                    return snprintf(text, size, "# HELP homeclimate_sample_overruns_total Missed sampling periods.\n"
+                                                "# TYPE homeclimate_sample_overruns_total counter\n");
+                }
+                current -= 1;
+                if (current < NUM_SENSOR_GROUPS)
+                {
+                    return snprintf(text, size, "homeclimate_sample_overruns_total{sensor=\"%s\"} %lu\n",
+                                    SENSOR_GROUP_NAMES[current], (unsigned long)getSamplingJitter((SensorGroup)current).overruns);
+                }
+                current -= NUM_SENSOR_GROUPS;
+                if (current == 0)
+                {
+                    return snprintf(text, size, "# HELP homeclimate_sample_rate_hz Current sampling rate.\n"
+                                                "# TYPE homeclimate_sample_rate_hz gauge\n");
+                }
+                current -= 1;
+                if (current < NUM_SENSOR_GROUPS)
+                {
+                    return snprintf(text, size, "homeclimate_sample_rate_hz{sensor=\"%s\"} %g\n",
+                                    SENSOR_GROUP_NAMES[current], 1e6 / getSamplingPeriod((SensorGroup)current));
+                }
+                current -= NUM_SENSOR_GROUPS;
+                if (current == 0)
+                {
+                    return snprintf(text, size, "# HELP homeclimate_sample_retimes_total Adaptive sampling period changes.\n"
+                                                "# TYPE homeclimate_sample_retimes_total counter\n");
+                }
+                current -= 1;
+                if (current < NUM_SENSOR_GROUPS)
+                {
+                    return snprintf(text, size, "homeclimate_sample_retimes_total{sensor=\"%s\"} %lu\n",
+                                    SENSOR_GROUP_NAMES[current], (unsigned long)getSamplingJitter((SensorGroup)current).retimes);
+                }
+                current -= NUM_SENSOR_GROUPS;
+                if (current == 0)
+                {
+                    return snprintf(text, size, "# HELP homeclimate_i2c_transactions_total I2C transactions per client.\n"
+                                                "# TYPE homeclimate_i2c_transactions_total counter\n");
+                }
+                current -= 1;
+                if (current < NUM_I2C_CLIENTS)
+                {
+                    return snprintf(text, size, "homeclimate_i2c_transactions_total{client=\"%s\"} %lu\n",
+                                    I2C_CLIENT_NAMES[current], (unsigned long)getI2CClientStats((I2CClient)current).transactions);
+                }
+                current -= NUM_I2C_CLIENTS;
+                if (current == 0)
+                {
+                    return snprintf(text, size, "# HELP homeclimate_i2c_busy_seconds_total Time holding the I2C bus.\n"
+                                                "# TYPE homeclimate_i2c_busy_seconds_total counter\n");
+                }
+                current -= 1;
+                if (current < NUM_I2C_CLIENTS)
+                {
+                    return snprintf(text, size, "homeclimate_i2c_busy_seconds_total{client=\"%s\"} %g\n",
+                                    I2C_CLIENT_NAMES[current], getI2CClientStats((I2CClient)current).busyUs / 1e6);
+                }
+                current -= NUM_I2C_CLIENTS;
+                if (current == 0)
+                {
+                    return snprintf(text, size, "# HELP homeclimate_i2c_wait_seconds_total Time waiting for the I2C bus.\n"
+                                                "# TYPE homeclimate_i2c_wait_seconds_total counter\n");
+                }
+                current -= 1;
+                if (current < NUM_I2C_CLIENTS)
+                {
+                    return snprintf(text, size, "homeclimate_i2c_wait_seconds_total{client=\"%s\"} %g\n",
+                                    I2C_CLIENT_NAMES[current], getI2CClientStats((I2CClient)current).waitUs / 1e6);
+                }
+                current -= NUM_I2C_CLIENTS;
+                if (current == 0)
+                {
+                    return snprintf(text, size, "# HELP homeclimate_i2c_wait_max_seconds Longest wait for the I2C bus.\n"
+                                                "# TYPE homeclimate_i2c_wait_max_seconds gauge\n");
+                }
+                current -= 1;
+                if (current < NUM_I2C_CLIENTS)
+                {
+                    return snprintf(text, size, "homeclimate_i2c_wait_max_seconds{client=\"%s\"} %g\n",
+                                    I2C_CLIENT_NAMES[current], getI2CClientStats((I2CClient)current).maxWaitUs / 1e6);
+                }
+                current -= NUM_I2C_CLIENTS;
+                if (current == 0)
+                {
+                    return snprintf(text, size, "# HELP homeclimate_i2c_timeouts_total Gave up waiting for the I2C bus.\n"
+                                                "# TYPE homeclimate_i2c_timeouts_total counter\n");
+                }
+                current -= 1;
+                if (current < NUM_I2C_CLIENTS)
+                {
+                    return snprintf(text, size, "homeclimate_i2c_timeouts_total{client=\"%s\"} %lu\n",
+                                    I2C_CLIENT_NAMES[current], (unsigned long)getI2CClientStats((I2CClient)current).timeouts);
+                }
+                current -= NUM_I2C_CLIENTS;
+                if (current == 0)
+                {
+                    return snprintf(text, size, "# HELP homeclimate_stage_overruns_total Watchdog stage deadline misses.\n"
+                                                "# TYPE homeclimate_stage_overruns_total counter\n");
+                }
+                current -= 1;
+                if (current < NUM_WATCHDOG_STAGES)
+                {
+                    return snprintf(text, size, "homeclimate_stage_overruns_total{stage=\"%s\"} %lu\n",
+                                    WATCHDOG_STAGE_NAMES[current], (unsigned long)getStageStats((WatchdogStage)current).overruns);
+                }
+                current -= NUM_WATCHDOG_STAGES;
+                if (current == 0)
+                {
+                    return snprintf(text, size, "# HELP homeclimate_stage_worst_seconds Longest run of a watchdog stage.\n"
+                                                "# TYPE homeclimate_stage_worst_seconds gauge\n");
+                }
+                current -= 1;
+                if (current < NUM_WATCHDOG_STAGES)
+                {
+                    return snprintf(text, size, "homeclimate_stage_worst_seconds{stage=\"%s\"} %g\n",
+                                    WATCHDOG_STAGE_NAMES[current], getStageStats((WatchdogStage)current).worstMs / 1e3);
+                }
+                current -= NUM_WATCHDOG_STAGES;
+                if (current == 0)
+                {
+                    return snprintf(text, size, "# HELP homeclimate_anomalies_total Early-warning anomalies per channel.\n"
+                                                "# TYPE homeclimate_anomalies_total counter\n");
+                }
+                current -= 1;
+                if (current < NUM_ANOMALY_CHANNELS)
+                {
+                    return snprintf(text, size, "homeclimate_anomalies_total{channel=\"%s\"} %lu\n",
+                                    CHANNEL_NAMES[ANOMALY_CHANNELS[current]],
+                                    (unsigned long)getAnomalyStatus((AnomalyChannel)current).events);
+                }
+                current -= NUM_ANOMALY_CHANNELS;
+                if (current == 0)
+                {
+                    return snprintf(text, size, "# HELP homeclimate_anomaly_active Early warning raised (1) or not (0).\n"
+                                                "# TYPE homeclimate_anomaly_active gauge\n");
+                }
+                current -= 1;
+                if (current < NUM_ANOMALY_CHANNELS)
+                {
+                    return snprintf(text, size, "homeclimate_anomaly_active{channel=\"%s\"} %d\n",
+                                    CHANNEL_NAMES[ANOMALY_CHANNELS[current]],
+                                    getAnomalyStatus((AnomalyChannel)current).triggers != 0 ? 1 : 0);
+                }
+                current -= NUM_ANOMALY_CHANNELS;
+                if (current == 0)
+                {
+                    return snprintf(text, size, "# HELP homeclimate_sound_band_dbfs KY-038 octave band level.\n"
+                                                "# TYPE homeclimate_sound_band_dbfs gauge\n");
+                }
+                current -= 1;
+                if (current < NUM_SOUND_BANDS)
+                {
+                    return snprintf(text, size, "homeclimate_sound_band_dbfs{band=\"%u\"} %.1f\n",
+                                    SOUND_BAND_CENTRES_HZ[current], getSoundSpectrum().bandDbfs[current]);
+                }
+                current -= NUM_SOUND_BANDS;
+                if (current == 0)
+                {
+                    return snprintf(text, size, "# HELP homeclimate_task_stack_free_bytes Unused stack (high-water mark).\n"
+                                                "# TYPE homeclimate_task_stack_free_bytes gauge\n");
+                }
+                current -= 1;
+                if (current < NUM_MEMORY_TASKS)
+                {
+                    int32_t stackFree = getMemoryStats().stackFree[current];
+                    if (stackFree < 0)
+                    {
+                        return snprintf(text, size, "# %s not running\n", MEMORY_TASK_NAMES[current]);
+                    }
+                    return snprintf(text, size, "homeclimate_task_stack_free_bytes{task=\"%s\"} %ld\n",
+                                    MEMORY_TASK_NAMES[current], (long)stackFree);
+                }
+                current -= NUM_MEMORY_TASKS;
+#ifdef MEMORY_ALLOC_HOOK
+                if (current == 0)
+                {
+                    return snprintf(text, size, "# HELP homeclimate_allocations_total Heap allocations per loop site.\n"
+                                                "# TYPE homeclimate_allocations_total counter\n");
+                }
+                current -= 1;
+                if (current < NUM_ALLOC_SITES)
+                {
+                    return snprintf(text, size, "homeclimate_allocations_total{site=\"%s\"} %lu\n", ALLOC_SITE_NAMES[current],
+                                    (unsigned long)getAllocationCount((AllocationSite)current).calls);
+                }
+                current -= NUM_ALLOC_SITES;
+                if (current == 0)
+                {
+                    return snprintf(text, size, "# HELP homeclimate_allocated_bytes_total Heap bytes requested per loop site.\n"
+                                                "# TYPE homeclimate_allocated_bytes_total counter\n");
+                }
+                current -= 1;
+                if (current < NUM_ALLOC_SITES)
+                {
+                    return snprintf(text, size, "homeclimate_allocated_bytes_total{site=\"%s\"} %lu\n", ALLOC_SITE_NAMES[current],
+                                    (unsigned long)getAllocationCount((AllocationSite)current).bytes);
+                }
+                current -= NUM_ALLOC_SITES;
+#endif
+                if (current < NUM_SCALAR_METRICS * 3)
+                {
+                    int metric = current / 3;
+                    const ScalarMetricInfo &info = SCALAR_METRICS[metric];
+                    switch (current % 3)
+                    {
+                    case 0:
+                        return snprintf(text, size, "# HELP %s %s\n", info.name, info.help);
+                    case 1:
+                        return snprintf(text, size, "# TYPE %s %s\n", info.name, info.type);
+                    default:
+                        return snprintf(text, size, "%s %.10g\n", info.name, scalarMetricValue(metric));
+                    }
+                }
+                return 0; });
+        });
+    request->send(response);
+}
+
+/*
+ * ==================================================
+ * FUNCTION: HANDLE HISTORY CSV
+ * ==================================================
+ * Description:
+ *   Serves /history.csv?channels=temperature,co&res=minute&last=3600 as a
+ *   chunked CSV stream. The store is locked only while a chunk is filled,
+ *   so sensor acquisition keeps running between chunks.
+ */
+
+static void handleHistoryCSV(AsyncWebServerRequest *request)
+{
+    uint16_t channelMask = ALL_CHANNELS_MASK;
+    TsResolution resolution = TS_MINUTE;
+    uint32_t from = 0;
+    uint32_t to = UINT32_MAX;
+
+    if (request->hasParam("channels"))
+    {
+        const String &list = request->getParam("channels")->value();
+        channelMask = parseChannelMask(list.c_str(), list.length());
+    }
+    if (request->hasParam("res"))
+    {
+        const String &res = request->getParam("res")->value();
+        resolution = res == "raw" ? TS_RAW : res == "hour" ? TS_HOUR : TS_MINUTE;
+    }
+    if (request->hasParam("from"))
+    {
+        from = strtoul(request->getParam("from")->value().c_str(), NULL, 10);
+    }
+    if (request->hasParam("to"))
+    {
+        to = strtoul(request->getParam("to")->value().c_str(), NULL, 10);
+    }
+    if (request->hasParam("last"))
+    {
+        uint32_t now = millis() / 1000;
+        uint32_t last = strtoul(request->getParam("last")->value().c_str(), NULL, 10);
+        from = last < now ? now - last : 0;
+    }
+
+    PendingLine pending = {"", 0, 0};
+    bool headerSent = false;
+    int channel = 0;
+    bool started = false;
+    TsIterator it;
+
+    AsyncWebServerResponse *response = request->beginChunkedResponse(
+        "text/csv",
+        [=](uint8_t *buffer, size_t maxLen, size_t) mutable -> size_t
+        {
+            lockTimeSeriesStore();
+            size_t written = fillLines(pending, buffer, maxLen, [&](char *text, size_t size) -> int
+                                       {
+                if (!headerSent)
+                {
+                    headerSent = true;
+                    return snprintf(text, size, "channel,timestamp,value\n");
+                }
+                while (channel < NUM_CHANNELS)
+                {
+                    if (!(channelMask & (1u << channel)))
+                    {
+                        channel++;
+                        continue;
+                    }
+                    if (!started)
+                    {
+                        beginTimeSeriesQuery(it, (SensorChannel)channel, resolution, from, to);
+                        started = true;
+                    }
+                    uint32_t timestamp;
+                    float value;
+                    if (nextTimeSeriesPoint(it, timestamp, value))
+                    {
+                        return snprintf(text, size, "%s,%lu,%.2f\n",
+                                        CHANNEL_NAMES[channel], (unsigned long)timestamp, value);
+                    }
+                    channel++;
+                    started = false;
+                }
+                return 0; });
+            unlockTimeSeriesStore();
+            return written;
+        });
+    request->send(response);
+}
+
+/*
+ * ==================================================
+ * FUNCTION: HANDLE PACKED OTA
+ * ==================================================
+ * Description:
+ *   POST /ota with a packed image from tools/ota_pack.py as the raw body
+ *   (HTTP basic auth, user OTA_HTTP_USER). The body is inflated into the
+ *   OTA partition as it arrives; the request that started the update owns
+ *   it until its final handler has answered. A dropped connection aborts.
+ */
+
+static AsyncWebServerRequest *packedOtaRequest = NULL;
+static OtaPackStatus packedOtaStatus = OTA_PACK_OK;
+
+static void handlePackedOTABody(AsyncWebServerRequest *request, uint8_t *data, size_t length, size_t index,
+                                size_t total)
+{
+    if (index == 0)
+    {
+        if (packedOtaRequest != NULL || !request->authenticate(OTA_HTTP_USER, OTA_PASSWORD))
+        {
+            return; // Answered by handlePackedOTA()
+        }
+        packedOtaRequest = request;
+        packedOtaStatus = beginPackedOTA();
+        request->onDisconnect([request]()
+                              {
+            if (packedOtaRequest == request)
+            {
+                abortPackedOTA();
+                packedOtaRequest = NULL;
+            } });
+    }
+    if (request != packedOtaRequest || packedOtaStatus != OTA_PACK_OK)
+    {
+        return;
+    }
+    packedOtaStatus = writePackedOTA(data, length);
+    if (packedOtaStatus == OTA_PACK_OK && index + length == total)
+    {
+        packedOtaStatus = endPackedOTA();
+    }
+}
+
+static void handlePackedOTA(AsyncWebServerRequest *request)
+{
+    if (!request->authenticate(OTA_HTTP_USER, OTA_PASSWORD))
+    {
+        request->requestAuthentication();
+        return;
+    }
+    if (packedOtaRequest == NULL)
+    {
+        request->send(400, "text/plain", "No image\n");
+        return;
+    }
+    if (packedOtaRequest != request)
+    {
+        request->send(409, "text/plain", "Another update is in progress\n");
+        return;
+    }
+
+    packedOtaRequest = NULL;
+    char text[HTTP_LINE_MAX];
+    if (packedOtaStatus != OTA_PACK_OK)
+    {
+        abortPackedOTA();
+        snprintf(text, sizeof(text), "Update failed: %s\n", OTA_PACK_STATUS_NAMES[packedOtaStatus]);
+        request->send(packedOtaStatus == OTA_PACK_BUSY ? 409 : 400, "text/plain", text);
+        return;
+    }
+    OtaStats stats = getOTAStats();
+    snprintf(text, sizeof(text), "Updated: %lu bytes from %lu (%.2fx) in %lu ms, restarting\n",
+             (unsigned long)stats.lastBytes, (unsigned long)stats.lastPackedBytes,
+             (double)stats.lastBytes / stats.lastPackedBytes, (unsigned long)stats.lastDurationMs);
+    request->send(200, "text/plain", text);
+}
+
+/*
+ * ==================================================
+ * FUNCTION: SETUP HTTP SERVER
+ * ==================================================
+ * Description:
+ *   Registers the endpoints and starts the asynchronous web server. Requests
+ *   are handled on the AsyncTCP task, independent of loop().
+ */
+
+void setupHTTPServer()
+{
+    server.on("/metrics", HTTP_GET, handleMetrics);
+    server.on("/history.csv", HTTP_GET, handleHistoryCSV);
+    server.on("/ota", HTTP_POST, handlePackedOTA, NULL, handlePackedOTABody);
+    server.onNotFound([](AsyncWebServerRequest *request)
+                      { request->send(404, "text/plain", "Not found"); });
+    server.begin();
+
+    logPrintf("HTTP server listening on port %d\n", HTTP_PORT);
+}
@@ -0,0 +1,172 @@
+#include "i2c_bus.h"
+#include "hardware_init.h"
+#include "sensor_registry.h"
+#include "static_arena.h"
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+#define I2C_CLIENT_NAME(id, name, address, maxHz) name,
+const char *const I2C_CLIENT_NAMES[NUM_I2C_CLIENTS] = {I2C_CLIENT_TABLE(I2C_CLIENT_NAME)};
+#undef I2C_CLIENT_NAME
+
+#define I2C_CLIENT_ADDRESS(id, name, address, maxHz) address,
+static const uint8_t CLIENT_ADDRESSES[NUM_I2C_CLIENTS] = {I2C_CLIENT_TABLE(I2C_CLIENT_ADDRESS)};
+#undef I2C_CLIENT_ADDRESS
+
+#define I2C_CLIENT_MAX_HZ(id, name, address, maxHz) maxHz,
+static const uint32_t CLIENT_MAX_HZ[NUM_I2C_CLIENTS] = {I2C_CLIENT_TABLE(I2C_CLIENT_MAX_HZ)};
+#undef I2C_CLIENT_MAX_HZ
+
+static StaticSemaphore_t busMutexBuffer;
+static SemaphoreHandle_t busMutex = NULL;
+static uint32_t clockHz = I2C_PROBE_HZ;
+static int64_t acquiredUs; // Start of the current transaction, set by the holder
+static I2CClientStats clientStats[NUM_I2C_CLIENTS];
+static portMUX_TYPE statsMux = portMUX_INITIALIZER_UNLOCKED;
+
+// True if a device acknowledges its address at the current clock
+static bool deviceAnswers(uint8_t address)
+{
+    Wire.beginTransmission(address);
+    return Wire.endTransmission() == 0;
+}
+
+/*
+ * ==================================================
+ * FUNCTION: INITIALIZE I2C BUS
+ * ==================================================
+ * Description:
+ *   Starts Wire, creates the bus mutex in static storage and picks the
+ *   clock: the devices that answer at I2C_PROBE_HZ set the limit, and the
+ *   clock steps down (fast mode, then I2C_PROBE_HZ) until all of them
+ *   still answer. The OLED driver is told to keep that clock, as it would
+ *   otherwise drop the bus to 100 kHz after every init. Call before any
+ *   device is initialised.
+ */
+
+void initializeI2CBus()
+{
+    Wire.begin(SDA_PIN, SCL_PIN, I2C_PROBE_HZ);
+    if (busMutex == NULL)
+    {
+        busMutex = xSemaphoreCreateMutexStatic(&busMutexBuffer);
+    }
+
+    bool present[NUM_I2C_CLIENTS];
+    uint32_t fastest = I2C_BUS_MAX_HZ;
+    for (int c = 0; c < NUM_I2C_CLIENTS; c++)
+    {
+        present[c] = deviceAnswers(CLIENT_ADDRESSES[c]);
+        if (present[c] && CLIENT_MAX_HZ[c] < fastest)
+        {
+            fastest = CLIENT_MAX_HZ[c];
+        }
+    }
+
+    clockHz = fastest;
+    for (;;)
+    {
+        Wire.setClock(clockHz);
+        bool allAnswer = true;
+        for (int c = 0; c < NUM_I2C_CLIENTS; c++)
+        {
+            allAnswer = allAnswer && (!present[c] || deviceAnswers(CLIENT_ADDRESSES[c]));
+        }
+        if (allAnswer || clockHz <= I2C_PROBE_HZ)
+        {
+            break;
+        }
+        clockHz = clockHz > I2C_FAST_HZ ? I2C_FAST_HZ : I2C_PROBE_HZ;
+    }
+    display.setBusClock(clockHz);
+
+    logPrintf("I2C bus at %lu kHz (limit %lu kHz)\n", (unsigned long)clockHz / 1000, (unsigned long)fastest / 1000);
+}
+
+/*
+ * ==================================================
+ * FUNCTION: ACQUIRE I2C BUS
+ * ==================================================
+ * Description:
+ *   Starts a transaction: waits up to I2C_ACQUIRE_TIMEOUT_MS for the bus,
+ *   behind any higher-priority task already waiting. Returns false on a
+ *   timeout, in which case the caller skips its bus access. Transactions
+ *   do not nest. Before initializeI2CBus() the bus is free for all.
+ */
+
+bool acquireI2CBus(I2CClient client)
+{
+    if (busMutex == NULL)
+    {
+        return true;
+    }
+
+    int64_t startUs = esp_timer_get_time();
+    bool acquired = xSemaphoreTake(busMutex, pdMS_TO_TICKS(I2C_ACQUIRE_TIMEOUT_MS)) == pdTRUE;
+    int64_t nowUs = esp_timer_get_time();
+    uint32_t waitUs = (uint32_t)(nowUs - startUs);
+
+    portENTER_CRITICAL(&statsMux);
+    I2CClientStats &stats = clientStats[client];
+    stats.waitUs += waitUs;
+    if (waitUs > stats.maxWaitUs)
+    {
+        stats.maxWaitUs = waitUs;
+    }
+    stats.timeouts += acquired ? 0 : 1;
+    portEXIT_CRITICAL(&statsMux);
+
+    if (acquired)
+    {
+        acquiredUs = nowUs;
+    }
+    return acquired;
+}
+
+/*
+ * ==================================================
+ * FUNCTION: RELEASE I2C BUS
+ * ==================================================
+ * Description:
+ *   Ends a transaction started by acquireI2CBus() and counts the time the
+ *   client held the bus. The highest-priority waiter goes next.
+ */
+
+void releaseI2CBus(I2CClient client)
+{
+    if (busMutex == NULL)
+    {
+        return;
+    }
+
+    uint32_t busyUs = (uint32_t)(esp_timer_get_time() - acquiredUs);
+    portENTER_CRITICAL(&statsMux);
+    clientStats[client].transactions++;
+    clientStats[client].busyUs += busyUs;
+    portEXIT_CRITICAL(&statsMux);
+    xSemaphoreGive(busMutex);
+}
+
+/*
+ * ==================================================
+ * FUNCTION: GET I2C BUS STATS
+ * ==================================================
+ * Description:
+ *   The clock chosen at boot, and a snapshot of one client's transactions,
+ *   wait and busy times. Bus utilisation is the busy time of all clients
+ *   over elapsed time.
+ */
+
+uint32_t getI2CClockHz()
+{
+    return clockHz;
+}
+
+I2CClientStats getI2CClientStats(I2CClient client)
+{
+    portENTER_CRITICAL(&statsMux);
+    I2CClientStats stats = clientStats[client];
+    portEXIT_CRITICAL(&statsMux);
+    return stats;
+}
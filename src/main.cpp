@@ -3,6 +3,24 @@
 #include "sensor_processing.h"
 #include "oled_display.h"
 #include "serial_monitor.h"
+#include "rolling_stats.h"
+#include "time_series_store.h"
+#include "diagnostics.h"
+#include "http_server.h"
+#include "power_management.h"
+#include "batch_mode.h"
+#include "boot_sequence.h"
+#include "calibration_store.h"
+#include "math_kernels.h"
+#include "sensor_registry.h"
+#include "sampling_scheduler.h"
+#include "runtime_config.h"
+#include "stage_watchdog.h"
+#include "memory_monitor.h"
+#include "static_arena.h"
+#include "sound_spectrum.h"
+#include "i2c_bus.h"
+#include "alert_dispatch.h"
 //
 #include "wifi_setup.h"
 #include "ota_setup.h"
@@ -11,6 +29,7 @@
 //
 #include "../lib/mqtt/mqtt_config.h"
 #include "../lib/mqtt/mqtt_functions.h"
+#include "../lib/mqtt/mqtt_history.h"
 
 /*
  * =================================================
@@ -21,24 +40,82 @@
 void setup()
 {
   Serial.begin(115200);
-  Wire.begin(SDA_PIN, SCL_PIN);
 
-  // Connect to Wi-Fi
-  connectToWiFi();
+  // Statically sized runtime buffers and the serial log lock
+  initializeStaticArena();
 
-  // Setup OTA
-  setupOTA();
+  // Shared I2C bus: fastest clock the attached devices allow, one lock
+  initializeI2CBus();
 
-  // Setup MQTT
+#ifdef DEEP_SLEEP_BATCH_MODE
+  // Headless sample-and-sleep mode: never returns
+  runBatchModeCycle();
+#endif
+
+  // Enable frequency scaling and light sleep (applied when Wi-Fi starts)
+  initializePowerManagement();
+
+  // Thresholds, sampling periods and display timing saved from the config topic
+  initializeRuntimeConfig();
+
+  // Stage deadlines and the task watchdog; a failed peripheral from here on
+  // is retried instead of halting the device
+  initializeStageWatchdog();
+
+  // Heap, fragmentation and stack sampling with alert thresholds
+  initializeMemoryMonitor();
+
+  // Associate with Wi-Fi and start OTA in the background
+  startNetworkBoot();
+
+  // Setup MQTT (connects on its own once Wi-Fi is up)
   setupMQTT(client);
 
-  // Initialize Hardware
+  // Setup HTTP endpoints (/metrics, /history.csv, /ota)
+  setupHTTPServer();
+
+  // Start with empty statistics windows and history
+  initializeRollingStats();
+  initializeTimeSeriesStore();
+
+  // Conversion tables for the per-sample math
+  initializeMathKernels();
+
+  // Cached MQ-2 R0 and gas baseline, so the sensors are ready immediately
+  initializeCalibrationStore();
+
+  // Initialize Hardware while Wi-Fi associates
   initializeBuzzer();
   initializeNeoPixels();
   initializeOLED();
+  startDisplayWriter();
   initializeBME680();
   initializeMQ2();
   initializeSoundSensor();
+  initializeSensorRegistry();
+
+  // First sample right away; the async transport queues it until connected
+  acquireAllSensors();
+  markFirstSample();
+#ifdef MQTT_ASYNC_TRANSPORT
+  publishMQTTReadings(client);
+#endif
+
+  // NeoPixel status and early-warning events, as soon as a sampler raises them
+  startAlertDispatch();
+
+  // From here on every sensor is sampled on its own period, off loop()
+  startSensorSampling();
+
+  // Octave bands and smoke alarm tone from KY-038 frames, below the samplers
+  startSoundSpectrum();
+
+  // Optional peripheral self-tests, in the background
+  startSelfTests();
+
+  // Static allocation mode: no heap allocation outside the network stack
+  // from here on
+  sealHeap();
 }
 
 /*
@@ -49,20 +126,31 @@ void setup()
 
 void loop()
 {
-  // Handle OTA updates
-  handleOTA();
-
-  // Reconnect Wi-Fi if needed
-  checkWiFi();
+  beginLoopTiming();
+  setAllocationSite(ALLOC_SITE_NETWORK);
 
-  // Reconnect MQTT if needed
-  if (!client.connected())
+  // Wi-Fi and the blocking MQTT client belong to the boot task until it is
+  // done. OTA runs in its own task.
+  bool networkReady = isNetworkReady();
+  if (networkReady)
   {
-    reconnectMQTT(client);
+    // Reconnect Wi-Fi if needed
+    checkWiFi();
+
+    // Reconnect MQTT if needed
+    if (beginStage(STAGE_PUBLISH))
+    {
+      loopMQTT(client);
+      endStage(STAGE_PUBLISH);
+    }
   }
-  client.loop();
 
-  // Process Sensors and Display on OLED
+  // Answer history queries received during client.loop()
+  setAllocationSite(ALLOC_SITE_HISTORY);
+  serviceMQTTHistoryQuery(client);
+
+  // Display the latest samples on the OLED
+  setAllocationSite(ALLOC_SITE_DISPLAY);
   displayWelcomeLogo();
   displayWaveAnimation();
   //
@@ -70,11 +158,47 @@ void loop()
   processBME680();
   processMQ2();
   //
+  setAllocationSite(ALLOC_SITE_REGISTRY);
+  if (beginStage(STAGE_ACQUISITION))
+  {
+    pollSensorRegistry();
+    endStage(STAGE_ACQUISITION);
+  }
+  setAllocationSite(ALLOC_SITE_DISPLAY);
+  displaySensorRegistryPages();
+  //
   displayWaveAnimation();
 
   // Publish updated sensor readings to MQTT
-  publishMQTTReadings(client, temperature, humidity, pressure, gas, altitude, lpg, co, smoke, sound);
+  setAllocationSite(ALLOC_SITE_PUBLISH);
+  beginPowerSection(PM_SECTION_NETWORK);
+  if (networkReady && beginStage(STAGE_PUBLISH))
+  {
+    publishMQTTReadings(client);
+    publishMQTTSoundSpectrum(client);
+    publishMQTTRoomReadings(client);
+    publishMQTTWatchdogEvent(client);
+    publishMQTTMemoryAlerts(client);
+
+    // Publish rolling aggregates and diagnostics at their own, lower rate
+    static unsigned long lastStatsPublish = 0;
+    if (millis() - lastStatsPublish >= getStatsPublishMs())
+    {
+      lastStatsPublish = millis();
+      publishMQTTStatistics(client);
+      publishMQTTDiagnostics(client);
+      publishMQTTWatchdog(client);
+      publishMQTTMemory(client);
+    }
+    endStage(STAGE_PUBLISH);
+  }
+  endPowerSection(PM_SECTION_NETWORK);
 
   // Gif plays as delay
+  setAllocationSite(ALLOC_SITE_DISPLAY);
   displayParrotGif();
+
+  setAllocationSite(ALLOC_SITE_OTHER);
+  endLoopTiming();
+  endPowerCycle();
 }
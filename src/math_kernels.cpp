@@ -0,0 +1,127 @@
+#include "math_kernels.h"
+#include <math.h>
+#include <string.h>
+
+static float altitudeTable[ALT_TABLE_SIZE]; // Altitude (m) at ALT_TABLE_MIN_HPA + i * step
+static float log2Table[POW_TABLE_SIZE];     // log2(1 + i / 64)
+static float exp2Table[POW_TABLE_SIZE];     // 2^(i / 64)
+
+/*
+ * ==================================================
+ * FUNCTION: INITIALIZE MATH KERNELS
+ * ==================================================
+ * Description:
+ *   Fills the lookup tables once with the exact float functions. Must run
+ *   before the first sensor reading.
+ */
+
+void initializeMathKernels()
+{
+    for (int i = 0; i < ALT_TABLE_SIZE; i++)
+    {
+        float pressure = ALT_TABLE_MIN_HPA + i * ALT_TABLE_STEP_HPA;
+        altitudeTable[i] = 44330.0f * (1.0f - powf(pressure / SEALEVELPRESSURE_HPA, 0.1903f));
+    }
+    for (int i = 0; i < POW_TABLE_SIZE; i++)
+    {
+        float x = (float)i / (1 << POW_TABLE_BITS);
+        log2Table[i] = log2f(1.0f + x);
+        exp2Table[i] = exp2f(x);
+    }
+}
+
+/*
+ * ==================================================
+ * FUNCTION: ALTITUDE FROM PRESSURE
+ * ==================================================
+ * Description:
+ *   Barometric altitude (m) for a pressure in hPa at SEALEVELPRESSURE_HPA,
+ *   by linear interpolation in the altitude table.
+ */
+
+float altitudeFromPressure(float pressureHpa)
+{
+    float position = (pressureHpa - ALT_TABLE_MIN_HPA) * (1.0f / ALT_TABLE_STEP_HPA);
+    int index = position < 0 ? 0 : (int)position;
+    if (index > ALT_TABLE_SIZE - 2)
+    {
+        index = ALT_TABLE_SIZE - 2;
+    }
+    float fraction = position - index;
+    return altitudeTable[index] + fraction * (altitudeTable[index + 1] - altitudeTable[index]);
+}
+
+/*
+ * ==================================================
+ * FUNCTION: FAST LOG2 / EXP2
+ * ==================================================
+ * Description:
+ *   log2 splits the float into exponent and mantissa and interpolates the
+ *   mantissa in log2Table; x must be a positive, finite, normal float.
+ *   exp2 splits x into integer and fraction, interpolates 2^fraction in
+ *   exp2Table and builds the power of two directly in the exponent bits.
+ */
+
+float fastLog2(float x)
+{
+    uint32_t bits;
+    memcpy(&bits, &x, sizeof(bits));
+
+    int32_t exponent = (int32_t)((bits >> 23) & 0xFF) - 127;
+    uint32_t mantissa = bits & 0x7FFFFF;
+    uint32_t index = mantissa >> (23 - POW_TABLE_BITS);
+    float fraction = (mantissa & ((1u << (23 - POW_TABLE_BITS)) - 1)) * (1.0f / (1u << (23 - POW_TABLE_BITS)));
+
+    return exponent + log2Table[index] + fraction * (log2Table[index + 1] - log2Table[index]);
+}
+
+float fastExp2(float x)
+{
+    if (x < -126.0f)
+    {
+        return 0.0f;
+    }
+    if (x >= 128.0f)
+    {
+        return INFINITY;
+    }
+
+    float whole = floorf(x);
+    float position = (x - whole) * (1 << POW_TABLE_BITS);
+    int index = (int)position;
+    float fraction = position - index;
+    float mantissa = exp2Table[index] + fraction * (exp2Table[index + 1] - exp2Table[index]);
+
+    uint32_t scaleBits = (uint32_t)((int32_t)whole + 127) << 23;
+    float scale;
+    memcpy(&scale, &scaleBits, sizeof(scale));
+    return mantissa * scale;
+}
+
+/*
+ * ==================================================
+ * FUNCTION: POWER LAW PPM
+ * ==================================================
+ * Description:
+ *   a * ratio^b evaluated as a * 2^(b * log2(ratio)). Callers take
+ *   log2(ratio) once and reuse it for every gas curve of the sensor.
+ */
+
+float powerLawPpm(float log2Ratio, float a, float b)
+{
+    return a * fastExp2(b * log2Ratio);
+}
+
+/*
+ * ==================================================
+ * FUNCTION: SOUND DECIBELS FROM RAW
+ * ==================================================
+ * Description:
+ *   Integer sound level for a raw KY-038 reading, identical to
+ *   map(raw, 0, 1023, 30, 100) for 0 <= raw <= 4095 without the division.
+ */
+
+int32_t soundDecibelsFromRaw(int32_t raw)
+{
+    return SOUND_DB_MIN + (int32_t)(((uint32_t)raw * SOUND_DB_MULTIPLIER) >> SOUND_DB_SHIFT);
+}
@@ -0,0 +1,385 @@
+#include "memory_monitor.h"
+#include "static_arena.h"
+#include <Arduino.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <esp_rom_sys.h>
+#include <string.h>
+#include <stdlib.h>
+
+#define MEMORY_TASK_NAME(name) name,
+const char *const MEMORY_TASK_NAMES[NUM_MEMORY_TASKS] = {MEMORY_TASK_TABLE(MEMORY_TASK_NAME)};
+#undef MEMORY_TASK_NAME
+
+#define ALLOC_SITE_NAME(id, name, sealed) name,
+const char *const ALLOC_SITE_NAMES[NUM_ALLOC_SITES] = {ALLOC_SITE_TABLE(ALLOC_SITE_NAME)};
+#undef ALLOC_SITE_NAME
+
+#define ALLOC_SITE_SEALED(id, name, sealed) sealed,
+static const bool ALLOC_SITE_SEALED_FLAGS[NUM_ALLOC_SITES] = {ALLOC_SITE_TABLE(ALLOC_SITE_SEALED)};
+#undef ALLOC_SITE_SEALED
+
+const char *const MEMORY_ALERT_NAMES[NUM_MEMORY_ALERTS] = {"heap_low", "block_small", "fragmented", "stack_low"};
+
+static esp_timer_handle_t sampleTimer = NULL;
+static MemoryStats memoryStats;
+static portMUX_TYPE memoryMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Allocation counters. Updated with atomics rather than memoryMux: malloc
+// also runs before the scheduler starts and inside other critical sections.
+static AllocationCount allocationCounts[NUM_ALLOC_SITES];
+static volatile AllocationSite currentSite = ALLOC_SITE_OTHER;
+static TaskHandle_t loopTaskHandle = NULL;
+
+// Static allocation mode. Entry 0 is loop(); entries are only added
+// during setup(), so the allocators read them without a lock.
+struct WatchedTask
+{
+    TaskHandle_t task;
+    uint8_t permitDepth; // > 0 while permitHeapAllocation(true) is in effect
+};
+static WatchedTask watchedTasks[MEM_MAX_WATCHED_TASKS + 1];
+static volatile bool heapSealed = false;
+static StrayAllocations strays;
+
+/*
+ * ==================================================
+ * FUNCTION: SAMPLE STACKS
+ * ==================================================
+ * Description:
+ *   Unused stack (high-water mark, bytes on ESP-IDF) of every task in
+ *   MEMORY_TASK_TABLE, looked up by name so library tasks are covered too.
+ */
+
+static void sampleStacks(int32_t stackFree[NUM_MEMORY_TASKS])
+{
+    for (int t = 0; t < NUM_MEMORY_TASKS; t++)
+    {
+        TaskHandle_t task = xTaskGetHandle(MEMORY_TASK_NAMES[t]);
+        stackFree[t] = task != NULL ? (int32_t)uxTaskGetStackHighWaterMark(task) : -1;
+    }
+}
+
+/*
+ * ==================================================
+ * FUNCTION: SAMPLE MEMORY
+ * ==================================================
+ * Description:
+ *   esp_timer callback: samples free heap and the largest free block,
+ *   tracks their lows and the fragmentation (the share of free heap that
+ *   is not in the largest block), checks the stacks every
+ *   MEM_STACK_CHECK_EVERY samples and evaluates the alert thresholds.
+ *   Alert changes are logged.
+ */
+
+static void sampleMemory(void *)
+{
+    static uint32_t sampleCount = 0;
+
+    uint32_t freeHeap = ESP.getFreeHeap();
+    uint32_t largestBlock = ESP.getMaxAllocHeap();
+    uint32_t minFreeHeap = ESP.getMinFreeHeap();
+    uint8_t fragmentationPct = freeHeap > 0 ? 100 - (uint64_t)largestBlock * 100 / freeHeap : 100;
+
+    bool checkStacks = sampleCount++ % MEM_STACK_CHECK_EVERY == 0;
+    int32_t stackFree[NUM_MEMORY_TASKS];
+    if (checkStacks)
+    {
+        sampleStacks(stackFree);
+    }
+
+    portENTER_CRITICAL(&memoryMux);
+    MemoryStats &stats = memoryStats;
+    bool first = stats.minLargestBlock == 0;
+    stats.freeHeap = freeHeap;
+    stats.minFreeHeap = minFreeHeap;
+    stats.largestBlock = largestBlock;
+    if (first || largestBlock < stats.minLargestBlock)
+    {
+        stats.minLargestBlock = largestBlock;
+    }
+    stats.fragmentationPct = fragmentationPct;
+    if (fragmentationPct > stats.maxFragmentationPct)
+    {
+        stats.maxFragmentationPct = fragmentationPct;
+    }
+    if (checkStacks)
+    {
+        memcpy(stats.stackFree, stackFree, sizeof(stats.stackFree));
+    }
+
+    uint8_t alerts = 0;
+    if (freeHeap < MEM_ALERT_FREE_BYTES)
+    {
+        alerts |= MEM_ALERT_HEAP_LOW;
+    }
+    if (largestBlock < MEM_ALERT_BLOCK_BYTES)
+    {
+        alerts |= MEM_ALERT_BLOCK_SMALL;
+    }
+    if (fragmentationPct > MEM_ALERT_FRAGMENTATION_PCT)
+    {
+        alerts |= MEM_ALERT_FRAGMENTED;
+    }
+    for (int t = 0; t < NUM_MEMORY_TASKS; t++)
+    {
+        if (stats.stackFree[t] >= 0 && stats.stackFree[t] < MEM_ALERT_STACK_BYTES)
+        {
+            alerts |= MEM_ALERT_STACK_LOW;
+        }
+    }
+    uint8_t changed = alerts ^ stats.alerts;
+    stats.alerts = alerts;
+    portEXIT_CRITICAL(&memoryMux);
+
+    for (int a = 0; a < NUM_MEMORY_ALERTS; a++)
+    {
+        if (changed & (1 << a))
+        {
+            logPrintf("Memory alert %s %s (free %lu, largest %lu, %u%% fragmented)\n", MEMORY_ALERT_NAMES[a],
+                      (alerts & (1 << a)) ? "raised" : "cleared", (unsigned long)freeHeap,
+                      (unsigned long)largestBlock, fragmentationPct);
+        }
+    }
+}
+
+/*
+ * ==================================================
+ * FUNCTION: INITIALIZE MEMORY MONITOR
+ * ==================================================
+ * Description:
+ *   Takes a first sample and starts periodic sampling. Must be called from
+ *   setup(): the calling task is the one allocations are attributed for.
+ */
+
+void initializeMemoryMonitor()
+{
+    loopTaskHandle = xTaskGetCurrentTaskHandle();
+    watchedTasks[0].task = loopTaskHandle;
+    for (int t = 0; t < NUM_MEMORY_TASKS; t++)
+    {
+        memoryStats.stackFree[t] = -1;
+    }
+    sampleMemory(NULL);
+
+    esp_timer_create_args_t timerArgs = {};
+    timerArgs.callback = sampleMemory;
+    timerArgs.dispatch_method = ESP_TIMER_TASK;
+    timerArgs.name = "memory";
+    esp_timer_create(&timerArgs, &sampleTimer);
+    esp_timer_start_periodic(sampleTimer, MEM_SAMPLE_INTERVAL_MS * 1000ULL);
+
+#ifdef MEMORY_ALLOC_HOOK
+    Serial.println("Memory monitor started (allocation hook on)");
+#else
+    Serial.println("Memory monitor started");
+#endif
+}
+
+/*
+ * ==================================================
+ * FUNCTION: SET ALLOCATION SITE
+ * ==================================================
+ * Description:
+ *   Called by loop() as it moves from one part of the cycle to the next;
+ *   allocations made by loop() count against the latest site.
+ */
+
+void setAllocationSite(AllocationSite site)
+{
+    currentSite = site;
+}
+
+/*
+ * ==================================================
+ * FUNCTION: GET MEMORY STATS / ALLOCATION COUNT
+ * ==================================================
+ * Description:
+ *   Snapshots for MQTT and /metrics. Allocation counts stay zero unless
+ *   the firmware is built with MEMORY_ALLOC_HOOK.
+ */
+
+MemoryStats getMemoryStats()
+{
+    portENTER_CRITICAL(&memoryMux);
+    MemoryStats stats = memoryStats;
+    portEXIT_CRITICAL(&memoryMux);
+    return stats;
+}
+
+AllocationCount getAllocationCount(AllocationSite site)
+{
+    AllocationCount count;
+    count.calls = __atomic_load_n(&allocationCounts[site].calls, __ATOMIC_RELAXED);
+    count.bytes = __atomic_load_n(&allocationCounts[site].bytes, __ATOMIC_RELAXED);
+    return count;
+}
+
+/*
+ * ==================================================
+ * FUNCTION: WATCH TASK ALLOCATIONS
+ * ==================================================
+ * Description:
+ *   Adds a task to the static allocation check: once the heap is sealed,
+ *   its allocations are strays. For the firmware's own tasks, from
+ *   setup() only. Tasks beyond MEM_MAX_WATCHED_TASKS are ignored.
+ */
+
+void watchTaskAllocations(TaskHandle_t task)
+{
+    for (int i = 1; i <= MEM_MAX_WATCHED_TASKS; i++)
+    {
+        if (watchedTasks[i].task == NULL || watchedTasks[i].task == task)
+        {
+            watchedTasks[i].task = task;
+            return;
+        }
+    }
+    logPrintf("Memory monitor: too many watched tasks, %s not checked\n", pcTaskGetName(task));
+}
+
+/*
+ * ==================================================
+ * FUNCTION: PERMIT HEAP ALLOCATION
+ * ==================================================
+ * Description:
+ *   Allows the calling task to allocate after the seal until the matching
+ *   permitHeapAllocation(false). Used around peripheral re-initialisation,
+ *   where the drivers allocate in begin(). Calls nest.
+ */
+
+void permitHeapAllocation(bool permit)
+{
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    for (int i = 0; i <= MEM_MAX_WATCHED_TASKS; i++)
+    {
+        if (watchedTasks[i].task == task)
+        {
+            if (permit)
+            {
+                watchedTasks[i].permitDepth++;
+            }
+            else if (watchedTasks[i].permitDepth > 0)
+            {
+                watchedTasks[i].permitDepth--;
+            }
+            return;
+        }
+    }
+}
+
+/*
+ * ==================================================
+ * FUNCTION: SEAL HEAP
+ * ==================================================
+ * Description:
+ *   End of setup(): from here on, allocations at sealed sites and from
+ *   watched tasks are strays. Does nothing without STATIC_ALLOCATION_MODE.
+ */
+
+void sealHeap()
+{
+#ifdef STATIC_ALLOCATION_MODE
+    heapSealed = true;
+    logPrintf("Heap sealed: %lu bytes free, static arena %u bytes\n", (unsigned long)ESP.getFreeHeap(),
+              (unsigned)sizeof(StaticArena));
+#endif
+}
+
+/*
+ * ==================================================
+ * FUNCTION: GET STRAY ALLOCATIONS
+ * ==================================================
+ * Description:
+ *   Strays since the seal. The details of the latest one may be torn if
+ *   two tasks stray at the same moment.
+ */
+
+StrayAllocations getStrayAllocations()
+{
+    StrayAllocations copy = strays;
+    copy.count = __atomic_load_n(&strays.count, __ATOMIC_RELAXED);
+    return copy;
+}
+
+#ifdef MEMORY_ALLOC_HOOK
+
+#ifdef STATIC_ALLOCATION_MODE
+// Record an allocation made after the seal if the task is watched and not
+// permitted. Runs inside malloc: ROM printf only, no locks.
+static void checkStrayAllocation(TaskHandle_t task, AllocationSite site, size_t size)
+{
+    for (int i = 0; i <= MEM_MAX_WATCHED_TASKS; i++)
+    {
+        if (watchedTasks[i].task != task)
+        {
+            continue;
+        }
+        if (watchedTasks[i].permitDepth > 0)
+        {
+            return;
+        }
+        const char *taskName = pcTaskGetName(task);
+        strays.lastSize = (uint32_t)size;
+        strays.lastSite = site;
+        strncpy(strays.lastTask, taskName, sizeof(strays.lastTask) - 1);
+#ifdef STATIC_ALLOC_TRAP
+        esp_rom_printf("Stray heap allocation trapped: %u bytes in %s at %s\n", (unsigned)size, taskName,
+                       ALLOC_SITE_NAMES[site]);
+        abort();
+#else
+        if (__atomic_fetch_add(&strays.count, 1, __ATOMIC_RELAXED) == 0)
+        {
+            esp_rom_printf("Stray heap allocation: %u bytes in %s at %s\n", (unsigned)size, taskName,
+                           ALLOC_SITE_NAMES[site]);
+        }
+#endif
+        return;
+    }
+}
+#endif
+
+// Count one allocation against loop()'s current site or "tasks"
+static void countAllocation(size_t size)
+{
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    AllocationSite site = (loopTaskHandle != NULL && task == loopTaskHandle) ? currentSite : ALLOC_SITE_TASKS;
+    __atomic_fetch_add(&allocationCounts[site].calls, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&allocationCounts[site].bytes, (uint32_t)size, __ATOMIC_RELAXED);
+#ifdef STATIC_ALLOCATION_MODE
+    if (heapSealed && ALLOC_SITE_SEALED_FLAGS[site])
+    {
+        checkStrayAllocation(task, site, size);
+    }
+#endif
+}
+
+// Linker-wrapped allocators (-Wl,--wrap=...): count, then allocate. new and
+// String end up in malloc/realloc, so they are covered as well.
+extern "C"
+{
+    void *__real_malloc(size_t size);
+    void *__real_calloc(size_t count, size_t size);
+    void *__real_realloc(void *ptr, size_t size);
+
+    void *__wrap_malloc(size_t size)
+    {
+        countAllocation(size);
+        return __real_malloc(size);
+    }
+
+    void *__wrap_calloc(size_t count, size_t size)
+    {
+        countAllocation(count * size);
+        return __real_calloc(count, size);
+    }
+
+    void *__wrap_realloc(void *ptr, size_t size)
+    {
+        countAllocation(size);
+        return __real_realloc(ptr, size);
+    }
+}
+
+#endif
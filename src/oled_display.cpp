@@ -2,6 +2,160 @@
 #include "helper_functions.h"
 #include "bitmap_logo.h"
 #include "bitmap_parrot.h"
+#include "power_management.h"
+#include "sensor_registry.h"
+#include "runtime_config.h"
+#include "stage_watchdog.h"
+#include "ota_setup.h"
+#include "i2c_bus.h"
+#include "static_arena.h"
+#include "memory_monitor.h"
+#include "sampling_scheduler.h"
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+static TaskHandle_t frameWriter = NULL;
+static StaticSemaphore_t frameIdleBuffer;
+static SemaphoreHandle_t frameIdle = NULL; // Given while no frame is being sent
+static DisplayWriterStats writerStats;
+static portMUX_TYPE writerMux = portMUX_INITIALIZER_UNLOCKED;
+
+static_assert(CFG_DISPLAY_PAGE_MAX_MS < WDT_TASK_TIMEOUT_S * 1000, "A display page must not outlast the task watchdog");
+
+/*
+ * ==================================================
+ * FUNCTION: WRITE FRAME
+ * ==================================================
+ * Description:
+ *   Sends a frame to the OLED page by page, each page one I2C transaction,
+ *   at full CPU clock. The whole frame is a watchdog render stage. Stops
+ *   at the first page the bus or the display refuses.
+ */
+
+static void writeFrame(const uint8_t *frame)
+{
+    if (!beginStage(STAGE_RENDER))
+    {
+        return;
+    }
+    beginPowerSection(PM_SECTION_RENDER);
+    int64_t startUs = esp_timer_get_time();
+    bool sent = true;
+    for (uint8_t page = 0; page < SCREEN_HEIGHT / 8 && sent; page++)
+    {
+        sent = acquireI2CBus(I2C_CLIENT_DISPLAY);
+        if (sent)
+        {
+            sent = display.writePage(page, frame + page * SCREEN_WIDTH);
+            releaseI2CBus(I2C_CLIENT_DISPLAY);
+        }
+    }
+    uint32_t frameUs = (uint32_t)(esp_timer_get_time() - startUs);
+    endPowerSection(PM_SECTION_RENDER);
+    endStage(STAGE_RENDER);
+
+    portENTER_CRITICAL(&writerMux);
+    if (sent)
+    {
+        writerStats.frames++;
+        writerStats.lastFrameUs = frameUs;
+    }
+    else
+    {
+        writerStats.droppedFrames++;
+    }
+    portEXIT_CRITICAL(&writerMux);
+}
+
+/*
+ * ==================================================
+ * FUNCTION: DISPLAY WRITER TASK
+ * ==================================================
+ * Description:
+ *   Sends each frame handed over by showFrame(), then marks the transfer
+ *   buffer free again.
+ */
+
+static void displayWriterTask(void *)
+{
+    for (;;)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        writeFrame(staticArena.displayTransfer);
+        xSemaphoreGive(frameIdle);
+    }
+}
+
+/*
+ * ==================================================
+ * FUNCTION: START DISPLAY WRITER
+ * ==================================================
+ * Description:
+ *   Starts the frame writer on the sampler core, so a sampler waiting for
+ *   the bus takes it over as soon as a page is done. Frames shown before
+ *   this are sent by the caller.
+ */
+
+void startDisplayWriter()
+{
+    frameIdle = xSemaphoreCreateBinaryStatic(&frameIdleBuffer);
+    xSemaphoreGive(frameIdle);
+    xTaskCreatePinnedToCore(displayWriterTask, "display", DISPLAY_WRITER_STACK, NULL, DISPLAY_WRITER_PRIORITY,
+                            &frameWriter, SAMPLER_CORE);
+    watchTaskAllocations(frameWriter);
+}
+
+/*
+ * ==================================================
+ * FUNCTION: GET DISPLAY WRITER STATS
+ * ==================================================
+ * Description:
+ *   Snapshot of the frame writer counters.
+ */
+
+DisplayWriterStats getDisplayWriterStats()
+{
+    portENTER_CRITICAL(&writerMux);
+    DisplayWriterStats stats = writerStats;
+    portEXIT_CRITICAL(&writerMux);
+    return stats;
+}
+
+/*
+ * ==================================================
+ * FUNCTION: SHOW FRAME
+ * ==================================================
+ * Description:
+ *   Hands the frame buffer to the writer task and returns; drawing the
+ *   next frame can start at once. Waits for the previous frame first, up
+ *   to DISPLAY_FRAME_WAIT_MS. Skipped while an OTA update is received.
+ *   Feeds loop()'s task watchdog, which sees no stage while pages are up.
+ */
+
+static void showFrame()
+{
+    feedLoopWatchdog();
+    if (isOTAInProgress())
+    {
+        return; // Leave the CPU and the bus to the update
+    }
+    if (frameWriter == NULL)
+    {
+        writeFrame(display.getBuffer());
+        return;
+    }
+    if (xSemaphoreTake(frameIdle, pdMS_TO_TICKS(DISPLAY_FRAME_WAIT_MS)) != pdTRUE)
+    {
+        portENTER_CRITICAL(&writerMux);
+        writerStats.droppedFrames++;
+        portEXIT_CRITICAL(&writerMux);
+        return;
+    }
+    memcpy(staticArena.displayTransfer, display.getBuffer(), DISPLAY_FRAME_BYTES);
+    xTaskNotifyGive(frameWriter);
+}
 
 /*
  * ==================================================
@@ -16,7 +170,7 @@ void displayWelcomeLogo()
 {
     display.clearDisplay();
     display.drawBitmap(0, 0, bitmap_logo, SCREEN_WIDTH, SCREEN_HEIGHT, 1);
-    display.display();
+    showFrame();
     delay(5000);
 }
 
@@ -33,52 +187,52 @@ void displayParrotGif()
     // parrot 1
     display.clearDisplay();
     display.drawBitmap(0, 0, bitmap_parrot1, SCREEN_WIDTH, SCREEN_HEIGHT, 1);
-    display.display();
+    showFrame();
     delay(500);
     // parrot 2
     display.clearDisplay();
     display.drawBitmap(0, 0, bitmap_parrot2, SCREEN_WIDTH, SCREEN_HEIGHT, 1);
-    display.display();
+    showFrame();
     delay(500);
     // parrot 3
     display.clearDisplay();
     display.drawBitmap(0, 0, bitmap_parrot3, SCREEN_WIDTH, SCREEN_HEIGHT, 1);
-    display.display();
+    showFrame();
     delay(500);
     // parrot 4
     display.clearDisplay();
     display.drawBitmap(0, 0, bitmap_parrot4, SCREEN_WIDTH, SCREEN_HEIGHT, 1);
-    display.display();
+    showFrame();
     delay(500);
     // parrot 5
     display.clearDisplay();
     display.drawBitmap(0, 0, bitmap_parrot5, SCREEN_WIDTH, SCREEN_HEIGHT, 1);
-    display.display();
+    showFrame();
     delay(500);
     // parrot 6
     display.clearDisplay();
     display.drawBitmap(0, 0, bitmap_parrot6, SCREEN_WIDTH, SCREEN_HEIGHT, 1);
-    display.display();
+    showFrame();
     delay(500);
     // parrot 7
     display.clearDisplay();
     display.drawBitmap(0, 0, bitmap_parrot7, SCREEN_WIDTH, SCREEN_HEIGHT, 1);
-    display.display();
+    showFrame();
     delay(500);
     // parrot 8
     display.clearDisplay();
     display.drawBitmap(0, 0, bitmap_parrot8, SCREEN_WIDTH, SCREEN_HEIGHT, 1);
-    display.display();
+    showFrame();
     delay(500);
     // parrot 9
     display.clearDisplay();
     display.drawBitmap(0, 0, bitmap_parrot9, SCREEN_WIDTH, SCREEN_HEIGHT, 1);
-    display.display();
+    showFrame();
     delay(500);
     // parrot 10
     display.clearDisplay();
     display.drawBitmap(0, 0, bitmap_parrot10, SCREEN_WIDTH, SCREEN_HEIGHT, 1);
-    display.display();
+    showFrame();
     delay(500);
 }
 
@@ -100,197 +254,104 @@ void displayWaveAnimation()
             int y = 32 + 16 * sin(2 * 3.14 * x / 64 + t / 10.0); // Sine wave
             display.drawPixel(x, y, 1);
         }
-        display.display();
+        showFrame();
         delay(50);
     }
 }
 
 /*
  * ==================================================
- * FUNCTION: DISPLAY BME680 READINGS
+ * FUNCTION: DISPLAY SENSOR READINGS
  * ==================================================
  * Description:
- *   Displays sensor readings from the BME680 on the OLED display. The readings
- *   include temperature, humidity, pressure, gas resistance, and altitude,
- *   formatted for clarity.
+ *   Shows a title page for one sensor, then its channels two per page:
+ *   the label in small text (marked HIGH above the warning threshold) and
+ *   the reading with its unit in large text. Each page stays up for the
+ *   configured display.page_ms (5 seconds by default).
  */
 
-void displayBME680Readings(float temperature, float humidity, float pressure, float gas, float altitude)
+void displaySensorReadings(SensorGroup group)
 {
-
-    // Display BME-680 Sensor
+    // Title page
     display.clearDisplay();
     display.setTextSize(3);
     display.setTextColor(1);
     display.setCursor(0, 10);
-    display.print("BME680");
+    display.print(SENSOR_GROUP_LABELS[group]);
     display.setTextSize(2);
-    display.setTextColor(1);
     display.setCursor(0, 45);
     display.print("SENSOR");
 
-    display.display();
-    delay(5000);
-
-    // Display Temperature
-    display.clearDisplay();
-    display.setTextSize(1);
-    display.setTextColor(1);
-    display.setCursor(0, 0);
-    display.print("Temperature:");
-    display.setTextSize(2);
-    display.setCursor(0, 10);
-    display.printf("%.1f C", temperature);
-    display.display();
-
-    // Display Humidity
-    display.setTextSize(1);
-    display.setTextColor(1);
-    display.setCursor(0, 35);
-    display.print("Relative Humidity:");
-    display.setTextSize(2);
-    display.setCursor(0, 45);
-    display.printf("%.1f %%", humidity);
-
-    display.display();
-    delay(5000);
+    showFrame();
+    delay(getDisplayPageMs());
 
-    // Display Pressure
-    display.clearDisplay();
-    display.setTextSize(1);
-    display.setTextColor(1);
-    display.setCursor(0, 0);
-    display.print("Barometric Pressure:");
-    display.setTextSize(2);
-    display.setCursor(0, 10);
-    display.printf("%.1f hPa", pressure);
-    display.display();
-
-    // Display Gas Resistance
-    display.setTextSize(1);
-    display.setTextColor(1);
-    display.setCursor(0, 35);
-    display.print("Gas Resistance:");
-    display.setTextSize(2);
-    display.setCursor(0, 45);
-    display.printf("%.1f kOhms", gas);
-
-    display.display();
-    delay(5000);
-
-    // Display Altitude
-    display.clearDisplay();
-    display.setTextSize(1);
-    display.setTextColor(1);
-    display.setCursor(0, 0);
-    display.print("Altitude:");
-    display.setTextSize(2);
-    display.setCursor(0, 10);
-    display.printf("%.1f m", altitude);
-
-    display.display();
-    delay(5000);
-}
-
-/*
- * ==================================================
- * FUNCTION: DISPLAY MQ-2 READINGS
- * ==================================================
- * Description:
- *   Displays sensor readings from the MQ-2 sensor on the OLED display. The
- *   readings include LPG, CO, and smoke levels, shown with clear labeling.
- */
-
-void displayMQ2Readings(float lpg, float co, float smoke)
-{
-
-    // Display MQ-2 Sensor
-    display.clearDisplay();
-    display.setTextSize(3);
-    display.setTextColor(1);
-    display.setCursor(0, 10);
-    display.print("MQ-2");
-    display.setTextSize(2);
-    display.setTextColor(1);
-    display.setCursor(0, 45);
-    display.print("SENSOR");
-
-    display.display();
-    delay(5000);
-
-    // LPG Reading
-    display.clearDisplay();
-    display.setTextSize(1);
-    display.setTextColor(1);
-    display.setCursor(0, 0);
-    display.print("LPG:");
-    display.setTextSize(2);
-    display.setCursor(0, 10);
-    display.printf("%.1f ppm", lpg);
-
-    // CO Reading
-    display.setTextSize(1);
-    display.setCursor(0, 35);
-    display.print("CO:");
-    display.setTextSize(2);
-    display.setCursor(0, 45);
-    display.printf("%.1f ppm", co);
+    char reading[24];
+    int slot = 0;
+    for (int ch = 0; ch < NUM_CHANNELS; ch++)
+    {
+        if (CHANNELS[ch].group != group)
+        {
+            continue;
+        }
+        if (slot == 0)
+        {
+            display.clearDisplay();
+        }
 
-    display.display();
-    delay(5000);
+        int top = slot * 35;
+        display.setTextSize(1);
+        display.setCursor(0, top);
+        display.printf("%s:%s", CHANNELS[ch].label, getChannelLevel((SensorChannel)ch) != LEVEL_NORMAL ? " HIGH" : "");
+        formatChannelReading((SensorChannel)ch, reading, sizeof(reading));
+        display.setTextSize(2);
+        display.setCursor(0, top + 10);
+        display.print(reading);
 
-    // Smoke Reading
-    display.clearDisplay();
-    display.setTextSize(1);
-    display.setTextColor(1);
-    display.setCursor(0, 0);
-    display.print("Smoke:");
-    display.setTextSize(2);
-    display.setCursor(0, 10);
-    display.printf("%.1f ppm", smoke);
-
-    display.display();
-    delay(5000);
+        if (++slot == 2)
+        {
+            showFrame();
+            delay(getDisplayPageMs());
+            slot = 0;
+        }
+    }
+    if (slot != 0)
+    {
+        showFrame();
+        delay(getDisplayPageMs());
+    }
 }
 
 /*
  * ==================================================
- *  FUNCTION: DISPLAY KY-038 READING
+ * FUNCTION: DISPLAY SENSOR REGISTRY PAGES
  * ==================================================
  * Description:
- *   Displays the sound level from the KY-038 sensor on the OLED display. The
- *   reading includes the sound level in decibels (dB) and indicates whether
- *   the environment is LOUD or Normal.
+ *   Shows one page per registered sensor with a reading: the room and
+ *   sensor type as a title, then one line per value.
  */
 
-void displaySoundSensorReading(float soundLevel)
+void displaySensorRegistryPages()
 {
-    float soundDecibels = convertRawSoundToDecibels(soundLevel);
-
-    // Display KY-038 Sensor
-    display.clearDisplay();
-    display.setTextSize(3);
-    display.setTextColor(1);
-    display.setCursor(0, 10);
-    display.print("KY-038");
-    display.setTextSize(2);
-    display.setCursor(0, 45);
-    display.print("SENSOR");
-
-    display.display();
-    delay(5000);
-
-    // Sound Reading
-    display.clearDisplay();
-    display.setTextSize(1);
-    display.setCursor(0, 0);
-    display.print("Sound Level:");
-    display.setCursor(0, 15);
-    display.printf("Level: %.1f dB", soundDecibels);
-    display.setTextSize(2);
-    display.setCursor(0, 35);
-    display.print(soundDecibels > LOUD_THRESHOLD ? "LOUD" : "Normal");
+    for (uint8_t i = 0; i < getSensorInstanceCount(); i++)
+    {
+        const SensorInstance &instance = getSensorInstance(i);
+        if (!instance.present || !instance.valid)
+        {
+            continue;
+        }
+        SensorType type = instance.config.type;
 
-    display.display();
-    delay(5000);
+        display.clearDisplay();
+        display.setTextSize(1);
+        display.setTextColor(1);
+        display.setCursor(0, 0);
+        display.printf("%s %s", instance.config.room, getSensorTypeName(type));
+        for (uint8_t v = 0; v < getSensorValueCount(type); v++)
+        {
+            display.setCursor(0, 14 + v * 10);
+            display.printf("%-12s %.1f", getSensorValueName(type, v), instance.values[v]);
+        }
+        showFrame();
+        delay(getDisplayPageMs());
+    }
 }
@@ -0,0 +1,265 @@
+#include "ota_pack.h"
+#include "ota_setup.h"
+#include "static_arena.h"
+#include <Arduino.h>
+#include <Update.h>
+#include <string.h>
+#include <stdlib.h>
+#include <esp_idf_version.h>
+#include <mbedtls/version.h>
+#include <mbedtls/sha256.h>
+
+// tinfl from the ROM: inflate without adding code to the image
+#if ESP_IDF_VERSION_MAJOR >= 5
+#include <miniz.h>
+#else
+#include <esp32/rom/miniz.h>
+#endif
+
+// mbedtls 3 dropped the _ret suffix
+#if MBEDTLS_VERSION_NUMBER >= 0x03000000
+#define mbedtls_sha256_starts_ret mbedtls_sha256_starts
+#define mbedtls_sha256_update_ret mbedtls_sha256_update
+#define mbedtls_sha256_finish_ret mbedtls_sha256_finish
+#endif
+
+const char *const OTA_PACK_STATUS_NAMES[NUM_OTA_PACK_STATUSES] = {
+    "ok", "busy", "bad header", "no memory", "flash error", "corrupt", "truncated", "hash mismatch"};
+
+// Inflate state of one update, allocated for its duration only (~15 kB)
+struct PackedOtaState
+{
+    tinfl_decompressor inflator;
+    uint8_t window[OTA_PACK_WINDOW_SIZE]; // Wrapping inflate output, also the back-reference window
+    size_t windowOffset;
+    OtaPackHeader header;
+    size_t headerBytes; // Header bytes received so far
+    uint32_t packedSeen;
+    uint32_t imageSeen;
+    bool inflated; // The zlib stream ended (and its Adler-32 matched)
+    mbedtls_sha256_context sha;
+};
+
+static PackedOtaState *state = NULL;
+
+/*
+ * ==================================================
+ * FUNCTION: BEGIN PACKED OTA
+ * ==================================================
+ * Description:
+ *   Starts receiving a packed image: allocates the inflate state and
+ *   pauses display and LED work. The OTA partition is opened once the
+ *   header has arrived.
+ */
+
+OtaPackStatus beginPackedOTA()
+{
+    if (state != NULL || isOTAInProgress())
+    {
+        return OTA_PACK_BUSY;
+    }
+    state = (PackedOtaState *)calloc(1, sizeof(PackedOtaState));
+    if (state == NULL)
+    {
+        return OTA_PACK_NO_MEMORY;
+    }
+    tinfl_init(&state->inflator);
+    mbedtls_sha256_init(&state->sha);
+    mbedtls_sha256_starts_ret(&state->sha, 0);
+    beginOTATransfer();
+    return OTA_PACK_OK;
+}
+
+/*
+ * ==================================================
+ * FUNCTION: ABORT PACKED OTA
+ * ==================================================
+ * Description:
+ *   Drops a packed update in progress, leaving the running firmware
+ *   bootable. Safe to call when none is running.
+ */
+
+void abortPackedOTA()
+{
+    if (state == NULL)
+    {
+        return;
+    }
+    if (Update.isRunning())
+    {
+        Update.abort();
+    }
+    mbedtls_sha256_free(&state->sha);
+    free(state);
+    state = NULL;
+    endOTATransfer(false, 0, 0);
+}
+
+// Check the header and open the OTA partition for the inflated image
+static OtaPackStatus openPackedImage(const OtaPackHeader &header)
+{
+    if (header.magic != OTA_PACK_MAGIC || header.version != OTA_PACK_VERSION ||
+        header.windowBits > OTA_PACK_MAX_WINDOW_BITS || header.imageBytes == 0 || header.packedBytes == 0)
+    {
+        return OTA_PACK_BAD_HEADER;
+    }
+    if (!Update.begin(header.imageBytes, U_FLASH))
+    {
+        return OTA_PACK_FLASH_ERROR;
+    }
+    logPrintf("Packed update: %lu bytes, %lu compressed\n", (unsigned long)header.imageBytes,
+              (unsigned long)header.packedBytes);
+    return OTA_PACK_OK;
+}
+
+// Inflate one chunk of the zlib stream, hashing and flashing the output
+static OtaPackStatus inflateChunk(const uint8_t *data, size_t length)
+{
+    PackedOtaState &s = *state;
+    if (length > s.header.packedBytes - s.packedSeen)
+    {
+        return OTA_PACK_CORRUPT;
+    }
+    while (!s.inflated)
+    {
+        size_t inBytes = length;
+        size_t outBytes = OTA_PACK_WINDOW_SIZE - s.windowOffset;
+        mz_uint32 flags = TINFL_FLAG_PARSE_ZLIB_HEADER;
+        if (s.packedSeen + inBytes < s.header.packedBytes)
+        {
+            flags |= TINFL_FLAG_HAS_MORE_INPUT;
+        }
+        tinfl_status status = tinfl_decompress(&s.inflator, data, &inBytes, s.window, s.window + s.windowOffset,
+                                               &outBytes, flags);
+        data += inBytes;
+        length -= inBytes;
+        s.packedSeen += inBytes;
+
+        if (outBytes > 0)
+        {
+            if (outBytes > s.header.imageBytes - s.imageSeen)
+            {
+                return OTA_PACK_CORRUPT;
+            }
+            uint8_t *out = s.window + s.windowOffset;
+            mbedtls_sha256_update_ret(&s.sha, out, outBytes);
+            if (Update.write(out, outBytes) != outBytes)
+            {
+                return OTA_PACK_FLASH_ERROR;
+            }
+            s.imageSeen += outBytes;
+            s.windowOffset = (s.windowOffset + outBytes) & (OTA_PACK_WINDOW_SIZE - 1);
+        }
+
+        if (status == TINFL_STATUS_DONE)
+        {
+            s.inflated = true;
+        }
+        else if (status < 0)
+        {
+            return status == TINFL_STATUS_FAILED_CANNOT_MAKE_PROGRESS ? OTA_PACK_TRUNCATED : OTA_PACK_CORRUPT;
+        }
+        else if (status == TINFL_STATUS_NEEDS_MORE_INPUT && length == 0)
+        {
+            break;
+        }
+    }
+    return length == 0 ? OTA_PACK_OK : OTA_PACK_CORRUPT;
+}
+
+/*
+ * ==================================================
+ * FUNCTION: WRITE PACKED OTA
+ * ==================================================
+ * Description:
+ *   Feeds the next bytes of the packed image, in any chunk size. On an
+ *   error the update is aborted and later calls return OTA_PACK_BUSY
+ *   until the next beginPackedOTA().
+ */
+
+OtaPackStatus writePackedOTA(const uint8_t *data, size_t length)
+{
+    if (state == NULL)
+    {
+        return OTA_PACK_BUSY;
+    }
+
+    // The header may arrive split across chunks
+    PackedOtaState &s = *state;
+    if (s.headerBytes < sizeof(OtaPackHeader))
+    {
+        size_t take = sizeof(OtaPackHeader) - s.headerBytes;
+        if (take > length)
+        {
+            take = length;
+        }
+        memcpy((uint8_t *)&s.header + s.headerBytes, data, take);
+        s.headerBytes += take;
+        data += take;
+        length -= take;
+        if (s.headerBytes < sizeof(OtaPackHeader))
+        {
+            return OTA_PACK_OK;
+        }
+        OtaPackStatus status = openPackedImage(s.header);
+        if (status != OTA_PACK_OK)
+        {
+            abortPackedOTA();
+            return status;
+        }
+    }
+
+    OtaPackStatus status = length > 0 ? inflateChunk(data, length) : OTA_PACK_OK;
+    if (status != OTA_PACK_OK)
+    {
+        abortPackedOTA();
+    }
+    return status;
+}
+
+/*
+ * ==================================================
+ * FUNCTION: END PACKED OTA
+ * ==================================================
+ * Description:
+ *   After the last byte: checks that the whole stream was inflated to
+ *   exactly the announced size and that its SHA-256 matches, then marks
+ *   the new image bootable and asks for a restart. Anything else aborts.
+ */
+
+OtaPackStatus endPackedOTA()
+{
+    if (state == NULL)
+    {
+        return OTA_PACK_BUSY;
+    }
+    PackedOtaState &s = *state;
+    if (s.headerBytes < sizeof(OtaPackHeader) || !s.inflated || s.imageSeen != s.header.imageBytes ||
+        s.packedSeen != s.header.packedBytes)
+    {
+        abortPackedOTA();
+        return OTA_PACK_TRUNCATED;
+    }
+
+    uint8_t digest[32];
+    mbedtls_sha256_finish_ret(&s.sha, digest);
+    if (memcmp(digest, s.header.sha256, sizeof(digest)) != 0)
+    {
+        abortPackedOTA();
+        return OTA_PACK_HASH_MISMATCH;
+    }
+    if (!Update.end())
+    {
+        abortPackedOTA();
+        return OTA_PACK_FLASH_ERROR;
+    }
+
+    uint32_t imageBytes = s.header.imageBytes;
+    uint32_t packedBytes = sizeof(OtaPackHeader) + s.header.packedBytes;
+    mbedtls_sha256_free(&s.sha);
+    free(state);
+    state = NULL;
+    endOTATransfer(true, imageBytes, packedBytes);
+    requestOTARestart();
+    return OTA_PACK_OK;
+}
@@ -1,27 +1,70 @@
 #include "ota_setup.h"
+#include "static_arena.h"
+#include <string.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#define OTA_STATS_MAGIC 0x4F544153 // Marks otaStats as initialised since power-on
+
+static volatile bool otaInProgress = false;
+static volatile bool restartPending = false;
+static uint32_t otaStartMs = 0;
+static uint32_t otaBytes = 0;
+static UBaseType_t savedPriority = OTA_TASK_PRIORITY;
+
+// Survive the software restart that follows a successful update
+RTC_NOINIT_ATTR static uint32_t otaStatsMagic;
+RTC_NOINIT_ATTR static OtaStats otaStats;
+
+// Service task: answers the espota invite and runs the transfer itself.
+// Also restarts the device after an update that arrived over HTTP.
+static void otaServiceTask(void *)
+{
+    for (;;)
+    {
+        if (restartPending)
+        {
+            vTaskDelay(pdMS_TO_TICKS(OTA_RESTART_DELAY_MS));
+            Serial.flush();
+            ESP.restart();
+        }
+        ArduinoOTA.handle();
+        vTaskDelay(pdMS_TO_TICKS(OTA_POLL_INTERVAL_MS));
+    }
+}
 
 // Function to set up OTA
 void setupOTA()
 {
+    if (otaStatsMagic != OTA_STATS_MAGIC)
+    {
+        memset(&otaStats, 0, sizeof(otaStats));
+        otaStatsMagic = OTA_STATS_MAGIC;
+    }
+
+    // Callbacks run in the service task, which ArduinoOTA.handle() blocks
+    // for the whole transfer
     ArduinoOTA.onStart([]()
                        {
-    String type;
-    if (ArduinoOTA.getCommand() == U_FLASH) {
-      type = "sketch";
-    } else { // U_SPIFFS
-      type = "filesystem";
-    }
-    Serial.println("Start updating " + type); });
+    // Literals, not String: no heap allocation while the update starts
+    const char *type = ArduinoOTA.getCommand() == U_FLASH ? "sketch" : "filesystem"; // else U_SPIFFS
+    otaBytes = 0;
+    beginOTATransfer();
+    logPrintf("Start updating %s\n", type); });
 
+    // ArduinoOTA restarts right after this returns
     ArduinoOTA.onEnd([]()
-                     { Serial.println("\nEnd"); });
+                     { endOTATransfer(true, otaBytes, 0); });
 
     ArduinoOTA.onProgress([](unsigned int progress, unsigned int total)
-                          { Serial.printf("Progress: %u%%\r", (progress / (total / 100))); });
+                          {
+    otaBytes = progress;
+    logPrintf("Progress: %u%%\r", (progress / (total / 100))); });
 
     ArduinoOTA.onError([](ota_error_t error)
                        {
-    Serial.printf("Error[%u]: ", error);
+    endOTATransfer(false, 0, 0);
+    logPrintf("Error[%u]: ", error);
     if (error == OTA_AUTH_ERROR) {
       Serial.println("Auth Failed");
     } else if (error == OTA_BEGIN_ERROR) {
@@ -35,16 +78,65 @@ void setupOTA()
     } });
 
     // Set a password for OTA updates
-    ArduinoOTA.setPassword("Password123!");
+    ArduinoOTA.setPassword(OTA_PASSWORD);
 
     ArduinoOTA.begin();
+    xTaskCreatePinnedToCore(otaServiceTask, "ota", OTA_TASK_STACK, NULL, OTA_TASK_PRIORITY, NULL, OTA_CORE);
     Serial.println("OTA ready");
     Serial.println("IP address: ");
     Serial.println(WiFi.localIP());
 }
 
-// Function to handle OTA updates
-void handleOTA()
+// Start of an update, from the task that receives the image: pauses
+// display and LED work and raises the task to OTA_TRANSFER_PRIORITY
+void beginOTATransfer()
+{
+    otaStartMs = millis();
+    otaInProgress = true;
+    savedPriority = uxTaskPriorityGet(NULL);
+    if (savedPriority < OTA_TRANSFER_PRIORITY)
+    {
+        vTaskPrioritySet(NULL, OTA_TRANSFER_PRIORITY);
+    }
+}
+
+// End of an update, from the same task. packedBytes is the size received
+// for a compressed image, 0 for a plain one.
+void endOTATransfer(bool success, uint32_t imageBytes, uint32_t packedBytes)
 {
-    ArduinoOTA.handle();
-}
\ No newline at end of file
+    if (success)
+    {
+        uint32_t durationMs = millis() - otaStartMs;
+        otaStats.updates++;
+        otaStats.lastBytes = imageBytes;
+        otaStats.lastPackedBytes = packedBytes;
+        otaStats.lastDurationMs = durationMs;
+        otaStats.lastBytesPerSec = durationMs > 0 ? (uint64_t)imageBytes * 1000 / durationMs : 0;
+        logPrintf("\nEnd: %lu bytes in %lu ms (%.1f KB/s)\n", (unsigned long)imageBytes, (unsigned long)durationMs,
+                  otaStats.lastBytesPerSec / 1024.0);
+    }
+    else
+    {
+        otaStats.failures++;
+    }
+    vTaskPrioritySet(NULL, savedPriority);
+    otaInProgress = false;
+}
+
+// Restart into the new firmware from the service task, after the HTTP
+// response had time to go out
+void requestOTARestart()
+{
+    restartPending = true;
+}
+
+// True while an image is being received; display and LED work pause
+bool isOTAInProgress()
+{
+    return otaInProgress;
+}
+
+OtaStats getOTAStats()
+{
+    return otaStats;
+}
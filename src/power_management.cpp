@@ -0,0 +1,175 @@
+#include "power_management.h"
+#include "static_arena.h"
+#include "sampling_scheduler.h"
+#include <Arduino.h>
+#include <WiFi.h>
+#include <esp_pm.h>
+#include <esp_timer.h>
+#include <esp_idf_version.h>
+
+static const char *const SECTION_NAMES[NUM_PM_SECTIONS] = {"acquisition", "render", "network"};
+
+static esp_pm_lock_handle_t sectionLocks[NUM_PM_SECTIONS];
+static int64_t sectionStartUs[NUM_PM_SECTIONS];
+static int64_t sectionAccumUs[NUM_PM_SECTIONS];
+static uint8_t sectionDepth[NUM_PM_SECTIONS];
+static int64_t cycleStartUs = 0;
+static PowerStats powerStats;
+static portMUX_TYPE sectionMux = portMUX_INITIALIZER_UNLOCKED; // Sections are entered from the sampler tasks too
+
+/*
+ * ==================================================
+ * FUNCTION: INITIALIZE POWER MANAGEMENT
+ * ==================================================
+ * Description:
+ *   Enables dynamic frequency scaling between PM_MIN_FREQ_MHZ and
+ *   PM_MAX_FREQ_MHZ with automatic light sleep, and Wi-Fi modem sleep. The
+ *   CPU only runs at full clock while one of the section locks is held.
+ *   Arduino cores built without CONFIG_PM_ENABLE reject the configuration;
+ *   the device then keeps running at full clock and only accounting is done.
+ */
+
+void initializePowerManagement()
+{
+#if ESP_IDF_VERSION_MAJOR >= 5
+    esp_pm_config_t config = {};
+#else
+    esp_pm_config_esp32_t config = {};
+#endif
+    config.max_freq_mhz = PM_MAX_FREQ_MHZ;
+    config.min_freq_mhz = PM_MIN_FREQ_MHZ;
+    config.light_sleep_enable = true;
+
+    esp_err_t err = esp_pm_configure(&config);
+    powerStats.pmEnabled = (err == ESP_OK);
+    if (powerStats.pmEnabled)
+    {
+        for (int i = 0; i < NUM_PM_SECTIONS; i++)
+        {
+            esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, SECTION_NAMES[i], &sectionLocks[i]);
+        }
+        WiFi.setSleep(true); // Modem sleep between DTIM beacons
+        logPrintf("Power management enabled (%d-%d MHz, light sleep)\n", PM_MIN_FREQ_MHZ, PM_MAX_FREQ_MHZ);
+    }
+    else
+    {
+        logPrintf("Power management unavailable (%s), running at full clock\n", esp_err_to_name(err));
+    }
+
+    cycleStartUs = esp_timer_get_time();
+}
+
+/*
+ * ==================================================
+ * FUNCTION: BEGIN / END POWER SECTION
+ * ==================================================
+ * Description:
+ *   Hold full clock for the duration of a hot section and account its
+ *   active time. Sections may nest, also across tasks; only the outermost
+ *   pair counts. esp_pm locks are reference counted, so acquiring and
+ *   releasing outside the spinlock is safe.
+ */
+
+void beginPowerSection(PowerSection section)
+{
+    portENTER_CRITICAL(&sectionMux);
+    bool outermost = sectionDepth[section]++ == 0;
+    if (outermost)
+    {
+        sectionStartUs[section] = esp_timer_get_time();
+    }
+    portEXIT_CRITICAL(&sectionMux);
+
+    if (outermost && powerStats.pmEnabled)
+    {
+        esp_pm_lock_acquire(sectionLocks[section]);
+    }
+}
+
+void endPowerSection(PowerSection section)
+{
+    portENTER_CRITICAL(&sectionMux);
+    bool outermost = sectionDepth[section] > 0 && --sectionDepth[section] == 0;
+    if (outermost)
+    {
+        sectionAccumUs[section] += esp_timer_get_time() - sectionStartUs[section];
+    }
+    portEXIT_CRITICAL(&sectionMux);
+
+    if (outermost && powerStats.pmEnabled)
+    {
+        esp_pm_lock_release(sectionLocks[section]);
+    }
+}
+
+/*
+ * ==================================================
+ * FUNCTION: END POWER CYCLE
+ * ==================================================
+ * Description:
+ *   Closes one loop() cycle: records active time per section and projects
+ *   daily charge from the duty cycle, so faster hot sections show up as
+ *   lower estimated consumption. Time outside the sections counts as light
+ *   sleep only while every sampler period leaves room for it, see
+ *   PM_LIGHT_SLEEP_MIN_PERIOD_US; otherwise as awake at low clock.
+ */
+
+void endPowerCycle()
+{
+    int64_t now = esp_timer_get_time();
+    int64_t cycleUs = now - cycleStartUs;
+    cycleStartUs = now;
+
+    int64_t activeUs = 0;
+    portENTER_CRITICAL(&sectionMux);
+    for (int i = 0; i < NUM_PM_SECTIONS; i++)
+    {
+        powerStats.sectionTimeMs[i] = sectionAccumUs[i] / 1000;
+        activeUs += sectionAccumUs[i];
+        sectionAccumUs[i] = 0;
+    }
+    portEXIT_CRITICAL(&sectionMux);
+
+    powerStats.cycleTimeMs = cycleUs / 1000;
+    powerStats.activeTimeMs = activeUs / 1000;
+    powerStats.activeRatio = cycleUs > 0 ? (float)activeUs / cycleUs : 0;
+    if (powerStats.activeRatio > 1)
+    {
+        powerStats.activeRatio = 1;
+    }
+
+    uint32_t shortestPeriodUs = UINT32_MAX;
+    for (int g = 0; g < NUM_SENSOR_GROUPS; g++)
+    {
+        uint32_t periodUs = getSamplingPeriod((SensorGroup)g);
+        if (periodUs < shortestPeriodUs)
+        {
+            shortestPeriodUs = periodUs;
+        }
+    }
+    powerStats.lightSleep = powerStats.pmEnabled && shortestPeriodUs >= PM_LIGHT_SLEEP_MIN_PERIOD_US;
+
+    float idleCurrent = !powerStats.pmEnabled   ? PM_ACTIVE_CURRENT_MA
+                        : powerStats.lightSleep ? PM_IDLE_CURRENT_MA
+                                                : PM_AWAKE_CURRENT_MA;
+    float averageCurrent = powerStats.activeRatio * PM_ACTIVE_CURRENT_MA + (1 - powerStats.activeRatio) * idleCurrent;
+    powerStats.estimatedMahPerDay = averageCurrent * 24;
+
+    logPrintf("Active %lu ms of %lu ms (%.1f%%), %s otherwise, est. %.0f mAh/day\n",
+              (unsigned long)powerStats.activeTimeMs, (unsigned long)powerStats.cycleTimeMs,
+              powerStats.activeRatio * 100, powerStats.lightSleep ? "light sleep" : "awake",
+              powerStats.estimatedMahPerDay);
+}
+
+/*
+ * ==================================================
+ * FUNCTION: GET POWER STATS
+ * ==================================================
+ * Description:
+ *   Returns the accounting of the last completed cycle.
+ */
+
+PowerStats getPowerStats()
+{
+    return powerStats;
+}
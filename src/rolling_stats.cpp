@@ -0,0 +1,62 @@
+#include "rolling_stats.h"
+#include "static_arena.h"
+#include <math.h>
+#include <freertos/FreeRTOS.h>
+
+// One window per sensor channel. Each is fed by its sensor's sampler task
+// and summarized from the publish path; the spinlock keeps a summary from
+// seeing a push half done. A push touches one slot, a summary every slot.
+static RollingWindow (&channelWindows)[NUM_CHANNELS] = staticArena.statsWindows;
+static portMUX_TYPE rollingMux = portMUX_INITIALIZER_UNLOCKED;
+
+/*
+ * ==================================================
+ * FUNCTION: INITIALIZE ROLLING STATS
+ * ==================================================
+ * Description:
+ *   Clears the windows of every sensor channel.
+ */
+
+void initializeRollingStats()
+{
+    for (int i = 0; i < NUM_CHANNELS; i++)
+    {
+        resetRollingWindow(channelWindows[i]);
+    }
+}
+
+/*
+ * ==================================================
+ * FUNCTION: UPDATE ROLLING STATS
+ * ==================================================
+ * Description:
+ *   Feeds a reading taken at nowMs into the window of the given channel.
+ */
+
+void updateRollingStats(SensorChannel channel, float value, uint32_t nowMs)
+{
+    if (isnan(value) || isinf(value))
+    {
+        return;
+    }
+    portENTER_CRITICAL(&rollingMux);
+    pushRollingWindow(channelWindows[channel], value, nowMs);
+    portEXIT_CRITICAL(&rollingMux);
+}
+
+/*
+ * ==================================================
+ * FUNCTION: GET ROLLING STATS
+ * ==================================================
+ * Description:
+ *   Returns the aggregates of the given channel over the window ending at
+ *   nowMs.
+ */
+
+StatsSummary getRollingStats(SensorChannel channel, uint32_t nowMs)
+{
+    portENTER_CRITICAL(&rollingMux);
+    StatsSummary summary = summarizeRollingWindow(channelWindows[channel], nowMs);
+    portEXIT_CRITICAL(&rollingMux);
+    return summary;
+}
@@ -0,0 +1,112 @@
+#include "rolling_stats.h"
+#include <math.h>
+
+/*
+ * ==================================================
+ * FUNCTION: RESET ROLLING WINDOW
+ * ==================================================
+ * Description:
+ *   Clears all slots of a window.
+ */
+
+void resetRollingWindow(RollingWindow &window)
+{
+    for (uint16_t i = 0; i < STATS_WINDOW_SLOTS; i++)
+    {
+        window.slots[i].index = 0;
+        window.slots[i].count = 0;
+    }
+}
+
+/*
+ * ==================================================
+ * FUNCTION: PUSH ROLLING WINDOW
+ * ==================================================
+ * Description:
+ *   Adds a reading taken at nowMs to its slot. A slot still holding an
+ *   older period is restarted first, which is what evicts readings from
+ *   the window. Min/max are kept per slot, mean/variance by Welford's
+ *   algorithm, so a push is O(1) at any sampling rate.
+ */
+
+void pushRollingWindow(RollingWindow &window, float value, uint32_t nowMs)
+{
+    uint32_t index = nowMs / STATS_SLOT_MS;
+    StatsSlot &slot = window.slots[index % STATS_WINDOW_SLOTS];
+
+    if (slot.count == 0 || slot.index != index)
+    {
+        slot.index = index;
+        slot.count = 1;
+        slot.min = value;
+        slot.max = value;
+        slot.mean = value;
+        slot.m2 = 0;
+        return;
+    }
+
+    slot.count++;
+    slot.min = fminf(slot.min, value);
+    slot.max = fmaxf(slot.max, value);
+    float delta = value - slot.mean;
+    slot.mean += delta / slot.count;
+    slot.m2 += delta * (value - slot.mean);
+}
+
+/*
+ * ==================================================
+ * FUNCTION: SUMMARIZE ROLLING WINDOW
+ * ==================================================
+ * Description:
+ *   Returns min, max, mean and sample standard deviation of the readings
+ *   in the last STATS_WINDOW_SLOTS slots before nowMs. Slots are merged
+ *   with Chan's pairwise update of mean and M2; this is O(slots), and
+ *   slots from before a millis() wrap simply drop out.
+ */
+
+StatsSummary summarizeRollingWindow(const RollingWindow &window, uint32_t nowMs)
+{
+    StatsSummary summary = {NAN, NAN, NAN, NAN, 0};
+    uint32_t newest = nowMs / STATS_SLOT_MS;
+    float mean = 0;
+    float m2 = 0;
+
+    for (uint16_t i = 0; i < STATS_WINDOW_SLOTS; i++)
+    {
+        const StatsSlot &slot = window.slots[i];
+        if (slot.count == 0 || newest - slot.index >= STATS_WINDOW_SLOTS)
+        {
+            continue;
+        }
+
+        if (summary.count == 0)
+        {
+            summary.min = slot.min;
+            summary.max = slot.max;
+        }
+        else
+        {
+            summary.min = fminf(summary.min, slot.min);
+            summary.max = fmaxf(summary.max, slot.max);
+        }
+
+        uint32_t count = summary.count + slot.count;
+        float delta = slot.mean - mean;
+        float weight = (float)slot.count / count;
+        mean += delta * weight;
+        m2 += slot.m2 + delta * delta * summary.count * weight;
+        summary.count = count;
+    }
+
+    if (summary.count == 0)
+    {
+        return summary;
+    }
+    summary.mean = mean;
+    summary.stddev = 0;
+    if (summary.count > 1 && m2 > 0)
+    {
+        summary.stddev = sqrtf(m2 / (summary.count - 1));
+    }
+    return summary;
+}
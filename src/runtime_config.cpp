@@ -0,0 +1,406 @@
+#include "runtime_config.h"
+#include "sampling_scheduler.h"
+#include "adaptive_sampling.h"
+#include "rolling_stats.h"
+#include <Arduino.h>
+#include <Preferences.h>
+
+static Preferences configPrefs;
+static RuntimeConfig activeConfig;
+static portMUX_TYPE configMux = portMUX_INITIALIZER_UNLOCKED;
+
+#define ADAPTIVE_SAMPLING_DEFAULT(group, fastestUs, slowestUs) \
+    config.samplingBounds[GROUP_##group].minUs = fastestUs;     \
+    config.samplingBounds[GROUP_##group].maxUs = slowestUs;
+
+/*
+ * ==================================================
+ * FUNCTION: DEFAULT CONFIG
+ * ==================================================
+ * Description:
+ *   The compiled-in configuration: thresholds, periods, adaptive sampling
+ *   bounds and deadlines from the channel, sensor, adaptive sampling and
+ *   stage tables, and the stats publish rate.
+ */
+
+static void defaultConfig(RuntimeConfig &config)
+{
+    for (int ch = 0; ch < NUM_CHANNELS; ch++)
+    {
+        config.thresholds[ch].warn = CHANNELS[ch].warn;
+        config.thresholds[ch].alarm = CHANNELS[ch].alarm;
+    }
+    for (int g = 0; g < NUM_SENSOR_GROUPS; g++)
+    {
+        config.samplePeriodUs[g] = SENSOR_SAMPLE_PERIODS_US[g];
+        config.samplingBounds[g] = SamplingBounds();
+    }
+    ADAPTIVE_SAMPLING_TABLE(ADAPTIVE_SAMPLING_DEFAULT)
+    config.displayPageMs = CFG_DEFAULT_DISPLAY_PAGE_MS;
+    config.statsPublishMs = STATS_PUBLISH_INTERVAL_MS;
+    for (int s = 0; s < NUM_WATCHDOG_STAGES; s++)
+    {
+        config.stageDeadlineMs[s] = WATCHDOG_DEFAULT_DEADLINES_MS[s];
+        config.stageEscalation[s] = WATCHDOG_DEFAULT_ESCALATIONS[s];
+    }
+}
+
+/*
+ * ==================================================
+ * FUNCTION: INITIALIZE RUNTIME CONFIG
+ * ==================================================
+ * Description:
+ *   Starts from the defaults and loads the last applied configuration
+ *   from NVS. Must run before the sampler tasks start and before MQTT can
+ *   deliver the retained config message.
+ */
+
+void initializeRuntimeConfig()
+{
+    defaultConfig(activeConfig);
+
+    configPrefs.begin(CFG_NVS_NAMESPACE, false);
+    if (configPrefs.getUChar("version", 0) == CFG_VERSION &&
+        configPrefs.getBytesLength("cfg") == sizeof(RuntimeConfig))
+    {
+        configPrefs.getBytes("cfg", &activeConfig, sizeof(RuntimeConfig));
+        Serial.println("Runtime configuration loaded from NVS");
+    }
+}
+
+// Compare a non-terminated token with a C string
+static bool tokenEquals(const char *token, size_t length, const char *text)
+{
+    return strlen(text) == length && strncmp(token, text, length) == 0;
+}
+
+// Copy a value token into a terminated buffer, false if it does not fit
+static bool copyToken(const char *token, size_t length, char *buffer)
+{
+    if (length == 0 || length >= CFG_TOKEN_MAX)
+    {
+        return false;
+    }
+    memcpy(buffer, token, length);
+    buffer[length] = '\0';
+    return true;
+}
+
+// Threshold value: a non-negative number, or "off" for none
+static bool parseThreshold(const char *token, size_t length, float &value)
+{
+    char buffer[CFG_TOKEN_MAX];
+    if (tokenEquals(token, length, "off"))
+    {
+        value = NAN;
+        return true;
+    }
+    if (!copyToken(token, length, buffer))
+    {
+        return false;
+    }
+    char *end;
+    value = strtof(buffer, &end);
+    return *end == '\0' && isfinite(value) && value >= 0;
+}
+
+// Unsigned integer within [minimum, maximum], scaled by multiplier
+static bool parseRange(const char *token, size_t length, uint32_t multiplier, uint32_t minimum, uint32_t maximum,
+                       uint32_t &value)
+{
+    char buffer[CFG_TOKEN_MAX];
+    if (!copyToken(token, length, buffer) || buffer[0] < '0' || buffer[0] > '9')
+    {
+        return false;
+    }
+    char *end;
+    unsigned long long parsed = strtoull(buffer, &end, 10);
+    if (*end != '\0' || parsed > maximum / multiplier || parsed * multiplier < minimum)
+    {
+        return false;
+    }
+    value = (uint32_t)(parsed * multiplier);
+    return true;
+}
+
+/*
+ * ==================================================
+ * FUNCTION: PARSE CONFIG PAIR
+ * ==================================================
+ * Description:
+ *   Applies one key=value pair to the staged configuration. Keys:
+ *     <channel>.warn, <channel>.alarm   threshold, or "off"
+ *     <sensor>.period_us, .period_ms     sampling period (adaptive: start)
+ *     <sensor>.min_period_us/_ms,
+ *     <sensor>.max_period_us/_ms         adaptive sampling bounds
+ *     <sensor>.adaptive                  "off" for a fixed period
+ *     display.page_ms                   time per OLED page
+ *     stats.publish_ms                   rolling statistics publish rate
+ *     <stage>.deadline_ms                watchdog deadline
+ *     <stage>.escalation                 "skip", "reset" or "reboot"
+ */
+
+static bool parseConfigPair(RuntimeConfig &config, const char *key, size_t keyLength, const char *value,
+                            size_t valueLength)
+{
+    const char *dot = (const char *)memchr(key, '.', keyLength);
+    if (dot == nullptr)
+    {
+        return false;
+    }
+    size_t prefixLength = dot - key;
+    const char *field = dot + 1;
+    size_t fieldLength = keyLength - prefixLength - 1;
+
+    for (int ch = 0; ch < NUM_CHANNELS; ch++)
+    {
+        if (!tokenEquals(key, prefixLength, CHANNEL_NAMES[ch]))
+        {
+            continue;
+        }
+        if (tokenEquals(field, fieldLength, "warn"))
+        {
+            return parseThreshold(value, valueLength, config.thresholds[ch].warn);
+        }
+        if (tokenEquals(field, fieldLength, "alarm"))
+        {
+            return parseThreshold(value, valueLength, config.thresholds[ch].alarm);
+        }
+        return false;
+    }
+
+    for (int g = 0; g < NUM_SENSOR_GROUPS; g++)
+    {
+        if (!tokenEquals(key, prefixLength, SENSOR_GROUP_NAMES[g]))
+        {
+            continue;
+        }
+        if (tokenEquals(field, fieldLength, "adaptive"))
+        {
+            config.samplingBounds[g] = SamplingBounds();
+            return tokenEquals(value, valueLength, "off");
+        }
+        uint32_t *period = &config.samplePeriodUs[g];
+        if (fieldLength > 4 && strncmp(field, "min_", 4) == 0)
+        {
+            period = &config.samplingBounds[g].minUs;
+            field += 4;
+            fieldLength -= 4;
+        }
+        else if (fieldLength > 4 && strncmp(field, "max_", 4) == 0)
+        {
+            period = &config.samplingBounds[g].maxUs;
+            field += 4;
+            fieldLength -= 4;
+        }
+        uint32_t multiplier = tokenEquals(field, fieldLength, "period_us")   ? 1
+                              : tokenEquals(field, fieldLength, "period_ms") ? 1000
+                                                                             : 0;
+        return multiplier != 0 &&
+               parseRange(value, valueLength, multiplier, CFG_PERIOD_MIN_US, CFG_PERIOD_MAX_US, *period);
+    }
+
+    for (int s = 0; s < NUM_WATCHDOG_STAGES; s++)
+    {
+        if (!tokenEquals(key, prefixLength, WATCHDOG_STAGE_NAMES[s]))
+        {
+            continue;
+        }
+        if (tokenEquals(field, fieldLength, "deadline_ms"))
+        {
+            return parseRange(value, valueLength, 1, CFG_DEADLINE_MIN_MS, CFG_DEADLINE_MAX_MS,
+                              config.stageDeadlineMs[s]);
+        }
+        if (tokenEquals(field, fieldLength, "escalation"))
+        {
+            for (int e = WDT_SKIP; e <= WDT_REBOOT; e++)
+            {
+                if (tokenEquals(value, valueLength, WATCHDOG_ESCALATION_NAMES[e]))
+                {
+                    config.stageEscalation[s] = (WatchdogEscalation)e;
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    if (tokenEquals(key, prefixLength, "display") && tokenEquals(field, fieldLength, "page_ms"))
+    {
+        return parseRange(value, valueLength, 1, CFG_DISPLAY_PAGE_MIN_MS, CFG_DISPLAY_PAGE_MAX_MS,
+                          config.displayPageMs);
+    }
+    if (tokenEquals(key, prefixLength, "stats") && tokenEquals(field, fieldLength, "publish_ms"))
+    {
+        return parseRange(value, valueLength, 1, CFG_STATS_PUBLISH_MIN_MS, CFG_STATS_PUBLISH_MAX_MS,
+                          config.statsPublishMs);
+    }
+    return false;
+}
+
+/*
+ * ==================================================
+ * FUNCTION: APPLY RUNTIME CONFIG
+ * ==================================================
+ * Description:
+ *   Parses a "co.alarm=40;mq2.period_ms=500;display.page_ms=3000" style
+ *   message in place (';', '&' or newline separated, no allocation) on top
+ *   of the current configuration. "reset" starts over from the defaults.
+ *   Any bad key or value rejects the whole message, as does a warning
+ *   level above the alarm level or an adaptive sampling bound without the
+ *   other. A valid change is swapped in as one unit,
+ *   sampling periods are retimed at once (a sensor with new adaptive bounds
+ *   restarts from its configured period) and the result is saved to NVS.
+ */
+
+ConfigResult applyRuntimeConfig(const char *text, size_t length, char *error, size_t errorSize)
+{
+    RuntimeConfig current = getRuntimeConfig();
+    RuntimeConfig staged = current;
+
+    size_t start = 0;
+    for (size_t i = 0; i <= length; i++)
+    {
+        if (i < length && text[i] != ';' && text[i] != '&' && text[i] != '\n')
+        {
+            continue;
+        }
+
+        const char *pair = text + start;
+        size_t pairLength = i - start;
+        start = i + 1;
+        while (pairLength > 0 && (pair[pairLength - 1] == ' ' || pair[pairLength - 1] == '\r'))
+        {
+            pairLength--;
+        }
+        while (pairLength > 0 && pair[0] == ' ')
+        {
+            pair++;
+            pairLength--;
+        }
+        if (pairLength == 0)
+        {
+            continue;
+        }
+        if (tokenEquals(pair, pairLength, "reset"))
+        {
+            defaultConfig(staged);
+            continue;
+        }
+
+        const char *eq = (const char *)memchr(pair, '=', pairLength);
+        if (eq == nullptr || !parseConfigPair(staged, pair, eq - pair, eq + 1, pairLength - (eq - pair) - 1))
+        {
+            snprintf(error, errorSize, "invalid '%.*s'", (int)pairLength, pair);
+            return CONFIG_REJECTED;
+        }
+    }
+
+    for (int ch = 0; ch < NUM_CHANNELS; ch++)
+    {
+        if (staged.thresholds[ch].warn > staged.thresholds[ch].alarm)
+        {
+            snprintf(error, errorSize, "%s.warn above %s.alarm", CHANNEL_NAMES[ch], CHANNEL_NAMES[ch]);
+            return CONFIG_REJECTED;
+        }
+    }
+
+    for (int g = 0; g < NUM_SENSOR_GROUPS; g++)
+    {
+        const SamplingBounds &bounds = staged.samplingBounds[g];
+        if ((bounds.minUs == 0) != (bounds.maxUs == 0))
+        {
+            snprintf(error, errorSize, "%s.min_period and %s.max_period go together", SENSOR_GROUP_NAMES[g],
+                     SENSOR_GROUP_NAMES[g]);
+            return CONFIG_REJECTED;
+        }
+        if (bounds.minUs > bounds.maxUs)
+        {
+            snprintf(error, errorSize, "%s.min_period above %s.max_period", SENSOR_GROUP_NAMES[g],
+                     SENSOR_GROUP_NAMES[g]);
+            return CONFIG_REJECTED;
+        }
+    }
+
+    if (memcmp(&staged, &current, sizeof(RuntimeConfig)) == 0)
+    {
+        return CONFIG_UNCHANGED;
+    }
+
+    portENTER_CRITICAL(&configMux);
+    activeConfig = staged;
+    portEXIT_CRITICAL(&configMux);
+
+    for (int g = 0; g < NUM_SENSOR_GROUPS; g++)
+    {
+        if (staged.samplePeriodUs[g] != current.samplePeriodUs[g] ||
+            memcmp(&staged.samplingBounds[g], &current.samplingBounds[g], sizeof(SamplingBounds)) != 0)
+        {
+            setSamplingPeriod((SensorGroup)g, staged.samplePeriodUs[g]);
+        }
+    }
+
+    configPrefs.putBytes("cfg", &staged, sizeof(RuntimeConfig));
+    configPrefs.putUChar("version", CFG_VERSION);
+    Serial.println("Runtime configuration applied");
+    return CONFIG_APPLIED;
+}
+
+/*
+ * ==================================================
+ * FUNCTION: GET RUNTIME CONFIG
+ * ==================================================
+ * Description:
+ *   Consistent snapshot of the whole configuration, and accessors for the
+ *   values read on hot paths. A threshold pair is always read from the
+ *   same configuration.
+ */
+
+RuntimeConfig getRuntimeConfig()
+{
+    portENTER_CRITICAL(&configMux);
+    RuntimeConfig config = activeConfig;
+    portEXIT_CRITICAL(&configMux);
+    return config;
+}
+
+ChannelThresholds getChannelThresholds(SensorChannel channel)
+{
+    portENTER_CRITICAL(&configMux);
+    ChannelThresholds thresholds = activeConfig.thresholds[channel];
+    portEXIT_CRITICAL(&configMux);
+    return thresholds;
+}
+
+uint32_t getSamplePeriodUs(SensorGroup group)
+{
+    return activeConfig.samplePeriodUs[group];
+}
+
+SamplingBounds getSamplingBounds(SensorGroup group)
+{
+    portENTER_CRITICAL(&configMux);
+    SamplingBounds bounds = activeConfig.samplingBounds[group];
+    portEXIT_CRITICAL(&configMux);
+    return bounds;
+}
+
+uint32_t getDisplayPageMs()
+{
+    return activeConfig.displayPageMs;
+}
+
+uint32_t getStatsPublishMs()
+{
+    return activeConfig.statsPublishMs;
+}
+
+uint32_t getStageDeadlineMs(WatchdogStage stage)
+{
+    return activeConfig.stageDeadlineMs[stage];
+}
+
+WatchdogEscalation getStageEscalation(WatchdogStage stage)
+{
+    return activeConfig.stageEscalation[stage];
+}
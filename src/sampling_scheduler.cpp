@@ -0,0 +1,319 @@
+#include "sampling_scheduler.h"
+#include "static_arena.h"
+#include "sensor_processing.h"
+#include "runtime_config.h"
+#include "memory_monitor.h"
+#include <Arduino.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+
+// Timer, task and jitter accounting of one sensor
+struct Sampler
+{
+    SensorGroup group;
+    esp_timer_handle_t timer;
+    TaskHandle_t task;
+    int64_t nextReleaseUs; // Scheduled start of the next sample
+    SamplingJitter jitter;
+    uint32_t histogram[JITTER_HISTOGRAM_BINS];
+};
+
+static Sampler samplers[NUM_SENSOR_GROUPS];
+static portMUX_TYPE jitterLock = portMUX_INITIALIZER_UNLOCKED;
+
+// Serialises the timer stop/start and priority changes of
+// setSamplingPeriod() (config path) and retimeSampling() (sampler tasks)
+static StaticSemaphore_t timingMutexBuffer;
+static SemaphoreHandle_t timingMutex = NULL;
+
+/*
+ * ==================================================
+ * FUNCTION: RELEASE SAMPLER
+ * ==================================================
+ * Description:
+ *   esp_timer callback: wakes the sensor's task. Releases that arrive
+ *   while the task is still busy accumulate in the notification count.
+ */
+
+static void releaseSampler(void *arg)
+{
+    xTaskNotifyGive(((Sampler *)arg)->task);
+}
+
+/*
+ * ==================================================
+ * FUNCTION: RECORD JITTER
+ * ==================================================
+ * Description:
+ *   Adds one start-time deviation (µs, late is positive) to the sensor's
+ *   min/max and histogram.
+ */
+
+static void recordJitter(Sampler &sampler, int32_t deviationUs)
+{
+    int bin = deviationUs < 0 ? 0 : deviationUs / JITTER_BIN_US;
+    if (bin >= JITTER_HISTOGRAM_BINS)
+    {
+        bin = JITTER_HISTOGRAM_BINS - 1;
+    }
+
+    portENTER_CRITICAL(&jitterLock);
+    SamplingJitter &jitter = sampler.jitter;
+    if (jitter.samples == 0 || deviationUs < jitter.minUs)
+    {
+        jitter.minUs = deviationUs;
+    }
+    if (jitter.samples == 0 || deviationUs > jitter.maxUs)
+    {
+        jitter.maxUs = deviationUs;
+    }
+    jitter.samples++;
+    sampler.histogram[bin]++;
+    portEXIT_CRITICAL(&jitterLock);
+}
+
+/*
+ * ==================================================
+ * FUNCTION: SAMPLER TASK
+ * ==================================================
+ * Description:
+ *   Waits for the timer, measures how late it started against the fixed
+ *   schedule (first release + n periods) and takes the sample. Missed
+ *   releases are counted as overruns and skipped, so the schedule never
+ *   drifts.
+ */
+
+static void samplerTask(void *arg)
+{
+    Sampler &sampler = *(Sampler *)arg;
+
+    for (;;)
+    {
+        uint32_t releases = ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        int64_t now = esp_timer_get_time();
+
+        portENTER_CRITICAL(&jitterLock);
+        uint32_t period = sampler.jitter.periodUs;
+        if (releases > 1)
+        {
+            sampler.jitter.overruns += releases - 1;
+            sampler.nextReleaseUs += (int64_t)(releases - 1) * period;
+        }
+        int32_t deviationUs = (int32_t)(now - sampler.nextReleaseUs);
+        sampler.nextReleaseUs += period;
+        portEXIT_CRITICAL(&jitterLock);
+
+        recordJitter(sampler, deviationUs);
+        sampleSensor(sampler.group);
+    }
+}
+
+/*
+ * ==================================================
+ * FUNCTION: ASSIGN PRIORITIES
+ * ==================================================
+ * Description:
+ *   Rate-monotonic priorities: SAMPLER_PRIORITY_BASE plus the number of
+ *   sensors with a longer period (ties broken by table order), so the
+ *   KY-038 preempts the MQ-2, which preempts the BME680 by default.
+ */
+
+static void assignPriorities()
+{
+    for (int g = 0; g < NUM_SENSOR_GROUPS; g++)
+    {
+        uint32_t period = samplers[g].jitter.periodUs;
+        uint8_t priority = SAMPLER_PRIORITY_BASE;
+        for (int other = 0; other < NUM_SENSOR_GROUPS; other++)
+        {
+            uint32_t otherPeriod = samplers[other].jitter.periodUs;
+            if (otherPeriod > period || (otherPeriod == period && other > g))
+            {
+                priority++;
+            }
+        }
+        samplers[g].jitter.priority = priority;
+        if (samplers[g].task != NULL)
+        {
+            vTaskPrioritySet(samplers[g].task, priority);
+        }
+    }
+}
+
+/*
+ * ==================================================
+ * FUNCTION: START SENSOR SAMPLING
+ * ==================================================
+ * Description:
+ *   Creates one task and one periodic esp_timer per sensor, at the periods
+ *   of the runtime configuration. All sampler tasks preempt loop(), which
+ *   only displays and publishes.
+ */
+
+void startSensorSampling()
+{
+    timingMutex = xSemaphoreCreateMutexStatic(&timingMutexBuffer);
+    for (int g = 0; g < NUM_SENSOR_GROUPS; g++)
+    {
+        samplers[g].group = (SensorGroup)g;
+        samplers[g].jitter.periodUs = getSamplePeriodUs((SensorGroup)g);
+    }
+    assignPriorities();
+
+    for (int g = 0; g < NUM_SENSOR_GROUPS; g++)
+    {
+        Sampler &sampler = samplers[g];
+        xTaskCreatePinnedToCore(samplerTask, SENSOR_GROUP_NAMES[g], SAMPLER_TASK_STACK, &sampler,
+                                sampler.jitter.priority, &sampler.task, SAMPLER_CORE);
+        watchTaskAllocations(sampler.task);
+
+        esp_timer_create_args_t timerArgs = {};
+        timerArgs.callback = releaseSampler;
+        timerArgs.arg = &sampler;
+        timerArgs.dispatch_method = ESP_TIMER_TASK;
+        timerArgs.name = SENSOR_GROUP_NAMES[g];
+        esp_timer_create(&timerArgs, &sampler.timer);
+
+        sampler.nextReleaseUs = esp_timer_get_time() + sampler.jitter.periodUs;
+        esp_timer_start_periodic(sampler.timer, sampler.jitter.periodUs);
+
+        logPrintf("Sampling %s every %lu us (priority %u)\n", SENSOR_GROUP_LABELS[g],
+                  (unsigned long)sampler.jitter.periodUs, sampler.jitter.priority);
+    }
+}
+
+/*
+ * ==================================================
+ * FUNCTION: SET SAMPLING PERIOD
+ * ==================================================
+ * Description:
+ *   Retimes one sensor while running: the next sample is one new period
+ *   from now and its jitter statistics start over. Priorities are
+ *   reassigned to stay rate-monotonic. Before startSensorSampling() the
+ *   period is only picked up at start.
+ */
+
+void setSamplingPeriod(SensorGroup group, uint32_t periodUs)
+{
+    Sampler &sampler = samplers[group];
+    if (sampler.timer == NULL)
+    {
+        return;
+    }
+
+    xSemaphoreTake(timingMutex, portMAX_DELAY);
+    esp_timer_stop(sampler.timer);
+    portENTER_CRITICAL(&jitterLock);
+    uint8_t priority = sampler.jitter.priority;
+    sampler.jitter = SamplingJitter();
+    sampler.jitter.periodUs = periodUs;
+    sampler.jitter.priority = priority;
+    memset(sampler.histogram, 0, sizeof(sampler.histogram));
+    sampler.nextReleaseUs = esp_timer_get_time() + periodUs;
+    portEXIT_CRITICAL(&jitterLock);
+    esp_timer_start_periodic(sampler.timer, periodUs);
+
+    assignPriorities();
+    xSemaphoreGive(timingMutex);
+    logPrintf("Sampling %s every %lu us (priority %u)\n", SENSOR_GROUP_LABELS[group], (unsigned long)periodUs,
+              sampler.jitter.priority);
+}
+
+/*
+ * ==================================================
+ * FUNCTION: RETIME SAMPLING
+ * ==================================================
+ * Description:
+ *   Adaptive sampling's lighter retime, called by the sensor's own sampler
+ *   task right after a sample: the next sample is one new period from now,
+ *   but the jitter statistics carry on and nothing is logged. Releases
+ *   that arrived during the sample belong to the old period and are
+ *   dropped. The period is clamped to the configured bounds read under
+ *   the lock, so a choice made before a config change cannot undo it,
+ *   and is dropped if the sensor is no longer adaptive. A retime that
+ *   finds setSamplingPeriod() running is skipped rather than waited for.
+ */
+
+void retimeSampling(SensorGroup group, uint32_t periodUs)
+{
+    Sampler &sampler = samplers[group];
+    if (sampler.timer == NULL || xSemaphoreTake(timingMutex, 0) != pdTRUE)
+    {
+        return;
+    }
+
+    SamplingBounds bounds = getSamplingBounds(group);
+    periodUs = periodUs < bounds.minUs ? bounds.minUs : periodUs > bounds.maxUs ? bounds.maxUs : periodUs;
+    if (bounds.maxUs == 0 || periodUs == sampler.jitter.periodUs)
+    {
+        xSemaphoreGive(timingMutex);
+        return;
+    }
+
+    esp_timer_stop(sampler.timer);
+    ulTaskNotifyTake(pdTRUE, 0);
+    portENTER_CRITICAL(&jitterLock);
+    sampler.jitter.periodUs = periodUs;
+    sampler.jitter.retimes++;
+    sampler.nextReleaseUs = esp_timer_get_time() + periodUs;
+    portEXIT_CRITICAL(&jitterLock);
+    esp_timer_start_periodic(sampler.timer, periodUs);
+
+    assignPriorities();
+    xSemaphoreGive(timingMutex);
+}
+
+/*
+ * ==================================================
+ * FUNCTION: GET SAMPLING PERIOD
+ * ==================================================
+ * Description:
+ *   Period the sensor is sampled at right now: the configured one, or the
+ *   latest adaptive choice.
+ */
+
+uint32_t getSamplingPeriod(SensorGroup group)
+{
+    return samplers[group].jitter.periodUs != 0 ? samplers[group].jitter.periodUs : getSamplePeriodUs(group);
+}
+
+/*
+ * ==================================================
+ * FUNCTION: GET SAMPLING JITTER
+ * ==================================================
+ * Description:
+ *   Snapshot of a sensor's jitter. The 99th percentile is the upper edge
+ *   of the histogram bin holding it, or the maximum if it falls in the
+ *   overflow bin.
+ */
+
+SamplingJitter getSamplingJitter(SensorGroup group)
+{
+    const Sampler &sampler = samplers[group];
+    uint32_t histogram[JITTER_HISTOGRAM_BINS];
+
+    portENTER_CRITICAL(&jitterLock);
+    SamplingJitter jitter = sampler.jitter;
+    memcpy(histogram, sampler.histogram, sizeof(histogram));
+    portEXIT_CRITICAL(&jitterLock);
+
+    jitter.p99Us = jitter.maxUs;
+    uint32_t target = jitter.samples - jitter.samples / 100;
+    uint32_t seen = 0;
+    for (int bin = 0; bin < JITTER_HISTOGRAM_BINS - 1 && jitter.samples > 0; bin++)
+    {
+        seen += histogram[bin];
+        if (seen >= target)
+        {
+            jitter.p99Us = (bin + 1) * JITTER_BIN_US;
+            if (jitter.p99Us > jitter.maxUs)
+            {
+                jitter.p99Us = jitter.maxUs;
+            }
+            break;
+        }
+    }
+    return jitter;
+}
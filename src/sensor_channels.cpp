@@ -0,0 +1,150 @@
+#include "sensor_channels.h"
+#include "runtime_config.h"
+#include <stdio.h>
+#include <string.h>
+
+// Reading globals
+#define SENSOR_CHANNEL_DEFINE(id, variable, group, name, topic, label, unit, precision, warn, alarm) float variable;
+SENSOR_CHANNEL_TABLE(SENSOR_CHANNEL_DEFINE)
+#undef SENSOR_CHANNEL_DEFINE
+
+// Channel descriptors, in SensorChannel order. Topics and formats are
+// concatenated string literals, so nothing is built at runtime.
+#define SENSOR_CHANNEL_DESCRIPTOR(id, variable, group, name, topic, label, unit, precision, warn, alarm) \
+    {name, TOPIC_SENSOR_BASE "/" topic, label, unit, "%." #precision "f", warn, alarm, GROUP_##group, &variable},
+const ChannelDescriptor CHANNELS[NUM_CHANNELS] = {
+    SENSOR_CHANNEL_TABLE(SENSOR_CHANNEL_DESCRIPTOR)
+};
+#undef SENSOR_CHANNEL_DESCRIPTOR
+
+// Channel names, in SensorChannel order
+#define SENSOR_CHANNEL_NAME(id, variable, group, name, topic, label, unit, precision, warn, alarm) name,
+const char *const CHANNEL_NAMES[NUM_CHANNELS] = {
+    SENSOR_CHANNEL_TABLE(SENSOR_CHANNEL_NAME)
+};
+#undef SENSOR_CHANNEL_NAME
+
+// Sensor names, display labels and sampling periods, in SensorGroup order
+#define SENSOR_GROUP_NAME(id, name, label, periodUs) name,
+const char *const SENSOR_GROUP_NAMES[NUM_SENSOR_GROUPS] = {
+    SENSOR_GROUP_TABLE(SENSOR_GROUP_NAME)
+};
+#undef SENSOR_GROUP_NAME
+
+#define SENSOR_GROUP_LABEL(id, name, label, periodUs) label,
+const char *const SENSOR_GROUP_LABELS[NUM_SENSOR_GROUPS] = {
+    SENSOR_GROUP_TABLE(SENSOR_GROUP_LABEL)
+};
+#undef SENSOR_GROUP_LABEL
+
+#define SENSOR_GROUP_PERIOD(id, name, label, periodUs) periodUs,
+const uint32_t SENSOR_SAMPLE_PERIODS_US[NUM_SENSOR_GROUPS] = {
+    SENSOR_GROUP_TABLE(SENSOR_GROUP_PERIOD)
+};
+#undef SENSOR_GROUP_PERIOD
+
+/*
+ * ==================================================
+ * FUNCTION: GET CHANNEL VALUE
+ * ==================================================
+ * Description:
+ *   Returns the latest reading of a channel.
+ */
+
+float getChannelValue(SensorChannel channel)
+{
+    return *CHANNELS[channel].value;
+}
+
+/*
+ * ==================================================
+ * FUNCTION: GET CHANNEL LEVEL
+ * ==================================================
+ * Description:
+ *   Compares the latest reading, or any value of the channel's kind (e.g.
+ *   from a registry sensor), with the channel's thresholds from the
+ *   runtime configuration. Channels without thresholds are always
+ *   LEVEL_NORMAL.
+ */
+
+ChannelLevel getChannelLevel(SensorChannel channel)
+{
+    return getChannelLevel(channel, *CHANNELS[channel].value);
+}
+
+ChannelLevel getChannelLevel(SensorChannel channel, float value)
+{
+    ChannelThresholds thresholds = getChannelThresholds(channel);
+    if (value > thresholds.alarm)
+    {
+        return LEVEL_ALARM;
+    }
+    if (value > thresholds.warn)
+    {
+        return LEVEL_WARNING;
+    }
+    return LEVEL_NORMAL;
+}
+
+/*
+ * ==================================================
+ * FUNCTION: FORMAT CHANNEL VALUE / READING
+ * ==================================================
+ * Description:
+ *   Writes the latest reading at the channel's precision, as the bare
+ *   value (MQTT payloads, JSON) or with its unit (OLED, serial). Returns
+ *   the snprintf() length.
+ */
+
+int formatChannelValue(SensorChannel channel, char *buffer, size_t size)
+{
+    return snprintf(buffer, size, CHANNELS[channel].format, *CHANNELS[channel].value);
+}
+
+int formatChannelReading(SensorChannel channel, char *buffer, size_t size)
+{
+    int length = formatChannelValue(channel, buffer, size);
+    const char *unit = CHANNELS[channel].unit;
+    if (unit[0] != '\0' && length >= 0 && (size_t)length < size)
+    {
+        length += snprintf(buffer + length, size - length, " %s", unit);
+    }
+    return length;
+}
+
+/*
+ * ==================================================
+ * FUNCTION: PARSE CHANNEL MASK
+ * ==================================================
+ * Description:
+ *   Parses a comma separated list of channel names (not necessarily
+ *   null-terminated) into a bit mask. "all" selects every channel and
+ *   unknown names are ignored.
+ */
+
+uint16_t parseChannelMask(const char *list, size_t length)
+{
+    if (length == 3 && strncmp(list, "all", 3) == 0)
+    {
+        return ALL_CHANNELS_MASK;
+    }
+
+    uint16_t mask = 0;
+    size_t start = 0;
+    for (size_t i = 0; i <= length; i++)
+    {
+        if (i == length || list[i] == ',')
+        {
+            size_t nameLength = i - start;
+            for (int ch = 0; ch < NUM_CHANNELS; ch++)
+            {
+                if (strlen(CHANNEL_NAMES[ch]) == nameLength && strncmp(list + start, CHANNEL_NAMES[ch], nameLength) == 0)
+                {
+                    mask |= 1u << ch;
+                }
+            }
+            start = i + 1;
+        }
+    }
+    return mask;
+}
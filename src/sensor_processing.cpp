@@ -3,27 +3,299 @@
 #include "helper_functions.h"
 #include "oled_display.h"
 #include "serial_monitor.h"
+#include "rolling_stats.h"
+#include "time_series_store.h"
+#include "power_management.h"
+#include "calibration_store.h"
+#include "air_quality.h"
+#include "math_kernels.h"
+#include "sampling_scheduler.h"
+#include "runtime_config.h"
+#include "stage_watchdog.h"
+#include "anomaly_detector.h"
+#include "adaptive_sampling.h"
+#include "i2c_bus.h"
+#include "alert_dispatch.h"
 
 /*
  * ==================================================
- * FUNCTION: PROCESS SOUND SENSOR
+ * FUNCTION: RECORD READING
  * ==================================================
  * Description:
- *   Reads data from the KY-038 Sound Sensor and converts it to decibels.
- *   Displays the sound level on the OLED and prints it to the Serial Monitor.
- *   Issues a status (e.g., LOUD or Normal) based on a defined threshold.
+ *   Feeds a fresh reading into the rolling statistics, the early-warning
+ *   detectors and the on-device time-series history, timestamped in
+ *   seconds since boot. The group variant records every channel of one
+ *   sensor, then lets adaptive sampling pick the sensor's next period.
  */
 
-void processSoundSensor()
+static void recordReading(SensorChannel channel, float value)
+{
+    uint32_t nowMs = millis();
+    updateRollingStats(channel, value, nowMs);
+    updateAnomalyDetector(channel, value, nowMs);
+    appendTimeSeries(channel, nowMs / 1000, value);
+}
+
+static void recordSensorReadings(SensorGroup group)
 {
+    for (int ch = 0; ch < NUM_CHANNELS; ch++)
+    {
+        if (CHANNELS[ch].group == group)
+        {
+            recordReading((SensorChannel)ch, getChannelValue((SensorChannel)ch));
+        }
+    }
+    updateAdaptiveSampling(group, millis());
+}
+
+/*
+ * ==================================================
+ * FUNCTION: READ SOUND SENSOR
+ * ==================================================
+ * Description:
+ *   Samples the KY-038 and stores the level in decibels in `sound`.
+ */
+
+void readSoundSensor()
+{
+    beginPowerSection(PM_SECTION_ACQUISITION);
     int rawSound = analogRead(KY038_PIN);
     sound = convertRawSoundToDecibels(rawSound);
+    endPowerSection(PM_SECTION_ACQUISITION);
+}
+
+/*
+ * ==================================================
+ * FUNCTION: READ BME680 SENSOR
+ * ==================================================
+ * Description:
+ *   Runs one forced-mode BME680 measurement and stores temperature,
+ *   humidity, pressure, gas resistance and altitude in their globals.
+ *   Altitude comes from the altitude table; bme.readAltitude() would run
+ *   a second full measurement.
+ *   The measurement is started at full clock and the gas heater wait runs
+ *   at low clock, with the I2C bus free for the OLED. Returns false if the
+ *   reading failed or the bus stayed busy. Good readings also
+ *   update the IAQ estimate (`iaq`, `eco2`, `iaqAccuracy`).
+ */
+
+bool readBME680()
+{
+    beginPowerSection(PM_SECTION_ACQUISITION);
+    unsigned long readyAt = 0;
+    if (acquireI2CBus(I2C_CLIENT_BME680))
+    {
+        readyAt = bme.beginReading();
+        releaseI2CBus(I2C_CLIENT_BME680);
+    }
+    endPowerSection(PM_SECTION_ACQUISITION);
+
+    if (readyAt != 0 && millis() < readyAt)
+    {
+        delay(readyAt - millis());
+    }
+
+    beginPowerSection(PM_SECTION_ACQUISITION);
+    bool readingOk = false;
+    if (readyAt != 0 && acquireI2CBus(I2C_CLIENT_BME680))
+    {
+        readingOk = bme.endReading();
+        releaseI2CBus(I2C_CLIENT_BME680);
+    }
+    if (readingOk)
+    {
+        temperature = bme.temperature;
+        humidity = bme.humidity;
+        pressure = bme.pressure / 100.0;
+        gas = bme.gas_resistance / 1000.0;
+        altitude = altitudeFromPressure(pressure);
+    }
+    endPowerSection(PM_SECTION_ACQUISITION);
+
+    if (readingOk)
+    {
+        updateAirQuality(gas, humidity);
+    }
+
+    return readingOk;
+}
+
+/*
+ * ==================================================
+ * FUNCTION: MQ-2 SENSOR RESISTANCE
+ * ==================================================
+ * Description:
+ *   Sensor resistance Rs (kΩ) for an MQ-2 output voltage, as
+ *   MQUnifiedsensor computes it.
+ */
+
+float mq2SensorResistance(float volts)
+{
+    return (MQ2_VOLTAGE_RESOLUTION * MQ2_LOAD_RESISTANCE_KOHM) / volts - MQ2_LOAD_RESISTANCE_KOHM;
+}
+
+/*
+ * ==================================================
+ * FUNCTION: COMPUTE MQ-2 CONCENTRATIONS
+ * ==================================================
+ * Description:
+ *   Evaluates the LPG, CO and smoke curves for one MQ-2 sample, with one
+ *   log2 of Rs/R0 shared by the three curves.
+ */
 
+void computeMQ2Concentrations(float volts, float r0, float &lpgPpm, float &coPpm, float &smokePpm)
+{
+    float ratio = mq2SensorResistance(volts) / r0;
+    if (!(ratio > 0))
+    {
+        lpgPpm = coPpm = smokePpm = INFINITY; // Sensor saturated
+    }
+    else if (isinf(ratio))
+    {
+        lpgPpm = coPpm = smokePpm = 0; // No output voltage
+    }
+    else
+    {
+        float log2Ratio = fastLog2(ratio);
+        lpgPpm = powerLawPpm(log2Ratio, 574.25, -2.222);
+        coPpm = powerLawPpm(log2Ratio, 36974, -3.109);
+        smokePpm = powerLawPpm(log2Ratio, 3616.1, -2.675);
+    }
+}
+
+/*
+ * ==================================================
+ * FUNCTION: READ MQ-2 SENSOR
+ * ==================================================
+ * Description:
+ *   Samples the MQ-2 once and evaluates the LPG, CO and smoke curves into
+ *   `lpg`, `co` and `smoke`. The same sample feeds the R0 baseline tracker.
+ */
+
+void readMQ2()
+{
+    beginPowerSection(PM_SECTION_ACQUISITION);
+    MQ2.update();
+
+    computeMQ2Concentrations(MQ2.getVoltage(false), MQ2.getR0(), lpg, co, smoke);
+    endPowerSection(PM_SECTION_ACQUISITION);
+
+    updateMQ2Baseline(MQ2.calibrate(MQ2_RATIO_CLEAN_AIR));
+}
+
+/*
+ * ==================================================
+ * FUNCTION: ACQUIRE ALL SENSORS
+ * ==================================================
+ * Description:
+ *   Reads every sensor and records the values, without display, logging or
+ *   alerts. Used to get the first sample out quickly at boot.
+ */
+
+void acquireAllSensors()
+{
+    readSoundSensor();
+    recordSensorReadings(GROUP_KY038);
+
+    if (readBME680())
+    {
+        recordSensorReadings(GROUP_BME680);
+    }
+
+    readMQ2();
+    recordSensorReadings(GROUP_MQ2);
+}
+
+/*
+ * ==================================================
+ * FUNCTION: SAMPLE SOUND PEAK
+ * ==================================================
+ * Description:
+ *   One KY-038 sample at the scheduler rate. `sound` is updated with the
+ *   loudest sample of each SOUND_WINDOW_US, which catches short noises a
+ *   single reading per loop() would miss.
+ */
+
+static void sampleSoundPeak()
+{
+    static float peak = 0;
+    static uint32_t count = 0;
+
+    float level = convertRawSoundToDecibels(analogRead(KY038_PIN));
+    if (level > peak)
+    {
+        peak = level;
+    }
+    if (++count >= SOUND_WINDOW_US / getSamplingPeriod(GROUP_KY038))
+    {
+        sound = peak;
+        recordSensorReadings(GROUP_KY038);
+        peak = 0;
+        count = 0;
+    }
+}
+
+/*
+ * ==================================================
+ * FUNCTION: SAMPLE SENSOR
+ * ==================================================
+ * Description:
+ *   Takes one scheduled sample of a sensor and records it. Runs on the
+ *   sensor's sampler task, as a watchdog acquisition stage. The MQ-2
+ *   drives the buzzer straight away (alert stage), so an alarm does not
+ *   wait for the display cycle in loop().
+ */
+
+void sampleSensor(SensorGroup group)
+{
+    if (!beginStage(STAGE_ACQUISITION))
+    {
+        return;
+    }
+    switch (group)
+    {
+    case GROUP_KY038:
+        sampleSoundPeak();
+        break;
+    case GROUP_MQ2:
+        readMQ2();
+        recordSensorReadings(GROUP_MQ2);
+        break;
+    case GROUP_BME680:
+        if (readBME680())
+        {
+            recordSensorReadings(GROUP_BME680);
+        }
+        break;
+    default:
+        break;
+    }
+    endStage(STAGE_ACQUISITION);
+
+    if (group == GROUP_MQ2 && beginStage(STAGE_ALERT))
+    {
+        updateAlarmBuzzer();
+        endStage(STAGE_ALERT);
+    }
+}
+
+/*
+ * ==================================================
+ * FUNCTION: PROCESS SOUND SENSOR
+ * ==================================================
+ * Description:
+ *   Displays the latest KY-038 sound level on the OLED and prints it to the
+ *   Serial Monitor, flagged when it is above the channel's warning
+ *   threshold. Sampling runs on the scheduler, see sampleSensor().
+ */
+
+void processSoundSensor()
+{
     // Display on OLED
-    displaySoundSensorReading(sound);
+    displaySensorReadings(GROUP_KY038);
 
     // Print to Serial Monitor
-    Serial.printf("Sound Level: %.1f dB\n", sound);
+    printSensorReadings(GROUP_KY038);
 }
 
 /*
@@ -31,35 +303,23 @@ void processSoundSensor()
  * FUNCTION: PROCESS BME680 SENSOR
  * ==================================================
  * Description:
- *   Reads environmental data from the BME680 sensor, including:
+ *   Displays the latest environmental data from the BME680 sensor, including:
  *   - Temperature (°C)
  *   - Humidity (%)
  *   - Pressure (hPa)
  *   - Gas resistance (kOhms)
  *   - Altitude (meters)
- *   Displays the readings on the OLED and prints any failures to the Serial Monitor.
+ *   - IAQ, eCO2 and IAQ accuracy
+ *   on the OLED and prints them to the Serial Monitor.
  */
 
 void processBME680()
 {
-    if (bme.performReading())
-    {
-        temperature = bme.temperature;
-        humidity = bme.humidity;
-        pressure = bme.pressure / 100.0;
-        gas = bme.gas_resistance / 1000.0;
-        altitude = bme.readAltitude(SEALEVELPRESSURE_HPA);
-
-        // Display on OLED
-        displayBME680Readings(temperature, humidity, pressure, gas, altitude);
+    // Display on OLED
+    displaySensorReadings(GROUP_BME680);
 
-        // Print to Serial Monitor
-        printBME680Readings(temperature, humidity, pressure, gas, altitude);
-    }
-    else
-    {
-        Serial.println("BME680 failed to perform reading!");
-    }
+    // Print to Serial Monitor
+    printSensorReadings(GROUP_BME680);
 }
 
 /*
@@ -67,36 +327,23 @@ void processBME680()
  * FUNCTION: PROCESS MQ-2 SENSOR
  * ==================================================
  * Description:
- *   Reads gas concentration data from the MQ-2 sensor, including:
+ *   Displays the latest gas concentrations from the MQ-2 sensor, including:
  *   - LPG (ppm)
  *   - CO (ppm)
  *   - Smoke (ppm)
- *   Displays the readings on the OLED and triggers safety alerts if thresholds
- *   are exceeded (via NeoPixels and buzzer).
+ *   on the OLED and refreshes the NeoPixel status. The buzzer follows the
+ *   alarm level at the MQ-2 sampling rate, see sampleSensor(); gas level
+ *   changes and early warnings reach the NeoPixels from there as well.
  */
 
 void processMQ2()
 {
-    MQ2.update();
-
-    MQ2.setA(574.25);
-    MQ2.setB(-2.222);
-    lpg = MQ2.readSensor();
-
-    MQ2.setA(36974);
-    MQ2.setB(-3.109);
-    co = MQ2.readSensor();
-
-    MQ2.setA(3616.1);
-    MQ2.setB(-2.675);
-    smoke = MQ2.readSensor();
-
     // Display on OLED
-    displayMQ2Readings(lpg, co, smoke);
+    displaySensorReadings(GROUP_MQ2);
 
     // Print to Serial Monitor
-    printMQ2Readings(lpg, co, smoke);
+    printSensorReadings(GROUP_MQ2);
 
-    // Trigger alerts if needed
-    checkSafetyAndAlert(lpg, co, smoke);
-}
\ No newline at end of file
+    // Refresh the status LEDs on the alert task
+    requestAlertUpdate();
+}
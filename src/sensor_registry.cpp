@@ -0,0 +1,373 @@
+#include "sensor_registry.h"
+#include "static_arena.h"
+#include "hardware_init.h"
+#include "helper_functions.h"
+#include "sensor_processing.h"
+#include "math_kernels.h"
+#include "power_management.h"
+#include "i2c_bus.h"
+#include "runtime_config.h"
+#include "alert_dispatch.h"
+
+// Sensors beyond the built-in ones. BME680s that do not answer at boot are
+// skipped, so unused entries cost nothing. ADC sensors cannot be probed and
+// must only be listed when wired. The main bus stays connected while a mux
+// channel is selected, so addresses behind the mux must differ from the
+// built-in BME680 (0x77) and the OLED (0x3C). They may repeat across
+// channels because only one channel is selected at a time.
+static const SensorConfig SENSOR_TABLE[] = {
+    {SENSOR_TYPE_BME680, "bedroom", 0, 0x76},
+    {SENSOR_TYPE_BME680, "kitchen", 1, 0x76},
+    // {SENSOR_TYPE_MQ2, "kitchen", MUX_NONE, 36},
+    // {SENSOR_TYPE_KY038, "bedroom", MUX_NONE, 35},
+};
+
+#define SENSOR_TABLE_SIZE (sizeof(SENSOR_TABLE) / sizeof(SENSOR_TABLE[0]))
+static_assert(SENSOR_TABLE_SIZE <= MAX_SENSOR_INSTANCES, "Raise MAX_SENSOR_INSTANCES");
+
+static const char *const TYPE_NAMES[NUM_SENSOR_TYPES] = {"bme680", "mq2", "ky038"};
+static const uint8_t VALUE_COUNTS[NUM_SENSOR_TYPES] = {5, 3, 1};
+static const char *const VALUE_NAMES[NUM_SENSOR_TYPES][MAX_SENSOR_VALUES] = {
+    {"temperature", "humidity", "pressure", "gas", "altitude"},
+    {"lpg", "co", "smoke"},
+    {"sound"},
+};
+// Built-in channel whose thresholds apply to each value
+static const SensorChannel VALUE_CHANNELS[NUM_SENSOR_TYPES][MAX_SENSOR_VALUES] = {
+    {CHANNEL_TEMPERATURE, CHANNEL_HUMIDITY, CHANNEL_PRESSURE, CHANNEL_GAS, CHANNEL_ALTITUDE},
+    {CHANNEL_LPG, CHANNEL_CO, CHANNEL_SMOKE},
+    {CHANNEL_SOUND},
+};
+
+// Instances sorted by mux channel, so a poll walks each channel once
+static SensorInstance instances[MAX_SENSOR_INSTANCES];
+static Adafruit_BME680 bmeDrivers[MAX_SENSOR_INSTANCES];
+static uint8_t instanceCount = 0;
+static bool muxPresent = false;
+static uint8_t selectedChannel = MUX_NONE;
+static SensorPollStats pollStats;
+
+/*
+ * ==================================================
+ * FUNCTION: SELECT MUX CHANNEL
+ * ==================================================
+ * Description:
+ *   Routes the bus to one TCA9548A channel, or to none with MUX_NONE. The
+ *   selection is cached so consecutive sensors on a channel cost nothing.
+ */
+
+static bool selectMuxChannel(uint8_t channel)
+{
+    if (channel == selectedChannel)
+    {
+        return true;
+    }
+    if (!muxPresent)
+    {
+        return channel == MUX_NONE;
+    }
+
+    Wire.beginTransmission(TCA9548A_ADDRESS);
+    Wire.write(channel == MUX_NONE ? 0 : (uint8_t)(1 << channel));
+    if (Wire.endTransmission() != 0)
+    {
+        return false;
+    }
+    selectedChannel = channel;
+    pollStats.muxSwitches++;
+    return true;
+}
+
+// Disconnect every mux channel before the bus is left alone for a while,
+// so nothing downstream answers while the built-in sensors and the OLED
+// use it
+static void deselectMux()
+{
+    if (selectedChannel != MUX_NONE && acquireI2CBus(I2C_CLIENT_REGISTRY))
+    {
+        selectMuxChannel(MUX_NONE);
+        releaseI2CBus(I2C_CLIENT_REGISTRY);
+    }
+}
+
+/*
+ * ==================================================
+ * FUNCTION: READ ADC SENSOR
+ * ==================================================
+ * Description:
+ *   Samples an MQ-2 or KY-038 instance. These sit on ADC pins and never
+ *   touch the I2C bus.
+ */
+
+static void readAdcSensor(SensorInstance &instance)
+{
+    int raw = analogRead(instance.config.location);
+    if (instance.config.type == SENSOR_TYPE_KY038)
+    {
+        instance.values[0] = convertRawSoundToDecibels(raw);
+    }
+    else
+    {
+        float volts = raw * MQ2_VOLTAGE_RESOLUTION / ((1 << MQ2_ADC_RESOLUTION) - 1);
+        computeMQ2Concentrations(volts, instance.r0, instance.values[0], instance.values[1], instance.values[2]);
+    }
+    instance.valid = true;
+}
+
+/*
+ * ==================================================
+ * FUNCTION: CALIBRATE MQ-2 INSTANCE
+ * ==================================================
+ * Description:
+ *   Clean-air R0 for an additional MQ-2, averaged like initializeMQ2().
+ */
+
+static float calibrateMQ2Instance(uint8_t pin)
+{
+    float r0 = 0;
+    for (int i = 0; i < 10; i++)
+    {
+        float volts = analogRead(pin) * MQ2_VOLTAGE_RESOLUTION / ((1 << MQ2_ADC_RESOLUTION) - 1);
+        r0 += mq2SensorResistance(volts) / MQ2_RATIO_CLEAN_AIR;
+        delay(100);
+    }
+    return r0 / 10;
+}
+
+/*
+ * ==================================================
+ * FUNCTION: INITIALIZE SENSOR REGISTRY
+ * ==================================================
+ * Description:
+ *   Probes the TCA9548A and every configured sensor, sorted by mux channel.
+ *   Sensors that fail are reported and left out of polling.
+ */
+
+void initializeSensorRegistry()
+{
+    muxPresent = false;
+    if (acquireI2CBus(I2C_CLIENT_REGISTRY))
+    {
+        Wire.beginTransmission(TCA9548A_ADDRESS);
+        muxPresent = Wire.endTransmission() == 0;
+        releaseI2CBus(I2C_CLIENT_REGISTRY);
+    }
+
+    instanceCount = 0;
+    for (size_t i = 0; i < SENSOR_TABLE_SIZE; i++)
+    {
+        // Insertion sort by mux channel, table order within a channel
+        int slot = instanceCount++;
+        while (slot > 0 && instances[slot - 1].config.muxChannel > SENSOR_TABLE[i].muxChannel)
+        {
+            instances[slot] = instances[slot - 1];
+            slot--;
+        }
+        instances[slot] = SensorInstance();
+        instances[slot].config = SENSOR_TABLE[i];
+    }
+
+    for (uint8_t i = 0; i < instanceCount; i++)
+    {
+        SensorInstance &instance = instances[i];
+        switch (instance.config.type)
+        {
+        case SENSOR_TYPE_BME680:
+            if (!acquireI2CBus(I2C_CLIENT_REGISTRY))
+            {
+                break;
+            }
+            instance.present = selectMuxChannel(instance.config.muxChannel) &&
+                               bmeDrivers[i].begin(instance.config.location);
+            if (instance.present)
+            {
+                configureBME680(bmeDrivers[i]);
+            }
+            releaseI2CBus(I2C_CLIENT_REGISTRY);
+            break;
+        case SENSOR_TYPE_MQ2:
+            instance.r0 = calibrateMQ2Instance(instance.config.location);
+            instance.present = instance.r0 > 0 && !isinf(instance.r0);
+            break;
+        case SENSOR_TYPE_KY038:
+            pinMode(instance.config.location, INPUT);
+            instance.present = true;
+            break;
+        default:
+            break;
+        }
+        logPrintf("Sensor %s/%s %s\n", instance.config.room, TYPE_NAMES[instance.config.type],
+                  instance.present ? "initialized!" : "not found");
+    }
+    deselectMux();
+}
+
+/*
+ * ==================================================
+ * FUNCTION: POLL SENSOR REGISTRY
+ * ==================================================
+ * Description:
+ *   Reads every registered sensor in two passes. The first pass selects
+ *   each mux channel once, starts all BME680 measurements on it and samples
+ *   the ADC sensors. After one shared heater wait, the second pass collects
+ *   the results. Each pass ends by deselecting the mux, so nothing
+ *   downstream is connected during the heater wait or between polls: with
+ *   n channels in use that is 2n + 2 mux writes per poll. Each sensor
+ *   access is one bus transaction (see i2c_bus.h), so a poll never holds
+ *   the bus across the heater wait; between the transactions of one pass
+ *   a channel stays selected, which is why downstream addresses must
+ *   differ from the built-in ones. A change of the registry's alarm level
+ *   wakes the alert task.
+ */
+
+void pollSensorRegistry()
+{
+    if (instanceCount == 0)
+    {
+        return;
+    }
+    unsigned long start = millis();
+    unsigned long readyAt = 0;
+
+    beginPowerSection(PM_SECTION_ACQUISITION);
+    for (uint8_t i = 0; i < instanceCount; i++)
+    {
+        SensorInstance &instance = instances[i];
+        if (!instance.present)
+        {
+            continue;
+        }
+        if (instance.config.type != SENSOR_TYPE_BME680)
+        {
+            readAdcSensor(instance);
+        }
+        else if (acquireI2CBus(I2C_CLIENT_REGISTRY))
+        {
+            if (selectMuxChannel(instance.config.muxChannel))
+            {
+                instance.readyAt = bmeDrivers[i].beginReading();
+                if (instance.readyAt > readyAt)
+                {
+                    readyAt = instance.readyAt;
+                }
+            }
+            releaseI2CBus(I2C_CLIENT_REGISTRY);
+        }
+    }
+    deselectMux();
+    endPowerSection(PM_SECTION_ACQUISITION);
+
+    if (readyAt != 0 && millis() < readyAt)
+    {
+        delay(readyAt - millis());
+    }
+
+    beginPowerSection(PM_SECTION_ACQUISITION);
+    for (uint8_t i = 0; i < instanceCount; i++)
+    {
+        SensorInstance &instance = instances[i];
+        if (instance.readyAt == 0 || !acquireI2CBus(I2C_CLIENT_REGISTRY))
+        {
+            continue;
+        }
+        if (!selectMuxChannel(instance.config.muxChannel))
+        {
+            releaseI2CBus(I2C_CLIENT_REGISTRY);
+            continue;
+        }
+        instance.readyAt = 0;
+        Adafruit_BME680 &sensor = bmeDrivers[i];
+        instance.valid = sensor.endReading();
+        releaseI2CBus(I2C_CLIENT_REGISTRY);
+        if (instance.valid)
+        {
+            instance.values[0] = sensor.temperature;
+            instance.values[1] = sensor.humidity;
+            instance.values[2] = sensor.pressure / 100.0;
+            instance.values[3] = sensor.gas_resistance / 1000.0;
+            instance.values[4] = altitudeFromPressure(instance.values[2]);
+        }
+    }
+    deselectMux();
+    endPowerSection(PM_SECTION_ACQUISITION);
+
+    pollStats.polls++;
+    pollStats.lastPollMs = millis() - start;
+
+    static ChannelLevel shownLevel = LEVEL_NORMAL;
+    ChannelLevel level = getSensorRegistryLevel();
+    if (level != shownLevel)
+    {
+        shownLevel = level;
+        requestAlertUpdate();
+    }
+}
+
+/*
+ * ==================================================
+ * FUNCTION: GET SENSOR REGISTRY LEVEL
+ * ==================================================
+ * Description:
+ *   Highest threshold level among the registry readings whose channel has
+ *   an alarm threshold, as worstAlarmLevel() does for the built-in ones.
+ *   Called from the alert task and the MQ-2 sampler while loop() polls;
+ *   a reading is a single float, so it is either old or new.
+ */
+
+ChannelLevel getSensorRegistryLevel()
+{
+    ChannelLevel worst = LEVEL_NORMAL;
+    for (uint8_t i = 0; i < instanceCount; i++)
+    {
+        const SensorInstance &instance = instances[i];
+        if (!instance.valid)
+        {
+            continue;
+        }
+        SensorType type = instance.config.type;
+        for (uint8_t v = 0; v < VALUE_COUNTS[type]; v++)
+        {
+            SensorChannel channel = VALUE_CHANNELS[type][v];
+            if (isnan(getChannelThresholds(channel).alarm))
+            {
+                continue;
+            }
+            ChannelLevel level = getChannelLevel(channel, instance.values[v]);
+            if (level > worst)
+            {
+                worst = level;
+            }
+        }
+    }
+    return worst;
+}
+
+uint8_t getSensorInstanceCount()
+{
+    return instanceCount;
+}
+
+const SensorInstance &getSensorInstance(uint8_t index)
+{
+    return instances[index];
+}
+
+uint8_t getSensorValueCount(SensorType type)
+{
+    return VALUE_COUNTS[type];
+}
+
+const char *getSensorTypeName(SensorType type)
+{
+    return TYPE_NAMES[type];
+}
+
+const char *getSensorValueName(SensorType type, uint8_t value)
+{
+    return VALUE_NAMES[type][value];
+}
+
+SensorPollStats getSensorPollStats()
+{
+    return pollStats;
+}
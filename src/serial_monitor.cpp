@@ -1,76 +1,55 @@
 #include "serial_monitor.h"
+#include "static_arena.h"
 #include "helper_functions.h"
+#include "runtime_config.h"
 
 /*
  * ==================================================
- * FUNCTION: PRINT BME680 DATA
+ * FUNCTION: PRINT SENSOR READINGS
  * ==================================================
  * Description:
- *   Prints sensor readings from the BME680 to the Serial Monitor. The readings
- *   include temperature, humidity, pressure, gas resistance, and altitude,
- *   formatted for easy debugging and monitoring.
+ *   Prints every channel of one sensor to the Serial Monitor, with units
+ *   and precision from SENSOR_CHANNEL_TABLE. Channels above their warning
+ *   or alarm threshold get a warning line; sensors with thresholds report
+ *   when everything is within limits.
  */
 
-void printBME680Readings(float temperature, float humidity, float pressure, float gas, float altitude)
+void printSensorReadings(SensorGroup group)
 {
-    Serial.println(F("BME680 Sensor Readings:"));
-    Serial.printf("Temperature: %.1f °C\n", temperature);
-    Serial.printf("Relative Humidity: %.1f %%\n", humidity);
-    Serial.printf("Barometric Pressure: %.1f hPa\n", pressure);
-    Serial.printf("Gas Resistance: %.1f kOhms\n", gas);
-    Serial.printf("Altitude: %.1f m\n", altitude);
-    Serial.println("----------------------------");
-}
+    logPrintf("%s Sensor Readings:\n", SENSOR_GROUP_LABELS[group]);
 
-/*
- * ==================================================
- *  FUNCTION: PRINT MQ-2 DATA
- * ==================================================
- * Description:
- *   Prints sensor readings from the MQ-2 sensor to the Serial Monitor. The
- *   readings include LPG, CO, and smoke levels, along with warnings if any
- *   values exceed safe thresholds.
- */
-
-void printMQ2Readings(float lpg, float co, float smoke)
-{
-    Serial.println(F("MQ-2 Sensor Readings:"));
-    Serial.printf("LPG: %.1f ppm\n", lpg);
-    Serial.printf("CO: %.1f ppm\n", co);
-    Serial.printf("Smoke: %.1f ppm\n", smoke);
-
-    if (lpg > 1000 || co > 50 || smoke > 200)
-    {
-        Serial.println("Warning: Unsafe gas levels detected!");
-    }
-    else
+    char reading[24];
+    bool hasThresholds = false;
+    bool withinLimits = true;
+    for (int ch = 0; ch < NUM_CHANNELS; ch++)
     {
-        Serial.println("Gas levels are within safe limits.");
+        const ChannelDescriptor &descriptor = CHANNELS[ch];
+        if (descriptor.group != group)
+        {
+            continue;
+        }
+        formatChannelReading((SensorChannel)ch, reading, sizeof(reading));
+        logPrintf("%s: %s\n", descriptor.label, reading);
+
+        ChannelThresholds thresholds = getChannelThresholds((SensorChannel)ch);
+        hasThresholds |= !isnan(thresholds.warn) || !isnan(thresholds.alarm);
+        withinLimits &= getChannelLevel((SensorChannel)ch) == LEVEL_NORMAL;
     }
-    Serial.println("----------------------------");
-}
-
-/*
- * ==================================================
- *  FUNCTION: PRINT KY-038 DATA
- * ==================================================
- * Description:
- *   Prints sensor readings from the KY-038 sound sensor to the Serial Monitor.
- *   Indicates whether the sound level exceeds the threshold for loudness.
- */
-
-void printSoundSensorReadings(float soundLevel)
-{
-    Serial.println(F("KY-038 Sound Sensor Readings:"));
-    Serial.printf("Sound Level: %.1f dB\n", soundLevel);
 
-    if (soundLevel > LOUD_THRESHOLD)
+    if (!withinLimits)
     {
-        Serial.println("Warning: Loud sound detected!");
+        for (int ch = 0; ch < NUM_CHANNELS; ch++)
+        {
+            ChannelLevel level = getChannelLevel((SensorChannel)ch);
+            if (CHANNELS[ch].group == group && level != LEVEL_NORMAL)
+            {
+                logPrintf("Warning: %s %s!\n", level == LEVEL_ALARM ? "Unsafe" : "High", CHANNELS[ch].label);
+            }
+        }
     }
-    else
+    else if (hasThresholds)
     {
-        Serial.println("Sound levels are within safe limits.");
+        logPrintf("%s readings are within safe limits.\n", SENSOR_GROUP_LABELS[group]);
     }
     Serial.println("----------------------------");
 }
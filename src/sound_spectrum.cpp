@@ -0,0 +1,183 @@
+#include "sound_spectrum.h"
+#include "hardware_init.h"
+#include "static_arena.h"
+#include "power_management.h"
+#include "memory_monitor.h"
+#include <Arduino.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+// Frames averaged into each reported band level
+#define SPECTRUM_WINDOW_FRAMES (SOUND_WINDOW_US / 1000 / SPECTRUM_FRAME_INTERVAL_MS)
+
+// Capture buffer, analysed in place (aligned for the ESP-DSP kernels);
+// owned by the spectrum task
+alignas(16) static float frame[SPECTRUM_FRAME_SIZE];
+static AlarmTonePattern pattern;
+static SoundSpectrum spectrum;
+static portMUX_TYPE spectrumMux = portMUX_INITIALIZER_UNLOCKED;
+
+/*
+ * ==================================================
+ * FUNCTION: CAPTURE FRAME
+ * ==================================================
+ * Description:
+ *   Reads one frame from the KY-038, each sample at its slot on a fixed
+ *   SPECTRUM_SAMPLE_PERIOD_US grid by spinning on esp_timer. Returns false,
+ *   and stops early, when a sample starts more than
+ *   SPECTRUM_LATE_LIMIT_US late.
+ */
+
+static bool captureFrame()
+{
+    beginPowerSection(PM_SECTION_ACQUISITION);
+    int64_t slotUs = esp_timer_get_time();
+    bool onTime = true;
+    for (int n = 0; n < SPECTRUM_FRAME_SIZE && onTime; n++)
+    {
+        int64_t now;
+        while ((now = esp_timer_get_time()) < slotUs)
+        {
+        }
+        onTime = now - slotUs <= SPECTRUM_LATE_LIMIT_US;
+        frame[n] = analogRead(KY038_PIN);
+        slotUs += SPECTRUM_SAMPLE_PERIOD_US;
+    }
+    endPowerSection(PM_SECTION_ACQUISITION);
+    return onTime;
+}
+
+/*
+ * ==================================================
+ * FUNCTION: SPECTRUM TASK
+ * ==================================================
+ * Description:
+ *   Captures and analyses one frame every SPECTRUM_FRAME_INTERVAL_MS.
+ *   Band powers are averaged over SPECTRUM_WINDOW_FRAMES frames before
+ *   they are reported; the tone decision goes to the T3 matcher at once.
+ */
+
+static void spectrumTask(void *)
+{
+    float bandSums[NUM_SOUND_BANDS] = {};
+    int windowFrames = 0;
+    TickType_t wake = xTaskGetTickCount();
+
+    for (;;)
+    {
+        vTaskDelayUntil(&wake, pdMS_TO_TICKS(SPECTRUM_FRAME_INTERVAL_MS));
+        if (!captureFrame())
+        {
+            portENTER_CRITICAL(&spectrumMux);
+            spectrum.droppedFrames++;
+            portEXIT_CRITICAL(&spectrumMux);
+            continue;
+        }
+
+        int64_t startUs = esp_timer_get_time();
+        SpectrumFrame result;
+        analyzeSpectrumFrame(frame, result);
+        uint32_t analysisUs = (uint32_t)(esp_timer_get_time() - startUs);
+
+        bool heard = updateAlarmTonePattern(pattern, result.tone, millis());
+
+        for (int b = 0; b < NUM_SOUND_BANDS; b++)
+        {
+            bandSums[b] += result.bandPower[b];
+        }
+        bool windowDone = ++windowFrames >= SPECTRUM_WINDOW_FRAMES;
+
+        portENTER_CRITICAL(&spectrumMux);
+        bool started = heard && !spectrum.alarmTone;
+        bool stopped = !heard && spectrum.alarmTone;
+        if (windowDone)
+        {
+            for (int b = 0; b < NUM_SOUND_BANDS; b++)
+            {
+                spectrum.bandDbfs[b] = powerToDbfs(bandSums[b] / windowFrames);
+            }
+        }
+        spectrum.toneShare = result.toneShare;
+        spectrum.toneHz = result.toneHz;
+        spectrum.alarmTone = heard;
+        spectrum.alarmToneDetections += started ? 1 : 0;
+        spectrum.frames++;
+        spectrum.analysisUs = analysisUs;
+        portEXIT_CRITICAL(&spectrumMux);
+
+        if (windowDone)
+        {
+            memset(bandSums, 0, sizeof(bandSums));
+            windowFrames = 0;
+        }
+        if (started)
+        {
+            logPrintf("Alarm tone: T3 pattern heard at %.0f Hz\n", result.toneHz);
+        }
+        else if (stopped)
+        {
+            logPrintf("Alarm tone: stopped\n");
+        }
+    }
+}
+
+/*
+ * ==================================================
+ * FUNCTION: START SOUND SPECTRUM
+ * ==================================================
+ * Description:
+ *   Builds the FFT tables and starts the capture task on the sampler core,
+ *   below the samplers so it never delays a scheduled sample.
+ */
+
+void startSoundSpectrum()
+{
+    initializeSpectrumKernels();
+    for (int b = 0; b < NUM_SOUND_BANDS; b++)
+    {
+        spectrum.bandDbfs[b] = SPECTRUM_SILENCE_DBFS;
+    }
+
+    TaskHandle_t task = NULL;
+    xTaskCreatePinnedToCore(spectrumTask, "spectrum", SPECTRUM_TASK_STACK, NULL, SPECTRUM_TASK_PRIORITY, &task,
+                            SAMPLER_CORE);
+    watchTaskAllocations(task);
+    logPrintf("Sound spectrum: %d-point frames at %d Hz every %d ms (%s FFT)\n", SPECTRUM_FRAME_SIZE,
+              SPECTRUM_SAMPLE_RATE_HZ, SPECTRUM_FRAME_INTERVAL_MS,
+#ifdef SPECTRUM_USE_ESP_DSP
+              "ESP-DSP"
+#else
+              "portable"
+#endif
+    );
+}
+
+/*
+ * ==================================================
+ * FUNCTION: GET SOUND SPECTRUM
+ * ==================================================
+ * Description:
+ *   Snapshot of the band levels, alarm tone state and frame counters.
+ */
+
+SoundSpectrum getSoundSpectrum()
+{
+    portENTER_CRITICAL(&spectrumMux);
+    SoundSpectrum snapshot = spectrum;
+    portEXIT_CRITICAL(&spectrumMux);
+    return snapshot;
+}
+
+/*
+ * ==================================================
+ * FUNCTION: IS ALARM TONE ACTIVE
+ * ==================================================
+ * Description:
+ *   True while a smoke alarm's T3 pattern is being heard.
+ */
+
+bool isAlarmToneActive()
+{
+    return spectrum.alarmTone;
+}
@@ -0,0 +1,332 @@
+#include "sound_spectrum.h"
+#include <math.h>
+#ifdef SPECTRUM_USE_ESP_DSP
+#include <esp_dsp.h>
+#endif
+
+static_assert((SPECTRUM_FRAME_SIZE & (SPECTRUM_FRAME_SIZE - 1)) == 0, "SPECTRUM_FRAME_SIZE must be a power of two");
+static_assert((SPECTRUM_FFT_MAX_SIZE & (SPECTRUM_FFT_MAX_SIZE - 1)) == 0, "SPECTRUM_FFT_MAX_SIZE must be a power of two");
+static_assert(SPECTRUM_FFT_MAX_SIZE >= SPECTRUM_FRAME_SIZE, "SPECTRUM_FFT_MAX_SIZE below the frame size");
+
+#define SPECTRUM_BIN_HZ ((float)SPECTRUM_SAMPLE_RATE_HZ / SPECTRUM_FRAME_SIZE)
+#define SPECTRUM_TONE_SPREAD 2 // Bins either side of the peak (Hann main lobe)
+
+#define SOUND_BAND_CENTRE(centreHz) centreHz,
+const uint16_t SOUND_BAND_CENTRES_HZ[NUM_SOUND_BANDS] = {SOUND_BAND_TABLE(SOUND_BAND_CENTRE)};
+#undef SOUND_BAND_CENTRE
+
+static float twiddleCos[SPECTRUM_FFT_MAX_SIZE / 2]; // cos(2πk / SPECTRUM_FFT_MAX_SIZE)
+static float twiddleSin[SPECTRUM_FFT_MAX_SIZE / 2]; // sin(2πk / SPECTRUM_FFT_MAX_SIZE)
+static float window[SPECTRUM_FRAME_SIZE];           // Hann
+static uint16_t bandFirstBin[NUM_SOUND_BANDS];
+static uint16_t bandLastBin[NUM_SOUND_BANDS];
+static uint16_t toneFirstBin;
+static uint16_t toneLastBin;
+
+/*
+ * ==================================================
+ * FUNCTION: INITIALIZE SPECTRUM KERNELS
+ * ==================================================
+ * Description:
+ *   Fills the twiddle and window tables and maps the octave bands and the
+ *   tone range to FFT bins. With ESP-DSP, also sets up its FFT tables
+ *   (allocated, so this must run before sealHeap()).
+ */
+
+void initializeSpectrumKernels()
+{
+    for (int k = 0; k < SPECTRUM_FFT_MAX_SIZE / 2; k++)
+    {
+        double angle = 2.0 * M_PI * k / SPECTRUM_FFT_MAX_SIZE;
+        twiddleCos[k] = (float)cos(angle);
+        twiddleSin[k] = (float)sin(angle);
+    }
+    for (int n = 0; n < SPECTRUM_FRAME_SIZE; n++)
+    {
+        window[n] = (float)(0.5 - 0.5 * cos(2.0 * M_PI * n / SPECTRUM_FRAME_SIZE));
+    }
+
+    const int lastBin = SPECTRUM_FRAME_SIZE / 2 - 1;
+    for (int b = 0; b < NUM_SOUND_BANDS; b++)
+    {
+        int first = (int)ceilf(SOUND_BAND_CENTRES_HZ[b] * (float)M_SQRT1_2 / SPECTRUM_BIN_HZ);
+        int last = (int)ceilf(SOUND_BAND_CENTRES_HZ[b] * (float)M_SQRT2 / SPECTRUM_BIN_HZ) - 1;
+        bandFirstBin[b] = first < 1 ? 1 : first;
+        bandLastBin[b] = last > lastBin ? lastBin : last;
+    }
+    toneFirstBin = (uint16_t)ceilf(SPECTRUM_TONE_LOW_HZ / SPECTRUM_BIN_HZ);
+    toneLastBin = (uint16_t)(SPECTRUM_TONE_HIGH_HZ / SPECTRUM_BIN_HZ);
+    if (toneLastBin > lastBin - SPECTRUM_TONE_SPREAD)
+    {
+        toneLastBin = lastBin - SPECTRUM_TONE_SPREAD;
+    }
+
+#ifdef SPECTRUM_USE_ESP_DSP
+    dsps_fft2r_init_fc32(NULL, SPECTRUM_FFT_MAX_SIZE / 2);
+#endif
+}
+
+/*
+ * ==================================================
+ * FUNCTION: COMPLEX FFT
+ * ==================================================
+ * Description:
+ *   In-place forward radix-2 FFT of `points` interleaved complex values:
+ *   bit-reversal permutation, then log2(points) butterfly passes with
+ *   twiddles strided out of the shared table.
+ */
+
+#ifndef SPECTRUM_USE_ESP_DSP
+static void complexFFT(float *data, uint16_t points)
+{
+    for (uint16_t i = 1, j = 0; i < points; i++)
+    {
+        uint16_t bit = points >> 1;
+        for (; j & bit; bit >>= 1)
+        {
+            j ^= bit;
+        }
+        j |= bit;
+        if (i < j)
+        {
+            float re = data[2 * i];
+            float im = data[2 * i + 1];
+            data[2 * i] = data[2 * j];
+            data[2 * i + 1] = data[2 * j + 1];
+            data[2 * j] = re;
+            data[2 * j + 1] = im;
+        }
+    }
+
+    for (uint16_t length = 2; length <= points; length <<= 1)
+    {
+        uint16_t half = length >> 1;
+        uint16_t stride = SPECTRUM_FFT_MAX_SIZE / length;
+        for (uint16_t start = 0; start < points; start += length)
+        {
+            for (uint16_t k = 0; k < half; k++)
+            {
+                float wr = twiddleCos[k * stride];
+                float wi = -twiddleSin[k * stride];
+                float *a = data + 2 * (start + k);
+                float *b = a + 2 * half;
+                float tr = b[0] * wr - b[1] * wi;
+                float ti = b[0] * wi + b[1] * wr;
+                b[0] = a[0] - tr;
+                b[1] = a[1] - ti;
+                a[0] += tr;
+                a[1] += ti;
+            }
+        }
+    }
+}
+#endif
+
+/*
+ * ==================================================
+ * FUNCTION: REAL FFT
+ * ==================================================
+ * Description:
+ *   In-place FFT of `size` real samples (a power of two, at most
+ *   SPECTRUM_FFT_MAX_SIZE), as a complex FFT of size/2 points on the
+ *   even/odd samples followed by the split into the real spectrum. Packed
+ *   output: data[0] is bin 0, data[1] the Nyquist bin, data[2k] and
+ *   data[2k + 1] the real and imaginary parts of bin k.
+ */
+
+void realFFT(float *data, uint16_t size)
+{
+    uint16_t points = size / 2;
+#ifdef SPECTRUM_USE_ESP_DSP
+    dsps_fft2r_fc32(data, points);
+    dsps_bit_rev_fc32(data, points);
+#else
+    complexFFT(data, points);
+#endif
+
+    float dc = data[0];
+    data[0] = dc + data[1];
+    data[1] = dc - data[1];
+
+    uint16_t stride = SPECTRUM_FFT_MAX_SIZE / size;
+    for (uint16_t k = 1; k <= points / 2; k++)
+    {
+        float *zk = data + 2 * k;
+        float *zm = data + 2 * (points - k);
+        float er = 0.5f * (zk[0] + zm[0]);
+        float ei = 0.5f * (zk[1] - zm[1]);
+        float or_ = 0.5f * (zk[1] + zm[1]);
+        float oi = -0.5f * (zk[0] - zm[0]);
+        float wr = twiddleCos[k * stride];
+        float wi = -twiddleSin[k * stride];
+        float tr = wr * or_ - wi * oi;
+        float ti = wr * oi + wi * or_;
+        zk[0] = er + tr;
+        zk[1] = ei + ti;
+        if (zm != zk)
+        {
+            zm[0] = er - tr;
+            zm[1] = ti - ei;
+        }
+    }
+}
+
+/*
+ * ==================================================
+ * FUNCTION: ANALYZE SPECTRUM FRAME
+ * ==================================================
+ * Description:
+ *   Removes the DC offset of a frame of raw ADC counts, applies the Hann
+ *   window and sums the FFT power into the octave bands. Also finds the
+ *   strongest bin in the alarm tone range and its share of the power above
+ *   the lowest band. Overwrites the frame.
+ */
+
+void analyzeSpectrumFrame(float *frame, SpectrumFrame &result)
+{
+    float mean = 0;
+    for (int n = 0; n < SPECTRUM_FRAME_SIZE; n++)
+    {
+        mean += frame[n];
+    }
+    mean /= SPECTRUM_FRAME_SIZE;
+    for (int n = 0; n < SPECTRUM_FRAME_SIZE; n++)
+    {
+        frame[n] = (frame[n] - mean) * window[n];
+    }
+
+    realFFT(frame, SPECTRUM_FRAME_SIZE);
+
+    // One-sided Hann power of a full-scale sine: 3 N² A² / 32
+    const float scale = 32.0f / (3.0f * SPECTRUM_FRAME_SIZE * SPECTRUM_FRAME_SIZE * SPECTRUM_FULL_SCALE *
+                                 SPECTRUM_FULL_SCALE);
+    float total = 0;
+    for (int b = 0; b < NUM_SOUND_BANDS; b++)
+    {
+        float power = 0;
+        for (int k = bandFirstBin[b]; k <= bandLastBin[b]; k++)
+        {
+            power += frame[2 * k] * frame[2 * k] + frame[2 * k + 1] * frame[2 * k + 1];
+        }
+        result.bandPower[b] = power * scale;
+        total += power;
+    }
+
+    int peak = toneFirstBin;
+    float peakPower = -1;
+    for (int k = toneFirstBin; k <= toneLastBin; k++)
+    {
+        float power = frame[2 * k] * frame[2 * k] + frame[2 * k + 1] * frame[2 * k + 1];
+        if (power > peakPower)
+        {
+            peakPower = power;
+            peak = k;
+        }
+    }
+    float tonePower = 0;
+    for (int k = peak - SPECTRUM_TONE_SPREAD; k <= peak + SPECTRUM_TONE_SPREAD; k++)
+    {
+        tonePower += frame[2 * k] * frame[2 * k] + frame[2 * k + 1] * frame[2 * k + 1];
+    }
+
+    result.tonePower = tonePower * scale;
+    result.toneShare = total > 0 ? tonePower / total : 0;
+    result.toneHz = peak * SPECTRUM_BIN_HZ;
+    result.tone = result.toneShare >= SPECTRUM_TONE_SHARE && powerToDbfs(result.tonePower) >= SPECTRUM_TONE_MIN_DBFS;
+}
+
+/*
+ * ==================================================
+ * FUNCTION: UPDATE ALARM TONE PATTERN
+ * ==================================================
+ * Description:
+ *   Feeds one frame's tone decision into the T3 matcher and returns true
+ *   while the alarm tone is heard: from the T3_CYCLES-th complete cycle
+ *   in a row until T3_HOLD_MS after the last one. Pulses and gaps are
+ *   timed from one change to the next; anything outside the T3 limits (a
+ *   continuous tone, a fourth pulse, a gap of the wrong length) starts
+ *   the count over. A cycle completes when the pause after the third
+ *   pulse reaches T3_PAUSE_MIN_MS.
+ */
+
+static void restartPattern(AlarmTonePattern &pattern)
+{
+    pattern.pulses = 0;
+    pattern.cycles = 0;
+    pattern.pauseOpen = false;
+}
+
+bool updateAlarmTonePattern(AlarmTonePattern &pattern, bool tone, uint32_t nowMs)
+{
+    uint32_t elapsed = nowMs - pattern.edgeMs;
+    if (tone == pattern.tone)
+    {
+        if (tone && elapsed > T3_PULSE_MAX_MS)
+        {
+            restartPattern(pattern);
+        }
+        else if (!tone && pattern.pulses == T3_PULSES && elapsed >= T3_PAUSE_MIN_MS)
+        {
+            pattern.pulses = 0;
+            pattern.pauseOpen = true;
+            pattern.lastCycleMs = nowMs;
+            if (++pattern.cycles >= T3_CYCLES)
+            {
+                pattern.cycles = T3_CYCLES;
+                pattern.heard = true;
+            }
+        }
+        else if (!tone && (pattern.pauseOpen || pattern.pulses != 0) && elapsed > T3_PAUSE_MAX_MS)
+        {
+            restartPattern(pattern);
+        }
+    }
+    else
+    {
+        pattern.tone = tone;
+        pattern.edgeMs = nowMs;
+        bool pulse = elapsed >= T3_PULSE_MIN_MS && elapsed <= T3_PULSE_MAX_MS;
+        if (!tone)
+        {
+            // End of a pulse
+            if (pulse && pattern.pulses < T3_PULSES)
+            {
+                pattern.pulses++;
+            }
+            else
+            {
+                restartPattern(pattern);
+            }
+        }
+        else if (pattern.pauseOpen)
+        {
+            // First pulse of the next cycle
+            pattern.pauseOpen = false;
+        }
+        else if (pattern.pulses != 0 && !pulse)
+        {
+            restartPattern(pattern);
+        }
+    }
+
+    if (pattern.heard && nowMs - pattern.lastCycleMs > T3_HOLD_MS)
+    {
+        pattern.heard = false;
+    }
+    return pattern.heard;
+}
+
+/*
+ * ==================================================
+ * FUNCTION: POWER TO DBFS
+ * ==================================================
+ * Description:
+ *   Level in dBFS of a power relative to a full-scale sine, with silence
+ *   clamped to SPECTRUM_SILENCE_DBFS.
+ */
+
+float powerToDbfs(float power)
+{
+    float level = power > 0 ? 10.0f * log10f(power) : SPECTRUM_SILENCE_DBFS;
+    return level < SPECTRUM_SILENCE_DBFS ? SPECTRUM_SILENCE_DBFS : level;
+}
@@ -0,0 +1,459 @@
+#include "stage_watchdog.h"
+#include "static_arena.h"
+#include "hardware_init.h"
+#include "runtime_config.h"
+#include "memory_monitor.h"
+#include "alert_dispatch.h"
+#include "../lib/mqtt/mqtt_functions.h"
+#include <Arduino.h>
+#include <esp_system.h>
+#include <esp_task_wdt.h>
+#include <esp_timer.h>
+#include <esp_idf_version.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#define WDT_EVENT_MAGIC 0x57444745 // Marks lastEvent as written before a watchdog reboot
+
+#define WATCHDOG_STAGE_NAME(id, name, deadlineMs, escalation) name,
+const char *const WATCHDOG_STAGE_NAMES[NUM_WATCHDOG_STAGES] = {WATCHDOG_STAGE_TABLE(WATCHDOG_STAGE_NAME)};
+#undef WATCHDOG_STAGE_NAME
+
+#define WATCHDOG_STAGE_DEADLINE(id, name, deadlineMs, escalation) deadlineMs,
+const uint32_t WATCHDOG_DEFAULT_DEADLINES_MS[NUM_WATCHDOG_STAGES] = {WATCHDOG_STAGE_TABLE(WATCHDOG_STAGE_DEADLINE)};
+#undef WATCHDOG_STAGE_DEADLINE
+
+#define WATCHDOG_STAGE_ESCALATION(id, name, deadlineMs, escalation) escalation,
+const WatchdogEscalation WATCHDOG_DEFAULT_ESCALATIONS[NUM_WATCHDOG_STAGES] = {WATCHDOG_STAGE_TABLE(WATCHDOG_STAGE_ESCALATION)};
+#undef WATCHDOG_STAGE_ESCALATION
+
+const char *const WATCHDOG_ESCALATION_NAMES[WDT_REBOOT + 1] = {"skip", "reset", "reboot"};
+
+// A task that runs stages, and where it is
+struct StageSlot
+{
+    TaskHandle_t task;
+    int8_t stage; // -1 between stages
+    bool skipNext;
+    int64_t startUs;
+    uint32_t missed;     // Deadlines missed by the current run
+    uint8_t consecutive; // Deadlines missed in a row, across runs
+};
+
+static StageSlot slots[WDT_MAX_TASKS];
+static StageStats stageStats[NUM_WATCHDOG_STAGES];
+static bool resetPending[NUM_WATCHDOG_STAGES];
+static uint32_t lastResetMs[NUM_WATCHDOG_STAGES];
+static TaskHandle_t loopTaskHandle = NULL;
+static TaskHandle_t resetTask = NULL;
+static bool taskWatchdogReset = false;
+static portMUX_TYPE watchdogMux = portMUX_INITIALIZER_UNLOCKED;
+
+RTC_NOINIT_ATTR static uint32_t eventMagic;
+RTC_NOINIT_ATTR static WatchdogEvent lastEvent;
+
+// Slot of a task, claimed on first use. Call with watchdogMux held.
+static StageSlot *findSlot(TaskHandle_t task)
+{
+    StageSlot *free = NULL;
+    for (int i = 0; i < WDT_MAX_TASKS; i++)
+    {
+        if (slots[i].task == task)
+        {
+            return &slots[i];
+        }
+        if (free == NULL && slots[i].task == NULL)
+        {
+            free = &slots[i];
+        }
+    }
+    if (free != NULL)
+    {
+        free->task = task;
+        free->stage = -1;
+    }
+    return free;
+}
+
+// Reset the ESP-IDF task watchdog when loop() passes a stage boundary
+static void feedTaskWatchdog(TaskHandle_t task)
+{
+    if (task == loopTaskHandle)
+    {
+        esp_task_wdt_reset();
+    }
+}
+
+/*
+ * ==================================================
+ * FUNCTION: RESET STAGE PERIPHERAL
+ * ==================================================
+ * Description:
+ *   Re-initialises what a stage talks to: the BME680 (and an MQ-2 without
+ *   a valid R0), the NeoPixels, the broker connection or the OLED. Runs in
+ *   the reset worker, as a hung task cannot reset its own peripheral and
+ *   a sampler must not block in a re-init. The NeoPixels come back blank,
+ *   so the alert task is asked to show the status again.
+ */
+
+static void resetStagePeripheral(WatchdogStage stage)
+{
+    logPrintf("Watchdog: resetting %s peripheral\n", WATCHDOG_STAGE_NAMES[stage]);
+    permitHeapAllocation(true); // Drivers allocate in begin()
+    switch (stage)
+    {
+    case STAGE_ACQUISITION:
+        initializeBME680();
+        if (!(MQ2.getR0() > 0) || isinf(MQ2.getR0()))
+        {
+            initializeMQ2();
+        }
+        break;
+    case STAGE_ALERT:
+        initializeNeoPixels();
+        requestAlertUpdate();
+        break;
+    case STAGE_PUBLISH:
+        resetMQTTConnection(client);
+        break;
+    case STAGE_RENDER:
+        initializeOLED();
+        break;
+    default:
+        break;
+    }
+    permitHeapAllocation(false);
+}
+
+/*
+ * ==================================================
+ * FUNCTION: RESET WORKER TASK
+ * ==================================================
+ * Description:
+ *   Carries out pending peripheral resets, at most one per stage every
+ *   WDT_RESET_HOLDOFF_MS. Sleeps until a reset is scheduled, or until the
+ *   hold-off of a pending one runs out.
+ */
+
+static void resetWorkerTask(void *)
+{
+    for (;;)
+    {
+        TickType_t wait = portMAX_DELAY;
+        for (int s = 0; s < NUM_WATCHDOG_STAGES; s++)
+        {
+            bool reset = false;
+            uint32_t holdMs = 0;
+            portENTER_CRITICAL(&watchdogMux);
+            uint32_t sinceMs = millis() - lastResetMs[s];
+            if (resetPending[s] && (lastResetMs[s] == 0 || sinceMs >= WDT_RESET_HOLDOFF_MS))
+            {
+                resetPending[s] = false;
+                lastResetMs[s] = millis() | 1;
+                stageStats[s].resets++;
+                reset = true;
+            }
+            else if (resetPending[s])
+            {
+                holdMs = WDT_RESET_HOLDOFF_MS - sinceMs;
+            }
+            portEXIT_CRITICAL(&watchdogMux);
+
+            // Outside the spinlock: peripheral initialisation blocks
+            if (reset)
+            {
+                resetStagePeripheral((WatchdogStage)s);
+            }
+            else if (holdMs > 0 && pdMS_TO_TICKS(holdMs) + 1 < wait)
+            {
+                wait = pdMS_TO_TICKS(holdMs) + 1;
+            }
+        }
+        ulTaskNotifyTake(pdTRUE, wait);
+    }
+}
+
+// Wake the reset worker after scheduling a reset
+static void notifyResetWorker()
+{
+    if (resetTask != NULL)
+    {
+        xTaskNotifyGive(resetTask);
+    }
+}
+
+/*
+ * ==================================================
+ * FUNCTION: WATCHDOG MONITOR TASK
+ * ==================================================
+ * Description:
+ *   Checks every task's current stage against its deadline. Each deadline
+ *   that passes while the stage is still running is one more consecutive
+ *   miss and one step up the escalation ladder: skip the task's next run,
+ *   then reset the peripheral, then reboot, capped at the stage's
+ *   configured escalation. A stage that finishes in time clears the
+ *   ladder of its task.
+ */
+
+static void watchdogMonitorTask(void *)
+{
+    for (;;)
+    {
+        vTaskDelay(pdMS_TO_TICKS(WDT_CHECK_INTERVAL_MS));
+        int64_t now = esp_timer_get_time();
+        uint32_t sequence = lastEvent.sequence;
+        bool reboot = false;
+        bool reset = false;
+
+        portENTER_CRITICAL(&watchdogMux);
+        for (int i = 0; i < WDT_MAX_TASKS; i++)
+        {
+            StageSlot &slot = slots[i];
+            if (slot.task == NULL || slot.stage < 0)
+            {
+                continue;
+            }
+            WatchdogStage stage = (WatchdogStage)slot.stage;
+            uint32_t deadlineMs = getStageDeadlineMs(stage);
+            uint32_t elapsedMs = (now - slot.startUs) / 1000;
+            while (slot.missed < elapsedMs / deadlineMs)
+            {
+                if (slot.missed++ == 0)
+                {
+                    stageStats[stage].overruns++;
+                }
+                if (slot.consecutive < 255)
+                {
+                    slot.consecutive++;
+                }
+
+                WatchdogEscalation action = slot.consecutive >= WDT_REBOOT_AFTER  ? WDT_REBOOT
+                                            : slot.consecutive >= WDT_RESET_AFTER ? WDT_RESET_PERIPHERAL
+                                                                                  : WDT_SKIP;
+                if (action > getStageEscalation(stage))
+                {
+                    action = getStageEscalation(stage);
+                }
+                slot.skipNext = true;
+                resetPending[stage] |= action >= WDT_RESET_PERIPHERAL;
+                reset |= action >= WDT_RESET_PERIPHERAL;
+                reboot |= action == WDT_REBOOT;
+
+                lastEvent.sequence++;
+                lastEvent.stage = stage;
+                strncpy(lastEvent.task, pcTaskGetName(slot.task), sizeof(lastEvent.task) - 1);
+                lastEvent.task[sizeof(lastEvent.task) - 1] = '\0';
+                lastEvent.elapsedMs = elapsedMs;
+                lastEvent.deadlineMs = deadlineMs;
+                lastEvent.action = action;
+                lastEvent.beforeReboot = false;
+            }
+        }
+        WatchdogEvent event = lastEvent;
+        portEXIT_CRITICAL(&watchdogMux);
+
+        if (reset)
+        {
+            notifyResetWorker();
+        }
+        if (event.sequence != sequence)
+        {
+            logPrintf("Watchdog: %s overran in task %s (%lu ms, deadline %lu ms), %s\n",
+                      WATCHDOG_STAGE_NAMES[event.stage], event.task, (unsigned long)event.elapsedMs,
+                      (unsigned long)event.deadlineMs, WATCHDOG_ESCALATION_NAMES[event.action]);
+        }
+        if (reboot)
+        {
+            lastEvent.beforeReboot = true;
+            eventMagic = WDT_EVENT_MAGIC;
+            Serial.flush();
+            ESP.restart();
+        }
+    }
+}
+
+/*
+ * ==================================================
+ * FUNCTION: INITIALIZE STAGE WATCHDOG
+ * ==================================================
+ * Description:
+ *   Subscribes the calling task (setup() runs on the loop() task) to the
+ *   ESP-IDF task watchdog with a WDT_TASK_TIMEOUT_S timeout and starts the
+ *   deadline monitor and the reset worker. Failures reported before this
+ *   are reset once the worker runs. An overrun recorded just before a watchdog reboot is
+ *   kept in RTC memory and reported again after it.
+ */
+
+void initializeStageWatchdog()
+{
+    taskWatchdogReset = esp_reset_reason() == ESP_RST_TASK_WDT;
+    if (eventMagic == WDT_EVENT_MAGIC && lastEvent.stage < NUM_WATCHDOG_STAGES)
+    {
+        logPrintf("Watchdog: rebooted after %s overran in task %s\n", WATCHDOG_STAGE_NAMES[lastEvent.stage],
+                  lastEvent.task);
+        lastEvent.sequence = 1;
+    }
+    else
+    {
+        memset(&lastEvent, 0, sizeof(lastEvent));
+    }
+    eventMagic = 0;
+    if (taskWatchdogReset)
+    {
+        Serial.println("Watchdog: the task watchdog reset the device");
+    }
+
+#if ESP_IDF_VERSION_MAJOR >= 5
+    esp_task_wdt_config_t config = {};
+    config.timeout_ms = WDT_TASK_TIMEOUT_S * 1000;
+    config.idle_core_mask = 1 << 0; // Arduino default: only the protocol core's idle task
+    config.trigger_panic = true;
+    if (esp_task_wdt_reconfigure(&config) != ESP_OK)
+    {
+        esp_task_wdt_init(&config);
+    }
+#else
+    esp_task_wdt_init(WDT_TASK_TIMEOUT_S, true);
+#endif
+    loopTaskHandle = xTaskGetCurrentTaskHandle();
+    esp_task_wdt_add(loopTaskHandle);
+
+    TaskHandle_t monitorTask = NULL;
+    xTaskCreate(watchdogMonitorTask, "watchdog", WDT_TASK_STACK, NULL, WDT_TASK_PRIORITY, &monitorTask);
+    watchTaskAllocations(monitorTask);
+    // Not watched: resets allocate in the drivers and the network stack
+    xTaskCreate(resetWorkerTask, "wdt_reset", WDT_RESET_TASK_STACK, NULL, WDT_RESET_TASK_PRIORITY, &resetTask);
+    logPrintf("Stage watchdog started (task watchdog %d s)\n", WDT_TASK_TIMEOUT_S);
+}
+
+/*
+ * ==================================================
+ * FUNCTION: BEGIN / END STAGE
+ * ==================================================
+ * Description:
+ *   Bracket one run of a stage. beginStage() returns false if the calling
+ *   task is to skip this run after an overrun; the caller then does not
+ *   call endStage(). Stages begun before
+ *   initializeStageWatchdog() are timed, but nothing watches them.
+ */
+
+bool beginStage(WatchdogStage stage)
+{
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    feedTaskWatchdog(self);
+
+    bool run = true;
+    portENTER_CRITICAL(&watchdogMux);
+    StageSlot *slot = findSlot(self);
+    if (slot != NULL && slot->skipNext)
+    {
+        slot->skipNext = false;
+        stageStats[stage].skips++;
+        run = false;
+    }
+    else if (slot != NULL)
+    {
+        slot->stage = stage;
+        slot->startUs = esp_timer_get_time();
+        slot->missed = 0;
+    }
+    portEXIT_CRITICAL(&watchdogMux);
+    return run;
+}
+
+void endStage(WatchdogStage stage)
+{
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&watchdogMux);
+    StageSlot *slot = findSlot(self);
+    if (slot != NULL && slot->stage == stage)
+    {
+        uint32_t elapsedMs = (now - slot->startUs) / 1000;
+        StageStats &stats = stageStats[stage];
+        stats.runs++;
+        stats.lastMs = elapsedMs;
+        if (elapsedMs > stats.worstMs)
+        {
+            stats.worstMs = elapsedMs;
+        }
+        if (slot->missed == 0)
+        {
+            slot->consecutive = 0;
+        }
+        slot->stage = -1;
+    }
+    portEXIT_CRITICAL(&watchdogMux);
+
+    feedTaskWatchdog(self);
+}
+
+/*
+ * ==================================================
+ * FUNCTION: FEED LOOP WATCHDOG
+ * ==================================================
+ * Description:
+ *   For loop() code that waits between stages, such as the display pages
+ *   (frames are sent by the writer task, outside loop()'s stages). Resets
+ *   the task watchdog when called from loop()'s task, does nothing
+ *   elsewhere.
+ */
+
+void feedLoopWatchdog()
+{
+    feedTaskWatchdog(xTaskGetCurrentTaskHandle());
+}
+
+/*
+ * ==================================================
+ * FUNCTION: REPORT STAGE FAILURE
+ * ==================================================
+ * Description:
+ *   For code that detects a dead peripheral itself (e.g. at init): counts
+ *   the failure and schedules a peripheral reset, so it is retried every
+ *   WDT_RESET_HOLDOFF_MS instead of halting the device. Not for a
+ *   peripheral that is simply not fitted, which would be retried forever.
+ */
+
+void reportStageFailure(WatchdogStage stage)
+{
+    portENTER_CRITICAL(&watchdogMux);
+    stageStats[stage].failures++;
+    resetPending[stage] = true;
+    portEXIT_CRITICAL(&watchdogMux);
+    notifyResetWorker();
+}
+
+/*
+ * ==================================================
+ * FUNCTION: GET STAGE STATS / LAST WATCHDOG EVENT
+ * ==================================================
+ * Description:
+ *   Snapshots for MQTT and /metrics. The stats carry the deadline and
+ *   escalation currently configured for the stage.
+ */
+
+StageStats getStageStats(WatchdogStage stage)
+{
+    portENTER_CRITICAL(&watchdogMux);
+    StageStats stats = stageStats[stage];
+    portEXIT_CRITICAL(&watchdogMux);
+
+    stats.deadlineMs = getStageDeadlineMs(stage);
+    stats.escalation = getStageEscalation(stage);
+    return stats;
+}
+
+WatchdogEvent getLastWatchdogEvent()
+{
+    portENTER_CRITICAL(&watchdogMux);
+    WatchdogEvent event = lastEvent;
+    portEXIT_CRITICAL(&watchdogMux);
+    return event;
+}
+
+bool lastResetByTaskWatchdog()
+{
+    return taskWatchdogReset;
+}
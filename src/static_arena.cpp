@@ -0,0 +1,56 @@
+#include "static_arena.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+StaticArena staticArena;
+
+static StaticSemaphore_t logMutexBuffer;
+static SemaphoreHandle_t logMutex = NULL;
+
+/*
+ * ==================================================
+ * FUNCTION: INITIALIZE STATIC ARENA
+ * ==================================================
+ * Description:
+ *   Creates the log line lock in static storage. Call first thing in
+ *   setup(), before any task that logs is started.
+ */
+
+void initializeStaticArena()
+{
+    if (logMutex == NULL)
+    {
+        logMutex = xSemaphoreCreateMutexStatic(&logMutexBuffer);
+    }
+}
+
+/*
+ * ==================================================
+ * FUNCTION: LOG PRINTF
+ * ==================================================
+ * Description:
+ *   printf to Serial through the arena's log line. Print::printf()
+ *   allocates on the heap for lines over 64 characters; this never does.
+ *   Lines longer than LOG_LINE_MAX - 1 are cut.
+ */
+
+void logPrintf(const char *format, ...)
+{
+    if (logMutex != NULL)
+    {
+        xSemaphoreTake(logMutex, portMAX_DELAY);
+    }
+
+    va_list args;
+    va_start(args, format);
+    vsnprintf(staticArena.logLine, LOG_LINE_MAX, format, args);
+    va_end(args);
+    Serial.print(staticArena.logLine);
+
+    if (logMutex != NULL)
+    {
+        xSemaphoreGive(logMutex);
+    }
+}
@@ -0,0 +1,292 @@
+#include "time_series_store.h"
+#include "static_arena.h"
+#include <string.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+// Ring of blocks for one channel at one resolution
+struct TsRing
+{
+    TsBlock *blocks;
+    uint8_t capacity;
+    uint8_t head; // Block currently being appended to
+    uint8_t used; // Blocks holding data
+};
+
+// Running mean of the bucket currently being rolled up
+struct TsRollup
+{
+    uint32_t bucketStart;
+    float sum;
+    uint16_t count;
+};
+
+static const uint32_t BUCKET_SECONDS[TS_NUM_RESOLUTIONS] = {1, 60, 3600};
+
+#define TS_RAW_CHANNEL_BLOCK_COUNT(id, variable, group, name, topic, label, unit, precision, warn, alarm) \
+    TS_RAW_BLOCKS_##group,
+static const uint8_t RAW_CHANNEL_BLOCKS[NUM_CHANNELS] = {SENSOR_CHANNEL_TABLE(TS_RAW_CHANNEL_BLOCK_COUNT)};
+#undef TS_RAW_CHANNEL_BLOCK_COUNT
+
+static TsBlock (&rawBlocks)[TS_RAW_TOTAL_BLOCKS] = staticArena.tsRawBlocks;
+static TsBlock (&minuteBlocks)[NUM_CHANNELS][TS_MINUTE_BLOCKS] = staticArena.tsMinuteBlocks;
+static TsBlock (&hourBlocks)[NUM_CHANNELS][TS_HOUR_BLOCKS] = staticArena.tsHourBlocks;
+
+static TsRing rings[NUM_CHANNELS][TS_NUM_RESOLUTIONS];
+static TsRollup rollups[NUM_CHANNELS][TS_NUM_RESOLUTIONS];
+
+// Serialises appends against readers running on other tasks (HTTP server)
+static SemaphoreHandle_t storeMutex = NULL;
+
+/*
+ * ==================================================
+ * FUNCTION: APPEND TO RING
+ * ==================================================
+ * Description:
+ *   Encodes a sample into the newest block of a ring, moving on to (and
+ *   overwriting) the oldest block when the current one is full.
+ */
+
+static void appendToRing(TsRing &ring, uint32_t timestamp, float value)
+{
+    TsBlock *block = &ring.blocks[ring.head];
+
+    if (ring.used > 0 && block->count > 0 && timestamp < block->lastTimestamp)
+    {
+        return; // Out-of-order sample, keep the stream monotonic
+    }
+
+    if (ring.used == 0)
+    {
+        ring.used = 1;
+    }
+    else if (block->bitLength + TS_MAX_SAMPLE_BITS > TS_BLOCK_BYTES * 8)
+    {
+        ring.head = (ring.head + 1) % ring.capacity;
+        if (ring.used < ring.capacity)
+        {
+            ring.used++;
+        }
+        block = &ring.blocks[ring.head];
+        block->count = 0;
+        block->generation++;
+    }
+
+    encodeTimeSeriesSample(*block, timestamp, value);
+}
+
+/*
+ * ==================================================
+ * FUNCTION: ACCUMULATE ROLLUP
+ * ==================================================
+ * Description:
+ *   Averages samples per bucket. When a sample opens a new bucket, the mean
+ *   of the previous one is stored at this resolution and cascades into the
+ *   next coarser one.
+ */
+
+static void accumulateRollup(SensorChannel channel, uint8_t resolution, uint32_t timestamp, float value)
+{
+    TsRollup &rollup = rollups[channel][resolution];
+    uint32_t bucket = timestamp - timestamp % BUCKET_SECONDS[resolution];
+
+    if (rollup.count > 0 && bucket != rollup.bucketStart)
+    {
+        float mean = rollup.sum / rollup.count;
+        appendToRing(rings[channel][resolution], rollup.bucketStart, mean);
+        if (resolution + 1 < TS_NUM_RESOLUTIONS)
+        {
+            accumulateRollup(channel, resolution + 1, rollup.bucketStart, mean);
+        }
+        rollup.count = 0;
+        rollup.sum = 0;
+    }
+
+    if (rollup.count == 0)
+    {
+        rollup.bucketStart = bucket;
+    }
+    rollup.sum += value;
+    rollup.count++;
+}
+
+/*
+ * ==================================================
+ * FUNCTION: INITIALIZE TIME SERIES STORE
+ * ==================================================
+ * Description:
+ *   Binds every channel's rings to their static block storage and clears
+ *   all history. The raw blocks are handed out in channel order.
+ */
+
+void initializeTimeSeriesStore()
+{
+    if (storeMutex == NULL)
+    {
+        storeMutex = xSemaphoreCreateMutex();
+    }
+
+    TsBlock *nextRawBlock = rawBlocks;
+    for (int ch = 0; ch < NUM_CHANNELS; ch++)
+    {
+        rings[ch][TS_RAW] = {nextRawBlock, RAW_CHANNEL_BLOCKS[ch], 0, 0};
+        nextRawBlock += RAW_CHANNEL_BLOCKS[ch];
+        rings[ch][TS_MINUTE] = {minuteBlocks[ch], TS_MINUTE_BLOCKS, 0, 0};
+        rings[ch][TS_HOUR] = {hourBlocks[ch], TS_HOUR_BLOCKS, 0, 0};
+        for (int res = 0; res < TS_NUM_RESOLUTIONS; res++)
+        {
+            rings[ch][res].blocks[0].count = 0;
+            rollups[ch][res] = {0, 0, 0};
+        }
+    }
+}
+
+/*
+ * ==================================================
+ * FUNCTION: APPEND TIME SERIES
+ * ==================================================
+ * Description:
+ *   Feeds a reading into the 1 s raw bucket, which cascades into the
+ *   minute/hour rollups. A second's mean is stored once a reading of a
+ *   later second arrives. Timestamps are in seconds and must not go
+ *   backwards.
+ */
+
+void appendTimeSeries(SensorChannel channel, uint32_t timestamp, float value)
+{
+    lockTimeSeriesStore();
+    accumulateRollup(channel, TS_RAW, timestamp, value);
+    unlockTimeSeriesStore();
+}
+
+/*
+ * ==================================================
+ * FUNCTION: BEGIN TIME SERIES QUERY
+ * ==================================================
+ * Description:
+ *   Positions an iterator on the oldest block of a channel/resolution.
+ *   Points are returned in time order within [from, to].
+ */
+
+void beginTimeSeriesQuery(TsIterator &it, SensorChannel channel, TsResolution resolution, uint32_t from, uint32_t to)
+{
+    const TsRing &ring = rings[channel][resolution];
+
+    it.channel = channel;
+    it.resolution = resolution;
+    it.from = from;
+    it.to = to;
+    it.blocksLeft = ring.used;
+    it.blockIndex = (ring.head + ring.capacity - (ring.used > 0 ? ring.used - 1 : 0)) % ring.capacity;
+    it.sampleIndex = 0;
+}
+
+/*
+ * ==================================================
+ * FUNCTION: NEXT TIME SERIES POINT
+ * ==================================================
+ * Description:
+ *   Returns the next point in range, or false once the range is exhausted.
+ *   Blocks that end before the range are skipped without decoding, and a
+ *   block recycled since the iterator entered it is abandoned.
+ */
+
+bool nextTimeSeriesPoint(TsIterator &it, uint32_t &timestamp, float &value)
+{
+    const TsRing &ring = rings[it.channel][it.resolution];
+
+    while (it.blocksLeft > 0)
+    {
+        const TsBlock &block = ring.blocks[it.blockIndex];
+
+        if (it.sampleIndex == 0 && (block.count == 0 || block.lastTimestamp < it.from))
+        {
+            it.blocksLeft--;
+            it.blockIndex = (it.blockIndex + 1) % ring.capacity;
+            continue;
+        }
+
+        if (it.sampleIndex > 0 && block.generation != it.generation)
+        {
+            it.sampleIndex = block.count; // Overwritten under us
+        }
+
+        if (it.sampleIndex >= block.count)
+        {
+            it.blocksLeft--;
+            it.blockIndex = (it.blockIndex + 1) % ring.capacity;
+            it.sampleIndex = 0;
+            continue;
+        }
+
+        if (it.sampleIndex == 0)
+        {
+            it.generation = block.generation;
+        }
+        decodeTimeSeriesSample(it, block);
+        if (it.timestamp > it.to)
+        {
+            it.blocksLeft = 0;
+            return false;
+        }
+        if (it.timestamp >= it.from)
+        {
+            timestamp = it.timestamp;
+            memcpy(&value, &it.valueBits, sizeof(value));
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * ==================================================
+ * FUNCTION: GET TIME SERIES STORE USAGE
+ * ==================================================
+ * Description:
+ *   Reports retained samples and their encoded size. The compression ratio
+ *   against plain (uint32 timestamp, float) pairs is samples * 8 / encodedBytes.
+ */
+
+TsStoreUsage getTimeSeriesStoreUsage()
+{
+    TsStoreUsage usage = {0, 0, sizeof(rawBlocks) + sizeof(minuteBlocks) + sizeof(hourBlocks)};
+    for (int ch = 0; ch < NUM_CHANNELS; ch++)
+    {
+        for (int res = 0; res < TS_NUM_RESOLUTIONS; res++)
+        {
+            const TsRing &ring = rings[ch][res];
+            for (uint8_t i = 0; i < ring.used; i++)
+            {
+                const TsBlock &block = ring.blocks[(ring.head + ring.capacity - i) % ring.capacity];
+                usage.samples += block.count;
+                usage.encodedBytes += (block.bitLength + 7) / 8;
+            }
+        }
+    }
+    return usage;
+}
+
+/*
+ * ==================================================
+ * FUNCTION: LOCK / UNLOCK TIME SERIES STORE
+ * ==================================================
+ * Description:
+ *   Guards the store against concurrent appends while another task iterates.
+ */
+
+void lockTimeSeriesStore()
+{
+    if (storeMutex != NULL)
+    {
+        xSemaphoreTake(storeMutex, portMAX_DELAY);
+    }
+}
+
+void unlockTimeSeriesStore()
+{
+    if (storeMutex != NULL)
+    {
+        xSemaphoreGive(storeMutex);
+    }
+}
@@ -0,0 +1,214 @@
+#include "time_series_store.h"
+#include <string.h>
+
+/*
+ * ==================================================
+ * BIT STREAM HELPERS
+ * ==================================================
+ * Description:
+ *   MSB-first bit packing into a block payload, a byte at a time.
+ */
+
+static void writeBits(TsBlock &block, uint32_t value, uint8_t nbits)
+{
+    while (nbits > 0)
+    {
+        uint16_t byteIndex = block.bitLength >> 3;
+        uint8_t bitOffset = block.bitLength & 7;
+        uint8_t space = 8 - bitOffset;
+        uint8_t take = nbits < space ? nbits : space;
+        uint8_t chunk = (value >> (nbits - take)) & ((1u << take) - 1);
+
+        if (bitOffset == 0)
+        {
+            block.data[byteIndex] = 0;
+        }
+        block.data[byteIndex] |= chunk << (space - take);
+        block.bitLength += take;
+        nbits -= take;
+    }
+}
+
+static uint32_t readBits(const TsBlock &block, uint16_t &bitPos, uint8_t nbits)
+{
+    uint32_t value = 0;
+    while (nbits > 0)
+    {
+        uint8_t bitOffset = bitPos & 7;
+        uint8_t space = 8 - bitOffset;
+        uint8_t take = nbits < space ? nbits : space;
+        uint8_t chunk = (block.data[bitPos >> 3] >> (space - take)) & ((1u << take) - 1);
+
+        value = (value << take) | chunk;
+        bitPos += take;
+        nbits -= take;
+    }
+    return value;
+}
+
+static inline int32_t signExtend(uint32_t value, uint8_t nbits)
+{
+    uint32_t signBit = 1u << (nbits - 1);
+    return (int32_t)((value ^ signBit) - signBit);
+}
+
+static inline uint32_t floatToBits(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+/*
+ * ==================================================
+ * FUNCTION: ENCODE TIME SERIES SAMPLE
+ * ==================================================
+ * Description:
+ *   Appends one sample to an open block. Timestamps are stored as
+ *   delta-of-delta in 1/9/12/16/36-bit buckets, values as the XOR with the
+ *   previous value, reusing the previous leading/trailing-zero window when
+ *   it fits (Gorilla, adapted to 32-bit floats).
+ */
+
+void encodeTimeSeriesSample(TsBlock &block, uint32_t timestamp, float value)
+{
+    uint32_t valueBits = floatToBits(value);
+
+    if (block.count == 0)
+    {
+        block.firstTimestamp = timestamp;
+        block.lastTimestamp = timestamp;
+        block.lastDelta = 0;
+        block.lastValueBits = valueBits;
+        block.lastLeading = TS_NO_WINDOW;
+        block.lastTrailing = 0;
+        block.bitLength = 0;
+        writeBits(block, valueBits, 32);
+        block.count = 1;
+        return;
+    }
+
+    // Timestamp: delta-of-delta
+    int32_t delta = (int32_t)(timestamp - block.lastTimestamp);
+    int32_t dod = delta - block.lastDelta;
+    if (dod == 0)
+    {
+        writeBits(block, 0b0, 1);
+    }
+    else if (dod >= -64 && dod <= 63)
+    {
+        writeBits(block, 0b10, 2);
+        writeBits(block, (uint32_t)dod & 0x7F, 7);
+    }
+    else if (dod >= -256 && dod <= 255)
+    {
+        writeBits(block, 0b110, 3);
+        writeBits(block, (uint32_t)dod & 0x1FF, 9);
+    }
+    else if (dod >= -2048 && dod <= 2047)
+    {
+        writeBits(block, 0b1110, 4);
+        writeBits(block, (uint32_t)dod & 0xFFF, 12);
+    }
+    else
+    {
+        writeBits(block, 0b1111, 4);
+        writeBits(block, (uint32_t)dod, 32);
+    }
+    block.lastDelta = delta;
+    block.lastTimestamp = timestamp;
+
+    // Value: XOR with previous
+    uint32_t xorBits = valueBits ^ block.lastValueBits;
+    if (xorBits == 0)
+    {
+        writeBits(block, 0b0, 1);
+    }
+    else
+    {
+        uint8_t leading = __builtin_clz(xorBits);
+        uint8_t trailing = __builtin_ctz(xorBits);
+
+        if (block.lastLeading != TS_NO_WINDOW && leading >= block.lastLeading && trailing >= block.lastTrailing)
+        {
+            uint8_t meaningful = 32 - block.lastLeading - block.lastTrailing;
+            writeBits(block, 0b10, 2);
+            writeBits(block, xorBits >> block.lastTrailing, meaningful);
+        }
+        else
+        {
+            uint8_t meaningful = 32 - leading - trailing;
+            writeBits(block, 0b11, 2);
+            writeBits(block, leading, 5);
+            writeBits(block, meaningful - 1, 5);
+            writeBits(block, xorBits >> trailing, meaningful);
+            block.lastLeading = leading;
+            block.lastTrailing = trailing;
+        }
+    }
+    block.lastValueBits = valueBits;
+    block.count++;
+}
+
+/*
+ * ==================================================
+ * FUNCTION: DECODE TIME SERIES SAMPLE
+ * ==================================================
+ * Description:
+ *   Reads the next sample of the iterator's current block, mirroring
+ *   encodeTimeSeriesSample().
+ */
+
+void decodeTimeSeriesSample(TsIterator &it, const TsBlock &block)
+{
+    if (it.sampleIndex == 0)
+    {
+        it.bitPos = 0;
+        it.timestamp = block.firstTimestamp;
+        it.delta = 0;
+        it.valueBits = readBits(block, it.bitPos, 32);
+        it.leading = TS_NO_WINDOW;
+        it.trailing = 0;
+        it.sampleIndex = 1;
+        return;
+    }
+
+    // Timestamp
+    int32_t dod;
+    if (readBits(block, it.bitPos, 1) == 0)
+    {
+        dod = 0;
+    }
+    else if (readBits(block, it.bitPos, 1) == 0)
+    {
+        dod = signExtend(readBits(block, it.bitPos, 7), 7);
+    }
+    else if (readBits(block, it.bitPos, 1) == 0)
+    {
+        dod = signExtend(readBits(block, it.bitPos, 9), 9);
+    }
+    else if (readBits(block, it.bitPos, 1) == 0)
+    {
+        dod = signExtend(readBits(block, it.bitPos, 12), 12);
+    }
+    else
+    {
+        dod = (int32_t)readBits(block, it.bitPos, 32);
+    }
+    it.delta += dod;
+    it.timestamp += it.delta;
+
+    // Value
+    if (readBits(block, it.bitPos, 1) == 1)
+    {
+        if (readBits(block, it.bitPos, 1) == 1)
+        {
+            it.leading = readBits(block, it.bitPos, 5);
+            uint8_t meaningful = readBits(block, it.bitPos, 5) + 1;
+            it.trailing = 32 - it.leading - meaningful;
+        }
+        uint8_t meaningful = 32 - it.leading - it.trailing;
+        it.valueBits ^= readBits(block, it.bitPos, meaningful) << it.trailing;
+    }
+    it.sampleIndex++;
+}
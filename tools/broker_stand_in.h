@@ -0,0 +1,332 @@
+// Minimal MQTT 3.1.1 broker for the host tests, so they run without a
+// mosquitto install. One thread serves every client with poll(): CONNECT,
+// SUBSCRIBE (filters with + and #), UNSUBSCRIBE, PUBLISH, PINGREQ and
+// DISCONNECT. Messages are routed at QoS 0; a QoS 1 PUBLISH is
+// acknowledged and delivered at QoS 0. Retained messages are not stored.
+//
+// Framing is checked strictly: a remaining length that does not match the
+// packet's contents, or an unknown packet type, counts as a protocol error
+// and closes the client, as a real broker would. Header-only, Linux only.
+
+#ifndef BROKER_STAND_IN_H
+#define BROKER_STAND_IN_H
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct BrokerStandIn
+{
+    int listenFd = -1;
+    int port = 0;
+    std::thread thread;
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> routed{0};         // PUBLISH packets delivered to subscribers
+    std::atomic<uint64_t> protocolErrors{0}; // Clients closed for malformed packets
+};
+
+struct BrokerClient
+{
+    int fd;
+    std::string in;
+    std::vector<std::string> filters;
+};
+
+// MQTT topic filter match with + (one level) and # (rest of the topic)
+static bool brokerTopicMatches(const std::string &filter, const std::string &topic)
+{
+    size_t f = 0;
+    size_t t = 0;
+    while (f < filter.size())
+    {
+        if (filter[f] == '#')
+        {
+            return true;
+        }
+        if (filter[f] == '+')
+        {
+            while (t < topic.size() && topic[t] != '/')
+            {
+                t++;
+            }
+            f++;
+            continue;
+        }
+        if (t >= topic.size() || filter[f] != topic[t])
+        {
+            return false;
+        }
+        f++;
+        t++;
+    }
+    return t == topic.size();
+}
+
+static void brokerSend(BrokerClient &client, const std::string &packet)
+{
+    size_t sent = 0;
+    while (sent < packet.size())
+    {
+        ssize_t n = send(client.fd, packet.data() + sent, packet.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0)
+        {
+            return; // Closed by the reader on its next poll
+        }
+        sent += n;
+    }
+}
+
+static std::string brokerPacket(uint8_t header, const std::string &body)
+{
+    std::string packet(1, (char)header);
+    size_t length = body.size();
+    do
+    {
+        uint8_t digit = length % 128;
+        length /= 128;
+        packet += (char)(length > 0 ? digit | 0x80 : digit);
+    } while (length > 0);
+    return packet + body;
+}
+
+// Reads a length-prefixed string at pos; false if it runs past the end
+static bool brokerString(const std::string &body, size_t &pos, std::string &text)
+{
+    if (pos + 2 > body.size())
+    {
+        return false;
+    }
+    size_t length = ((uint8_t)body[pos] << 8) | (uint8_t)body[pos + 1];
+    if (pos + 2 + length > body.size())
+    {
+        return false;
+    }
+    text.assign(body, pos + 2, length);
+    pos += 2 + length;
+    return true;
+}
+
+// Handles one complete packet; false on a protocol error (counted) or
+// DISCONNECT
+static bool brokerHandle(BrokerStandIn &broker, std::vector<BrokerClient> &clients, size_t index, uint8_t header,
+                         const std::string &body)
+{
+    size_t pos = 0;
+    std::string text;
+    switch (header >> 4)
+    {
+    case 1: // CONNECT
+        brokerSend(clients[index], std::string("\x20\x02\x00\x00", 4));
+        return true;
+    case 3: // PUBLISH
+    {
+        uint8_t qos = (header >> 1) & 3;
+        if (!brokerString(body, pos, text) || qos > 1 || (qos == 1 && pos + 2 > body.size()))
+        {
+            broker.protocolErrors++;
+            return false;
+        }
+        if (qos == 1)
+        {
+            brokerSend(clients[index], brokerPacket(0x40, body.substr(pos, 2)));
+            pos += 2;
+        }
+        std::string forward;
+        forward += (char)(text.size() >> 8);
+        forward += (char)(text.size() & 0xFF);
+        forward += text;
+        forward.append(body, pos, std::string::npos);
+        std::string packet = brokerPacket(0x30, forward);
+        for (BrokerClient &client : clients)
+        {
+            for (const std::string &filter : client.filters)
+            {
+                if (brokerTopicMatches(filter, text))
+                {
+                    brokerSend(client, packet);
+                    broker.routed++;
+                    break;
+                }
+            }
+        }
+        return true;
+    }
+    case 8:  // SUBSCRIBE
+    case 10: // UNSUBSCRIBE
+    {
+        if (body.size() < 2)
+        {
+            broker.protocolErrors++;
+            return false;
+        }
+        bool subscribe = header >> 4 == 8;
+        std::string reply = body.substr(0, 2);
+        pos = 2;
+        while (pos < body.size())
+        {
+            if (!brokerString(body, pos, text) || (subscribe && pos >= body.size()))
+            {
+                broker.protocolErrors++;
+                return false;
+            }
+            std::vector<std::string> &filters = clients[index].filters;
+            if (subscribe)
+            {
+                filters.push_back(text);
+                reply += (char)0;
+                pos++;
+            }
+            else
+            {
+                for (size_t i = 0; i < filters.size(); i++)
+                {
+                    if (filters[i] == text)
+                    {
+                        filters.erase(filters.begin() + i);
+                        break;
+                    }
+                }
+            }
+        }
+        brokerSend(clients[index], brokerPacket(subscribe ? 0x90 : 0xB0, reply));
+        return true;
+    }
+    case 12: // PINGREQ
+        brokerSend(clients[index], std::string("\xD0\x00", 2));
+        return true;
+    case 14: // DISCONNECT
+        return false;
+    default:
+        broker.protocolErrors++;
+        return false;
+    }
+}
+
+// Splits a client's input into packets; false once the client must go
+static bool brokerReceive(BrokerStandIn &broker, std::vector<BrokerClient> &clients, size_t index)
+{
+    char buffer[4096];
+    ssize_t n = recv(clients[index].fd, buffer, sizeof(buffer), 0);
+    if (n <= 0)
+    {
+        return false;
+    }
+    clients[index].in.append(buffer, n);
+
+    for (;;)
+    {
+        std::string &in = clients[index].in;
+        size_t length = 0;
+        size_t pos = 1;
+        int shift = 0;
+        bool complete = false;
+        while (pos < in.size() && pos <= 4)
+        {
+            uint8_t digit = in[pos++];
+            length |= (size_t)(digit & 0x7F) << shift;
+            shift += 7;
+            if (!(digit & 0x80))
+            {
+                complete = true;
+                break;
+            }
+        }
+        if (!complete)
+        {
+            if (pos > 4)
+            {
+                broker.protocolErrors++;
+                return false;
+            }
+            return true; // Header not all here yet
+        }
+        if (in.size() < pos + length)
+        {
+            return true;
+        }
+        uint8_t header = in[0];
+        std::string body = in.substr(pos, length);
+        in.erase(0, pos + length);
+        if (!brokerHandle(broker, clients, index, header, body))
+        {
+            return false;
+        }
+    }
+}
+
+static void brokerRun(BrokerStandIn *broker)
+{
+    std::vector<BrokerClient> clients;
+    while (!broker->stop)
+    {
+        std::vector<pollfd> fds(1, {broker->listenFd, POLLIN, 0});
+        for (const BrokerClient &client : clients)
+        {
+            fds.push_back({client.fd, POLLIN, 0});
+        }
+        if (poll(fds.data(), fds.size(), 50) <= 0)
+        {
+            continue;
+        }
+        for (size_t i = clients.size(); i-- > 0;)
+        {
+            if (fds[i + 1].revents && !brokerReceive(*broker, clients, i))
+            {
+                close(clients[i].fd);
+                clients.erase(clients.begin() + i);
+            }
+        }
+        if (fds[0].revents & POLLIN)
+        {
+            int fd = accept(broker->listenFd, NULL, NULL);
+            if (fd >= 0)
+            {
+                int noDelay = 1; // Forward each packet now, not after the host's 40 ms delayed ACK
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+                clients.push_back({fd, "", {}});
+            }
+        }
+    }
+    for (const BrokerClient &client : clients)
+    {
+        close(client.fd);
+    }
+}
+
+// Listens on an ephemeral loopback port and starts serving; returns the
+// port, or 0 if the socket could not be set up
+static int startBrokerStandIn(BrokerStandIn &broker)
+{
+    broker.listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(address);
+    if (broker.listenFd < 0 || bind(broker.listenFd, (sockaddr *)&address, sizeof(address)) != 0 ||
+        listen(broker.listenFd, 64) != 0 || getsockname(broker.listenFd, (sockaddr *)&address, &length) != 0)
+    {
+        return 0;
+    }
+    broker.port = ntohs(address.sin_port);
+    broker.thread = std::thread(brokerRun, &broker);
+    return broker.port;
+}
+
+static void stopBrokerStandIn(BrokerStandIn &broker)
+{
+    broker.stop = true;
+    if (broker.thread.joinable())
+    {
+        broker.thread.join();
+    }
+    close(broker.listenFd);
+}
+
+#endif
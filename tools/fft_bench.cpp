@@ -0,0 +1,231 @@
+// FFT benchmark: times the portable real FFT of spectrum_kernels.cpp per
+// frame size, checks it against a direct DFT and runs the alarm tone
+// detector over synthetic sound. No dependencies beyond libstdc++:
+//
+//   g++ -std=c++17 -O2 -Iinclude -DSPECTRUM_FFT_MAX_SIZE=4096 -o fft_bench
+//       tools/fft_bench.cpp src/spectrum_kernels.cpp
+//   ./fft_bench
+//
+// Throughput is frames per second of realFFT() alone, and of
+// analyzeSpectrumFrame() (DC removal, window, FFT, bands, tone search) at
+// SPECTRUM_FRAME_SIZE, with its share of the capture interval. The flop
+// rate uses the usual 2.5 N log2 N estimate for a real FFT. On the ESP32
+// the same kernels run on ESP-DSP's FFT instead, see sound_spectrum.h.
+//
+// The detector runs on frames of a simulated KY-038 at
+// SPECTRUM_FRAME_INTERVAL_MS, quantised to the 12-bit ADC: a T3 smoke
+// alarm, the same tone held continuously, broadband noise and a
+// harmonic-rich hum. Only the T3 alarm may be reported.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <random>
+#include <vector>
+#include "sound_spectrum.h"
+
+#define BENCH_MIN_SIZE 64
+#define BENCH_SECONDS 0.25    // Timing run per size
+#define BENCH_DFT_MAX 2048    // Largest size checked against the direct DFT
+#define DETECTOR_SECONDS 60   // Simulated time per scenario
+#define ADC_MIDPOINT 1900     // KY-038 output at rest, in counts
+
+static std::mt19937 rng(12345);
+
+static double nowS()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Largest error of realFFT() against a double-precision DFT, relative to
+// the largest bin
+static double fftError(const std::vector<float> &input, uint16_t size)
+{
+    std::vector<float> packed(input.begin(), input.end());
+    realFFT(packed.data(), size);
+
+    double worst = 0;
+    double largest = 0;
+    for (int k = 0; k <= size / 2; k++)
+    {
+        double re = 0;
+        double im = 0;
+        for (int n = 0; n < size; n++)
+        {
+            double angle = -2.0 * M_PI * k * n / size;
+            re += input[n] * cos(angle);
+            im += input[n] * sin(angle);
+        }
+        double gotRe = k == 0 ? packed[0] : k == size / 2 ? packed[1] : packed[2 * k];
+        double gotIm = k == 0 || k == size / 2 ? 0 : packed[2 * k + 1];
+        worst = fmax(worst, hypot(gotRe - re, gotIm - im));
+        largest = fmax(largest, hypot(re, im));
+    }
+    return worst / largest;
+}
+
+// Frames per second of fn(), run for BENCH_SECONDS after a warm-up
+template <typename Fn>
+static double framesPerSecond(Fn fn)
+{
+    for (int i = 0; i < 100; i++)
+    {
+        fn();
+    }
+    long frames = 0;
+    double start = nowS();
+    double elapsed;
+    do
+    {
+        for (int i = 0; i < 100; i++)
+        {
+            fn();
+        }
+        frames += 100;
+        elapsed = nowS() - start;
+    } while (elapsed < BENCH_SECONDS);
+    return frames / elapsed;
+}
+
+static void benchmarkFFT()
+{
+    printf("%6s %10s %12s %10s %12s\n", "size", "us/frame", "frames/s", "Mflop/s", "max error");
+    std::normal_distribution<float> noise(0, 500);
+    for (uint16_t size = BENCH_MIN_SIZE; size <= SPECTRUM_FFT_MAX_SIZE; size *= 2)
+    {
+        std::vector<float> input(size);
+        for (float &x : input)
+        {
+            x = noise(rng);
+        }
+        std::vector<float> work(size);
+        double rate = framesPerSecond([&]
+                                      {
+            memcpy(work.data(), input.data(), size * sizeof(float));
+            realFFT(work.data(), size); });
+
+        char error[16] = "-";
+        if (size <= BENCH_DFT_MAX)
+        {
+            snprintf(error, sizeof(error), "%.1e", fftError(input, size));
+        }
+        printf("%6u %10.2f %12.0f %10.0f %12s\n", size, 1e6 / rate, rate, 2.5 * size * log2(size) * rate / 1e6,
+               error);
+    }
+
+    std::vector<float> input(SPECTRUM_FRAME_SIZE);
+    for (float &x : input)
+    {
+        x = ADC_MIDPOINT + noise(rng);
+    }
+    float frame[SPECTRUM_FRAME_SIZE];
+    SpectrumFrame result;
+    double rate = framesPerSecond([&]
+                                  {
+        memcpy(frame, input.data(), sizeof(frame));
+        analyzeSpectrumFrame(frame, result); });
+    printf("\nFrame analysis, %d points: %.2f us/frame, %.0f frames/s, %.4f%% of the %d ms frame interval\n",
+           SPECTRUM_FRAME_SIZE, 1e6 / rate, rate, 100.0 * 1e3 / rate / SPECTRUM_FRAME_INTERVAL_MS,
+           SPECTRUM_FRAME_INTERVAL_MS);
+}
+
+// Simulated sound sources, sampled at the capture rate
+enum Scenario
+{
+    SCENE_T3_ALARM,
+    SCENE_CONTINUOUS_TONE,
+    SCENE_BROADBAND_NOISE,
+    SCENE_HUM,
+    NUM_SCENES
+};
+
+static const char *const SCENE_NAMES[NUM_SCENES] = {"T3 smoke alarm 3150 Hz", "continuous 3150 Hz tone",
+                                                    "broadband noise (vacuum)", "hum, 100 Hz + harmonics"};
+
+// T3 cadence: on 0-0.5, 1-1.5, 2-2.5 s of every 4 s
+static bool t3On(double t)
+{
+    double phase = fmod(t, 4.0);
+    return phase < 3.0 && fmod(phase, 1.0) < 0.5;
+}
+
+static float sceneSample(Scenario scene, double t)
+{
+    static std::normal_distribution<float> background(0, 6);
+    static std::normal_distribution<float> loud(0, 350);
+    float x = background(rng);
+    switch (scene)
+    {
+    case SCENE_T3_ALARM:
+        x += t3On(t) ? 300 * sinf(2 * M_PI * 3150 * t) : 0;
+        break;
+    case SCENE_CONTINUOUS_TONE:
+        x += 300 * sinf(2 * M_PI * 3150 * t);
+        break;
+    case SCENE_BROADBAND_NOISE:
+        x += loud(rng);
+        break;
+    case SCENE_HUM:
+        for (int h = 1; h <= 40; h++)
+        {
+            x += 400.0f / h * sinf(2 * M_PI * 100 * h * t);
+        }
+        break;
+    default:
+        break;
+    }
+    float counts = roundf(ADC_MIDPOINT + x);
+    return counts < 0 ? 0 : counts > 4095 ? 4095 : counts;
+}
+
+static void checkDetector()
+{
+    printf("\nAlarm tone detector, %d s per scenario:\n", DETECTOR_SECONDS);
+    for (int s = 0; s < NUM_SCENES; s++)
+    {
+        AlarmTonePattern pattern = {};
+        float frame[SPECTRUM_FRAME_SIZE];
+        int toneFrames = 0;
+        int frames = 0;
+        double firstHeard = -1;
+        int heardFrames = 0;
+        for (uint32_t ms = 0; ms < DETECTOR_SECONDS * 1000; ms += SPECTRUM_FRAME_INTERVAL_MS)
+        {
+            for (int n = 0; n < SPECTRUM_FRAME_SIZE; n++)
+            {
+                frame[n] = sceneSample((Scenario)s, ms / 1e3 + (double)n / SPECTRUM_SAMPLE_RATE_HZ);
+            }
+            SpectrumFrame result;
+            analyzeSpectrumFrame(frame, result);
+            bool heard = updateAlarmTonePattern(pattern, result.tone, ms);
+            toneFrames += result.tone ? 1 : 0;
+            heardFrames += heard ? 1 : 0;
+            frames++;
+            if (heard && firstHeard < 0)
+            {
+                firstHeard = ms / 1e3;
+            }
+        }
+        printf("  %-26s tone in %3d/%d frames, ", SCENE_NAMES[s], toneFrames, frames);
+        if (firstHeard < 0)
+        {
+            printf("not reported\n");
+        }
+        else
+        {
+            printf("reported after %.2f s, in %d%% of frames\n", firstHeard, 100 * heardFrames / frames);
+        }
+    }
+}
+
+int main()
+{
+    initializeSpectrumKernels();
+    benchmarkFFT();
+    checkDetector();
+    return 0;
+}
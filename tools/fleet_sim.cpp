@@ -0,0 +1,1013 @@
+// Fleet simulator: runs thousands of virtual nodes against a local MQTT
+// broker and reports broker throughput, publish latency and reconnect
+// storms. Linux only, no dependencies beyond libstdc++:
+//
+//   g++ -std=c++17 -O2 -Iinclude -Ilib/mqtt -o fleet_sim tools/fleet_sim.cpp
+//       lib/mqtt/mqtt_identity.cpp src/sensor_channels.cpp
+//   ./fleet_sim --nodes 2000 --interval 10 --duration 300
+//
+// Each node derives its client ID and topic base from a simulated MAC with
+// buildMQTTIdentity() and publishes the readings the way
+// publishMQTTReadings() does: every channel of SENSOR_CHANNEL_TABLE,
+// formatted by formatChannelValue(), retained, QoS 0, on its mapped topic.
+// It subscribes to its history request and config topics on connect, sends
+// keepalives every MQTT_KEEPALIVE_SECONDS and reconnects after
+// MQTT_RECONNECT_DELAY_MS like the async transport.
+//
+// A monitor connection subscribes to TOPIC_SENSOR_BASE/# and counts what
+// the broker delivers. Publish latency is measured from a node writing its
+// temperature reading to the monitor receiving it. Restart the broker while
+// the simulator runs to see the reconnect storm and how long the fleet
+// takes to recover.
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <deque>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "mqtt_identity.h"
+#include "runtime_config.h"
+#include "sensor_channels.h"
+
+// Firmware settings the nodes mirror (lib/mqtt/mqtt_async.h)
+#define MQTT_KEEPALIVE_SECONDS 15
+#define MQTT_RECONNECT_DELAY_MS 2000
+
+// The client ID every node used before identities were derived from the MAC
+#define LEGACY_CLIENT_ID "ESP32Client"
+
+#define MAX_EVENTS 256
+#define READ_CHUNK 4096
+#define MAX_PROBES_IN_FLIGHT 16 // Per node; beyond that the monitor has fallen hopelessly behind
+
+// MQTT 3.1.1 packet types
+enum PacketType
+{
+    MQTT_CONNECT = 1,
+    MQTT_CONNACK = 2,
+    MQTT_PUBLISH = 3,
+    MQTT_PUBACK = 4,
+    MQTT_SUBSCRIBE = 8,
+    MQTT_SUBACK = 9,
+    MQTT_PINGREQ = 12,
+    MQTT_PINGRESP = 13
+};
+
+enum NodeState
+{
+    NODE_IDLE,         // Waiting for the next connection attempt
+    NODE_CONNECTING,   // TCP connect in progress
+    NODE_WAIT_CONNACK, // CONNECT sent
+    NODE_UP
+};
+
+struct Options
+{
+    const char *host = "127.0.0.1";
+    int port = 1883;
+    const char *username = NULL;
+    const char *password = NULL;
+    int nodes = 1000;
+    double intervalS = 10;  // Between two readings publishes of a node
+    double durationS = 0;   // 0: until Ctrl-C
+    double rampPerS = 200;  // Initial connection attempts per second
+    int reconnectMs = MQTT_RECONNECT_DELAY_MS;
+    int jitterMs = 0;       // Random extra reconnect delay, 0 like the firmware
+    int qos = 0;            // Readings QoS; 1 also measures PUBACK latency
+    double reportS = 5;
+    bool legacyId = false;  // Every node connects as LEGACY_CLIENT_ID
+};
+
+struct Node
+{
+    int fd = -1;
+    NodeState state = NODE_IDLE;
+    bool monitor = false;
+    bool closing = false; // Disconnect initiated by the simulator
+    MqttIdentity identity;
+    std::string out;
+    size_t outOffset = 0;
+    bool wantWrite = false;
+    std::string in;
+    uint64_t nextConnectUs = 0;
+    uint64_t nextPublishUs = 0;
+    uint64_t lastSendUs = 0;
+    std::deque<uint64_t> probesUs; // Send times of temperature readings on their way to the monitor
+    uint16_t nextPacketId = 1;
+    std::unordered_map<uint16_t, uint64_t> inflight; // QoS 1 publishes awaiting PUBACK
+    float values[NUM_CHANNELS];
+};
+
+// Counters of one report window; the run totals use the same struct
+struct Counters
+{
+    uint64_t attempts = 0;  // TCP connection attempts
+    uint64_t connects = 0;  // Accepted CONNACKs
+    uint64_t refused = 0;   // Failed TCP connects and refused CONNACKs
+    uint64_t drops = 0;     // Established sessions closed by the broker
+    uint64_t published = 0; // PUBLISH packets written by the nodes
+    uint64_t delivered = 0; // PUBLISH packets received by the monitor
+    uint64_t bytesOut = 0;
+    std::vector<uint32_t> latencyUs;
+    std::vector<uint32_t> ackUs;
+
+    void add(const Counters &other)
+    {
+        attempts += other.attempts;
+        connects += other.connects;
+        refused += other.refused;
+        drops += other.drops;
+        published += other.published;
+        delivered += other.delivered;
+        bytesOut += other.bytesOut;
+        latencyUs.insert(latencyUs.end(), other.latencyUs.begin(), other.latencyUs.end());
+        ackUs.insert(ackUs.end(), other.ackUs.begin(), other.ackUs.end());
+    }
+};
+
+// Period from the first node dropping (after the initial ramp-up) to the
+// whole fleet being up again
+struct Storm
+{
+    double startS;
+    double recoveredS; // < 0 while still recovering
+    uint64_t drops;
+    uint64_t attempts;
+    uint32_t peakAttemptsPerS;
+};
+
+static Options options;
+static std::vector<Node> nodes; // Virtual nodes, the monitor last
+static std::unordered_map<std::string, size_t> nodeByClientId;
+static int epollFd = -1;
+static sockaddr_storage brokerAddress;
+static socklen_t brokerAddressLength = 0;
+static std::mt19937 rng(12345);
+static volatile sig_atomic_t stopRequested = 0;
+
+static Counters window;
+static Counters total;
+static int nodesUp = 0;
+static uint64_t startUs = 0;
+static double fleetUpS = -1; // Time the whole fleet was first up
+static std::vector<uint32_t> attemptsPerSecond;
+static std::vector<Storm> storms;
+
+// Readings start at typical indoor values and wander from there
+static const float INITIAL_VALUES[NUM_CHANNELS] = {21, 45, 1013, 50, 120, 5, 2, 10, 40, 50, 500, 2};
+static_assert(sizeof(INITIAL_VALUES) / sizeof(INITIAL_VALUES[0]) == NUM_CHANNELS,
+              "INITIAL_VALUES must list every channel of SENSOR_CHANNEL_TABLE");
+
+// getChannelLevel() in sensor_channels.cpp needs the runtime thresholds;
+// the simulator uses the defaults
+ChannelThresholds getChannelThresholds(SensorChannel channel)
+{
+    return {CHANNELS[channel].warn, CHANNELS[channel].alarm};
+}
+
+static uint64_t nowUs()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static double elapsedS(uint64_t us)
+{
+    return (us - startUs) / 1e6;
+}
+
+// Storm in progress, NULL while the whole fleet is up
+static Storm *activeStorm()
+{
+    return !storms.empty() && storms.back().recoveredS < 0 ? &storms.back() : NULL;
+}
+
+/*
+ * MQTT encoding
+ */
+
+static void appendRemainingLength(std::string &packet, size_t length)
+{
+    do
+    {
+        uint8_t digit = length % 128;
+        length /= 128;
+        packet += (char)(length > 0 ? digit | 0x80 : digit);
+    } while (length > 0);
+}
+
+static void appendString(std::string &packet, const char *text, size_t length)
+{
+    packet += (char)(length >> 8);
+    packet += (char)(length & 0xFF);
+    packet.append(text, length);
+}
+
+static void appendPacket(Node &node, uint8_t header, const std::string &body)
+{
+    node.out += (char)header;
+    appendRemainingLength(node.out, body.size());
+    node.out += body;
+}
+
+static void queueConnect(Node &node)
+{
+    std::string body;
+    appendString(body, "MQTT", 4);
+    body += (char)4; // Protocol level 3.1.1
+    uint8_t flags = 0x02; // Clean session, like both firmware transports
+    if (options.username != NULL)
+    {
+        flags |= 0x80;
+    }
+    if (options.password != NULL)
+    {
+        flags |= 0x40;
+    }
+    body += (char)flags;
+    body += (char)0;
+    body += (char)MQTT_KEEPALIVE_SECONDS;
+    const char *clientId = options.legacyId && !node.monitor ? LEGACY_CLIENT_ID : node.identity.clientId;
+    appendString(body, clientId, strlen(clientId));
+    if (options.username != NULL)
+    {
+        appendString(body, options.username, strlen(options.username));
+    }
+    if (options.password != NULL)
+    {
+        appendString(body, options.password, strlen(options.password));
+    }
+    appendPacket(node, MQTT_CONNECT << 4, body);
+}
+
+static uint16_t nextPacketId(Node &node)
+{
+    if (node.nextPacketId == 0)
+    {
+        node.nextPacketId = 1;
+    }
+    return node.nextPacketId++;
+}
+
+static void queueSubscribe(Node &node, const char *topic, uint8_t qos)
+{
+    std::string body;
+    uint16_t packetId = nextPacketId(node);
+    body += (char)(packetId >> 8);
+    body += (char)(packetId & 0xFF);
+    appendString(body, topic, strlen(topic));
+    body += (char)qos;
+    appendPacket(node, (MQTT_SUBSCRIBE << 4) | 0x02, body);
+}
+
+static void queuePublish(Node &node, const char *topic, const char *payload, bool retain, uint64_t now)
+{
+    std::string body;
+    appendString(body, topic, strlen(topic));
+    if (options.qos > 0)
+    {
+        uint16_t packetId = nextPacketId(node);
+        body += (char)(packetId >> 8);
+        body += (char)(packetId & 0xFF);
+        node.inflight[packetId] = now;
+    }
+    body += payload;
+    appendPacket(node, (MQTT_PUBLISH << 4) | (options.qos << 1) | (retain ? 1 : 0), body);
+    window.published++;
+}
+
+/*
+ * Connections
+ */
+
+static size_t nodeIndex(const Node &node)
+{
+    return &node - nodes.data();
+}
+
+static void watchNode(Node &node, int op)
+{
+    epoll_event event = {};
+    event.events = EPOLLIN | (node.wantWrite ? (uint32_t)EPOLLOUT : 0);
+    event.data.u64 = nodeIndex(node);
+    epoll_ctl(epollFd, op, node.fd, &event);
+}
+
+static void closeNode(Node &node, uint64_t now)
+{
+    if (node.fd >= 0)
+    {
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, node.fd, NULL);
+        close(node.fd);
+        node.fd = -1;
+    }
+    if (node.state == NODE_UP && !node.monitor)
+    {
+        nodesUp--;
+        if (!node.closing)
+        {
+            window.drops++;
+            if (fleetUpS >= 0 && activeStorm() == NULL)
+            {
+                storms.push_back({elapsedS(now), -1, 0, 0, 0});
+            }
+            if (activeStorm() != NULL)
+            {
+                activeStorm()->drops++;
+            }
+        }
+    }
+    node.state = NODE_IDLE;
+    node.closing = false;
+    node.out.clear();
+    node.outOffset = 0;
+    node.in.clear();
+    node.inflight.clear();
+    node.probesUs.clear();
+    uint32_t delayMs = options.reconnectMs;
+    if (options.jitterMs > 0)
+    {
+        delayMs += rng() % options.jitterMs;
+    }
+    node.nextConnectUs = now + (uint64_t)delayMs * 1000;
+}
+
+// Write what is pending; wait for EPOLLOUT if the socket is full
+static void flushNode(Node &node, uint64_t now)
+{
+    while (node.outOffset < node.out.size())
+    {
+        ssize_t written = send(node.fd, node.out.data() + node.outOffset, node.out.size() - node.outOffset,
+                               MSG_NOSIGNAL);
+        if (written < 0)
+        {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                break;
+            }
+            closeNode(node, now);
+            return;
+        }
+        node.outOffset += written;
+        window.bytesOut += written;
+        node.lastSendUs = now;
+    }
+    if (node.outOffset == node.out.size())
+    {
+        node.out.clear();
+        node.outOffset = 0;
+    }
+    bool wantWrite = !node.out.empty();
+    if (wantWrite != node.wantWrite)
+    {
+        node.wantWrite = wantWrite;
+        watchNode(node, EPOLL_CTL_MOD);
+    }
+}
+
+static void startConnect(Node &node, uint64_t now)
+{
+    if (!node.monitor)
+    {
+        window.attempts++;
+        size_t second = (size_t)elapsedS(now);
+        if (attemptsPerSecond.size() <= second)
+        {
+            attemptsPerSecond.resize(second + 1, 0);
+        }
+        attemptsPerSecond[second]++;
+        if (activeStorm() != NULL)
+        {
+            activeStorm()->attempts++;
+        }
+    }
+    node.fd = socket(brokerAddress.ss_family, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (node.fd < 0)
+    {
+        window.refused++;
+        closeNode(node, now);
+        return;
+    }
+    int one = 1;
+    setsockopt(node.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (connect(node.fd, (sockaddr *)&brokerAddress, brokerAddressLength) < 0 && errno != EINPROGRESS)
+    {
+        window.refused++;
+        closeNode(node, now);
+        return;
+    }
+    node.state = NODE_CONNECTING;
+    node.wantWrite = true;
+    watchNode(node, EPOLL_CTL_ADD);
+}
+
+// Publish every channel, as publishMQTTReadings() does
+static void publishReadings(Node &node, uint64_t now)
+{
+    std::normal_distribution<float> step(0, 0.2f);
+    char topic[MQTT_TOPIC_MAX];
+    char payload[16];
+    for (int ch = 0; ch < NUM_CHANNELS; ch++)
+    {
+        node.values[ch] += step(rng) * (INITIAL_VALUES[ch] * 0.01f + 0.1f);
+        *CHANNELS[ch].value = node.values[ch];
+        formatChannelValue((SensorChannel)ch, payload, sizeof(payload));
+        mapDeviceTopic(node.identity, CHANNELS[ch].topic, topic, sizeof(topic));
+        queuePublish(node, topic, payload, true, now);
+    }
+    if (node.probesUs.size() < MAX_PROBES_IN_FLIGHT)
+    {
+        node.probesUs.push_back(now);
+    }
+    flushNode(node, now);
+}
+
+static void onConnack(Node &node, uint8_t returnCode, uint64_t now)
+{
+    if (returnCode != 0)
+    {
+        window.refused++;
+        closeNode(node, now);
+        return;
+    }
+    node.state = NODE_UP;
+    char topic[MQTT_TOPIC_MAX];
+    if (node.monitor)
+    {
+        queueSubscribe(node, TOPIC_SENSOR_BASE "/#", 0);
+    }
+    else
+    {
+        window.connects++;
+        nodesUp++;
+        if (nodesUp == options.nodes)
+        {
+            if (fleetUpS < 0)
+            {
+                fleetUpS = elapsedS(now);
+            }
+            else if (activeStorm() != NULL)
+            {
+                activeStorm()->recoveredS = elapsedS(now);
+            }
+        }
+        mapDeviceTopic(node.identity, TOPIC_SENSOR_BASE "/history/request", topic, sizeof(topic));
+        queueSubscribe(node, topic, 0);
+        mapDeviceTopic(node.identity, TOPIC_SENSOR_BASE "/config", topic, sizeof(topic));
+        queueSubscribe(node, topic, 1);
+        if (node.nextPublishUs < now)
+        {
+            node.nextPublishUs = now + (uint64_t)(options.intervalS * 1e6 * (rng() % 1000) / 1000);
+        }
+    }
+    flushNode(node, now);
+}
+
+// The monitor matches the temperature readings of each node to their send
+// times. The broker keeps the order of one client's messages, so the oldest
+// outstanding reading is the one that arrived.
+static void onMonitorPublish(const char *topic, size_t topicLength, bool retained, uint64_t now)
+{
+    window.delivered++;
+    if (retained)
+    {
+        return; // Stored copy sent on subscribe
+    }
+    static const size_t baseLength = sizeof(TOPIC_SENSOR_BASE);
+    static const char *probeSuffix = CHANNELS[CHANNEL_TEMPERATURE].topic + baseLength - 1;
+    size_t suffixLength = strlen(probeSuffix);
+    if (topicLength <= baseLength + suffixLength ||
+        memcmp(topic + topicLength - suffixLength, probeSuffix, suffixLength) != 0)
+    {
+        return;
+    }
+    std::string clientId(topic + baseLength, topicLength - baseLength - suffixLength);
+    auto found = nodeByClientId.find(clientId);
+    if (found == nodeByClientId.end())
+    {
+        return;
+    }
+    Node &node = nodes[found->second];
+    if (!node.probesUs.empty())
+    {
+        window.latencyUs.push_back((uint32_t)(now - node.probesUs.front()));
+        node.probesUs.pop_front();
+    }
+}
+
+static void handlePacket(Node &node, uint8_t header, const uint8_t *body, size_t length, uint64_t now)
+{
+    switch (header >> 4)
+    {
+    case MQTT_CONNACK:
+        if (node.state == NODE_WAIT_CONNACK && length >= 2)
+        {
+            onConnack(node, body[1], now);
+        }
+        break;
+    case MQTT_PUBLISH:
+    {
+        if (length < 2)
+        {
+            break;
+        }
+        size_t topicLength = (body[0] << 8) | body[1];
+        uint8_t qos = (header >> 1) & 0x03;
+        if (2 + topicLength + (qos > 0 ? 2 : 0) > length)
+        {
+            break;
+        }
+        if (node.monitor)
+        {
+            onMonitorPublish((const char *)body + 2, topicLength, header & 0x01, now);
+        }
+        if (qos == 1)
+        {
+            std::string ack;
+            ack += (char)body[2 + topicLength];
+            ack += (char)body[3 + topicLength];
+            appendPacket(node, MQTT_PUBACK << 4, ack);
+            flushNode(node, now);
+        }
+        break;
+    }
+    case MQTT_PUBACK:
+        if (length >= 2)
+        {
+            auto found = node.inflight.find((body[0] << 8) | body[1]);
+            if (found != node.inflight.end())
+            {
+                window.ackUs.push_back((uint32_t)(now - found->second));
+                node.inflight.erase(found);
+            }
+        }
+        break;
+    default:
+        break; // SUBACK, PINGRESP
+    }
+}
+
+// Split the received bytes into packets
+static void readNode(Node &node, uint64_t now)
+{
+    char buffer[READ_CHUNK];
+    for (;;)
+    {
+        ssize_t received = recv(node.fd, buffer, sizeof(buffer), 0);
+        if (received == 0 || (received < 0 && errno != EAGAIN && errno != EWOULDBLOCK))
+        {
+            closeNode(node, now);
+            return;
+        }
+        if (received < 0)
+        {
+            break;
+        }
+        node.in.append(buffer, received);
+    }
+
+    size_t offset = 0;
+    while (node.fd >= 0 && node.in.size() - offset >= 2)
+    {
+        const uint8_t *data = (const uint8_t *)node.in.data() + offset;
+        size_t available = node.in.size() - offset;
+        size_t length = 0;
+        size_t multiplier = 1;
+        size_t position = 1;
+        bool complete = false;
+        while (position < available && position <= 4)
+        {
+            length += (data[position] & 0x7F) * multiplier;
+            multiplier *= 128;
+            if ((data[position++] & 0x80) == 0)
+            {
+                complete = true;
+                break;
+            }
+        }
+        if (!complete || available < position + length)
+        {
+            break;
+        }
+        handlePacket(node, data[0], data + position, length, now);
+        offset += position + length;
+    }
+    if (node.fd >= 0)
+    {
+        node.in.erase(0, offset);
+    }
+}
+
+static void onWritable(Node &node, uint64_t now)
+{
+    if (node.state == NODE_CONNECTING)
+    {
+        int error = 0;
+        socklen_t errorLength = sizeof(error);
+        getsockopt(node.fd, SOL_SOCKET, SO_ERROR, &error, &errorLength);
+        if (error != 0)
+        {
+            if (!node.monitor)
+            {
+                window.refused++;
+            }
+            closeNode(node, now);
+            return;
+        }
+        node.state = NODE_WAIT_CONNACK;
+        queueConnect(node);
+    }
+    flushNode(node, now);
+}
+
+// Connection attempts, publishes and keepalives that are due
+static void serviceTimers(uint64_t now)
+{
+    for (Node &node : nodes)
+    {
+        if (node.state == NODE_IDLE)
+        {
+            if (now >= node.nextConnectUs)
+            {
+                startConnect(node, now);
+            }
+        }
+        else if (node.state == NODE_UP)
+        {
+            if (!node.monitor && now >= node.nextPublishUs)
+            {
+                node.nextPublishUs += (uint64_t)(options.intervalS * 1e6);
+                if (node.nextPublishUs < now)
+                {
+                    node.nextPublishUs = now + (uint64_t)(options.intervalS * 1e6);
+                }
+                publishReadings(node, now);
+            }
+            else if (now - node.lastSendUs >= MQTT_KEEPALIVE_SECONDS * 1000000ULL)
+            {
+                appendPacket(node, MQTT_PINGREQ << 4, std::string());
+                flushNode(node, now);
+            }
+        }
+    }
+}
+
+/*
+ * Reporting
+ */
+
+static uint32_t percentile(std::vector<uint32_t> &samples, double fraction)
+{
+    if (samples.empty())
+    {
+        return 0;
+    }
+    size_t rank = std::min(samples.size() - 1, (size_t)(fraction * samples.size()));
+    std::nth_element(samples.begin(), samples.begin() + rank, samples.end());
+    return samples[rank];
+}
+
+static void formatLatency(char *buffer, size_t size, std::vector<uint32_t> &samples)
+{
+    if (samples.empty())
+    {
+        snprintf(buffer, size, "-");
+        return;
+    }
+    uint32_t p50 = percentile(samples, 0.50);
+    uint32_t p99 = percentile(samples, 0.99);
+    uint32_t max = *std::max_element(samples.begin(), samples.end());
+    snprintf(buffer, size, "%.1f/%.1f/%.1f ms", p50 / 1000.0, p99 / 1000.0, max / 1000.0);
+}
+
+static void report(uint64_t now, double windowS)
+{
+    char latency[48];
+    char ack[48];
+    formatLatency(latency, sizeof(latency), window.latencyUs);
+    formatLatency(ack, sizeof(ack), window.ackUs);
+    printf("%7.1fs  up %5d/%d  pub %7.0f/s  recv %7.0f/s  %6.1f KB/s  latency %s", elapsedS(now), nodesUp,
+           options.nodes, window.published / windowS, window.delivered / windowS, window.bytesOut / 1024.0 / windowS,
+           latency);
+    if (options.qos > 0)
+    {
+        printf("  puback %s", ack);
+    }
+    printf("  connects %llu drops %llu refused %llu\n", (unsigned long long)window.connects,
+           (unsigned long long)window.drops, (unsigned long long)window.refused);
+    fflush(stdout);
+    total.add(window);
+    window = Counters();
+}
+
+static void printSummary(uint64_t now)
+{
+    double runS = elapsedS(now);
+    char latency[48];
+    char ack[48];
+    formatLatency(latency, sizeof(latency), total.latencyUs);
+    formatLatency(ack, sizeof(ack), total.ackUs);
+
+    printf("\n%d nodes (%s client IDs), %.0f s run, readings every %.1f s, QoS %d\n", options.nodes,
+           options.legacyId ? "shared" : "per-device", runS, options.intervalS, options.qos);
+    printf("throughput   %.0f publishes/s in, %.0f messages/s delivered to the monitor, %.1f KB/s from the nodes\n",
+           total.published / runS, total.delivered / runS, total.bytesOut / 1024.0 / runS);
+    printf("latency      publish to delivery p50/p99/max %s (%zu samples)\n", latency, total.latencyUs.size());
+    if (options.qos > 0)
+    {
+        printf("             publish to PUBACK p50/p99/max %s\n", ack);
+    }
+    printf("connections  %llu attempts, %llu accepted, %llu refused, %llu dropped by the broker\n",
+           (unsigned long long)total.attempts, (unsigned long long)total.connects, (unsigned long long)total.refused,
+           (unsigned long long)total.drops);
+    if (fleetUpS >= 0)
+    {
+        printf("ramp-up      all nodes up after %.1f s\n", fleetUpS);
+    }
+    else
+    {
+        printf("ramp-up      %d of %d nodes up at the end\n", nodesUp, options.nodes);
+    }
+
+    uint32_t peak = 0;
+    for (Storm &storm : storms)
+    {
+        size_t first = (size_t)storm.startS;
+        size_t last = storm.recoveredS >= 0 ? (size_t)storm.recoveredS : attemptsPerSecond.size();
+        for (size_t s = first; s <= last && s < attemptsPerSecond.size(); s++)
+        {
+            storm.peakAttemptsPerS = std::max(storm.peakAttemptsPerS, attemptsPerSecond[s]);
+        }
+    }
+    for (size_t s = 0; s < attemptsPerSecond.size(); s++)
+    {
+        peak = std::max(peak, attemptsPerSecond[s]);
+    }
+    printf("storms       %zu after ramp-up, peak %u connection attempts/s over the run\n", storms.size(), peak);
+    for (const Storm &storm : storms)
+    {
+        printf("  at %7.1f s: %llu drops, %llu attempts, peak %u/s, ", storm.startS, (unsigned long long)storm.drops,
+               (unsigned long long)storm.attempts, storm.peakAttemptsPerS);
+        if (storm.recoveredS >= 0)
+        {
+            printf("all up again after %.1f s\n", storm.recoveredS - storm.startS);
+        }
+        else
+        {
+            printf("not recovered\n");
+        }
+    }
+}
+
+/*
+ * Setup
+ */
+
+static void usage(const char *program)
+{
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  --host HOST          broker address (127.0.0.1)\n"
+            "  --port PORT          broker port (1883)\n"
+            "  --username USER      broker credentials\n"
+            "  --password PASS\n"
+            "  --nodes N            virtual nodes (1000)\n"
+            "  --interval S         seconds between readings of a node (10)\n"
+            "  --duration S         stop after S seconds (until Ctrl-C)\n"
+            "  --ramp N             initial connection attempts per second (200)\n"
+            "  --reconnect-ms MS    reconnect delay (%d, as MQTT_RECONNECT_DELAY_MS)\n"
+            "  --jitter-ms MS       random extra reconnect delay (0)\n"
+            "  --qos 0|1            readings QoS; 1 also reports PUBACK latency (0)\n"
+            "  --report S           seconds between report lines (5)\n"
+            "  --legacy-id          connect every node as \"" LEGACY_CLIENT_ID "\", as before per-device IDs\n",
+            program, MQTT_RECONNECT_DELAY_MS);
+    exit(2);
+}
+
+static void parseOptions(int argc, char **argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const char *name = argv[i];
+        if (strcmp(name, "--legacy-id") == 0)
+        {
+            options.legacyId = true;
+            continue;
+        }
+        if (i + 1 >= argc)
+        {
+            usage(argv[0]);
+        }
+        const char *value = argv[++i];
+        if (strcmp(name, "--host") == 0)
+        {
+            options.host = value;
+        }
+        else if (strcmp(name, "--port") == 0)
+        {
+            options.port = atoi(value);
+        }
+        else if (strcmp(name, "--username") == 0)
+        {
+            options.username = value;
+        }
+        else if (strcmp(name, "--password") == 0)
+        {
+            options.password = value;
+        }
+        else if (strcmp(name, "--nodes") == 0)
+        {
+            options.nodes = atoi(value);
+        }
+        else if (strcmp(name, "--interval") == 0)
+        {
+            options.intervalS = atof(value);
+        }
+        else if (strcmp(name, "--duration") == 0)
+        {
+            options.durationS = atof(value);
+        }
+        else if (strcmp(name, "--ramp") == 0)
+        {
+            options.rampPerS = atof(value);
+        }
+        else if (strcmp(name, "--reconnect-ms") == 0)
+        {
+            options.reconnectMs = atoi(value);
+        }
+        else if (strcmp(name, "--jitter-ms") == 0)
+        {
+            options.jitterMs = atoi(value);
+        }
+        else if (strcmp(name, "--qos") == 0)
+        {
+            options.qos = atoi(value);
+        }
+        else if (strcmp(name, "--report") == 0)
+        {
+            options.reportS = atof(value);
+        }
+        else
+        {
+            usage(argv[0]);
+        }
+    }
+    if (options.nodes < 1 || options.nodes > 0xFFFFFF || options.intervalS <= 0 || options.rampPerS <= 0 ||
+        options.reportS <= 0 || options.qos < 0 || options.qos > 1)
+    {
+        usage(argv[0]);
+    }
+}
+
+static bool resolveBroker()
+{
+    addrinfo hints = {};
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo *result = NULL;
+    char port[8];
+    snprintf(port, sizeof(port), "%d", options.port);
+    if (getaddrinfo(options.host, port, &hints, &result) != 0 || result == NULL)
+    {
+        return false;
+    }
+    memcpy(&brokerAddress, result->ai_addr, result->ai_addrlen);
+    brokerAddressLength = result->ai_addrlen;
+    freeaddrinfo(result);
+    return true;
+}
+
+// One socket per node: raise the descriptor limit as far as allowed
+static void raiseFileLimit()
+{
+    rlimit limit;
+    getrlimit(RLIMIT_NOFILE, &limit);
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+    getrlimit(RLIMIT_NOFILE, &limit);
+    if (limit.rlim_cur < (rlim_t)options.nodes + 16)
+    {
+        fprintf(stderr, "warning: open file limit %llu is below %d nodes, raise it with ulimit -n\n",
+                (unsigned long long)limit.rlim_cur, options.nodes);
+    }
+}
+
+static void onSignal(int)
+{
+    stopRequested = 1;
+}
+
+int main(int argc, char **argv)
+{
+    parseOptions(argc, argv);
+    if (!resolveBroker())
+    {
+        fprintf(stderr, "cannot resolve %s\n", options.host);
+        return 1;
+    }
+    raiseFileLimit();
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    epollFd = epoll_create1(0);
+
+    // Locally administered MACs 02:00:00:xx:xx:xx, one per node
+    startUs = nowUs();
+    nodes.resize(options.nodes + 1);
+    for (int i = 0; i < options.nodes; i++)
+    {
+        Node &node = nodes[i];
+        uint8_t mac[6] = {0x02, 0x00, 0x00, (uint8_t)(i >> 16), (uint8_t)(i >> 8), (uint8_t)i};
+        buildMQTTIdentity(node.identity, mac);
+        nodeByClientId[node.identity.clientId] = i;
+        node.nextConnectUs = startUs + (uint64_t)(i * 1e6 / options.rampPerS);
+        for (int ch = 0; ch < NUM_CHANNELS; ch++)
+        {
+            node.values[ch] = INITIAL_VALUES[ch];
+        }
+    }
+    Node &monitor = nodes.back();
+    monitor.monitor = true;
+    snprintf(monitor.identity.clientId, sizeof(monitor.identity.clientId), "fleet-sim-monitor-%d", (int)getpid());
+    monitor.nextConnectUs = startUs;
+
+    printf("%d nodes on %s:%d, client IDs %s..%s\n", options.nodes, options.host, options.port,
+           nodes[0].identity.clientId, nodes[options.nodes - 1].identity.clientId);
+
+    epoll_event events[MAX_EVENTS];
+    uint64_t lastReportUs = startUs;
+    uint64_t reportUs = (uint64_t)(options.reportS * 1e6);
+    while (!stopRequested)
+    {
+        uint64_t now = nowUs();
+        if (options.durationS > 0 && elapsedS(now) >= options.durationS)
+        {
+            break;
+        }
+        serviceTimers(now);
+        if (now - lastReportUs >= reportUs)
+        {
+            report(now, (now - lastReportUs) / 1e6);
+            lastReportUs = now;
+        }
+
+        int count = epoll_wait(epollFd, events, MAX_EVENTS, 5);
+        now = nowUs();
+        for (int e = 0; e < count; e++)
+        {
+            Node &node = nodes[events[e].data.u64];
+            if (node.fd < 0)
+            {
+                continue;
+            }
+            if (events[e].events & (EPOLLERR | EPOLLHUP))
+            {
+                if (node.state == NODE_CONNECTING && !node.monitor)
+                {
+                    window.refused++;
+                }
+                closeNode(node, now);
+                continue;
+            }
+            if (events[e].events & EPOLLOUT)
+            {
+                onWritable(node, now);
+            }
+            if (node.fd >= 0 && (events[e].events & EPOLLIN))
+            {
+                readNode(node, now);
+            }
+        }
+    }
+
+    uint64_t now = nowUs();
+    report(now, std::max((now - lastReportUs) / 1e6, 1e-3));
+    printSummary(now);
+    for (Node &node : nodes)
+    {
+        if (node.fd >= 0)
+        {
+            node.closing = true;
+            appendPacket(node, 0xE0, std::string()); // DISCONNECT
+            flushNode(node, now);
+            closeNode(node, now);
+        }
+    }
+    return 0;
+}
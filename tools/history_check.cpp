@@ -0,0 +1,688 @@
+// History query integration test: runs the firmware's query parser and
+// chunked response (lib/mqtt/mqtt_history_query.cpp) against an MQTT
+// broker and checks what a subscriber receives. Linux only, no
+// dependencies beyond libstdc++:
+//
+//   g++ -std=c++17 -O2 -pthread -Iinclude -Ilib/mqtt -o history_check
+//       tools/history_check.cpp lib/mqtt/mqtt_history_query.cpp
+//       lib/mqtt/mqtt_identity.cpp src/sensor_channels.cpp
+//   ./history_check                       (built-in broker stand-in)
+//   ./history_check --broker 127.0.0.1:1883   (e.g. a local mosquitto)
+//
+// A device connection subscribes to its request topic and answers each
+// query with streamHistoryResponse(), publishing every chunk as one
+// PUBLISH packet like PubSubClient's publish(). A chunk must be published
+// with the store unlocked, so a slow socket never holds up the samplers.
+// A dashboard connection sends the queries and checks the responses:
+//   - chunks numbered from 0, the query id echoed, final=1 on the last one
+//     only, and every payload within the transport's chunk limit
+//   - every record of a selected channel, in channel order, in the time
+//     range, with strictly increasing timestamps and the stored value
+//   - on a store that does not change, exactly the records in range
+//
+// The store is a stand-in for time_series_store.cpp with the same query
+// interface and lock. A writer thread appends a second of readings to
+// every channel each millisecond during the live queries, recycling the
+// oldest like the rings do, and every read is checked to happen with the
+// store locked by the reading thread.
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "broker_stand_in.h"
+#include "mqtt_history_query.h"
+#include "mqtt_identity.h"
+#include "runtime_config.h"
+
+// Transport chunk limits the firmware uses (lib/mqtt/mqtt_functions.h,
+// lib/mqtt/mqtt_queue.h)
+#define MQTT_BUFFER_SIZE 512
+#define MQTT_QUEUE_PAYLOAD_MAX 384
+#define MQTT_FIXED_HEADER_MAX 5
+
+#define RESPONSE_TIMEOUT_MS 10000
+#define QUIET_MS 500 // Wait for a response that must not come
+
+// Store stand-in capacity per tier, in points
+#define STORE_RAW_POINTS 900
+#define STORE_MINUTE_POINTS 1200
+#define STORE_HOUR_POINTS 72
+#define STORE_START_S (3 * 86400) // Simulated uptime the store is filled to
+
+/*
+ * Store stand-in
+ */
+
+struct Point
+{
+    uint32_t timestamp;
+    float value;
+};
+
+static const uint32_t TIER_SECONDS[TS_NUM_RESOLUTIONS] = {1, 60, 3600};
+static const size_t TIER_POINTS[TS_NUM_RESOLUTIONS] = {STORE_RAW_POINTS, STORE_MINUTE_POINTS, STORE_HOUR_POINTS};
+
+static std::vector<Point> store[NUM_CHANNELS][TS_NUM_RESOLUTIONS];
+static std::mutex storeMutex;
+static std::atomic<std::thread::id> storeHolder;
+static std::atomic<uint64_t> unlockedReads{0};
+static std::atomic<uint32_t> storeNow{0}; // Simulated seconds since boot
+
+// getChannelLevel() in sensor_channels.cpp needs the runtime thresholds;
+// the test uses the defaults
+ChannelThresholds getChannelThresholds(SensorChannel channel)
+{
+    return {CHANNELS[channel].warn, CHANNELS[channel].alarm};
+}
+
+static float fixtureValue(int channel, uint32_t timestamp)
+{
+    return channel * 100 + (timestamp % 10007) * 0.01f;
+}
+
+// Appends the readings of second `now` to every channel and tier
+static void appendSecond(uint32_t now)
+{
+    for (int ch = 0; ch < NUM_CHANNELS; ch++)
+    {
+        for (int res = 0; res < TS_NUM_RESOLUTIONS; res++)
+        {
+            if (now % TIER_SECONDS[res] != 0)
+            {
+                continue;
+            }
+            std::vector<Point> &points = store[ch][res];
+            points.push_back({now, fixtureValue(ch, now)});
+            if (points.size() > TIER_POINTS[res])
+            {
+                points.erase(points.begin()); // The ring recycles its oldest block
+            }
+        }
+    }
+    storeNow = now;
+}
+
+void lockTimeSeriesStore()
+{
+    storeMutex.lock();
+    storeHolder = std::this_thread::get_id();
+}
+
+void unlockTimeSeriesStore()
+{
+    storeHolder = std::thread::id();
+    storeMutex.unlock();
+}
+
+void beginTimeSeriesQuery(TsIterator &it, SensorChannel channel, TsResolution resolution, uint32_t from, uint32_t to)
+{
+    it.channel = channel;
+    it.resolution = resolution;
+    it.from = from;
+    it.to = to;
+    it.sampleIndex = 0;
+}
+
+// Next point after the last one returned, found by timestamp so that
+// recycled points do not move the cursor
+bool nextTimeSeriesPoint(TsIterator &it, uint32_t &timestamp, float &value)
+{
+    if (storeHolder.load() != std::this_thread::get_id())
+    {
+        unlockedReads++;
+    }
+    if (it.sampleIndex > 0 && it.timestamp == UINT32_MAX)
+    {
+        return false;
+    }
+    const std::vector<Point> &points = store[it.channel][it.resolution];
+    uint32_t after = it.sampleIndex == 0 ? it.from : it.timestamp + 1;
+    auto next = std::lower_bound(points.begin(), points.end(), after,
+                                 [](const Point &point, uint32_t t) { return point.timestamp < t; });
+    if (next == points.end() || next->timestamp > it.to)
+    {
+        return false;
+    }
+    it.sampleIndex = 1;
+    it.timestamp = next->timestamp;
+    timestamp = next->timestamp;
+    value = next->value;
+    return true;
+}
+
+/*
+ * MQTT client side
+ */
+
+static void appendRemainingLength(std::string &packet, size_t length)
+{
+    do
+    {
+        uint8_t digit = length % 128;
+        length /= 128;
+        packet += (char)(length > 0 ? digit | 0x80 : digit);
+    } while (length > 0);
+}
+
+static void appendString(std::string &packet, const char *text)
+{
+    size_t length = strlen(text);
+    packet += (char)(length >> 8);
+    packet += (char)(length & 0xFF);
+    packet.append(text, length);
+}
+
+static bool sendAll(int fd, const void *data, size_t length)
+{
+    const char *bytes = (const char *)data;
+    while (length > 0)
+    {
+        ssize_t n = send(fd, bytes, length, MSG_NOSIGNAL);
+        if (n <= 0)
+        {
+            return false;
+        }
+        bytes += n;
+        length -= n;
+    }
+    return true;
+}
+
+static bool sendPacket(int fd, uint8_t header, const std::string &body)
+{
+    std::string packet(1, (char)header);
+    appendRemainingLength(packet, body.size());
+    packet += body;
+    return sendAll(fd, packet.data(), packet.size());
+}
+
+static int64_t nowMs()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// Buffered reader of one connection
+struct Connection
+{
+    int fd = -1;
+    std::string in;
+};
+
+// Reads the next packet within timeoutMs; header 0 on timeout or close
+static uint8_t readPacket(Connection &connection, std::string &body, int timeoutMs)
+{
+    int64_t deadline = nowMs() + timeoutMs;
+    for (;;)
+    {
+        std::string &in = connection.in;
+        size_t length = 0;
+        size_t pos = 1;
+        int shift = 0;
+        bool complete = false;
+        while (pos < in.size() && pos <= 4)
+        {
+            uint8_t digit = in[pos++];
+            length |= (size_t)(digit & 0x7F) << shift;
+            shift += 7;
+            if (!(digit & 0x80))
+            {
+                complete = true;
+                break;
+            }
+        }
+        if (complete && in.size() >= pos + length)
+        {
+            uint8_t header = in[0];
+            body = in.substr(pos, length);
+            in.erase(0, pos + length);
+            return header;
+        }
+
+        int64_t left = deadline - nowMs();
+        pollfd fd = {connection.fd, POLLIN, 0};
+        if (left <= 0 || poll(&fd, 1, (int)std::min<int64_t>(left, 100)) < 0)
+        {
+            return 0;
+        }
+        if (fd.revents == 0)
+        {
+            continue;
+        }
+        char buffer[8192];
+        ssize_t n = recv(connection.fd, buffer, sizeof(buffer), 0);
+        if (n <= 0)
+        {
+            return 0;
+        }
+        in.append(buffer, n);
+    }
+}
+
+static bool connectClient(Connection &connection, const sockaddr_in &broker, const char *clientId)
+{
+    connection.fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (connection.fd < 0 || connect(connection.fd, (const sockaddr *)&broker, sizeof(broker)) != 0)
+    {
+        return false;
+    }
+    std::string body;
+    appendString(body, "MQTT");
+    body += (char)4;    // Protocol level 3.1.1
+    body += (char)0x02; // Clean session
+    body += (char)0;
+    body += (char)60;
+    appendString(body, clientId);
+    std::string reply;
+    return sendPacket(connection.fd, 0x10, body) && readPacket(connection, reply, 2000) == 0x20 &&
+           reply.size() == 2 && reply[1] == 0;
+}
+
+static bool subscribe(Connection &connection, const char *filter)
+{
+    std::string body("\x00\x01", 2);
+    appendString(body, filter);
+    body += (char)0;
+    std::string reply;
+    return sendPacket(connection.fd, 0x82, body) && readPacket(connection, reply, 2000) == 0x90;
+}
+
+static bool publish(Connection &connection, const char *topic, const std::string &payload)
+{
+    std::string body;
+    appendString(body, topic);
+    return sendPacket(connection.fd, 0x30, body + payload);
+}
+
+// Splits a PUBLISH body into topic and payload
+static bool parsePublish(const std::string &body, std::string &topic, std::string &payload)
+{
+    if (body.size() < 2)
+    {
+        return false;
+    }
+    size_t length = ((uint8_t)body[0] << 8) | (uint8_t)body[1];
+    if (2 + length > body.size())
+    {
+        return false;
+    }
+    topic = body.substr(2, length);
+    payload = body.substr(2 + length);
+    return true;
+}
+
+/*
+ * Device
+ */
+
+struct Device
+{
+    Connection connection;
+    char requestTopic[MQTT_TOPIC_MAX];
+    char responseTopic[MQTT_TOPIC_MAX];
+    size_t chunkLimit;
+    char chunk[MQTT_BUFFER_SIZE];
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> lockedPublishes{0};
+};
+
+static bool deviceWait(void *)
+{
+    return true;
+}
+
+// PubSubClient::publish(): header, topic and payload in one packet
+static bool devicePublish(void *context, const char *data, size_t length)
+{
+    Device &device = *(Device *)context;
+    if (storeHolder.load() == std::this_thread::get_id())
+    {
+        device.lockedPublishes++;
+    }
+    std::string packet(1, (char)0x30);
+    appendRemainingLength(packet, 2 + strlen(device.responseTopic) + length);
+    appendString(packet, device.responseTopic);
+    packet.append(data, length);
+    return sendAll(device.connection.fd, packet.data(), packet.size());
+}
+
+static void runDevice(Device *device)
+{
+    HistorySink sink = {device, deviceWait, devicePublish};
+    while (!device->stop)
+    {
+        std::string body;
+        std::string topic;
+        std::string payload;
+        uint8_t header = readPacket(device->connection, body, 100);
+        if ((header >> 4) != 3 || !parsePublish(body, topic, payload) || topic != device->requestTopic)
+        {
+            continue;
+        }
+        HistoryQuery query;
+        if (parseHistoryQuery(payload.data(), payload.size(), storeNow, query))
+        {
+            streamHistoryResponse(query, device->chunk, device->chunkLimit, sink);
+        }
+    }
+}
+
+/*
+ * Dashboard checks
+ */
+
+struct Scenario
+{
+    const char *name;
+    const char *request;
+    bool live;      // Store written to while the query runs
+    bool answered;  // False: the device must ignore the request
+    size_t chunkLimit;
+};
+
+struct Outcome
+{
+    bool ok = true;
+    int chunks = 0;
+    size_t records = 0;
+    size_t bytes = 0;
+    double seconds = 0;
+};
+
+static void fail(Outcome &outcome, const char *format, const char *detail)
+{
+    if (outcome.ok)
+    {
+        printf("  ");
+        printf(format, detail);
+        printf("\n");
+    }
+    outcome.ok = false;
+}
+
+// Query as the device will parse it, for the expected range and id
+static HistoryQuery expectedQuery(const char *request)
+{
+    HistoryQuery query;
+    parseHistoryQuery(request, strlen(request), storeNow, query);
+    return query;
+}
+
+static size_t recordsInRange(const HistoryQuery &query)
+{
+    size_t count = 0;
+    for (int ch = 0; ch < NUM_CHANNELS; ch++)
+    {
+        if (query.channelMask & (1u << ch))
+        {
+            for (const Point &point : store[ch][query.resolution])
+            {
+                count += point.timestamp >= query.from && point.timestamp <= query.to;
+            }
+        }
+    }
+    return count;
+}
+
+// Checks one response payload; tracks channel order and last timestamp
+static void checkChunk(const HistoryQuery &query, const std::string &payload, size_t limit, Outcome &outcome,
+                       bool &final, int &lastChannel, uint32_t &lastTimestamp)
+{
+    char expected[64];
+    snprintf(expected, sizeof(expected), "#id=%s;chunk=%d;final=", query.id, outcome.chunks);
+    if (payload.compare(0, strlen(expected), expected) != 0)
+    {
+        fail(outcome, "bad chunk header: %s", payload.substr(0, payload.find('\n')).c_str());
+        final = true;
+        return;
+    }
+    final = payload[strlen(expected)] == '1';
+    if (payload.size() > limit)
+    {
+        fail(outcome, "chunk larger than the transport limit: %s", expected);
+    }
+
+    size_t pos = payload.find('\n') + 1;
+    while (pos < payload.size())
+    {
+        size_t end = payload.find('\n', pos);
+        std::string line = payload.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
+        pos = end == std::string::npos ? payload.size() : end + 1;
+        outcome.records++;
+
+        char name[32];
+        unsigned long timestamp;
+        char value[24];
+        if (end == std::string::npos || sscanf(line.c_str(), "%31[^,],%lu,%23s", name, &timestamp, value) != 3)
+        {
+            fail(outcome, "malformed record: %s", line.c_str());
+            continue;
+        }
+        int channel = -1;
+        for (int ch = 0; ch < NUM_CHANNELS; ch++)
+        {
+            channel = strcmp(CHANNEL_NAMES[ch], name) == 0 ? ch : channel;
+        }
+        if (channel < 0 || !(query.channelMask & (1u << channel)))
+        {
+            fail(outcome, "record of a channel not asked for: %s", line.c_str());
+            continue;
+        }
+        if (channel < lastChannel || (channel == lastChannel && timestamp <= lastTimestamp))
+        {
+            fail(outcome, "record out of order: %s", line.c_str());
+        }
+        if (timestamp < query.from || timestamp > query.to)
+        {
+            fail(outcome, "record outside the range: %s", line.c_str());
+        }
+        char stored[24];
+        snprintf(stored, sizeof(stored), "%.2f", fixtureValue(channel, timestamp));
+        if (strcmp(stored, value) != 0)
+        {
+            fail(outcome, "value differs from the store: %s", line.c_str());
+        }
+        lastChannel = channel;
+        lastTimestamp = timestamp;
+    }
+}
+
+static Outcome runScenario(const Scenario &scenario, Device &device, Connection &dashboard)
+{
+    Outcome outcome;
+    device.chunkLimit = scenario.chunkLimit;
+    HistoryQuery query = expectedQuery(scenario.request);
+    size_t expectedRecords = recordsInRange(query);
+
+    std::atomic<bool> writing{scenario.live};
+    std::thread writer([&]()
+                       {
+        while (writing)
+        {
+            lockTimeSeriesStore();
+            appendSecond(storeNow + 1);
+            unlockTimeSeriesStore();
+            usleep(1000);
+        } });
+
+    timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    publish(dashboard, device.requestTopic, scenario.request);
+
+    bool final = false;
+    int lastChannel = -1;
+    uint32_t lastTimestamp = 0;
+    while (!final)
+    {
+        std::string body;
+        std::string topic;
+        std::string payload;
+        uint8_t header = readPacket(dashboard, body, scenario.answered ? RESPONSE_TIMEOUT_MS : QUIET_MS);
+        if (header == 0)
+        {
+            if (scenario.answered)
+            {
+                fail(outcome, "%s", "response incomplete: timed out");
+            }
+            break;
+        }
+        if ((header >> 4) != 3 || !parsePublish(body, topic, payload) || topic != device.responseTopic)
+        {
+            continue;
+        }
+        if (!scenario.answered)
+        {
+            fail(outcome, "%s", "answered a request that should be ignored");
+            break;
+        }
+        outcome.bytes += payload.size();
+        checkChunk(query, payload, scenario.chunkLimit, outcome, final, lastChannel, lastTimestamp);
+        outcome.chunks++;
+    }
+
+    timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    outcome.seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    writing = false;
+    writer.join();
+
+    if (scenario.answered && !scenario.live && outcome.records != expectedRecords)
+    {
+        char detail[64];
+        snprintf(detail, sizeof(detail), "%zu records, %zu in range", outcome.records, expectedRecords);
+        fail(outcome, "%s", detail);
+    }
+    if (scenario.answered && outcome.records == 0)
+    {
+        fail(outcome, "%s", "no records");
+    }
+    return outcome;
+}
+
+static bool resolveBroker(const char *spec, sockaddr_in &address)
+{
+    std::string host(spec);
+    int port = 1883;
+    size_t colon = host.rfind(':');
+    if (colon != std::string::npos)
+    {
+        port = atoi(host.c_str() + colon + 1);
+        host.resize(colon);
+    }
+    addrinfo hints = {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo *result = NULL;
+    if (getaddrinfo(host.c_str(), NULL, &hints, &result) != 0 || result == NULL)
+    {
+        return false;
+    }
+    address = *(sockaddr_in *)result->ai_addr;
+    address.sin_port = htons(port);
+    freeaddrinfo(result);
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    BrokerStandIn standIn;
+    sockaddr_in broker = {};
+    if (argc == 3 && strcmp(argv[1], "--broker") == 0)
+    {
+        if (!resolveBroker(argv[2], broker))
+        {
+            fprintf(stderr, "cannot resolve %s\n", argv[2]);
+            return 2;
+        }
+    }
+    else if (argc == 1)
+    {
+        broker.sin_family = AF_INET;
+        broker.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        broker.sin_port = htons(startBrokerStandIn(standIn));
+    }
+    else
+    {
+        fprintf(stderr, "usage: %s [--broker host:port]\n", argv[0]);
+        return 2;
+    }
+
+    for (uint32_t now = 1; now <= STORE_START_S; now++)
+    {
+        appendSecond(now);
+    }
+
+    // The device's own topics, as the firmware maps them
+    static const uint8_t MAC[6] = {0x24, 0x6f, 0x28, 0xa1, 0xb2, 0xc3};
+    MqttIdentity identity;
+    buildMQTTIdentity(identity, MAC);
+    Device device;
+    mapDeviceTopic(identity, TOPIC_HISTORY_REQUEST, device.requestTopic, sizeof(device.requestTopic));
+    mapDeviceTopic(identity, TOPIC_HISTORY_RESPONSE, device.responseTopic, sizeof(device.responseTopic));
+
+    Connection dashboard;
+    if (!connectClient(device.connection, broker, identity.clientId) ||
+        !subscribe(device.connection, device.requestTopic) || !connectClient(dashboard, broker, "history-check") ||
+        !subscribe(dashboard, device.responseTopic))
+    {
+        fprintf(stderr, "cannot connect and subscribe to the broker\n");
+        return 2;
+    }
+    std::thread deviceThread(runDevice, &device);
+
+    size_t syncLimit = MQTT_BUFFER_SIZE - 2 - strlen(device.responseTopic) - MQTT_FIXED_HEADER_MAX;
+    char lastQuery[64];
+    snprintf(lastQuery, sizeof(lastQuery), "channels=all;res=raw;last=%d;id=live", STORE_RAW_POINTS / 2);
+    const Scenario scenarios[] = {
+        {"all, minute", "channels=all;res=minute;id=all", false, true, syncLimit},
+        {"two, raw, range", "channels=temperature,co;res=raw;from=258900;to=259100;id=raw", false, true,
+         MQTT_QUEUE_PAYLOAD_MAX},
+        {"one, hour, long id", "channels=smoke;res=hour;id=dashboard-restart-1", false, true, syncLimit},
+        {"all, raw, live", lastQuery, true, true, syncLimit},
+        {"all, minute, live", "channels=all;res=minute;last=36000;id=live2", true, true, MQTT_QUEUE_PAYLOAD_MAX},
+        {"empty range", "channels=temperature;from=20;to=10;id=none", false, false, syncLimit},
+        {"no channels", "channels=dust;id=none", false, false, syncLimit},
+    };
+
+    printf("broker %s:%d, device %s\n\n", inet_ntoa(broker.sin_addr), ntohs(broker.sin_port), identity.clientId);
+    printf("%-20s %7s %8s %9s %9s\n", "query", "chunks", "records", "bytes", "ms");
+    bool ok = true;
+    for (const Scenario &scenario : scenarios)
+    {
+        Outcome outcome = runScenario(scenario, device, dashboard);
+        ok = ok && outcome.ok;
+        printf("%-20s %7d %8zu %9zu %9.1f%s\n", scenario.name, outcome.chunks, outcome.records, outcome.bytes,
+               outcome.seconds * 1000, outcome.ok ? "" : "  FAIL");
+    }
+
+    device.stop = true;
+    deviceThread.join();
+    close(device.connection.fd);
+    close(dashboard.fd);
+    if (broker.sin_port == htons(standIn.port))
+    {
+        stopBrokerStandIn(standIn);
+        printf("\nbroker: %llu messages routed, %llu protocol errors\n", (unsigned long long)standIn.routed,
+               (unsigned long long)standIn.protocolErrors);
+        ok = ok && standIn.protocolErrors == 0;
+    }
+    printf("chunks published with the store locked: %llu, store reads without the lock: %llu\n",
+           (unsigned long long)device.lockedPublishes, (unsigned long long)unlockedReads);
+    ok = ok && device.lockedPublishes == 0 && unlockedReads == 0;
+    printf("%s\n", ok ? "all responses valid" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,308 @@
+// IAQ estimator check: replays a BME680 trace through the portable
+// kernels of air_quality_kernels.cpp and calibration_kernels.cpp, the
+// same calls updateAirQuality() makes on the device, and checks IAQ,
+// eCO2 and the accuracy state sample by sample. No dependencies beyond
+// libstdc++:
+//
+//   g++ -std=c++17 -O2 -Iinclude -o iaq_check tools/iaq_check.cpp
+//       src/air_quality_kernels.cpp src/calibration_kernels.cpp
+//   ./iaq_check [trace.csv]
+//
+// The trace defaults to tools/iaq_trace.csv. Its columns are time_s,
+// gas_kohm, humidity_pct and phase, one row per reading; lines starting
+// with '#' are comments. A recorded trace with the same columns can be
+// passed instead.
+//
+// Every sample is compared against a double-precision reference of the
+// documented formulas, and eCO2 must be the rescaled IAQ. The accuracy
+// state must be 0 until the heaters are warm and a baseline exists, 1 for
+// IAQ_SETTLE_MS after that and 2 afterwards, or 2 straight after warm-up
+// when the baseline came from NVS. Phases named in the trace add
+// behavioural checks: clean air scores well, a VOC incident scores badly
+// without dragging the baseline down, and a humidity step at unchanged
+// air quality barely moves the index (the uncompensated index is shown
+// for contrast).
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "air_quality.h"
+#include "calibration_store.h"
+
+#define DEFAULT_TRACE "tools/iaq_trace.csv"
+#define BME680_PERIOD_MS 10000   // Default period, SENSOR_GROUP_TABLE; the baseline weights are per period
+#define BENCH_REPLAYS 20000      // Timed replays of the whole trace
+#define IAQ_TOLERANCE 0.05       // Index points against the double reference
+#define CLEAN_IAQ_MAX 50.0f      // "Excellent" band
+#define VOC_IAQ_MIN 150.0f       // An incident must reach "moderately polluted"
+#define HUMID_IAQ_MAX 100.0f     // A humidity step alone stays "good"
+#define VOC_BASELINE_DROP 0.05f  // Largest relative baseline loss over an incident
+
+static double nowS()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// One trace row
+struct Sample
+{
+    uint32_t ms;
+    float gasKOhm;
+    float humidity;
+    std::string phase;
+};
+
+// Kernel outputs for one row
+struct Result
+{
+    float baseline;
+    AirQualityEstimate estimate;
+    IaqAccuracy accuracy;
+};
+
+static bool loadTrace(const char *path, std::vector<Sample> &trace)
+{
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+    {
+        perror(path);
+        return false;
+    }
+
+    char line[256];
+    bool header = true;
+    while (fgets(line, sizeof(line), file))
+    {
+        if (line[0] == '#' || line[0] == '\n')
+        {
+            continue;
+        }
+        if (header)
+        {
+            header = false;
+            continue;
+        }
+        double seconds;
+        float gas, humidity;
+        char phase[32] = "";
+        if (sscanf(line, "%lf,%f,%f,%31[^,\r\n]", &seconds, &gas, &humidity, phase) < 3)
+        {
+            fprintf(stderr, "%s: bad row: %s", path, line);
+            fclose(file);
+            return false;
+        }
+        trace.push_back({(uint32_t)llround(seconds * 1000), gas, humidity, phase});
+    }
+    fclose(file);
+    return !trace.empty();
+}
+
+// updateAirQuality() and its baseline tracking, with the trace as the clock
+static std::vector<Result> replay(const std::vector<Sample> &trace, float cachedBaseline)
+{
+    std::vector<Result> results(trace.size());
+    float baseline = cachedBaseline;
+    uint32_t learningStartMs = 0;
+    uint32_t lastTrackedMs = 0;
+    for (size_t i = 0; i < trace.size(); i++)
+    {
+        const Sample &sample = trace[i];
+        float compensated = compensateGasResistance(sample.gasKOhm, sample.humidity);
+        if (sample.ms >= CAL_WARMUP_MS)
+        {
+            float periods = lastTrackedMs == 0 ? 1.0f : (float)(sample.ms - lastTrackedMs) / BME680_PERIOD_MS;
+            lastTrackedMs = sample.ms;
+            baseline = stepBaseline(baseline, compensated, periods);
+        }
+        results[i].baseline = baseline;
+        results[i].estimate = estimateAirQuality(compensated, sample.humidity, baseline);
+        results[i].accuracy = classifyAirQualityAccuracy(baseline, sample.ms, cachedBaseline > 0, learningStartMs);
+    }
+    return results;
+}
+
+// The documented IAQ formula in double precision
+static double referenceIaq(double gasKOhm, double humidity, double baseline)
+{
+    double compensated = gasKOhm * exp(IAQ_HUMIDITY_SLOPE * (humidity - IAQ_HUMIDITY_REFERENCE));
+    double gasScore = IAQ_GAS_WEIGHT;
+    if (baseline > 0 && compensated < baseline)
+    {
+        gasScore = compensated / baseline * IAQ_GAS_WEIGHT;
+    }
+    double humidityScore = humidity > IAQ_HUMIDITY_REFERENCE
+                               ? (100 - humidity) / (100 - IAQ_HUMIDITY_REFERENCE) * IAQ_HUMIDITY_WEIGHT
+                               : humidity / IAQ_HUMIDITY_REFERENCE * IAQ_HUMIDITY_WEIGHT;
+    humidityScore = fmin(fmax(humidityScore, 0.0), IAQ_HUMIDITY_WEIGHT);
+    return (100 - gasScore - humidityScore) * 5;
+}
+
+// Compare one replay against the reference; returns false on any mismatch
+static bool checkReplay(const char *name, const std::vector<Sample> &trace, const std::vector<Result> &results,
+                        double cachedBaseline)
+{
+    bool ok = true;
+    double baseline = cachedBaseline;
+    double learningStartMs = -1;
+    double lastTrackedMs = -1;
+    double maxIaqError = 0, maxEco2Error = 0;
+    int accuracyErrors = 0;
+    for (size_t i = 0; i < trace.size(); i++)
+    {
+        const Sample &sample = trace[i];
+        const Result &result = results[i];
+        double compensated = sample.gasKOhm * exp(IAQ_HUMIDITY_SLOPE * (sample.humidity - IAQ_HUMIDITY_REFERENCE));
+        bool tracked = sample.ms >= CAL_WARMUP_MS && compensated > 0 && !isinf(compensated);
+        if (sample.ms >= CAL_WARMUP_MS)
+        {
+            double periods = lastTrackedMs < 0 ? 1.0 : (sample.ms - lastTrackedMs) / BME680_PERIOD_MS;
+            lastTrackedMs = sample.ms;
+            if (tracked)
+            {
+                double alpha = compensated > baseline ? CAL_ALPHA_RISE : CAL_ALPHA_FALL;
+                double weight = 1 - pow(1 - alpha, periods);
+                baseline = baseline <= 0 ? compensated : baseline + weight * (compensated - baseline);
+            }
+        }
+
+        double iaqError = fabs(result.estimate.iaq - referenceIaq(sample.gasKOhm, sample.humidity, baseline));
+        double eco2 = IAQ_ECO2_BASE_PPM + IAQ_ECO2_PPM_PER_INDEX * result.estimate.iaq;
+        double eco2Error = fabs(result.estimate.eco2 - eco2);
+        maxIaqError = fmax(maxIaqError, iaqError);
+        maxEco2Error = fmax(maxEco2Error, eco2Error);
+        if (!(result.estimate.iaq >= 0 && result.estimate.iaq <= 500))
+        {
+            printf("  %s: IAQ %.1f out of range at %.0f s\n", name, result.estimate.iaq, sample.ms / 1000.0);
+            ok = false;
+        }
+
+        IaqAccuracy expected = IAQ_STABILIZING;
+        if (baseline > 0 && sample.ms >= CAL_WARMUP_MS)
+        {
+            if (learningStartMs < 0)
+            {
+                learningStartMs = sample.ms;
+            }
+            bool settled = cachedBaseline > 0 || sample.ms - learningStartMs >= IAQ_SETTLE_MS;
+            expected = settled ? IAQ_CALIBRATED : IAQ_LEARNING;
+        }
+        if (result.accuracy != expected)
+        {
+            if (accuracyErrors++ == 0)
+            {
+                printf("  %s: accuracy %d, expected %d at %.0f s\n", name, result.accuracy, expected,
+                       sample.ms / 1000.0);
+            }
+            ok = false;
+        }
+    }
+
+    // eCO2 is a float sum of up to ~3400 ppm, so allow its rounding
+    ok = ok && maxIaqError <= IAQ_TOLERANCE && maxEco2Error <= 1e-3;
+    printf("%-10s %10.4f %10.4f %10d   %s\n", name, maxIaqError, maxEco2Error, accuracyErrors, ok ? "ok" : "FAIL");
+    return ok;
+}
+
+// Per-phase summary of the learning replay, plus the phase checks. "raw"
+// is the index without humidity compensation; "base chg" is the baseline
+// change from just before the phase's first sample to its last one.
+static bool checkPhases(const std::vector<Sample> &trace, const std::vector<Result> &results)
+{
+    std::vector<std::string> phases;
+    for (const Sample &sample : trace)
+    {
+        if (std::find(phases.begin(), phases.end(), sample.phase) == phases.end())
+        {
+            phases.push_back(sample.phase);
+        }
+    }
+
+    bool ok = true;
+    printf("\n%-10s %7s %8s %8s %8s %9s %8s %10s\n", "phase", "samples", "IAQ min", "mean", "max", "eCO2 max",
+           "raw max", "base chg");
+    for (const std::string &phase : phases)
+    {
+        int count = 0;
+        float iaqMin = 500, iaqMax = 0, eco2Max = 0, rawMax = 0;
+        double iaqSum = 0;
+        float baselineFirst = 0, baselineLast = 0;
+        for (size_t i = 0; i < trace.size(); i++)
+        {
+            if (trace[i].phase != phase)
+            {
+                continue;
+            }
+            const AirQualityEstimate &estimate = results[i].estimate;
+            // Same reading scored without humidity compensation
+            float raw = estimateAirQuality(trace[i].gasKOhm, trace[i].humidity, results[i].baseline).iaq;
+            iaqMin = fminf(iaqMin, estimate.iaq);
+            iaqMax = fmaxf(iaqMax, estimate.iaq);
+            eco2Max = fmaxf(eco2Max, estimate.eco2);
+            rawMax = fmaxf(rawMax, raw);
+            iaqSum += estimate.iaq;
+            baselineFirst = count == 0 && i > 0 ? results[i - 1].baseline : baselineFirst;
+            baselineLast = results[i].baseline;
+            count++;
+        }
+
+        bool phaseOk = true;
+        float drop = baselineFirst > 0 ? (baselineFirst - baselineLast) / baselineFirst : 0;
+        if (phase == "clean")
+        {
+            phaseOk = iaqMax <= CLEAN_IAQ_MAX;
+        }
+        else if (phase == "voc")
+        {
+            phaseOk = iaqMax >= VOC_IAQ_MIN && drop < VOC_BASELINE_DROP;
+        }
+        else if (phase == "humid")
+        {
+            phaseOk = iaqMax <= HUMID_IAQ_MAX;
+        }
+        ok = ok && phaseOk;
+        printf("%-10s %7d %8.1f %8.1f %8.1f %9.0f %8.1f %9.1f%% %s\n", phase.c_str(), count, iaqMin, iaqSum / count,
+               iaqMax, eco2Max, rawMax, -drop * 100, phaseOk ? "" : "FAIL");
+    }
+    return ok;
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = argc > 1 ? argv[1] : DEFAULT_TRACE;
+    std::vector<Sample> trace;
+    if (!loadTrace(path, trace))
+    {
+        fprintf(stderr, "No samples in %s\n", path);
+        return 1;
+    }
+    printf("%s: %zu samples over %.0f s\n\n", path, trace.size(), (trace.back().ms - trace.front().ms) / 1000.0);
+
+    std::vector<Result> learning = replay(trace, 0);
+    float cachedBaseline = learning.back().baseline;
+    std::vector<Result> cached = replay(trace, cachedBaseline);
+
+    bool ok = true;
+    printf("%-10s %10s %10s %10s\n", "baseline", "IAQ err", "eCO2 err", "acc errs");
+    ok &= checkReplay("learned", trace, learning, 0);
+    ok &= checkReplay("cached", trace, cached, cachedBaseline);
+    ok &= checkPhases(trace, learning);
+
+    double start = nowS();
+    volatile float sink = 0;
+    for (int i = 0; i < BENCH_REPLAYS; i++)
+    {
+        sink += replay(trace, 0).back().estimate.iaq;
+    }
+    double elapsed = nowS() - start;
+    printf("\n%.1f ns per update (baseline step, IAQ, eCO2 and accuracy)\n",
+           elapsed / BENCH_REPLAYS / trace.size() * 1e9);
+
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
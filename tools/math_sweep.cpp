@@ -0,0 +1,235 @@
+// Math kernel sweep: checks the table-driven kernels of math_kernels.cpp
+// against libm over every float of their input ranges and times them
+// against the libm calls they replace. No dependencies beyond libstdc++:
+//
+//   g++ -std=c++17 -O2 -Iinclude -o math_sweep tools/math_sweep.cpp
+//       src/math_kernels.cpp
+//   ./math_sweep
+//
+// The sweeps take about a minute.
+//
+// The MQ-2 ratio range comes from the ADC: over codes 1..4094 the sensor
+// resistance spans 2.4 ohm to 41 Mohm, so with R0 anywhere between 1 and
+// 100 kOhm Rs/R0 stays within 2^-16..2^16. fastLog2() is swept over every
+// float in that range, fastExp2() over every float of +-32 (|b| * 16 for
+// the MQ-2 curves, down to 2^-24 where 2^x rounds to 1), and each MQ-2
+// curve over every ratio. Altitude covers every float pressure of the
+// table, the sound level every 12-bit ADC value.
+//
+// The reference is libm in double precision. A kernel fails when its
+// worst error exceeds the bound documented in math_kernels.h. Timings are
+// nanoseconds per call over ratios, pressures and ADC values spread
+// across the same ranges. A desktop libm is fast, so they only show the
+// relative cost; on the ESP32 powf() and log2f() are much slower.
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <random>
+#include <vector>
+#include "math_kernels.h"
+
+#define RATIO_MIN_LOG2 -16 // Rs/R0 range over the ADC, as a power of two
+#define RATIO_MAX_LOG2 16
+#define EXP2_MIN_LOG2 -24   // Smallest |x| swept for fastExp2()
+#define EXP2_MAX 32.0f
+#define LOG2_BOUND 4.4e-5   // Absolute, from math_kernels.h
+#define EXP2_BOUND 1.6e-5   // Relative
+#define PPM_BOUND 1.2e-4    // Relative, for the MQ-2 curves
+#define ALTITUDE_BOUND 0.29 // m
+#define BENCH_INPUTS 4096
+#define BENCH_ROUNDS 4096   // Passes over the inputs per timing
+
+// MQ-2 curves, as in computeMQ2Concentrations()
+struct Curve
+{
+    const char *name;
+    float a;
+    float b;
+};
+
+static const Curve CURVES[] = {
+    {"LPG", 574.25f, -2.222f},
+    {"CO", 36974.0f, -3.109f},
+    {"smoke", 3616.1f, -2.675f},
+};
+#define CURVE_COUNT (sizeof(CURVES) / sizeof(CURVES[0]))
+
+static double nowS()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint32_t floatBits(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static float bitsFloat(uint32_t bits)
+{
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// Worst error of one kernel and where it occurs
+struct Sweep
+{
+    double error;
+    double at;
+    uint64_t count;
+};
+
+static void record(Sweep &sweep, double error, double at)
+{
+    if (!(error <= sweep.error)) // Also catches NaN
+    {
+        sweep.error = error;
+        sweep.at = at;
+    }
+    sweep.count++;
+}
+
+static bool report(const char *name, const Sweep &sweep, double bound, const char *unit)
+{
+    bool ok = sweep.error <= bound;
+    printf("%-14s %12llu %12.4g %12.4g %-4s %14.6g   %s\n", name, (unsigned long long)sweep.count, sweep.error, bound,
+           unit, sweep.at, ok ? "ok" : "FAIL");
+    return ok;
+}
+
+static bool sweepKernels()
+{
+    bool ok = true;
+    uint32_t ratioFirst = floatBits(ldexpf(1.0f, RATIO_MIN_LOG2));
+    uint32_t ratioLast = floatBits(ldexpf(1.0f, RATIO_MAX_LOG2));
+
+    printf("%-14s %12s %12s %12s %-4s %14s\n", "kernel", "inputs", "max error", "bound", "", "worst at");
+
+    Sweep log2Sweep = {0, 0, 0};
+    for (uint32_t bits = ratioFirst; bits <= ratioLast; bits++)
+    {
+        float x = bitsFloat(bits);
+        record(log2Sweep, fabs(fastLog2(x) - log2((double)x)), x);
+    }
+    ok &= report("fastLog2", log2Sweep, LOG2_BOUND, "abs");
+
+    Sweep exp2Sweep = {0, 0, 0};
+    uint32_t exp2First = floatBits(ldexpf(1.0f, EXP2_MIN_LOG2));
+    uint32_t exp2Last = floatBits(EXP2_MAX);
+    for (uint32_t bits = exp2First; bits <= exp2Last; bits++)
+    {
+        for (float x : {bitsFloat(bits), -bitsFloat(bits)})
+        {
+            double reference = exp2((double)x);
+            record(exp2Sweep, fabs(fastExp2(x) - reference) / reference, x);
+        }
+    }
+    ok &= report("fastExp2", exp2Sweep, EXP2_BOUND, "rel");
+
+    for (size_t c = 0; c < CURVE_COUNT; c++)
+    {
+        const Curve &curve = CURVES[c];
+        Sweep ppmSweep = {0, 0, 0};
+        for (uint32_t bits = ratioFirst; bits <= ratioLast; bits++)
+        {
+            float ratio = bitsFloat(bits);
+            double reference = curve.a * pow((double)ratio, (double)curve.b);
+            record(ppmSweep, fabs(powerLawPpm(fastLog2(ratio), curve.a, curve.b) - reference) / reference, ratio);
+        }
+        char name[32];
+        snprintf(name, sizeof(name), "ppm %s", curve.name);
+        ok &= report(name, ppmSweep, PPM_BOUND, "rel");
+    }
+
+    Sweep altitudeSweep = {0, 0, 0};
+    for (uint32_t bits = floatBits(ALT_TABLE_MIN_HPA); bits <= floatBits(ALT_TABLE_MAX_HPA); bits++)
+    {
+        float pressure = bitsFloat(bits);
+        double reference = 44330.0 * (1.0 - pow(pressure / SEALEVELPRESSURE_HPA, 0.1903));
+        record(altitudeSweep, fabs(altitudeFromPressure(pressure) - reference), pressure);
+    }
+    ok &= report("altitude", altitudeSweep, ALTITUDE_BOUND, "m");
+
+    Sweep soundSweep = {0, 0, 0};
+    for (int32_t raw = 0; raw <= 4095; raw++)
+    {
+        int32_t reference = raw * (100 - SOUND_DB_MIN) / 1023 + SOUND_DB_MIN; // map(raw, 0, 1023, 30, 100)
+        record(soundSweep, abs(soundDecibelsFromRaw(raw) - reference), raw);
+    }
+    ok &= report("sound dB", soundSweep, 0, "dB");
+    return ok;
+}
+
+// Time one kernel and its libm counterpart over the same inputs
+template <typename Input, typename Kernel, typename Libm>
+static void bench(const char *name, const std::vector<Input> &inputs, Kernel kernel, Libm libm)
+{
+    volatile float sink = 0;
+    double times[2];
+    for (int pass = 0; pass < 2; pass++)
+    {
+        double start = nowS();
+        float sum = 0;
+        for (int round = 0; round < BENCH_ROUNDS; round++)
+        {
+            for (const Input &input : inputs)
+            {
+                sum += pass == 0 ? kernel(input) : libm(input);
+            }
+        }
+        sink = sink + sum;
+        times[pass] = (nowS() - start) / BENCH_ROUNDS / inputs.size() * 1e9;
+    }
+    printf("%-14s %10.2f %10.2f %9.1fx\n", name, times[0], times[1], times[1] / times[0]);
+}
+
+static void benchKernels()
+{
+    std::mt19937 rng(12345);
+    std::uniform_real_distribution<float> log2Ratio(RATIO_MIN_LOG2, RATIO_MAX_LOG2);
+    std::uniform_real_distribution<float> pressure(ALT_TABLE_MIN_HPA, ALT_TABLE_MAX_HPA);
+    std::vector<float> ratios(BENCH_INPUTS), pressures(BENCH_INPUTS);
+    std::vector<int32_t> raws(BENCH_INPUTS);
+    for (int i = 0; i < BENCH_INPUTS; i++)
+    {
+        ratios[i] = exp2f(log2Ratio(rng));
+        pressures[i] = pressure(rng);
+        raws[i] = rng() % 4096;
+    }
+
+    printf("\n%-14s %10s %10s %10s\n", "ns per call", "kernel", "libm", "speed-up");
+    bench("log2", ratios, [](float x) { return fastLog2(x); }, [](float x) { return log2f(x); });
+    bench(
+        "3 MQ-2 curves", ratios,
+        [](float ratio)
+        {
+            float log2Ratio = fastLog2(ratio);
+            return powerLawPpm(log2Ratio, CURVES[0].a, CURVES[0].b) +
+                   powerLawPpm(log2Ratio, CURVES[1].a, CURVES[1].b) +
+                   powerLawPpm(log2Ratio, CURVES[2].a, CURVES[2].b);
+        },
+        [](float ratio)
+        {
+            return CURVES[0].a * powf(ratio, CURVES[0].b) + CURVES[1].a * powf(ratio, CURVES[1].b) +
+                   CURVES[2].a * powf(ratio, CURVES[2].b);
+        });
+    bench("altitude", pressures, [](float p) { return altitudeFromPressure(p); },
+          [](float p) { return 44330.0f * (1.0f - powf(p / (float)SEALEVELPRESSURE_HPA, 0.1903f)); });
+    bench("sound dB", raws, [](int32_t raw) { return (float)soundDecibelsFromRaw(raw); },
+          [](int32_t raw) { return (float)(raw * (100 - SOUND_DB_MIN) / 1023 + SOUND_DB_MIN); });
+}
+
+int main()
+{
+    initializeMathKernels();
+    bool ok = sweepKernels();
+    benchKernels();
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,798 @@
+// Async transport throughput and latency test: runs the outbound queue of
+// the async MQTT transport (lib/mqtt/mqtt_queue.cpp) against an MQTT broker
+// and measures what a subscriber receives. Linux only, no dependencies
+// beyond libstdc++:
+//
+//   g++ -std=c++17 -O2 -pthread -Iinclude -Ilib/mqtt -o mqtt_queue_check
+//       tools/mqtt_queue_check.cpp lib/mqtt/mqtt_queue.cpp
+//       lib/mqtt/mqtt_identity.cpp src/sensor_channels.cpp
+//   ./mqtt_queue_check                       (built-in broker stand-in)
+//   ./mqtt_queue_check --broker 127.0.0.1:1883   (e.g. a local mosquitto)
+//
+// The device side is threaded like mqtt_async.cpp. Producers push under the
+// queue mutex and never block, except bulk producers, which wait for a free
+// slot like mqttQueueWaitForSpace(). A drain thread peeks the oldest
+// message, publishes it and completes it; when the publish does not fit the
+// TCP send buffer it backs off 10 ms and retries. The link stands in for
+// lwIP: a LINK_SEND_BUFFER-byte send buffer that a network thread empties
+// onto the socket at the scenario's link rate.
+//
+// Readings go out like publishMQTTReadings(): every channel, retained and
+// coalescing, on the device's mapped topics. Each payload carries a message
+// number after the formatted value, so a monitor subscribed to the device's
+// topics can measure enqueue-to-delivery latency. Per scenario the table
+// gives offered and delivered messages per second, latency percentiles and
+// the queue's drop and coalesce counts. A scenario fails if
+//   - the monitor does not receive every message the queue sent,
+//   - a topic's messages arrive out of order,
+//   - a queued message never arrives although no later push displaced it
+//     (coalesced over it or evicted it) while it was still queued,
+//   - a topic's last delivered message is not the last one queued on it
+//     (the newest state must always get through), or
+//   - a scenario within the link's capacity loses any message.
+//
+// tools/fleet_sim loads the broker with thousands of nodes; this test looks
+// at one node's transport and its backpressure instead.
+
+#include <arpa/inet.h>
+#include <math.h>
+#include <netdb.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "broker_stand_in.h"
+#include "mqtt_identity.h"
+#include "mqtt_queue.h"
+#include "runtime_config.h"
+#include "sensor_channels.h"
+
+#define LINK_SEND_BUFFER 5744   // lwIP TCP_SND_BUF of the ESP32 Arduino core
+#define DRAIN_BACKOFF_MS 10     // drainQueueTask() retry after a full send buffer
+#define WAIT_FOR_SPACE_MS 1000  // publishMQTTMessage() limit for non-coalescing messages
+#define SETTLE_TIMEOUT_MS 10000 // For the last messages to arrive after a scenario
+#define MAX_MESSAGES 4000000    // Message numbers per run
+
+/*
+ * MQTT client side
+ */
+
+static uint64_t nowUs()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void appendRemainingLength(std::string &packet, size_t length)
+{
+    do
+    {
+        uint8_t digit = length % 128;
+        length /= 128;
+        packet += (char)(length > 0 ? digit | 0x80 : digit);
+    } while (length > 0);
+}
+
+static void appendString(std::string &packet, const char *text)
+{
+    size_t length = strlen(text);
+    packet += (char)(length >> 8);
+    packet += (char)(length & 0xFF);
+    packet.append(text, length);
+}
+
+static std::string buildPacket(uint8_t header, const std::string &body)
+{
+    std::string packet(1, (char)header);
+    appendRemainingLength(packet, body.size());
+    return packet + body;
+}
+
+static bool sendAll(int fd, const std::string &data)
+{
+    size_t sent = 0;
+    while (sent < data.size())
+    {
+        ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0)
+        {
+            return false;
+        }
+        sent += n;
+    }
+    return true;
+}
+
+// Buffered reader of one connection
+struct Connection
+{
+    int fd = -1;
+    std::string in;
+};
+
+// Reads the next packet within timeoutMs; header 0 on timeout or close
+static uint8_t readPacket(Connection &connection, std::string &body, int timeoutMs)
+{
+    uint64_t deadline = nowUs() + (uint64_t)timeoutMs * 1000;
+    for (;;)
+    {
+        std::string &in = connection.in;
+        size_t length = 0;
+        size_t pos = 1;
+        int shift = 0;
+        bool complete = false;
+        while (pos < in.size() && pos <= 4)
+        {
+            uint8_t digit = in[pos++];
+            length |= (size_t)(digit & 0x7F) << shift;
+            shift += 7;
+            if (!(digit & 0x80))
+            {
+                complete = true;
+                break;
+            }
+        }
+        if (complete && in.size() >= pos + length)
+        {
+            uint8_t header = in[0];
+            body = in.substr(pos, length);
+            in.erase(0, pos + length);
+            return header;
+        }
+
+        uint64_t now = nowUs();
+        pollfd fd = {connection.fd, POLLIN, 0};
+        if (now >= deadline || poll(&fd, 1, (int)std::min<uint64_t>((deadline - now) / 1000 + 1, 100)) < 0)
+        {
+            return 0;
+        }
+        if (fd.revents == 0)
+        {
+            continue;
+        }
+        char buffer[16384];
+        ssize_t n = recv(connection.fd, buffer, sizeof(buffer), 0);
+        if (n <= 0)
+        {
+            return 0;
+        }
+        in.append(buffer, n);
+    }
+}
+
+static bool connectClient(Connection &connection, const sockaddr_in &broker, const char *clientId)
+{
+    connection.fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (connection.fd < 0 || connect(connection.fd, (const sockaddr *)&broker, sizeof(broker)) != 0)
+    {
+        return false;
+    }
+    int noDelay = 1; // Host delayed ACKs would otherwise hold small packets for 40 ms
+    setsockopt(connection.fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+    std::string body;
+    appendString(body, "MQTT");
+    body += (char)4;    // Protocol level 3.1.1
+    body += (char)0x02; // Clean session
+    body += (char)0;
+    body += (char)120;
+    appendString(body, clientId);
+    std::string reply;
+    return sendAll(connection.fd, buildPacket(0x10, body)) && readPacket(connection, reply, 2000) == 0x20 &&
+           reply.size() == 2 && reply[1] == 0;
+}
+
+static bool subscribe(Connection &connection, const char *filter)
+{
+    std::string body("\x00\x01", 2);
+    appendString(body, filter);
+    body += (char)0;
+    std::string reply;
+    return sendAll(connection.fd, buildPacket(0x82, body)) && readPacket(connection, reply, 2000) == 0x90;
+}
+
+/*
+ * Device: queue, drain thread and link
+ */
+
+struct Device
+{
+    Connection connection;
+    std::vector<MqttQueueEntry> entries = std::vector<MqttQueueEntry>(MQTT_QUEUE_LENGTH);
+    MqttQueue queue;
+    MqttQueuePolicy policy = MQTT_QUEUE_POLICY;
+    std::mutex queueMutex;
+
+    // Task notification of the drain thread
+    std::mutex notifyMutex;
+    std::condition_variable notifyCondition;
+    bool notified = false;
+
+    // Send buffer of the TCP stack
+    std::mutex linkMutex;
+    std::condition_variable linkCondition;
+    std::string linkPending;
+    double linkBytesPerS = 0; // 0: as fast as the socket takes them
+
+    std::atomic<bool> stop{false};
+};
+
+static void notifyDrain(Device &device)
+{
+    std::lock_guard<std::mutex> lock(device.notifyMutex);
+    device.notified = true;
+    device.notifyCondition.notify_one();
+}
+
+// Like AsyncMqttClient::publish(): false, and nothing written, when the
+// packet does not fit the space left in the send buffer
+static bool linkPublish(Device &device, const MqttQueueEntry &entry)
+{
+    std::string body;
+    appendString(body, entry.topic);
+    body.append(entry.payload, entry.length);
+    std::string packet = buildPacket(0x30 | (entry.retain ? 1 : 0), body);
+
+    std::lock_guard<std::mutex> lock(device.linkMutex);
+    if (device.linkPending.size() + packet.size() > LINK_SEND_BUFFER)
+    {
+        return false;
+    }
+    device.linkPending += packet;
+    device.linkCondition.notify_one();
+    return true;
+}
+
+// Network thread: moves the send buffer onto the socket at the link rate
+static void runLink(Device *device)
+{
+    double credit = 0;
+    uint64_t last = nowUs();
+    std::unique_lock<std::mutex> lock(device->linkMutex);
+    while (!device->stop)
+    {
+        bool throttled = device->linkBytesPerS > 0;
+        device->linkCondition.wait_for(lock, std::chrono::milliseconds(throttled ? 1 : 100),
+                                       [&] { return device->stop || (!throttled && !device->linkPending.empty()); });
+        uint64_t now = nowUs();
+        credit = throttled ? std::min(credit + (now - last) * device->linkBytesPerS / 1e6, (double)LINK_SEND_BUFFER)
+                           : device->linkPending.size();
+        last = now;
+        size_t length = std::min(device->linkPending.size(), (size_t)credit);
+        if (length == 0)
+        {
+            continue;
+        }
+        std::string chunk = device->linkPending.substr(0, length);
+        device->linkPending.erase(0, length);
+        credit -= length;
+        lock.unlock();
+        sendAll(device->connection.fd, chunk);
+        lock.lock();
+    }
+}
+
+// Drain thread, as drainQueueTask(): publish the oldest message until the
+// queue is empty or the send buffer is full
+static void runDrain(Device *device)
+{
+    MqttQueueEntry entry;
+    int waitMs = -1;
+    while (!device->stop)
+    {
+        {
+            std::unique_lock<std::mutex> lock(device->notifyMutex);
+            device->notifyCondition.wait_for(lock, std::chrono::milliseconds(waitMs < 0 ? 100 : waitMs),
+                                             [&] { return device->stop || device->notified; });
+            device->notified = false;
+        }
+        waitMs = -1;
+
+        for (;;)
+        {
+            device->queueMutex.lock();
+            bool pending = peekMqttQueue(device->queue, entry);
+            device->queueMutex.unlock();
+            if (!pending)
+            {
+                break;
+            }
+            if (!linkPublish(*device, entry))
+            {
+                waitMs = DRAIN_BACKOFF_MS;
+                break;
+            }
+            uint32_t sentUs = (uint32_t)nowUs();
+            device->queueMutex.lock();
+            completeMqttQueue(device->queue, entry, sentUs);
+            device->queueMutex.unlock();
+        }
+    }
+}
+
+/*
+ * Message numbers
+ */
+
+// Enqueue time of every message number, written before the message is
+// queued and read when it arrives
+static std::unique_ptr<std::atomic<uint64_t>[]> enqueuedUs(new std::atomic<uint64_t>[MAX_MESSAGES]);
+
+// What the producer saw become of every message: queued, then possibly
+// displaced (coalesced over or evicted) while still in the queue. Only a
+// displaced message may fail to arrive.
+enum MessageFate : uint8_t
+{
+    FATE_NONE,
+    FATE_QUEUED,
+    FATE_DISPLACED
+};
+static std::vector<uint8_t> fates(MAX_MESSAGES);
+static std::vector<uint8_t> arrived(MAX_MESSAGES); // Written by the monitor
+
+static uint32_t messageNumber(const char *payload, size_t length)
+{
+    std::string text(payload, length);
+    size_t marker = text.find("n=");
+    return marker == std::string::npos ? MAX_MESSAGES : strtoul(text.c_str() + marker + 2, NULL, 10);
+}
+
+// Message the next push displaces, from the queue as it is before the
+// push: the queued message on the same topic if coalescing, else the
+// oldest if the queue is full. MAX_MESSAGES if none.
+static uint32_t displacedMessage(const Device &device, const char *topic, bool coalesce)
+{
+    const MqttQueue &queue = device.queue;
+    for (uint16_t i = 0; device.policy == MQTT_COALESCE && coalesce && i < queue.count; i++)
+    {
+        const MqttQueueEntry &queued = queue.entries[(queue.head + i) % MQTT_QUEUE_LENGTH];
+        if (queued.coalesce && strcmp(queued.topic, topic) == 0)
+        {
+            return messageNumber(queued.payload, queued.length);
+        }
+    }
+    if (queue.count == MQTT_QUEUE_LENGTH)
+    {
+        const MqttQueueEntry &oldest = queue.entries[queue.head];
+        return messageNumber(oldest.payload, oldest.length);
+    }
+    return MAX_MESSAGES;
+}
+
+// As mqttQueuePublish(), recording what the push did
+static bool devicePublish(Device &device, uint32_t number, const char *topic, const std::string &payload, bool retain,
+                          bool coalesce)
+{
+    device.queueMutex.lock();
+    uint32_t displaced = displacedMessage(device, topic, coalesce);
+    bool queued = pushMqttQueue(device.queue, device.policy, topic, payload.data(), payload.size(), retain, coalesce,
+                                (uint32_t)nowUs());
+    if (queued)
+    {
+        fates[number] = FATE_QUEUED;
+        if (displaced < MAX_MESSAGES)
+        {
+            fates[displaced] = FATE_DISPLACED;
+        }
+    }
+    device.queueMutex.unlock();
+    if (queued)
+    {
+        notifyDrain(device);
+    }
+    return queued;
+}
+
+// As mqttQueueWaitForSpace()
+static bool waitForSpace(Device &device, uint32_t timeoutMs)
+{
+    uint64_t start = nowUs();
+    for (;;)
+    {
+        device.queueMutex.lock();
+        bool full = device.queue.count >= MQTT_QUEUE_LENGTH;
+        device.queueMutex.unlock();
+        if (!full)
+        {
+            return true;
+        }
+        if (nowUs() - start >= (uint64_t)timeoutMs * 1000)
+        {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+}
+
+static bool deviceIdle(Device &device)
+{
+    std::lock_guard<std::mutex> queueLock(device.queueMutex);
+    std::lock_guard<std::mutex> linkLock(device.linkMutex);
+    return device.queue.count == 0 && device.linkPending.empty();
+}
+
+/*
+ * Monitor
+ */
+
+struct Monitor
+{
+    Connection connection;
+    std::mutex mutex;
+    uint64_t delivered = 0;
+    uint64_t bytes = 0;
+    uint64_t firstUs = 0;
+    uint64_t lastUs = 0;
+    uint64_t outOfOrder = 0;
+    uint64_t malformed = 0;
+    std::vector<uint32_t> latencyUs;
+    std::map<std::string, uint32_t> lastNumber; // Per topic
+    std::atomic<bool> stop{false};
+};
+
+static void resetMonitor(Monitor &monitor)
+{
+    std::lock_guard<std::mutex> lock(monitor.mutex);
+    monitor.delivered = 0;
+    monitor.bytes = 0;
+    monitor.firstUs = 0;
+    monitor.lastUs = 0;
+    monitor.outOfOrder = 0;
+    monitor.malformed = 0;
+    monitor.latencyUs.clear();
+    monitor.lastNumber.clear();
+}
+
+// Records every live PUBLISH; retained copies a real broker sends on
+// subscribing are left out
+static void runMonitor(Monitor *monitor)
+{
+    std::string body;
+    while (!monitor->stop)
+    {
+        uint8_t header = readPacket(monitor->connection, body, 100);
+        if ((header >> 4) != 3 || (header & 1))
+        {
+            continue;
+        }
+        uint64_t now = nowUs();
+        size_t topicLength = body.size() >= 2 ? ((uint8_t)body[0] << 8) | (uint8_t)body[1] : 0;
+        std::string topic = body.substr(2, topicLength);
+        std::string payload = body.substr(std::min(body.size(), 2 + topicLength));
+        uint32_t number = messageNumber(payload.data(), payload.size());
+
+        std::lock_guard<std::mutex> lock(monitor->mutex);
+        if (topicLength == 0 || number >= MAX_MESSAGES)
+        {
+            monitor->malformed++;
+            continue;
+        }
+        auto last = monitor->lastNumber.find(topic);
+        if (last != monitor->lastNumber.end() && last->second >= number)
+        {
+            monitor->outOfOrder++;
+        }
+        monitor->lastNumber[topic] = number;
+        arrived[number] = 1;
+        monitor->latencyUs.push_back((uint32_t)(now - enqueuedUs[number]));
+        monitor->delivered++;
+        monitor->bytes += payload.size();
+        monitor->firstUs = monitor->firstUs == 0 ? now : monitor->firstUs;
+        monitor->lastUs = now;
+    }
+}
+
+/*
+ * Scenarios
+ */
+
+struct Scenario
+{
+    const char *name;
+    MqttQueuePolicy policy;
+    bool bulk;            // Full-size non-coalescing messages, waiting for space, instead of readings
+    double intervalMs;    // Between two rounds of readings
+    double linkBytesPerS; // 0: unthrottled
+    double durationS;
+    bool withinCapacity;  // Nothing may be dropped, coalesced or given up on
+};
+
+struct Outcome
+{
+    bool ok = true;
+    uint64_t offered = 0;  // Publish attempts
+    uint64_t rejected = 0; // Publishes that gave up waiting for space
+    MqttQueueStats stats = {};
+    uint64_t delivered = 0;
+    uint64_t lost = 0; // Queued, never displaced, never arrived
+    double offeredPerS = 0;
+    double deliveredPerS = 0;
+    double kBytesPerS = 0;
+    double p50Ms = 0;
+    double p99Ms = 0;
+    double maxMs = 0;
+};
+
+static void fail(Outcome &outcome, const Scenario &scenario, const char *what, unsigned long long value)
+{
+    if (outcome.ok)
+    {
+        printf("  %s: %s %llu\n", scenario.name, what, value);
+    }
+    outcome.ok = false;
+}
+
+static Outcome runScenario(const Scenario &scenario, Device &device, Monitor &monitor, char topics[][MQTT_TOPIC_MAX],
+                           const char *bulkTopic, uint32_t &nextNumber)
+{
+    Outcome outcome;
+    {
+        std::lock_guard<std::mutex> queueLock(device.queueMutex);
+        std::lock_guard<std::mutex> linkLock(device.linkMutex);
+        resetMqttQueue(device.queue, device.entries.data());
+        device.policy = scenario.policy;
+        device.linkBytesPerS = scenario.linkBytesPerS;
+    }
+    resetMonitor(monitor);
+
+    std::map<std::string, uint32_t> lastQueued;
+    uint32_t firstNumber = nextNumber;
+    uint64_t start = nowUs();
+    uint64_t end = start + (uint64_t)(scenario.durationS * 1e6);
+    std::string payload;
+    char value[16];
+    for (uint64_t round = 0; nowUs() < end && nextNumber + NUM_CHANNELS < MAX_MESSAGES; round++)
+    {
+        if (scenario.bulk)
+        {
+            uint32_t number = nextNumber++;
+            payload = "n=" + std::to_string(number) + ";";
+            payload.resize(MQTT_QUEUE_PAYLOAD_MAX, 'x');
+            outcome.offered++;
+            if (!waitForSpace(device, WAIT_FOR_SPACE_MS))
+            {
+                outcome.rejected++;
+                continue;
+            }
+            enqueuedUs[number] = nowUs();
+            if (devicePublish(device, number, bulkTopic, payload, false, false))
+            {
+                lastQueued[bulkTopic] = number;
+            }
+            continue;
+        }
+
+        uint64_t due = start + (uint64_t)(round * scenario.intervalMs * 1000);
+        uint64_t now = nowUs();
+        if (due > now)
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(due - now));
+        }
+        for (int ch = 0; ch < NUM_CHANNELS; ch++)
+        {
+            *CHANNELS[ch].value = 20.0f + 5.0f * sinf(round * 0.01f + ch);
+            formatChannelValue((SensorChannel)ch, value, sizeof(value));
+            uint32_t number = nextNumber++;
+            payload = std::string(value) + ";n=" + std::to_string(number);
+            outcome.offered++;
+            enqueuedUs[number] = nowUs();
+            if (devicePublish(device, number, topics[ch], payload, true, true))
+            {
+                lastQueued[topics[ch]] = number;
+            }
+        }
+    }
+    double producedS = (nowUs() - start) / 1e6;
+
+    // Let the queue drain and the monitor catch up
+    uint64_t deadline = nowUs() + SETTLE_TIMEOUT_MS * 1000ull;
+    for (;;)
+    {
+        bool idle = deviceIdle(device);
+        device.queueMutex.lock();
+        outcome.stats = device.queue.stats;
+        device.queueMutex.unlock();
+        monitor.mutex.lock();
+        bool arrived = monitor.delivered >= outcome.stats.sent;
+        monitor.mutex.unlock();
+        if ((idle && arrived) || nowUs() >= deadline)
+        {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100)); // Anything beyond what was sent
+
+    std::lock_guard<std::mutex> lock(monitor.mutex);
+    outcome.delivered = monitor.delivered;
+    outcome.offeredPerS = outcome.offered / producedS;
+    double spanS = monitor.lastUs > monitor.firstUs ? (monitor.lastUs - start) / 1e6 : producedS;
+    outcome.deliveredPerS = monitor.delivered / spanS;
+    outcome.kBytesPerS = monitor.bytes / spanS / 1000;
+    std::vector<uint32_t> &latency = monitor.latencyUs;
+    std::sort(latency.begin(), latency.end());
+    if (!latency.empty())
+    {
+        outcome.p50Ms = latency[latency.size() / 2] / 1000.0;
+        outcome.p99Ms = latency[latency.size() * 99 / 100] / 1000.0;
+        outcome.maxMs = latency.back() / 1000.0;
+    }
+
+    if (monitor.delivered != outcome.stats.sent)
+    {
+        fail(outcome, scenario, "delivered, differing from sent:", monitor.delivered);
+    }
+    if (monitor.outOfOrder > 0 || monitor.malformed > 0)
+    {
+        fail(outcome, scenario, "out of order or malformed:", monitor.outOfOrder + monitor.malformed);
+    }
+    for (uint32_t number = firstNumber; number < nextNumber; number++)
+    {
+        if (fates[number] == FATE_QUEUED && !arrived[number])
+        {
+            outcome.lost++;
+        }
+    }
+    if (outcome.lost > 0)
+    {
+        fail(outcome, scenario, "lost without being displaced:", outcome.lost);
+    }
+    for (const auto &queued : lastQueued)
+    {
+        auto last = monitor.lastNumber.find(queued.first);
+        if (last == monitor.lastNumber.end() || last->second != queued.second)
+        {
+            fail(outcome, scenario, "newest message missing, number", queued.second);
+        }
+    }
+    if (scenario.withinCapacity && outcome.stats.dropped + outcome.stats.coalesced + outcome.rejected > 0)
+    {
+        fail(outcome, scenario, "dropped, coalesced or rejected within capacity:",
+             outcome.stats.dropped + outcome.stats.coalesced + outcome.rejected);
+    }
+    return outcome;
+}
+
+static bool resolveBroker(const char *spec, sockaddr_in &address)
+{
+    std::string host(spec);
+    int port = 1883;
+    size_t colon = host.rfind(':');
+    if (colon != std::string::npos)
+    {
+        port = atoi(host.c_str() + colon + 1);
+        host.resize(colon);
+    }
+    addrinfo hints = {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo *result = NULL;
+    if (getaddrinfo(host.c_str(), NULL, &hints, &result) != 0 || result == NULL)
+    {
+        return false;
+    }
+    address = *(sockaddr_in *)result->ai_addr;
+    address.sin_port = htons(port);
+    freeaddrinfo(result);
+    return true;
+}
+
+// getChannelLevel() in sensor_channels.cpp needs the runtime thresholds;
+// the test uses the defaults
+ChannelThresholds getChannelThresholds(SensorChannel channel)
+{
+    return {CHANNELS[channel].warn, CHANNELS[channel].alarm};
+}
+
+int main(int argc, char **argv)
+{
+    BrokerStandIn standIn;
+    sockaddr_in broker = {};
+    if (argc == 3 && strcmp(argv[1], "--broker") == 0)
+    {
+        if (!resolveBroker(argv[2], broker))
+        {
+            fprintf(stderr, "cannot resolve %s\n", argv[2]);
+            return 2;
+        }
+    }
+    else if (argc == 1)
+    {
+        broker.sin_family = AF_INET;
+        broker.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        broker.sin_port = htons(startBrokerStandIn(standIn));
+    }
+    else
+    {
+        fprintf(stderr, "usage: %s [--broker host:port]\n", argv[0]);
+        return 2;
+    }
+
+    // The device's own topics, as the firmware maps them
+    static const uint8_t MAC[6] = {0x24, 0x6f, 0x28, 0xa1, 0xb2, 0xc4};
+    MqttIdentity identity;
+    buildMQTTIdentity(identity, MAC);
+    char topics[NUM_CHANNELS][MQTT_TOPIC_MAX];
+    for (int ch = 0; ch < NUM_CHANNELS; ch++)
+    {
+        mapDeviceTopic(identity, CHANNELS[ch].topic, topics[ch], sizeof(topics[ch]));
+    }
+    char bulkTopic[MQTT_TOPIC_MAX];
+    char filter[MQTT_TOPIC_MAX];
+    mapDeviceTopic(identity, TOPIC_SENSOR_BASE "/queue_check/bulk", bulkTopic, sizeof(bulkTopic));
+    mapDeviceTopic(identity, TOPIC_SENSOR_BASE "/#", filter, sizeof(filter));
+
+    Device device;
+    Monitor monitor;
+    if (!connectClient(device.connection, broker, identity.clientId) ||
+        !connectClient(monitor.connection, broker, "mqtt-queue-check") || !subscribe(monitor.connection, filter))
+    {
+        fprintf(stderr, "cannot connect and subscribe to the broker\n");
+        return 2;
+    }
+    resetMqttQueue(device.queue, device.entries.data());
+    std::thread linkThread(runLink, &device);
+    std::thread drainThread(runDrain, &device);
+    std::thread monitorThread(runMonitor, &monitor);
+
+    // 12 channels per round: 10 Hz is far below any link, 1 kHz saturates
+    // the loopback; 16 kB/s is a weak Wi-Fi link
+    const Scenario scenarios[] = {
+        {"readings 10 Hz", MQTT_COALESCE, false, 100, 0, 3, true},
+        {"readings 1 kHz", MQTT_COALESCE, false, 1, 0, 3, false},
+        {"readings 50 Hz, 16 kB/s, coalesce", MQTT_COALESCE, false, 20, 16000, 3, false},
+        {"readings 50 Hz, 16 kB/s, drop oldest", MQTT_DROP_OLDEST, false, 20, 16000, 3, false},
+        {"bulk", MQTT_COALESCE, true, 0, 0, 2, true},
+        {"bulk, 16 kB/s", MQTT_COALESCE, true, 0, 16000, 3, true},
+    };
+
+    printf("broker %s:%d, device %s, queue %d x %d bytes, send buffer %d bytes\n\n", inet_ntoa(broker.sin_addr),
+           ntohs(broker.sin_port), identity.clientId, MQTT_QUEUE_LENGTH, MQTT_QUEUE_PAYLOAD_MAX, LINK_SEND_BUFFER);
+    printf("%-37s %9s %9s %8s %8s %8s %8s %8s %9s %5s\n", "scenario", "offer/s", "deliv/s", "kB/s", "p50 ms",
+           "p99 ms", "max ms", "dropped", "coalesced", "high");
+    bool ok = true;
+    uint32_t nextNumber = 0;
+    for (const Scenario &scenario : scenarios)
+    {
+        Outcome outcome = runScenario(scenario, device, monitor, topics, bulkTopic, nextNumber);
+        ok = ok && outcome.ok;
+        printf("%-37s %9.0f %9.0f %8.1f %8.2f %8.2f %8.2f %8u %9u %5u%s\n", scenario.name, outcome.offeredPerS,
+               outcome.deliveredPerS, outcome.kBytesPerS, outcome.p50Ms, outcome.p99Ms, outcome.maxMs,
+               outcome.stats.dropped + (uint32_t)outcome.rejected, outcome.stats.coalesced, outcome.stats.highWater,
+               outcome.ok ? "" : "  FAIL");
+    }
+
+    device.stop = true;
+    monitor.stop = true;
+    device.linkCondition.notify_one();
+    notifyDrain(device);
+    linkThread.join();
+    drainThread.join();
+    monitorThread.join();
+    close(device.connection.fd);
+    close(monitor.connection.fd);
+    if (broker.sin_port == htons(standIn.port))
+    {
+        stopBrokerStandIn(standIn);
+        printf("\nbroker: %llu messages routed, %llu protocol errors\n", (unsigned long long)standIn.routed,
+               (unsigned long long)standIn.protocolErrors);
+        ok = ok && standIn.protocolErrors == 0;
+    }
+    printf("%s\n", ok ? "all messages accounted for" : "FAILED");
+    return ok ? 0 : 1;
+}
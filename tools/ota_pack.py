@@ -0,0 +1,79 @@
+#!/usr/bin/env python3
+"""Pack a firmware image for compressed OTA and optionally upload it.
+
+    python tools/ota_pack.py .pio/build/esp32dev/firmware.bin
+    python tools/ota_pack.py .pio/build/esp32dev/firmware.bin --upload 192.168.1.40
+
+The packed image is an OtaPackHeader (include/ota_pack.h) followed by the
+firmware as one zlib stream. The device inflates it into a 4 kB window, so
+the stream is compressed with wbits = OTA_PACK_MAX_WINDOW_BITS.
+"""
+
+import argparse
+import base64
+import hashlib
+import http.client
+import struct
+import sys
+import time
+import zlib
+
+OTA_PACK_MAGIC = 0x315A4348  # "HCZ1"
+OTA_PACK_VERSION = 1
+OTA_PACK_MAX_WINDOW_BITS = 12
+HEADER_FORMAT = "<IBBHII32s"  # Must match OtaPackHeader
+OTA_HTTP_USER = "ota"
+
+
+def pack(image, level=9):
+    compressor = zlib.compressobj(level, zlib.DEFLATED, OTA_PACK_MAX_WINDOW_BITS, 9)
+    stream = compressor.compress(image) + compressor.flush()
+    header = struct.pack(HEADER_FORMAT, OTA_PACK_MAGIC, OTA_PACK_VERSION, OTA_PACK_MAX_WINDOW_BITS, 0,
+                         len(image), len(stream), hashlib.sha256(image).digest())
+    return header + stream
+
+
+def upload(host, port, password, packed, timeout):
+    auth = base64.b64encode(f"{OTA_HTTP_USER}:{password}".encode()).decode()
+    connection = http.client.HTTPConnection(host, port, timeout=timeout)
+    start = time.monotonic()
+    connection.request("POST", "/ota", body=packed, headers={
+        "Content-Type": "application/octet-stream",
+        "Authorization": f"Basic {auth}",
+    })
+    response = connection.getresponse()
+    text = response.read().decode(errors="replace").strip()
+    return response.status, text, time.monotonic() - start
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("firmware", help="firmware.bin built by PlatformIO")
+    parser.add_argument("-o", "--output", help="packed image (default: <firmware>.hcz)")
+    parser.add_argument("--level", type=int, default=9, help="zlib level 1-9 (default 9)")
+    parser.add_argument("--upload", metavar="HOST", help="POST the packed image to http://HOST/ota")
+    parser.add_argument("--port", type=int, default=80)
+    parser.add_argument("--password", default="Password123!", help="OTA_PASSWORD of the device")
+    parser.add_argument("--timeout", type=float, default=120)
+    args = parser.parse_args()
+
+    with open(args.firmware, "rb") as f:
+        image = f.read()
+    packed = pack(image, args.level)
+    output = args.output or args.firmware.rsplit(".", 1)[0] + ".hcz"
+    with open(output, "wb") as f:
+        f.write(packed)
+    print(f"{output}: {len(image)} -> {len(packed)} bytes, ratio {len(image) / len(packed):.2f}x, "
+          f"sha256 {hashlib.sha256(image).hexdigest()}")
+
+    if args.upload:
+        status, text, seconds = upload(args.upload, args.port, args.password, packed, args.timeout)
+        print(f"{args.upload}: HTTP {status} after {seconds:.1f} s "
+              f"({len(packed) / 1024 / seconds:.1f} KB/s on the wire, {len(image) / 1024 / seconds:.1f} KB/s "
+              f"of image): {text}")
+        return 0 if status == 200 else 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,229 @@
+// Rolling statistics benchmark: times the per-sample update of the
+// portable window kernels of rolling_window.cpp and checks every summary
+// against a brute-force pass over the same window. No dependencies beyond
+// libstdc++:
+//
+//   g++ -std=c++17 -O2 -Iinclude -o stats_bench
+//       tools/stats_bench.cpp src/rolling_window.cpp
+//   ./stats_bench
+//
+// Each signal is pushed through one window of STATS_WINDOW_SLOTS slots,
+// with the sampling period changing every RATE_BLOCK samples between the
+// adaptive MQ-2 bounds (250 ms to 5 s), so a window holds anywhere from
+// 60 to 1200 readings. The cost is nanoseconds per pushRollingWindow(),
+// per push plus summarizeRollingWindow() (what a sampler and a reader do
+// together), and per brute-force recomputation of the window for
+// comparison. Spikes put the extremes in a single reading.
+//
+// The reference takes every reading whose slot is among the last
+// STATS_WINDOW_SLOTS at the time of the summary. Count, min and max must
+// match exactly. Mean and standard deviation may differ from the
+// double-precision reference by float rounding of the per-slot Welford
+// updates and of the merge; the largest difference is reported relative
+// to the signal's spread.
+#include <math.h>
+#include <stdio.h>
+#include <time.h>
+#include <random>
+#include <vector>
+#include "rolling_stats.h"
+
+#define BENCH_SAMPLES 2000000 // Timed pushes per signal
+#define CHECK_SAMPLES 200000  // Pushes checked against the brute-force window
+#define RATE_BLOCK 1000       // Samples between sampling period changes
+#define MEAN_TOLERANCE 1e-4   // Relative to the signal's spread
+#define STDDEV_TOLERANCE 2e-3
+
+static double nowS()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Adaptive sampling periods, as the MQ-2 moves between its bounds
+static const uint32_t PERIODS_MS[] = {250, 500, 1000, 2500, 5000};
+#define PERIOD_COUNT (sizeof(PERIODS_MS) / sizeof(PERIODS_MS[0]))
+
+// Test signal: name and spread, values and sample times generated up front
+struct Signal
+{
+    const char *name;
+    double spread;
+    std::vector<float> values;
+    std::vector<uint32_t> timesMs;
+};
+
+static Signal makeSignal(const char *name, int count)
+{
+    Signal signal = {name, 0, std::vector<float>(count), std::vector<uint32_t>(count)};
+    std::mt19937 rng(12345);
+    std::normal_distribution<float> noise(0.0f, 0.05f);
+    uint32_t periodMs = PERIODS_MS[0];
+    uint32_t timeMs = 0;
+    for (int i = 0; i < count; i++)
+    {
+        if (i % RATE_BLOCK == 0)
+        {
+            periodMs = PERIODS_MS[rng() % PERIOD_COUNT];
+        }
+        timeMs += periodMs;
+        signal.timesMs[i] = timeMs;
+
+        float value;
+        switch (name[0])
+        {
+        case 't': // Room temperature with sensor noise
+            value = 22.0f + 0.5f * sinf(i * 2e-4f) + noise(rng);
+            break;
+        case 'r': // Rising ramp
+            value = 1000.0f + 0.01f * (i % 100000);
+            break;
+        case 'f': // Falling ramp
+            value = 2000.0f - 0.01f * (i % 100000);
+            break;
+        case 's': // Alarm spikes on a flat MQ-2 baseline
+            value = i % 500 < 5 ? 5000.0f : 200.0f + 10.0f * noise(rng);
+            break;
+        default: // Uniform noise
+            value = std::uniform_real_distribution<float>(-1000.0f, 1000.0f)(rng);
+            break;
+        }
+        signal.values[i] = value;
+    }
+    float lo = signal.values[0];
+    float hi = signal.values[0];
+    for (float value : signal.values)
+    {
+        lo = fminf(lo, value);
+        hi = fmaxf(hi, value);
+    }
+    signal.spread = hi > lo ? hi - lo : 1.0;
+    return signal;
+}
+
+// First reading of the window that ends with reading `end`
+static int windowStart(const Signal &signal, int end, int start)
+{
+    uint32_t newest = signal.timesMs[end] / STATS_SLOT_MS;
+    while (newest - signal.timesMs[start] / STATS_SLOT_MS >= STATS_WINDOW_SLOTS)
+    {
+        start++;
+    }
+    return start;
+}
+
+// Min, max, mean and sample standard deviation of the values from `start`
+// to `end`, in double precision
+static StatsSummary bruteForce(const float *values, int start, int end, double &mean, double &stddev)
+{
+    uint32_t count = end - start + 1;
+    StatsSummary summary = {values[end], values[end], 0, 0, count};
+    double sum = 0;
+    for (int i = start; i <= end; i++)
+    {
+        summary.min = fminf(summary.min, values[i]);
+        summary.max = fmaxf(summary.max, values[i]);
+        sum += values[i];
+    }
+    mean = sum / count;
+    double m2 = 0;
+    for (int i = start; i <= end; i++)
+    {
+        m2 += (values[i] - mean) * (values[i] - mean);
+    }
+    stddev = count > 1 ? sqrt(m2 / (count - 1)) : 0;
+    return summary;
+}
+
+// Pushes the first CHECK_SAMPLES values and compares every summary;
+// returns false on a min/max mismatch or an error above tolerance
+static bool checkSignal(const Signal &signal, double &meanError, double &stddevError)
+{
+    RollingWindow window;
+    resetRollingWindow(window);
+    meanError = 0;
+    stddevError = 0;
+    bool ok = true;
+    int start = 0;
+
+    for (int i = 0; i < CHECK_SAMPLES; i++)
+    {
+        pushRollingWindow(window, signal.values[i], signal.timesMs[i]);
+        StatsSummary summary = summarizeRollingWindow(window, signal.timesMs[i]);
+        start = windowStart(signal, i, start);
+        double mean;
+        double stddev;
+        StatsSummary reference = bruteForce(signal.values.data(), start, i, mean, stddev);
+
+        if (summary.count != reference.count || summary.min != reference.min || summary.max != reference.max)
+        {
+            if (ok)
+            {
+                printf("  %s: sample %d: count %u/%u min %g/%g max %g/%g\n", signal.name, i, summary.count,
+                       reference.count, summary.min, reference.min, summary.max, reference.max);
+            }
+            ok = false;
+        }
+        meanError = fmax(meanError, fabs(summary.mean - mean) / signal.spread);
+        stddevError = fmax(stddevError, fabs(summary.stddev - stddev) / signal.spread);
+    }
+    return ok && meanError <= MEAN_TOLERANCE && stddevError <= STDDEV_TOLERANCE;
+}
+
+int main()
+{
+    const char *names[] = {"temperature", "noise", "rising", "falling", "spikes"};
+    volatile float sink = 0;
+    bool ok = true;
+
+    printf("window %lu ms in %d slots, %d timed pushes per signal\n\n", (unsigned long)STATS_WINDOW_MS,
+           STATS_WINDOW_SLOTS, BENCH_SAMPLES);
+    printf("%-12s %10s %14s %12s %12s %12s\n", "signal", "push ns", "push+sum ns", "brute ns", "mean err", "stddev err");
+
+    for (const char *name : names)
+    {
+        Signal signal = makeSignal(name, BENCH_SAMPLES);
+        RollingWindow window;
+
+        resetRollingWindow(window);
+        double start = nowS();
+        for (int i = 0; i < BENCH_SAMPLES; i++)
+        {
+            pushRollingWindow(window, signal.values[i], signal.timesMs[i]);
+        }
+        double pushNs = (nowS() - start) * 1e9 / BENCH_SAMPLES;
+        sink = sink + window.slots[0].mean;
+
+        resetRollingWindow(window);
+        start = nowS();
+        for (int i = 0; i < BENCH_SAMPLES; i++)
+        {
+            pushRollingWindow(window, signal.values[i], signal.timesMs[i]);
+            sink = sink + summarizeRollingWindow(window, signal.timesMs[i]).stddev;
+        }
+        double bothNs = (nowS() - start) * 1e9 / BENCH_SAMPLES;
+
+        int bruteSamples = BENCH_SAMPLES / 10;
+        int first = 0;
+        start = nowS();
+        for (int i = 0; i < bruteSamples; i++)
+        {
+            double mean;
+            double stddev;
+            first = windowStart(signal, i, first);
+            sink = sink + bruteForce(signal.values.data(), first, i, mean, stddev).min + stddev;
+        }
+        double bruteNs = (nowS() - start) * 1e9 / bruteSamples;
+
+        double meanError;
+        double stddevError;
+        bool passed = checkSignal(signal, meanError, stddevError);
+        ok = ok && passed;
+        printf("%-12s %10.1f %14.1f %12.1f %12.2e %12.2e%s\n", name, pushNs, bothNs, bruteNs, meanError, stddevError,
+               passed ? "" : "  FAIL");
+    }
+
+    printf("\n%s\n", ok ? "all summaries match" : "MISMATCH");
+    return ok ? 0 : 1;
+}
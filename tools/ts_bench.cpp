@@ -0,0 +1,310 @@
+// Time-series codec benchmark: encodes synthetic sensor series with the
+// Gorilla codec of ts_codec.cpp, decodes them again and asserts that every
+// timestamp and every value bit comes back unchanged. No dependencies
+// beyond libstdc++:
+//
+//   g++ -std=c++17 -O2 -Iinclude -o ts_bench tools/ts_bench.cpp src/ts_codec.cpp
+//   ./ts_bench
+//
+// Each series is simulated for BENCH_DAYS at its sensor's default period
+// (timestamps in whole seconds, as appendTimeSeries() gets them) and
+// rolled up into 1 s raw, minute and hour means like the store does; the
+// KY-038 records one peak level per second. Blocks are closed by the
+// store's rule: a sample is only encoded while TS_MAX_SAMPLE_BITS still
+// fit. Raw rings have their sensor's TS_RAW_BLOCKS_FOR() blocks.
+//
+// Per series and tier the table gives bits per sample, the compression
+// ratio against plain (uint32 timestamp, float) pairs, the samples one
+// TS_BLOCK_BYTES block holds, encode and decode speed, and the history a
+// ring of that tier keeps. A full ring recycles its oldest block, so the
+// retained span is between (blocks - 1) and blocks full blocks; the lower
+// bound is reported.
+//
+// A second pass encodes random timestamps on every delta-of-delta bucket
+// boundary and random float bit patterns (including NaN and infinities).
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <random>
+#include <vector>
+#include "time_series_store.h"
+
+#define BENCH_DAYS 30
+#define BENCH_REPEATS 5        // Timing passes over the encoded blocks
+#define FUZZ_SAMPLES 2000000   // Random samples for the exactness pass
+
+static std::mt19937 rng(12345);
+
+static double nowS()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+struct Sample
+{
+    uint32_t timestamp;
+    float value;
+};
+
+// Simulated channel: name, sensor period, raw ring blocks and a value at
+// time t (seconds)
+struct Series
+{
+    const char *name;
+    double periodS;
+    int rawBlocks;
+    float (*value)(double t);
+};
+
+static std::normal_distribution<float> noise(0.0f, 1.0f);
+
+static float diurnal(double t)
+{
+    return sinf((float)(t * 2.0 * M_PI / 86400.0));
+}
+
+static float temperatureAt(double t) { return 21.5f + 2.0f * diurnal(t) + 0.03f * noise(rng); }
+static float humidityAt(double t) { return 45.0f - 8.0f * diurnal(t) + 0.2f * noise(rng); }
+static float pressureAt(double t) { return 1013.25f + 4.0f * sinf((float)(t / 200000.0)) + 0.05f * noise(rng); }
+static float gasAt(double t) { return 80.0f + 20.0f * diurnal(t) + 1.5f * noise(rng); }
+static float smokeAt(double) { return 12.0f * expf(0.05f * noise(rng)); }
+static float soundAt(double) { return roundf(45.0f + 3.0f * noise(rng)); } // Whole dB, like soundDecibelsFromRaw()
+
+static const Series SERIES[] = {
+    {"temperature", 10.0, TS_RAW_BLOCKS_BME680, temperatureAt},
+    {"humidity", 10.0, TS_RAW_BLOCKS_BME680, humidityAt},
+    {"pressure", 10.0, TS_RAW_BLOCKS_BME680, pressureAt},
+    {"gas", 10.0, TS_RAW_BLOCKS_BME680, gasAt},
+    {"smoke", 1.0, TS_RAW_BLOCKS_MQ2, smokeAt},
+    {"sound", 1.0, TS_RAW_BLOCKS_KY038, soundAt},
+};
+
+static const char *const TIER_NAMES[TS_NUM_RESOLUTIONS] = {"raw", "minute", "hour"};
+static const uint32_t TIER_SECONDS[TS_NUM_RESOLUTIONS] = {1, 60, 3600};
+static const int TIER_BLOCKS[TS_NUM_RESOLUTIONS] = {0, TS_MINUTE_BLOCKS, TS_HOUR_BLOCKS}; // Raw: per series
+
+// Encodes the samples into as many blocks as needed
+static std::vector<TsBlock> encodeAll(const std::vector<Sample> &samples)
+{
+    std::vector<TsBlock> blocks(1);
+    blocks[0].count = 0;
+    for (const Sample &sample : samples)
+    {
+        if (blocks.back().count > 0 && blocks.back().bitLength + TS_MAX_SAMPLE_BITS > TS_BLOCK_BYTES * 8)
+        {
+            blocks.emplace_back();
+            blocks.back().count = 0;
+        }
+        encodeTimeSeriesSample(blocks.back(), sample.timestamp, sample.value);
+    }
+    return blocks;
+}
+
+// Decodes every block; counts samples that differ from the input in
+// timestamp or in any value bit
+static size_t decodeAll(const std::vector<TsBlock> &blocks, const std::vector<Sample> *expected)
+{
+    size_t mismatches = 0;
+    size_t index = 0;
+    volatile uint32_t sink = 0;
+    for (const TsBlock &block : blocks)
+    {
+        TsIterator it = {};
+        for (it.sampleIndex = 0; it.sampleIndex < block.count;)
+        {
+            decodeTimeSeriesSample(it, block);
+            if (expected == NULL)
+            {
+                sink = sink + it.valueBits;
+                continue;
+            }
+            const Sample &sample = (*expected)[index++];
+            uint32_t bits;
+            memcpy(&bits, &sample.value, sizeof(bits));
+            if (it.timestamp != sample.timestamp || it.valueBits != bits)
+            {
+                if (mismatches == 0)
+                {
+                    printf("  sample %zu: got (%u, 0x%08x), want (%u, 0x%08x)\n", index - 1, it.timestamp,
+                           it.valueBits, sample.timestamp, bits);
+                }
+                mismatches++;
+            }
+        }
+    }
+    if (expected != NULL && index != expected->size())
+    {
+        printf("  decoded %zu of %zu samples\n", index, expected->size());
+        mismatches++;
+    }
+    return mismatches;
+}
+
+// Running mean of one tier's bucket, as in the store
+struct Rollup
+{
+    uint32_t bucketStart;
+    float sum;
+    uint16_t count;
+};
+
+// Closes a bucket when a sample opens the next one and cascades its mean
+// into the next coarser tier, like accumulateRollup()
+static void rollUp(std::vector<Sample> tiers[TS_NUM_RESOLUTIONS], Rollup rollups[TS_NUM_RESOLUTIONS], int res,
+                   Sample sample)
+{
+    Rollup &rollup = rollups[res];
+    uint32_t bucket = sample.timestamp - sample.timestamp % TIER_SECONDS[res];
+    if (rollup.count > 0 && bucket != rollup.bucketStart)
+    {
+        Sample mean = {rollup.bucketStart, rollup.sum / rollup.count};
+        tiers[res].push_back(mean);
+        if (res + 1 < TS_NUM_RESOLUTIONS)
+        {
+            rollUp(tiers, rollups, res + 1, mean);
+        }
+        rollup.count = 0;
+        rollup.sum = 0;
+    }
+    if (rollup.count == 0)
+    {
+        rollup.bucketStart = bucket;
+    }
+    rollup.sum += sample.value;
+    rollup.count++;
+}
+
+// Simulates one series at its sensor period
+static void simulate(const Series &series, std::vector<Sample> tiers[TS_NUM_RESOLUTIONS])
+{
+    Rollup rollups[TS_NUM_RESOLUTIONS] = {};
+    long total = (long)(BENCH_DAYS * 86400.0 / series.periodS);
+
+    for (long i = 0; i < total; i++)
+    {
+        double t = i * series.periodS;
+        rollUp(tiers, rollups, TS_RAW, {(uint32_t)t, series.value(t)});
+    }
+}
+
+static void formatSpan(char *text, size_t size, double seconds)
+{
+    if (seconds < 60)
+    {
+        snprintf(text, size, "%.1f s", seconds);
+    }
+    else if (seconds < 3600)
+    {
+        snprintf(text, size, "%.0f min", seconds / 60);
+    }
+    else if (seconds < 2 * 86400)
+    {
+        snprintf(text, size, "%.1f h", seconds / 3600);
+    }
+    else
+    {
+        snprintf(text, size, "%.1f d", seconds / 86400);
+    }
+}
+
+// Random timestamps on and around every bucket boundary, and random value
+// bits; returns the number of mismatches
+static size_t fuzz()
+{
+    static const int32_t EDGES[] = {0, 1, -1, 63, 64, -64, -65, 255, 256, -256, -257, 2047, 2048, -2048, -2049};
+    std::vector<Sample> samples(FUZZ_SAMPLES);
+    uint32_t timestamp = 1000000;
+    int32_t delta = 0;
+    for (Sample &sample : samples)
+    {
+        int32_t dod = rng() % 4 == 0 ? (int32_t)(rng() % 200001) - 100000 : EDGES[rng() % (sizeof(EDGES) / 4)];
+        if ((int64_t)delta + dod < 0)
+        {
+            dod = -delta; // Keep time monotonic, as the store does
+        }
+        delta += dod;
+        timestamp += delta;
+        uint32_t bits = rng() % 8 == 0 ? 0x7FC00000u : rng() % 8 == 0 ? 0x7F800000u : (uint32_t)rng();
+        if (rng() % 4 == 0)
+        {
+            bits ^= 1u << (rng() % 32); // Small XORs reuse the previous window
+        }
+        memcpy(&sample.value, &bits, sizeof(bits));
+        sample.timestamp = timestamp;
+        delta = delta > 1000000 ? 0 : delta;
+    }
+    return decodeAll(encodeAll(samples), &samples);
+}
+
+int main()
+{
+    size_t failures = 0;
+
+    printf("%d-byte blocks, %d days simulated per series\n\n", TS_BLOCK_BYTES, BENCH_DAYS);
+    printf("%-12s %-6s %9s %8s %7s %11s %11s %9s %6s %9s\n", "series", "tier", "samples", "bits/smp", "ratio",
+           "smp/block", "enc Msmp/s", "dec Msmp/s", "blocks", "retained");
+
+    for (const Series &series : SERIES)
+    {
+        std::vector<Sample> tiers[TS_NUM_RESOLUTIONS];
+        simulate(series, tiers);
+
+        for (int res = 0; res < TS_NUM_RESOLUTIONS; res++)
+        {
+            const std::vector<Sample> &samples = tiers[res];
+            if (samples.empty())
+            {
+                continue;
+            }
+
+            double start = nowS();
+            std::vector<TsBlock> blocks;
+            for (int r = 0; r < BENCH_REPEATS; r++)
+            {
+                blocks = encodeAll(samples);
+            }
+            double encodeRate = samples.size() * BENCH_REPEATS / (nowS() - start) / 1e6;
+
+            start = nowS();
+            for (int r = 0; r < BENCH_REPEATS; r++)
+            {
+                decodeAll(blocks, NULL);
+            }
+            double decodeRate = samples.size() * BENCH_REPEATS / (nowS() - start) / 1e6;
+
+            size_t mismatches = decodeAll(blocks, &samples);
+            failures += mismatches;
+
+            // Full blocks only: the last one is still open
+            size_t bits = 0;
+            size_t fullSamples = 0;
+            for (size_t b = 0; b + 1 < blocks.size(); b++)
+            {
+                bits += blocks[b].bitLength;
+                fullSamples += blocks[b].count;
+            }
+            double perBlock = blocks.size() > 1 ? (double)fullSamples / (blocks.size() - 1) : samples.size();
+            double bitsPerSample = fullSamples > 0 ? (double)bits / fullSamples : 0;
+
+            double spacing = res == TS_RAW ? fmax(series.periodS, 1.0) : TIER_SECONDS[res];
+            int ringBlocks = res == TS_RAW ? series.rawBlocks : TIER_BLOCKS[res];
+            double retained = (ringBlocks - 1) * perBlock * spacing;
+            char span[16];
+            formatSpan(span, sizeof(span), retained);
+
+            printf("%-12s %-6s %9zu %8.1f %6.1fx %11.0f %11.1f %11.1f %6d %9s%s\n", series.name, TIER_NAMES[res],
+                   samples.size(), bitsPerSample, bitsPerSample > 0 ? 64.0 / bitsPerSample : 0.0, perBlock,
+                   encodeRate, decodeRate, ringBlocks, span, mismatches ? "  MISMATCH" : "");
+        }
+    }
+
+    size_t fuzzMismatches = fuzz();
+    failures += fuzzMismatches;
+    printf("\nrandom timestamps and value bits: %d samples, %zu mismatches\n", FUZZ_SAMPLES, fuzzMismatches);
+    printf("%s\n", failures == 0 ? "round trip exact" : "ROUND TRIP FAILED");
+    return failures == 0 ? 0 : 1;
+}